@@ -0,0 +1,18 @@
+// Instanced vegetation billboards.
+#version 120
+
+uniform sampler2D atlas;    // Grass texture atlas
+
+varying vec2 uv;
+varying vec3 light;         // Ambient and diffuse light of the bush
+
+void main()
+{
+    vec4 texel = texture2D(atlas, uv);
+    
+    // Drop the fully transparent texels so they don't write the depth buffer
+    if (texel.a < 0.1)
+        discard;
+    
+    gl_FragColor = vec4(texel.rgb * light, texel.a);
+}
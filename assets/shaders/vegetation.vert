@@ -0,0 +1,34 @@
+// Instanced vegetation billboards.
+// Every bush is a single instance (position, size, species) and the quad is expanded here,
+// always facing the camera around the vertical axis and bent at the top by the wind.
+#version 120
+
+attribute vec2 corner;      // Quad corner: x in [-1, 1] (left/right), y in [0, 1] (bottom/top)
+attribute vec4 instance;    // Bush root position (xyz) and size (w)
+attribute float species;    // Column of the bush in the texture atlas (0 lowlands, 1 highlands)
+
+uniform float time;         // Wind time
+uniform vec3 light_position; // World position of the sun or the moon
+uniform vec3 light_color;    // Diffuse color of the sun or the moon
+uniform float ambient_light; // Ambient light intensity of the current time of the day
+
+varying vec2 uv;
+varying vec3 light;
+
+void main()
+{
+    // The first row of the modelview matrix is the camera right vector in world space; drop its vertical
+    // component so that bushes stay upright (cylindrical billboarding)
+    vec3 right = normalize(vec3(gl_ModelViewMatrix[0][0], 0.0, gl_ModelViewMatrix[2][0]));
+    vec3 position = instance.xyz + right * corner.x * instance.w + vec3(0.0, corner.y * instance.w, 0.0);
+    
+    // Each species takes one half of the atlas; the top of the quad sways with the wind
+    uv.x = species * 0.5 + (corner.x + 1.0) * 0.25 + corner.y * 0.05 * sin(time);
+    uv.y = 1.0 - corner.y;
+    
+    // Light the bush like the ground it grows on, whose normal points up, with the same model as the fixed function terrain
+    float diffuse = max(normalize(light_position - position).y, 0.0);
+    light = vec3(ambient_light) + light_color * diffuse;
+    
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);
+}
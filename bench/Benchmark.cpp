@@ -0,0 +1,412 @@
+/**
+@file
+@brief Headless benchmark. Renders a fixed terrain along a scripted camera path into an offscreen context and writes a JSON report.
+*/
+
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Terrain.h"
+#include "Renderer.h"
+#include "Camera.h"
+#include "QuadTree.h"
+#include "GlutFramework.h"
+#include "AssetManager.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "PerlinNoise.hpp"
+#include "Constants.h"
+#include "Colors.h"
+
+// Size of the offscreen surface
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+// Frames rendered before the measurements start, while the vegetation chunks and the caches fill up
+#define BENCH_WARMUP_FRAMES 60
+// Side of the generated heightmap, the size of the model output
+#define BENCH_HEIGHTMAP_SIZE 450
+// Seed of the generated heightmap
+#define BENCH_SEED 2024
+#define BENCH_SCRIPT_PATH "./bench/flythrough.txt"
+#define BENCH_REPORT_PATH "./bench.json"
+
+using namespace std;
+
+/**
+ * @brief Step of the camera path: the camera commands held for a number of frames.
+ */
+typedef struct
+{
+    vector<string> commands;    ///< Commands applied at every frame, like held keys
+    int frames;                 ///< Number of frames
+} BenchStep;
+
+/**
+ * @brief Offscreen EGL context the benchmark renders into, only the benchmark links EGL.
+ */
+class HeadlessContext
+{
+public:
+    // Destroy the context, after the objects declared later have deleted their OpenGL objects
+    ~HeadlessContext()
+    {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        eglTerminate(display);
+    }
+
+    // Create the context on an offscreen pbuffer and make it current
+    static bool initialize(int width, int height)
+    {
+        // Prefer the surfaceless platform, which needs neither a display server nor a GPU (llvmpipe)
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display)
+            display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            display = EGL_NO_DISPLAY;
+            cerr << COLOR_RED << "Failed to initialize the EGL display" << COLOR_RESET << endl;
+            return false;
+        }
+
+        // Same buffers as the window, but single sampled
+        const EGLint config_attributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_STENCIL_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configs = 0;
+        if (!eglChooseConfig(display, config_attributes, &config, 1, &configs) || configs == 0)
+        {
+            cerr << COLOR_RED << "No EGL config supports an offscreen OpenGL surface" << COLOR_RESET << endl;
+            return false;
+        }
+
+        const EGLint surface_attributes[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, surface_attributes);
+
+        // The renderer relies on the fixed function pipeline, like with the glut window
+        const EGLint context_attributes[] = {EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE};
+        eglBindAPI(EGL_OPENGL_API);
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+
+        if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+        {
+            cerr << COLOR_RED << "Failed to create the headless OpenGL context" << COLOR_RESET << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Swap the buffers of the offscreen surface
+    static void swapBuffers()
+    {
+        eglSwapBuffers(display, surface);
+    }
+
+private:
+    static EGLDisplay display;  ///< EGL display of the context
+    static EGLSurface surface;  ///< Offscreen surface
+    static EGLContext context;  ///< Headless context
+};
+
+EGLDisplay HeadlessContext::display = EGL_NO_DISPLAY;
+EGLSurface HeadlessContext::surface = EGL_NO_SURFACE;
+EGLContext HeadlessContext::context = EGL_NO_CONTEXT;
+
+// Global objects variables
+ResourceRegistry resource_registry;
+AssetManager asset_manager;
+Camera camera;
+HeadlessContext headless_context;
+GlutFramework glut_framework;
+Renderer renderer;
+QuadTree quadtree;
+Profiler profiler;
+
+// Generate a deterministic heightmap, with the same zeroed border as the model output
+static cv::Mat generateHeightmap()
+{
+    const siv::PerlinNoise perlin_noise(BENCH_SEED);
+    cv::Mat heightmap = cv::Mat::zeros(BENCH_HEIGHTMAP_SIZE, BENCH_HEIGHTMAP_SIZE, CV_8UC1);
+
+    for (int i = 5; i < BENCH_HEIGHTMAP_SIZE - 5; i++)
+        for (int j = 5; j < BENCH_HEIGHTMAP_SIZE - 5; j++)
+        {
+            double height = perlin_noise.octave2D_01(j * 0.006, i * 0.006, 6);
+            heightmap.at<uint8_t>(i, j) = (uint8_t)std::min(255.0, std::max(0.0, (height - 0.2) * 320.0));
+        }
+
+    return heightmap;
+}
+
+// Parse the camera path: one step per line, "<command>[+<command>...] <frames>", # starts a comment
+static bool loadScript(const string &path, vector<BenchStep> &steps)
+{
+    ifstream file(path);
+    if (!file.is_open())
+        return false;
+
+    string line;
+    while (getline(file, line))
+    {
+        line = line.substr(0, line.find('#'));
+        istringstream stream(line);
+        string commands;
+        BenchStep step;
+        step.frames = 1;
+        if (!(stream >> commands))
+            continue;
+        stream >> step.frames;
+
+        size_t start = 0;
+        size_t end;
+        while ((end = commands.find('+', start)) != string::npos)
+        {
+            step.commands.push_back(commands.substr(start, end - start));
+            start = end + 1;
+        }
+        step.commands.push_back(commands.substr(start));
+        steps.push_back(step);
+    }
+
+    return true;
+}
+
+// Apply a command through the camera API, as the keys would during a simulation step
+static void applyCommand(const string &command)
+{
+    if (command == "forward")
+        camera.moveForward();
+    else if (command == "backward")
+        camera.moveBackward();
+    else if (command == "left")
+        camera.moveLeft();
+    else if (command == "right")
+        camera.moveRight();
+    else if (command == "up")
+        camera.moveUp();
+    else if (command == "down")
+        camera.moveDown();
+    else if (command == "turn_left")
+        camera.rotateLeft();
+    else if (command == "turn_right")
+        camera.rotateRight();
+    else if (command == "look_up")
+        camera.rotateUp();
+    else if (command == "look_down")
+        camera.rotateDown();
+    else if (command == "faster")
+        camera.increaseSpeed();
+    else if (command == "slower")
+        camera.decreaseSpeed();
+    else if (command.compare(0, 5, "time=") == 0)
+        renderer.setTime(atoi(command.c_str() + 5));
+    else if (command != "wait")
+        cerr << COLOR_YELLOW << "Unknown benchmark command " << command << COLOR_RESET << endl;
+}
+
+// Nearest rank percentile of sorted values
+static double percentile(const vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+static bool writeReport(const string &path, const vector<double> &frame_times, double wall_time)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    vector<double> sorted = frame_times;
+    sort(sorted.begin(), sorted.end());
+    double mean = 0.0;
+    for (double time : sorted)
+        mean += time / sorted.size();
+
+    const ProfilerFrame &total = Profiler::getTotal();
+    const ProfilerFrame &peak = Profiler::getPeak();
+    double resolved = std::max(Profiler::getResolvedFrames(), 1ul);
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"renderer\": \"%s\",\n", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    fprintf(file, "  \"width\": %d,\n", GlutFramework::getWidth());
+    fprintf(file, "  \"height\": %d,\n", GlutFramework::getHeight());
+    fprintf(file, "  \"frames\": %zu,\n", frame_times.size());
+    fprintf(file, "  \"wall_time_s\": %.3f,\n", wall_time);
+    fprintf(file, "  \"fps\": %.2f,\n", mean > 0.0 ? 1000.0 / mean : 0.0);
+    fprintf(file, "  \"frame_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+            mean, percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 95), percentile(sorted, 99), sorted.empty() ? 0.0 : sorted.back());
+    fprintf(file, "  \"frame_cpu_ms\": {\"mean\": %.3f, \"max\": %.3f},\n", total.frame_cpu_ms / resolved, peak.frame_cpu_ms);
+    fprintf(file, "  \"frame_gpu_ms\": {\"mean\": %.3f, \"max\": %.3f},\n", total.frame_gpu_ms / resolved, peak.frame_gpu_ms);
+
+    // Only the passes which ran during the flythrough
+    fprintf(file, "  \"passes\": {");
+    bool is_first = true;
+    for (int pass = 0; pass < PROFILER_PASSES; pass++)
+    {
+        if (peak.cpu_ms[pass] == 0.0 && peak.gpu_ms[pass] == 0.0)
+            continue;
+        fprintf(file, "%s\n    \"%s\": {\"cpu_ms\": {\"mean\": %.3f, \"max\": %.3f}, \"gpu_ms\": {\"mean\": %.3f, \"max\": %.3f}}", is_first ? "" : ",",
+                Profiler::getPassName(pass), total.cpu_ms[pass] / resolved, peak.cpu_ms[pass], total.gpu_ms[pass] / resolved, peak.gpu_ms[pass]);
+        is_first = false;
+    }
+    fprintf(file, "\n  },\n");
+
+    fprintf(file, "  \"resolution_scale\": %.3f,\n", DynamicResolution::getScale());
+    fprintf(file, "  \"memory_mb\": {\"gpu\": %.2f, \"host\": %.2f},\n", ResourceRegistry::getGpuBytes() / (1024.0 * 1024.0), ResourceRegistry::getHostBytes() / (1024.0 * 1024.0));
+    fprintf(file, "  \"per_frame\": {\"primitives\": %.1f, \"draw_calls\": %.1f, \"uploads\": %.2f, \"upload_bytes\": %.1f, \"sync_waits\": %.2f}\n",
+            total.primitives / resolved, total.draw_calls / resolved, total.uploads / resolved, total.upload_bytes / resolved, total.sync_waits / resolved);
+    fprintf(file, "}\n");
+
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int width = BENCH_WIDTH;
+    int height = BENCH_HEIGHT;
+    int warmup_frames = BENCH_WARMUP_FRAMES;
+    string heightmap_path;
+    string script_path = BENCH_SCRIPT_PATH;
+    string report_path = BENCH_REPORT_PATH;
+    bool is_dynamic_resolution = false;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--width"))
+            width = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--height"))
+            height = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--warmup"))
+            warmup_frames = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--heightmap"))
+            heightmap_path = argv[i + 1];
+        else if (!strcmp(argv[i], "--script"))
+            script_path = argv[i + 1];
+        else if (!strcmp(argv[i], "--output"))
+            report_path = argv[i + 1];
+        else if (!strcmp(argv[i], "--dynamic-resolution"))
+            is_dynamic_resolution = atoi(argv[i + 1]) != 0;
+    }
+
+    vector<BenchStep> steps;
+    if (!loadScript(script_path, steps))
+    {
+        cerr << COLOR_RED << "Failed to open " << script_path << COLOR_RESET << endl;
+        return 1;
+    }
+
+    cv::Mat heightmap = heightmap_path.empty() ? generateHeightmap() : cv::imread(heightmap_path, cv::IMREAD_GRAYSCALE);
+    if (heightmap.empty() || heightmap.rows != heightmap.cols)
+    {
+        cerr << COLOR_RED << "The heightmap must be a square grayscale image" << COLOR_RESET << endl;
+        return 1;
+    }
+
+    // Start decoding the assets in background while the context is being created
+    AssetManager::prefetch();
+
+    if (!HeadlessContext::initialize(width, height) || !glut_framework.initializeHeadless(width, height, HeadlessContext::swapBuffers))
+        return 1;
+    profiler.initialize();
+    renderer.initialize(&camera, &quadtree);
+
+    // The frames are measured at the native resolution unless asked otherwise, so that the runs stay comparable
+    if (!is_dynamic_resolution)
+        DynamicResolution::toggle();
+
+    // Build the world like the rendering screen does once the terrain is generated
+    glDisable(GL_MULTISAMPLE);
+    Terrain *terrain = new Terrain();
+    terrain->initialize(WORLD_SCALE, TEXTURE_SCALE, heightmap);
+    camera.setTerrain(terrain);
+    renderer.setTerrain(terrain);
+    quadtree.initialize(terrain);
+    renderer.initializeWater();
+    renderer.initializeOrbit(terrain->getWorldDim() / 2);
+    renderer.initializeVegetation();
+    renderer.setTime(STARTING_TIME);
+    camera.setPosition(0, terrain->getWaterLevel() + STARTING_Y_OFFSET, terrain->getWorldDim() / 2 + STARTING_Z_OFFSET + 5);
+    renderer.current_menu_page = RENDERING_SCREEN;
+
+    printf(COLOR_GREEN "Benchmarking %s at %dx%d\n" COLOR_RESET, reinterpret_cast<const char *>(glGetString(GL_RENDERER)), width, height);
+
+    // Every frame is a single simulation step, so that the path doesn't depend on the frame rate
+    vector<double> frame_times;
+    chrono::steady_clock::time_point start;
+    int frame = 0;
+    for (const BenchStep &step : steps)
+    {
+        for (int i = 0; i < step.frames; i++, frame++)
+        {
+            if (frame == warmup_frames)
+            {
+                Profiler::flush();
+                Profiler::reset();
+                start = chrono::steady_clock::now();
+            }
+
+            chrono::steady_clock::time_point frame_start = chrono::steady_clock::now();
+
+            camera.storeState();
+            for (const string &command : step.commands)
+                applyCommand(command);
+            renderer.update(1.0f / 60.0f);
+            renderer.setInterpolation(1.0f);
+
+            // Wait for the GPU, the offscreen swap doesn't
+            renderer.renderFrame();
+            glFinish();
+
+            if (frame >= warmup_frames)
+                frame_times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - frame_start).count());
+        }
+    }
+    Profiler::flush();
+
+    if (frame_times.empty())
+    {
+        cerr << COLOR_RED << "The flythrough is shorter than the warm-up" << COLOR_RESET << endl;
+        return 1;
+    }
+
+    double wall_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!writeReport(report_path, frame_times, wall_time))
+    {
+        cerr << COLOR_RED << "Failed to write " << report_path << COLOR_RESET << endl;
+        return 1;
+    }
+    printf(COLOR_GREEN "%zu frames in %.2f s, report saved to %s\n" COLOR_RESET, frame_times.size(), wall_time, report_path.c_str());
+
+    return 0;
+}
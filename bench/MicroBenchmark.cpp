@@ -0,0 +1,326 @@
+/**
+@file
+@brief Micro-benchmarks of the CPU hot paths. Runs without a display and reports the time, the throughput and the allocations of each path.
+*/
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Terrain.h"
+#include "Renderer.h"
+#include "QuadTree.h"
+#include "Vegetation.h"
+#include "AssetManager.h"
+#include "PerlinNoise.hpp"
+#include "Vec.hpp"
+#include "Constants.h"
+#include "Colors.h"
+
+// Minimum duration of a measured run, the iterations are calibrated to reach it
+#define MICROBENCH_MIN_TIME 0.2
+// Measured runs of each benchmark, the median is reported
+#define MICROBENCH_REPEATS 5
+// Samples processed by an operation of the element-wise benchmarks
+#define MICROBENCH_BATCH 1024
+// Texture scale of the benchmarked terrains: the texture cost is linear in the texels, reported as the throughput
+#define MICROBENCH_TEXTURE_SCALE 4
+#define MICROBENCH_SEED 2024
+
+using namespace std;
+
+/**
+ * @brief Result of a micro-benchmark.
+ */
+typedef struct
+{
+    string name;            ///< Benchmarked path
+    int size;               ///< Side of the map, 0 if the path doesn't depend on it
+    string unit;            ///< Unit of the items processed by an operation
+    double ns_per_op;       ///< Median time of an operation in nanoseconds
+    double items_per_op;    ///< Items processed by an operation
+    double allocs_per_op;   ///< Heap allocations of an operation
+    double bytes_per_op;    ///< Heap bytes allocated by an operation
+} MicroResult;
+
+// Heap allocations counted by the replaced global operator new
+static atomic<size_t> allocation_count(0);
+static atomic<size_t> allocation_bytes(0);
+
+void *operator new(size_t size)
+{
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    allocation_bytes.fetch_add(size, memory_order_relaxed);
+    void *pointer = malloc(size ? size : 1);
+    if (pointer == nullptr)
+        throw bad_alloc();
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+// Global objects variables
+AssetManager asset_manager;
+
+static vector<MicroResult> results;
+static string filter;
+// Keeps the results of the operations alive
+static volatile double sink;
+
+// Run an operation a number of times, returning the elapsed seconds
+template <typename Operation>
+static double measure(Operation &operation, long iterations, double &items)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++)
+        items = operation(i);
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Calibrate the iterations, then take the median of the measured runs. The operation returns the items it processed.
+template <typename Operation>
+static void run(const string &name, int size, const string &unit, Operation operation)
+{
+    if (!filter.empty() && name.find(filter) == string::npos)
+        return;
+
+    double items = 0.0;
+    long iterations = 1;
+    double elapsed = measure(operation, iterations, items);
+    while (elapsed < MICROBENCH_MIN_TIME && iterations < (1l << 30))
+    {
+        double scale = elapsed > 0.0 ? MICROBENCH_MIN_TIME / elapsed * 1.2 : 100.0;
+        iterations = max(iterations * 2, (long)(iterations * min(scale, 100.0)));
+        elapsed = measure(operation, iterations, items);
+    }
+
+    vector<double> times;
+    size_t allocations = 0;
+    size_t bytes = 0;
+    for (int repeat = 0; repeat < MICROBENCH_REPEATS; repeat++)
+    {
+        size_t count_before = allocation_count.load();
+        size_t bytes_before = allocation_bytes.load();
+        times.push_back(measure(operation, iterations, items) / iterations * 1e9);
+        allocations += allocation_count.load() - count_before;
+        bytes += allocation_bytes.load() - bytes_before;
+    }
+    sort(times.begin(), times.end());
+
+    MicroResult result;
+    result.name = name;
+    result.size = size;
+    result.unit = unit;
+    result.ns_per_op = times[times.size() / 2];
+    result.items_per_op = items;
+    result.allocs_per_op = (double)allocations / (iterations * MICROBENCH_REPEATS);
+    result.bytes_per_op = (double)bytes / (iterations * MICROBENCH_REPEATS);
+    results.push_back(result);
+
+    printf("%-28s %6s %14.1f %12.4g %-10s %10.1f %12.0f\n", name.c_str(), size ? to_string(size).c_str() : "-", result.ns_per_op,
+           result.items_per_op / result.ns_per_op * 1e9, unit.c_str(), result.allocs_per_op, result.bytes_per_op);
+    fflush(stdout);
+}
+
+// Generate a deterministic heightmap of the given side, with the same zeroed border as the model output
+static cv::Mat generateHeightmap(int size)
+{
+    const siv::PerlinNoise perlin_noise(MICROBENCH_SEED);
+    cv::Mat heightmap = cv::Mat::zeros(size, size, CV_8UC1);
+    double frequency = 2.7 / size;
+
+    for (int i = 5; i < size - 5; i++)
+        for (int j = 5; j < size - 5; j++)
+        {
+            double height = perlin_noise.octave2D_01(j * frequency, i * frequency, 6);
+            heightmap.at<uint8_t>(i, j) = (uint8_t)min(255.0, max(0.0, (height - 0.2) * 320.0));
+        }
+
+    return heightmap;
+}
+
+// Benchmark the paths which depend on the size of the map
+static void runMapBenchmarks(int size)
+{
+    cv::Mat heightmap = generateHeightmap(size);
+    Terrain terrain;
+    terrain.initialize(WORLD_SCALE, MICROBENCH_TEXTURE_SCALE, heightmap);
+    double vertices = (double)size * size;
+
+    run("Terrain::loadHeightmap", size, "vertices", [&](long) {
+        terrain.loadHeightmap(heightmap);
+        return vertices;
+    });
+
+    double texels = (double)terrain.getTexture().rows * terrain.getTexture().cols;
+    run("Terrain::loadTexture", size, "texels", [&](long) {
+        terrain.loadTexture();
+        return texels;
+    });
+
+    run("Terrain::loadWatermap", size, "vertices", [&](long) {
+        terrain.loadWatermap();
+        return vertices;
+    });
+
+    // Every node and leaf mesh, with its normals
+    QuadTree quadtree;
+    run("QuadNode::buildMesh", size, "vertices", [&](long) {
+        quadtree.build(&terrain);
+        return vertices;
+    });
+
+    // Full traversal from the center of the map, turning around between the operations
+    vector<QuadNode *> leaves;
+    run("QuadTree::isInFrustum", size, "leaves", [&](long i) {
+        float angle = i * 0.1f;
+        quadtree.setCamera(Vec2<float>(0.0f, 0.0f), Vec2<float>(sin(angle), cos(angle)));
+        quadtree.cull(leaves);
+        return (double)leaves.size();
+    });
+
+    Object water;
+    Renderer::buildWater(&terrain, water);
+    const siv::PerlinNoise perlin_noise(12345);
+    vector<float> water_vertices;
+    vector<float> water_normals;
+    run("Renderer::animateWater", size, "vertices", [&](long i) {
+        Renderer::animateWater(water, perlin_noise, i / 60.0f, water_vertices, water_normals);
+        sink = water_normals[water_normals.size() / 2];
+        return vertices;
+    });
+
+    // Every chunk of the world, as the workers would generate them
+    Vegetation vegetation;
+    vegetation.buildGrid(&terrain);
+    run("Vegetation::scatter", size, "bushes", [&](long) {
+        int bushes = 0;
+        for (int index = 0; index < vegetation.getChunkCount(); index++)
+            bushes += vegetation.scatter(index);
+        return (double)bushes;
+    });
+}
+
+// Benchmark the element-wise helpers on a batch of random samples
+static void runHelperBenchmarks()
+{
+    mt19937 generator(MICROBENCH_SEED);
+    uniform_real_distribution<float> uniform(-1000.0f, 1000.0f);
+    vector<Vec3<float>> vectors(MICROBENCH_BATCH + 2);
+    vector<Vec2<float>> vectors_2d(MICROBENCH_BATCH + 1);
+    for (Vec3<float> &vector : vectors)
+        vector = Vec3<float>(uniform(generator), uniform(generator), uniform(generator));
+    for (Vec2<float> &vector : vectors_2d)
+        vector = Vec2<float>(uniform(generator), uniform(generator));
+
+    const siv::PerlinNoise perlin_noise(12345);
+    run("siv::PerlinNoise::noise3D", 0, "samples", [&](long i) {
+        double sum = 0.0;
+        for (int k = 0; k < MICROBENCH_BATCH; k++)
+            sum += perlin_noise.noise3D_01(vectors[k].x * 0.0005, vectors[k].z * 0.0005, i / 60.0);
+        sink = sum;
+        return (double)MICROBENCH_BATCH;
+    });
+
+    run("Vec3 crossProduct", 0, "vectors", [&](long) {
+        float sum = 0.0f;
+        for (int k = 0; k < MICROBENCH_BATCH; k++)
+            sum += crossProduct(subtract(vectors[k + 1], vectors[k]), subtract(vectors[k + 2], vectors[k])).y;
+        sink = sum;
+        return (double)MICROBENCH_BATCH;
+    });
+
+    run("Vec3 newellMethod", 0, "vectors", [&](long) {
+        float sum = 0.0f;
+        for (int k = 0; k < MICROBENCH_BATCH; k++)
+            sum += newellMethod(vectors[k], vectors[k + 1], vectors[k + 2]).y;
+        sink = sum;
+        return (double)MICROBENCH_BATCH;
+    });
+
+    run("Vec3 normalize", 0, "vectors", [&](long) {
+        float sum = 0.0f;
+        for (int k = 0; k < MICROBENCH_BATCH; k++)
+            sum += normalize(vectors[k]).y;
+        sink = sum;
+        return (double)MICROBENCH_BATCH;
+    });
+
+    run("Vec2 normalize dot", 0, "vectors", [&](long) {
+        float sum = 0.0f;
+        for (int k = 0; k < MICROBENCH_BATCH; k++)
+            sum += dot(normalize(subtract(vectors_2d[k], vectors_2d[k + 1])), vectors_2d[k]);
+        sink = sum;
+        return (double)MICROBENCH_BATCH;
+    });
+}
+
+static bool writeReport(const string &path)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "[");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const MicroResult &result = results[i];
+        fprintf(file, "%s\n  {\"name\": \"%s\", \"size\": %d, \"ns_per_op\": %.1f, \"items_per_op\": %.1f, \"unit\": \"%s\", \"items_per_s\": %.4g, \"allocs_per_op\": %.2f, \"bytes_per_op\": %.0f}",
+                i ? "," : "", result.name.c_str(), result.size, result.ns_per_op, result.items_per_op, result.unit.c_str(),
+                result.items_per_op / result.ns_per_op * 1e9, result.allocs_per_op, result.bytes_per_op);
+    }
+    fprintf(file, "\n]\n");
+
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    vector<int> sizes = {128, 256, 450, 1024};
+    string report_path;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--filter"))
+            filter = argv[i + 1];
+        else if (!strcmp(argv[i], "--json"))
+            report_path = argv[i + 1];
+        else if (!strcmp(argv[i], "--sizes"))
+        {
+            // Comma separated list of map sides
+            sizes.clear();
+            for (char *size = strtok(argv[i + 1], ","); size != nullptr; size = strtok(nullptr, ","))
+                sizes.push_back(atoi(size));
+        }
+    }
+
+    printf(COLOR_GREEN "%-28s %6s %14s %23s %10s %12s\n" COLOR_RESET, "benchmark", "size", "ns/op", "throughput/s", "allocs/op", "bytes/op");
+
+    runHelperBenchmarks();
+    for (int size : sizes)
+        runMapBenchmarks(size);
+
+    if (!report_path.empty() && !writeReport(report_path))
+    {
+        cerr << COLOR_RED << "Failed to write " << report_path << COLOR_RESET << endl;
+        return 1;
+    }
+
+    return 0;
+}
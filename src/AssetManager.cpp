@@ -0,0 +1,294 @@
+/**
+@file
+@brief AssetManager source file.
+*/
+
+#include "AssetManager.h"
+
+
+AssetManager *AssetManager::instance = nullptr;
+
+// Default constructor
+AssetManager::AssetManager()
+{
+    if (AssetManager::instance == nullptr)
+        AssetManager::instance = this;
+
+    // Start the workers, leaving a core to the main thread
+    this->stopping = false;
+    int worker_count = std::max(2, std::min(4, (int)std::thread::hardware_concurrency() - 1));
+    for (int i = 0; i < worker_count; i++)
+        this->workers.emplace_back(&AssetManager::work, this);
+}
+
+// Destructor
+AssetManager::~AssetManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->jobs_mutex);
+        this->stopping = true;
+    }
+    this->jobs_condition.notify_all();
+    for (std::thread &worker : this->workers)
+        worker.join();
+    this->workers.clear();
+
+    AssetManager::instance = nullptr;
+}
+
+void AssetManager::work()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(this->jobs_mutex);
+            this->jobs_condition.wait(lock, [this]{ return this->stopping || !this->jobs.empty(); });
+            if (this->stopping)
+                return;
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void AssetManager::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->jobs_mutex);
+        this->jobs.push_back(std::move(job));
+    }
+    this->jobs_condition.notify_one();
+}
+
+template <typename T>
+std::shared_future<T> AssetManager::request(std::map<std::string, std::shared_future<T>> &cache, const std::string &key, std::function<T()> decode)
+{
+    std::lock_guard<std::mutex> lock(this->cache_mutex);
+
+    // Already requested: share the decoded (or in flight) asset
+    auto cached = cache.find(key);
+    if (cached != cache.end())
+        return cached->second;
+
+    std::shared_ptr<std::promise<T>> promise = std::make_shared<std::promise<T>>();
+    std::shared_future<T> future = promise->get_future().share();
+    cache[key] = future;
+
+    // A decoder throwing (e.g. an allocation failure or a corrupted file) still fulfils the promise, with an empty asset
+    submit([promise, decode, key]()
+    {
+        try
+        {
+            promise->set_value(decode());
+        }
+        catch (const std::exception &exception)
+        {
+            std::cerr << COLOR_RED << "Failed to decode " << key << ": " << exception.what() << COLOR_RESET << std::endl;
+            promise->set_value(T());
+        }
+    });
+
+    return future;
+}
+
+std::shared_future<cv::Mat> AssetManager::loadImage(const std::string &path, int flags)
+{
+    std::string key = path + "|" + std::to_string(flags);
+    return instance->request<cv::Mat>(instance->images, key, [path, flags]()
+    {
+        cv::Mat image = cv::imread(path, flags);
+        if (image.empty())
+            std::cerr << COLOR_RED << "Failed to load image " << path << COLOR_RESET << std::endl;
+        return image;
+    });
+}
+
+std::shared_future<std::shared_ptr<const MeshAsset>> AssetManager::loadMesh(const std::string &path, unsigned int flags)
+{
+    std::string key = path + "|" + std::to_string(flags);
+    return instance->request<std::shared_ptr<const MeshAsset>>(instance->meshes, key, [path, flags]()
+    {
+        return AssetManager::decodeMesh(path, flags);
+    });
+}
+
+std::shared_future<std::shared_ptr<const SoundAsset>> AssetManager::loadSound(const std::string &path)
+{
+    return instance->request<std::shared_ptr<const SoundAsset>>(instance->sounds, path, [path]()
+    {
+        return AssetManager::decodeSound(path);
+    });
+}
+
+void AssetManager::prefetch()
+{
+    // Sounds
+    loadSound("./assets/sounds/Menu.wav");
+    loadSound("./assets/sounds/World.wav");
+    loadSound("./assets/sounds/Click.wav");
+    loadSound("./assets/sounds/Pop.wav");
+    loadSound("./assets/sounds/Reset.wav");
+    loadSound("./assets/sounds/Success.wav");
+    loadSound("./assets/sounds/Water.wav");
+    loadSound("./assets/sounds/Wind.wav");
+
+    // Skydome
+    loadImage("./assets/textures/day.jpg");
+    loadImage("./assets/textures/night.jpg");
+    loadMesh("./assets/models/skydome.obj");
+
+    // Orbit
+    loadImage("./assets/textures/sun.png");
+    loadImage("./assets/textures/moon.jpg");
+    loadMesh("./assets/models/sun.obj");
+    loadMesh("./assets/models/moon.obj");
+
+    // Water and vegetation
+    loadImage("./assets/textures/water.jpg");
+    loadImage("./assets/textures/grass.png", cv::IMREAD_UNCHANGED);
+
+    // Terrain tiles
+    for (int i = 1; i <= 6; i++)
+        loadImage("./assets/textures/" + std::to_string(i) + ".jpg");
+}
+
+void AssetManager::parallelFor(int count, const std::function<void(int)> &task)
+{
+    if (instance == nullptr || count <= 1)
+    {
+        for (int i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    // Shared with the helper jobs, which may only start once every index is taken and the caller is gone
+    struct Batch
+    {
+        std::function<void(int)> task;
+        int count;
+        std::atomic<int> next;
+        int done;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->task = task;
+    batch->count = count;
+    batch->next = 0;
+    batch->done = 0;
+
+    auto run = [batch]()
+    {
+        for (int i = batch->next++; i < batch->count; i = batch->next++)
+        {
+            batch->task(i);
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if (++batch->done == batch->count)
+                batch->condition.notify_all();
+        }
+    };
+
+    int helper_count = std::min(count - 1, (int)instance->workers.size());
+    for (int i = 0; i < helper_count; i++)
+        instance->submit(run);
+    run();
+
+    // Wait for the indexes still running on the workers
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->condition.wait(lock, [&batch]{ return batch->done == batch->count; });
+}
+
+std::shared_ptr<const MeshAsset> AssetManager::decodeMesh(const std::string &path, unsigned int flags)
+{
+    Assimp::Importer importer;
+
+    // Load the model file
+    const aiScene *scene = importer.ReadFile(path.c_str(), flags);
+    // Check if the scene was loaded successfully
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    {
+        std::cerr << COLOR_RED << "Error loading model " << path << ": " << importer.GetErrorString() << COLOR_RESET << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<MeshAsset> asset = std::make_shared<MeshAsset>();
+
+    // For each mesh in the scene
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+    {
+        const aiMesh *mesh = scene->mMeshes[i];
+
+        // For each vertex in the mesh
+        for (unsigned int j = 0; j < mesh->mNumVertices; ++j)
+        {
+            // Extract vertices
+            aiVector3D vertex = mesh->mVertices[j];
+            asset->vertices.push_back(vertex.x);
+            asset->vertices.push_back(vertex.y);
+            asset->vertices.push_back(vertex.z);
+
+            // Extract texture coordinates
+            if (mesh->HasTextureCoords(0))
+            {
+                aiVector3D texture_coord = mesh->mTextureCoords[0][j];
+                asset->textures.push_back(texture_coord.x);
+                asset->textures.push_back(texture_coord.y);
+            }
+        }
+
+        // For each face in the mesh
+        for (unsigned int j = 0; j < mesh->mNumFaces; ++j)
+        {
+            const aiFace &face = mesh->mFaces[j];
+
+            // Assume triangular faces
+            if (face.mNumIndices == 3)
+            {
+                asset->indices.push_back(face.mIndices[0]);
+                asset->indices.push_back(face.mIndices[1]);
+                asset->indices.push_back(face.mIndices[2]);
+            }
+        }
+    }
+
+    return asset;
+}
+
+std::shared_ptr<const SoundAsset> AssetManager::decodeSound(const std::string &path)
+{
+    SF_INFO sfinfo;
+
+    // Open the audio file and check that it's usable
+    SNDFILE *sndfile = sf_open(path.c_str(), SFM_READ, &sfinfo);
+    if (!sndfile)
+    {
+        fprintf(stderr, "Could not open audio in %s: %s\n", path.c_str(), sf_strerror(sndfile));
+        return nullptr;
+    }
+    if (sfinfo.frames < 1 || sfinfo.frames > (sf_count_t)(INT_MAX / sizeof(short)) / sfinfo.channels)
+    {
+        fprintf(stderr, "Bad sample count in %s (%" PRId64 ")\n", path.c_str(), sfinfo.frames);
+        sf_close(sndfile);
+        return nullptr;
+    }
+
+    std::shared_ptr<SoundAsset> asset = std::make_shared<SoundAsset>();
+    asset->channels = sfinfo.channels;
+    asset->sample_rate = sfinfo.samplerate;
+    asset->is_ambisonic = (sfinfo.channels == 3 || sfinfo.channels == 4) && sf_command(sndfile, SFC_WAVEX_GET_AMBISONIC, NULL, 0) == SF_AMBISONIC_B_FORMAT;
+
+    // Decode the whole audio file
+    asset->samples.resize((size_t)(sfinfo.frames * sfinfo.channels));
+    sf_count_t num_frames = sf_readf_short(sndfile, asset->samples.data(), sfinfo.frames);
+    sf_close(sndfile);
+    if (num_frames < 1)
+    {
+        fprintf(stderr, "Failed to read samples in %s (%" PRId64 ")\n", path.c_str(), num_frames);
+        return nullptr;
+    }
+    asset->samples.resize((size_t)(num_frames * sfinfo.channels));
+
+    return asset;
+}
@@ -0,0 +1,174 @@
+/**
+@file
+@brief AssetManager header file.
+*/
+
+#ifndef ASSETMANAGER_H
+#define ASSETMANAGER_H
+
+#include <opencv2/opencv.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <sndfile.h>
+#include <inttypes.h>
+#include <climits>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include "Colors.h"
+
+/**
+ * @brief Triangle mesh decoded from a model file.
+ */
+typedef struct
+{
+    std::vector<float> vertices;        ///< Vertex positions (x, y, z)
+    std::vector<float> textures;        ///< Texture coordinates (u, v)
+    std::vector<unsigned int> indices;  ///< Triangle indices
+} MeshAsset;
+
+/**
+ * @brief Audio clip decoded to 16 bit samples.
+ */
+typedef struct
+{
+    std::vector<short> samples;         ///< Interleaved samples
+    int channels;                       ///< Number of channels
+    int sample_rate;                    ///< Sample rate in Hz
+    bool is_ambisonic;                  ///< Whether the clip is in B-format ambisonic
+} SoundAsset;
+
+/**
+ * @brief AssetManager class which decodes images, meshes and sounds in parallel on worker threads.
+ *
+ * Every request returns a shared future immediately and is decoded once: the result is cached by path and decoding settings,
+ * so that repeated requests (e.g. when a new world is generated) get the already decoded asset. Decoded assets are immutable
+ * and shared between the requesters. Requests can be issued early (see prefetch) to overlap the decoding with the startup.
+ * The caches have no eviction on purpose: they only hold the fixed set of textures, models and sounds shipped in ./assets (see
+ * prefetch), which stay resident for the whole run. Per-world data such as the heightmaps doesn't go through the AssetManager.
+ */
+class AssetManager
+{
+public:
+    /**
+     * @brief Construct the AssetManager singleton and start the workers.
+     */
+    AssetManager();
+
+    /**
+     * @brief Destroy the AssetManager singleton, stopping the workers.
+     */
+    ~AssetManager();
+
+    /**
+     * @brief Request the decoding of an image.
+     *
+     * @param path Image path
+     * @param flags cv::imread flags
+     * @return std::shared_future<cv::Mat> Decoded image, empty if the file couldn't be read
+     */
+    static std::shared_future<cv::Mat> loadImage(const std::string &path, int flags = cv::IMREAD_COLOR);
+
+    /**
+     * @brief Request the import of a model.
+     *
+     * @param path Model path
+     * @param flags Assimp post-processing flags
+     * @return std::shared_future<std::shared_ptr<const MeshAsset>> Decoded mesh, nullptr if the file couldn't be imported
+     */
+    static std::shared_future<std::shared_ptr<const MeshAsset>> loadMesh(const std::string &path, unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
+
+    /**
+     * @brief Request the decoding of a sound.
+     *
+     * @param path Sound path
+     * @return std::shared_future<std::shared_ptr<const SoundAsset>> Decoded sound, nullptr if the file couldn't be decoded
+     */
+    static std::shared_future<std::shared_ptr<const SoundAsset>> loadSound(const std::string &path);
+
+    /**
+     * @brief Request every asset used at startup and when entering a world, so that they are decoded in background.
+     */
+    static void prefetch();
+
+    /**
+     * @brief Run a task for every index on the decoding workers and the calling thread, returning once every index is done.
+     *
+     * Lets the other CPU-heavy asset jobs (e.g. the texture compression) share the workers instead of starting threads of their
+     * own. The calling thread takes indexes too, so the call never waits behind the queued decodings, and it runs everything by
+     * itself without an AssetManager.
+     *
+     * @param count Number of indexes
+     * @param task Task run once for each index in [0, count), concurrently
+     */
+    static void parallelFor(int count, const std::function<void(int)> &task);
+
+private:
+    static AssetManager *instance;                      ///< Used to access the AssetManager object from the static functions
+
+    std::map<std::string, std::shared_future<cv::Mat>> images;                              ///< Image cache
+    std::map<std::string, std::shared_future<std::shared_ptr<const MeshAsset>>> meshes;     ///< Mesh cache
+    std::map<std::string, std::shared_future<std::shared_ptr<const SoundAsset>>> sounds;    ///< Sound cache
+    std::mutex cache_mutex;                             ///< Protects the caches
+
+    std::vector<std::thread> workers;                   ///< Worker threads decoding the assets
+    std::deque<std::function<void()>> jobs;             ///< Decoding jobs waiting for a worker
+    std::mutex jobs_mutex;                              ///< Protects the jobs queue and the stopping flag
+    std::condition_variable jobs_condition;             ///< Wakes up the workers when new jobs are queued
+    bool stopping;                                      ///< Tells the workers to exit
+
+    /**
+     * @brief Worker loop consuming the jobs queue.
+     */
+    void work();
+
+    /**
+     * @brief Queue a decoding job.
+     *
+     * @param job Job to run on a worker thread
+     */
+    void submit(std::function<void()> job);
+
+    /**
+     * @brief Return the cached future of an asset, queuing its decoding on the first request.
+     *
+     * @tparam T Decoded asset type
+     * @param cache Cache of the asset type
+     * @param key Path and decoding settings of the asset
+     * @param decode Decoding function, run on a worker thread
+     * @return std::shared_future<T>
+     */
+    template <typename T>
+    std::shared_future<T> request(std::map<std::string, std::shared_future<T>> &cache, const std::string &key, std::function<T()> decode);
+
+    /**
+     * @brief Import a model (runs on a worker thread).
+     *
+     * @param path Model path
+     * @param flags Assimp post-processing flags
+     * @return std::shared_ptr<const MeshAsset>
+     */
+    static std::shared_ptr<const MeshAsset> decodeMesh(const std::string &path, unsigned int flags);
+
+    /**
+     * @brief Decode a sound (runs on a worker thread).
+     *
+     * @param path Sound path
+     * @return std::shared_ptr<const SoundAsset>
+     */
+    static std::shared_ptr<const SoundAsset> decodeSound(const std::string &path);
+};
+
+#endif // ASSETMANAGER_H
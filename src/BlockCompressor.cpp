@@ -0,0 +1,419 @@
+/**
+@file
+@brief BlockCompressor source file.
+*/
+
+#include "BlockCompressor.h"
+
+
+// Pack an 8 bit per channel color into 5:6:5
+static uint16_t pack565(float r, float g, float b)
+{
+    int r5 = std::min(31, std::max(0, (int)(r * 31.0f / 255.0f + 0.5f)));
+    int g6 = std::min(63, std::max(0, (int)(g * 63.0f / 255.0f + 0.5f)));
+    int b5 = std::min(31, std::max(0, (int)(b * 31.0f / 255.0f + 0.5f)));
+    return (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+}
+
+// Unpack a 5:6:5 color into 8 bit per channel (r, g, b)
+static void unpack565(uint16_t color, int *rgb)
+{
+    int r5 = (color >> 11) & 31;
+    int g6 = (color >> 5) & 63;
+    int b5 = color & 31;
+    rgb[0] = (r5 << 3) | (r5 >> 2);
+    rgb[1] = (g6 << 2) | (g6 >> 4);
+    rgb[2] = (b5 << 3) | (b5 >> 2);
+}
+
+void BlockCompressor::encodeColorBlock(const uint8_t *texels, uint8_t *output)
+{
+    // Mean of the block (texels are BGRA)
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += texels[i * 4 + 2 - c];
+    for (int c = 0; c < 3; c++)
+        mean[c] /= 16.0f;
+
+    // Covariance of the block
+    float covariance[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++)
+    {
+        float r = texels[i * 4 + 2] - mean[0];
+        float g = texels[i * 4 + 1] - mean[1];
+        float b = texels[i * 4 + 0] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+
+    // Principal axis by power iteration, starting from the luminance axis
+    float axis[3] = {0.299f, 0.587f, 0.114f};
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+        float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+        float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+        float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+        if (length < 1e-6f)
+            break;
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    // Endpoints are the extreme projections on the axis, slightly inset to reduce the quantization error
+    float min_projection = FLT_MAX;
+    float max_projection = -FLT_MAX;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = (texels[i * 4 + 2] - mean[0]) * axis[0] + (texels[i * 4 + 1] - mean[1]) * axis[1] + (texels[i * 4 + 0] - mean[2]) * axis[2];
+        min_projection = std::min(min_projection, projection);
+        max_projection = std::max(max_projection, projection);
+    }
+    float axis_length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    if (axis_length > 0)
+    {
+        float inset = (max_projection - min_projection) / 16.0f;
+        min_projection = (min_projection + inset) / axis_length;
+        max_projection = (max_projection - inset) / axis_length;
+    }
+
+    uint16_t color0 = pack565(mean[0] + axis[0] * max_projection, mean[1] + axis[1] * max_projection, mean[2] + axis[2] * max_projection);
+    uint16_t color1 = pack565(mean[0] + axis[0] * min_projection, mean[1] + axis[1] * min_projection, mean[2] + axis[2] * min_projection);
+
+    // color0 > color1 selects the 4 colors mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        // Build the palette
+        int palette[4][3];
+        unpack565(color0, palette[0]);
+        unpack565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        // Pick the closest palette entry for each texel
+        for (int i = 0; i < 16; i++)
+        {
+            int best_index = 0;
+            int best_distance = INT_MAX;
+            for (int p = 0; p < 4; p++)
+            {
+                int dr = texels[i * 4 + 2] - palette[p][0];
+                int dg = texels[i * 4 + 1] - palette[p][1];
+                int db = texels[i * 4 + 0] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < best_distance)
+                {
+                    best_distance = distance;
+                    best_index = p;
+                }
+            }
+            indices |= (uint32_t)best_index << (i * 2);
+        }
+    }
+
+    output[0] = color0 & 0xFF;
+    output[1] = color0 >> 8;
+    output[2] = color1 & 0xFF;
+    output[3] = color1 >> 8;
+    output[4] = indices & 0xFF;
+    output[5] = (indices >> 8) & 0xFF;
+    output[6] = (indices >> 16) & 0xFF;
+    output[7] = (indices >> 24) & 0xFF;
+}
+
+void BlockCompressor::encodeAlphaBlock(const uint8_t *texels, uint8_t *output)
+{
+    int alpha0 = 0;
+    int alpha1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        alpha0 = std::max(alpha0, (int)texels[i * 4 + 3]);
+        alpha1 = std::min(alpha1, (int)texels[i * 4 + 3]);
+    }
+
+    uint64_t indices = 0;
+    if (alpha0 != alpha1)
+    {
+        // alpha0 > alpha1 selects the 8 values mode
+        int palette[8];
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+
+        // Pick the closest palette entry for each texel
+        for (int i = 0; i < 16; i++)
+        {
+            int best_index = 0;
+            int best_distance = INT_MAX;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = std::abs(texels[i * 4 + 3] - palette[p]);
+                if (distance < best_distance)
+                {
+                    best_distance = distance;
+                    best_index = p;
+                }
+            }
+            indices |= (uint64_t)best_index << (i * 3);
+        }
+    }
+
+    output[0] = (uint8_t)alpha0;
+    output[1] = (uint8_t)alpha1;
+    for (int i = 0; i < 6; i++)
+        output[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+CompressedLevel BlockCompressor::compressLevel(const cv::Mat &image, bool has_alpha)
+{
+    CompressedLevel level;
+    level.width = image.cols;
+    level.height = image.rows;
+
+    int blocks_x = (image.cols + 3) / 4;
+    int blocks_y = (image.rows + 3) / 4;
+    int block_size = has_alpha ? 16 : 8;
+    level.data.resize((size_t)blocks_x * blocks_y * block_size);
+
+    // Encode the block rows in parallel on the asset workers
+    AssetManager::parallelFor(blocks_y, [&](int block_y)
+    {
+        uint8_t texels[64];
+        for (int block_x = 0; block_x < blocks_x; block_x++)
+        {
+            // Gather the block, clamping at the image borders
+            for (int y = 0; y < 4; y++)
+            {
+                const uint8_t *row = image.ptr<uint8_t>(std::min(block_y * 4 + y, image.rows - 1));
+                for (int x = 0; x < 4; x++)
+                    memcpy(texels + (y * 4 + x) * 4, row + std::min(block_x * 4 + x, image.cols - 1) * 4, 4);
+            }
+
+            uint8_t *output = level.data.data() + ((size_t)block_y * blocks_x + block_x) * block_size;
+            if (has_alpha)
+            {
+                encodeAlphaBlock(texels, output);
+                encodeColorBlock(texels, output + 8);
+            }
+            else
+                encodeColorBlock(texels, output);
+        }
+    });
+
+    return level;
+}
+
+CompressedTexture BlockCompressor::compress(const cv::Mat &image, bool has_alpha)
+{
+    CompressedTexture texture;
+    texture.format = has_alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+    // Work on 4 channels in any case
+    cv::Mat level;
+    if (image.channels() == 4)
+        level = image;
+    else
+        cv::cvtColor(image, level, cv::COLOR_BGR2BGRA);
+
+    // Compress the whole mip chain
+    while (true)
+    {
+        texture.levels.push_back(compressLevel(level, has_alpha));
+        if (level.cols == 1 && level.rows == 1)
+            break;
+        cv::Mat next_level;
+        cv::resize(level, next_level, cv::Size(std::max(1, level.cols / 2), std::max(1, level.rows / 2)), 0, 0, cv::INTER_AREA);
+        level = next_level;
+    }
+
+    return texture;
+}
+
+std::string BlockCompressor::getCachePath(const std::string &key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash(key.data(), key.size()));
+    return std::string(BLOCK_CACHE_DIRECTORY) + "/" + name + ".bc";
+}
+
+bool BlockCompressor::load(const std::string &key, CompressedTexture &texture)
+{
+    std::string path = getCachePath(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    // Check the header and the full key, to rule out stale files and hash collisions
+    uint32_t header[4];
+    uint32_t key_size;
+    file.read(reinterpret_cast<char *>(header), sizeof(header));
+    file.read(reinterpret_cast<char *>(&key_size), sizeof(key_size));
+    if (!file || header[0] != BLOCK_CACHE_MAGIC || header[1] != BLOCK_CACHE_VERSION || key_size != key.size())
+        return false;
+    std::string stored_key(key_size, '\0');
+    file.read(&stored_key[0], key_size);
+    if (!file || stored_key != key)
+        return false;
+
+    texture.format = header[2];
+    texture.levels.resize(header[3]);
+    for (CompressedLevel &level : texture.levels)
+    {
+        uint32_t level_header[3];
+        file.read(reinterpret_cast<char *>(level_header), sizeof(level_header));
+        if (!file)
+            return false;
+        level.width = level_header[0];
+        level.height = level_header[1];
+        level.data.resize(level_header[2]);
+        file.read(reinterpret_cast<char *>(level.data.data()), level.data.size());
+    }
+    if (!file)
+        return false;
+
+    // Mark the file as the most recently used
+    utime(path.c_str(), nullptr);
+    return true;
+}
+
+void BlockCompressor::save(const std::string &key, const CompressedTexture &texture)
+{
+    mkdir(BLOCK_CACHE_DIRECTORY, 0755);
+
+    // Write to a temporary file first so that a concurrent run never reads a partial file
+    std::string path = getCachePath(key);
+    std::string temporary_path = path + ".tmp";
+    std::ofstream file(temporary_path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << COLOR_YELLOW << "Failed to write the texture cache " << path << COLOR_RESET << std::endl;
+        return;
+    }
+
+    uint32_t header[4] = {BLOCK_CACHE_MAGIC, BLOCK_CACHE_VERSION, (uint32_t)texture.format, (uint32_t)texture.levels.size()};
+    uint32_t key_size = key.size();
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(&key_size), sizeof(key_size));
+    file.write(key.data(), key.size());
+    for (const CompressedLevel &level : texture.levels)
+    {
+        uint32_t level_header[3] = {(uint32_t)level.width, (uint32_t)level.height, (uint32_t)level.data.size()};
+        file.write(reinterpret_cast<const char *>(level_header), sizeof(level_header));
+        file.write(reinterpret_cast<const char *>(level.data.data()), level.data.size());
+    }
+    file.close();
+
+    std::rename(temporary_path.c_str(), path.c_str());
+    evict(path);
+}
+
+void BlockCompressor::evict(const std::string &kept_path)
+{
+    DIR *directory = opendir(BLOCK_CACHE_DIRECTORY);
+    if (directory == nullptr)
+        return;
+
+    // Files of the cache, from the most to the least recently used
+    struct CacheFile
+    {
+        int64_t time;
+        size_t size;
+        std::string path;
+    };
+    std::vector<CacheFile> files;
+    for (struct dirent *entry = readdir(directory); entry != nullptr; entry = readdir(directory))
+    {
+        std::string name = entry->d_name;
+        std::string path = std::string(BLOCK_CACHE_DIRECTORY) + "/" + name;
+        struct stat info;
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".bc") == 0 && stat(path.c_str(), &info) == 0)
+            files.push_back({path == kept_path ? INT64_MAX : info.st_mtim.tv_sec * 1000000000ll + info.st_mtim.tv_nsec, (size_t)info.st_size, path});
+    }
+    closedir(directory);
+    std::stable_sort(files.begin(), files.end(), [](const CacheFile &a, const CacheFile &b) { return a.time > b.time; });
+
+    // Keep the most recent files within the budget, the file just saved always stays
+    size_t total = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (i > 0 && total + files[i].size > BLOCK_CACHE_BUDGET)
+        {
+            std::remove(files[i].path.c_str());
+            continue;
+        }
+        total += files[i].size;
+    }
+}
+
+size_t BlockCompressor::upload(const CompressedTexture &texture)
+{
+    size_t bytes = 0;
+    for (unsigned int i = 0; i < texture.levels.size(); i++)
+    {
+        const CompressedLevel &level = texture.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, texture.format, level.width, level.height, 0, level.data.size(), level.data.data());
+        bytes += level.data.size();
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels.size() - 1);
+    return bytes;
+}
+
+size_t BlockCompressor::uploadImage(const cv::Mat &image, const std::string &key, bool has_alpha)
+{
+    if (!isSupported())
+    {
+        // Uncompressed fallback, the drivers pad RGB texels to 4 bytes and the mip chain adds a third
+        GLenum format = image.channels() == 4 ? GL_BGRA : GL_BGR;
+        glTexImage2D(GL_TEXTURE_2D, 0, has_alpha ? GL_RGBA : GL_RGB, image.cols, image.rows, 0, format, GL_UNSIGNED_BYTE, image.data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        return (size_t)image.cols * image.rows * 4 * 4 / 3;
+    }
+
+    CompressedTexture texture;
+    std::string full_key = key + (has_alpha ? "|bc3" : "|bc1");
+    if (!load(full_key, texture))
+    {
+        texture = compress(image, has_alpha);
+        save(full_key, texture);
+    }
+    return upload(texture);
+}
+
+bool BlockCompressor::isSupported()
+{
+    return GLEW_EXT_texture_compression_s3tc;
+}
+
+std::string BlockCompressor::getFileKey(const std::string &path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return path;
+    return path + "|" + std::to_string((long long)info.st_size) + "|" + std::to_string((long long)info.st_mtime);
+}
+
+uint64_t BlockCompressor::hash(const void *data, size_t size, uint64_t seed)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,183 @@
+/**
+@file
+@brief BlockCompressor header file.
+*/
+
+#ifndef BLOCKCOMPRESSOR_H
+#define BLOCKCOMPRESSOR_H
+
+#include <GL/glew.h>
+#include <opencv2/opencv.hpp>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include "AssetManager.h"
+#include "Colors.h"
+
+// Folder of the transcoded textures
+#define BLOCK_CACHE_DIRECTORY "./assets/cache"
+// Cache file signature and version, to be bumped whenever the encoder output changes
+#define BLOCK_CACHE_MAGIC 0x43424345u
+#define BLOCK_CACHE_VERSION 1
+// Size of the cache on disk in bytes, the least recently used textures (mostly the baked terrains) are evicted beyond it
+#define BLOCK_CACHE_BUDGET (256ull * 1024 * 1024)
+
+/**
+ * @brief Mip level of a block-compressed texture.
+ */
+typedef struct
+{
+    int width;                      ///< Level width in pixels
+    int height;                     ///< Level height in pixels
+    std::vector<uint8_t> data;      ///< Compressed blocks, row by row
+} CompressedLevel;
+
+/**
+ * @brief Block-compressed texture with its whole mip chain.
+ */
+typedef struct
+{
+    GLenum format;                          ///< GL_COMPRESSED_RGB_S3TC_DXT1_EXT (BC1) or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT (BC3)
+    std::vector<CompressedLevel> levels;    ///< Mip levels, from the biggest to 1x1
+} CompressedTexture;
+
+/**
+ * @brief BlockCompressor class which transcodes images to BC1/BC3 and caches the result on disk.
+ *
+ * The encoder works on 4x4 blocks: the color endpoints are the (slightly inset) extremes of the block along its principal axis and
+ * each texel picks the closest of the 4 interpolated colors, alpha (BC3 only) uses the 8 interpolated values mode. Block rows are split among
+ * the AssetManager workers. BC1 stores 8 bytes per block and BC3 16 bytes, i.e. 6x and 4x smaller than RGB and RGBA (8x and 4x in VRAM, where
+ * RGB is padded to 4 bytes). Transcoded mip chains are saved in BLOCK_CACHE_DIRECTORY, so that later runs upload them directly. A load
+ * refreshes the modification time of its file, and the least recently used files are evicted once the cache exceeds BLOCK_CACHE_BUDGET,
+ * since every generated world adds its baked texture.
+ */
+class BlockCompressor
+{
+public:
+    /**
+     * @brief Compress an image and its mip chain.
+     *
+     * @param image BGR or BGRA 8 bit image
+     * @param has_alpha Whether the alpha channel must be kept (BC3) or dropped (BC1)
+     * @return CompressedTexture
+     */
+    static CompressedTexture compress(const cv::Mat &image, bool has_alpha);
+
+    /**
+     * @brief Load a compressed texture from the cache.
+     *
+     * @param key Cache key of the texture
+     * @param texture Loaded texture
+     * @return true If the texture was in the cache
+     * @return false If the texture is missing or stale
+     */
+    static bool load(const std::string &key, CompressedTexture &texture);
+
+    /**
+     * @brief Save a compressed texture into the cache.
+     *
+     * @param key Cache key of the texture
+     * @param texture Texture to save
+     */
+    static void save(const std::string &key, const CompressedTexture &texture);
+
+    /**
+     * @brief Upload a compressed texture into the texture bound to GL_TEXTURE_2D.
+     *
+     * @param texture Compressed texture
+     * @return size_t Uploaded bytes, mip chain included
+     */
+    static size_t upload(const CompressedTexture &texture);
+
+    /**
+     * @brief Upload an image into the texture bound to GL_TEXTURE_2D, compressed through the cache when supported.
+     *
+     * Falls back to an uncompressed upload with generated mipmaps when S3TC is not supported.
+     *
+     * @param image BGR or BGRA 8 bit image
+     * @param key Cache key of the image (see getFileKey)
+     * @param has_alpha Whether the alpha channel must be kept
+     * @return size_t Uploaded bytes, mip chain included (estimated for the uncompressed fallback)
+     */
+    static size_t uploadImage(const cv::Mat &image, const std::string &key, bool has_alpha);
+
+    /**
+     * @brief Check if the S3TC formats are supported by the driver.
+     *
+     * @return true If BC1/BC3 textures can be uploaded
+     * @return false Otherwise
+     */
+    static bool isSupported();
+
+    /**
+     * @brief Build the cache key of a source file from its path, size and modification time.
+     *
+     * @param path Source file path
+     * @return std::string
+     */
+    static std::string getFileKey(const std::string &path);
+
+    /**
+     * @brief Hash a buffer with 64 bit FNV-1a, used to build the cache key of generated textures.
+     *
+     * @param data Buffer to hash
+     * @param size Size in bytes of the buffer
+     * @param seed Hash to continue from
+     * @return uint64_t
+     */
+    static uint64_t hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+private:
+    /**
+     * @brief Delete the least recently used files once the cache exceeds its budget.
+     *
+     * @param kept_path Path of the file just saved, never deleted
+     */
+    static void evict(const std::string &kept_path);
+
+    /**
+     * @brief Compress a single mip level, one block row per job.
+     *
+     * @param image BGRA 8 bit image
+     * @param has_alpha Whether to encode BC3 (true) or BC1 (false) blocks
+     * @return CompressedLevel
+     */
+    static CompressedLevel compressLevel(const cv::Mat &image, bool has_alpha);
+
+    /**
+     * @brief Encode the color part of a 4x4 block.
+     *
+     * @param texels 16 BGRA texels
+     * @param output 8 bytes of output
+     */
+    static void encodeColorBlock(const uint8_t *texels, uint8_t *output);
+
+    /**
+     * @brief Encode the alpha part of a 4x4 block.
+     *
+     * @param texels 16 BGRA texels
+     * @param output 8 bytes of output
+     */
+    static void encodeAlphaBlock(const uint8_t *texels, uint8_t *output);
+
+    /**
+     * @brief Get the path of the cache file of a key.
+     *
+     * @param key Cache key
+     * @return std::string
+     */
+    static std::string getCachePath(const std::string &key);
+};
+
+#endif // BLOCKCOMPRESSOR_H
@@ -16,6 +16,7 @@ Camera::Camera()
     this->beta = 0.0f;
     this->movement_speed = 40.0f;
     this->rotation_speed = 1.5f;
+    this->storeState();
 }
 
 // Parametrized constructor
@@ -28,6 +29,7 @@ Camera::Camera(GLdouble x, GLdouble y, GLdouble z, GLdouble alfa, GLdouble beta,
     this->beta = beta*(M_PI / 180.0);
     this->movement_speed = movement_speed;
     this->rotation_speed = rotation_speed;
+    this->storeState();
 }
 
 // Destructor
@@ -42,6 +44,7 @@ void Camera::reset()
     this->beta = 0.0f;
     this->movement_speed = 4.0f * 10;
     this->rotation_speed = 1.5f;
+    this->storeState();
 }
 
 // Set the position of the camera
@@ -50,6 +53,8 @@ void Camera::setPosition(GLdouble x, GLdouble y, GLdouble z)
     this->position.x = x;
     this->position.y = y;
     this->position.z = z;
+    // Jump to the new position instead of interpolating towards it
+    this->previous_position = this->position;
 }
 
 // Move the camera forward
@@ -162,14 +167,17 @@ void Camera::rotateDown()
     beta -= (M_PI / 180.0) * rotation_speed;
 }
 
+// The mouse rotations are applied to both states, so that they show up in the next frame without waiting for a step
 void Camera::rotateLeftRight(GLdouble delta)
 {
     alfa -= delta*(M_PI / 180.0);
+    previous_alfa -= delta*(M_PI / 180.0);
 }
 
 void Camera::rotateUpDown(GLdouble delta)
 {
     beta -= delta*(M_PI / 180.0);
+    previous_beta -= delta*(M_PI / 180.0);
 }
 
 void Camera::increaseSpeed()
@@ -182,17 +190,37 @@ void Camera::decreaseSpeed()
     this->movement_speed -= 10;
 }
 
+// Store the state of the previous step
+void Camera::storeState()
+{
+    this->previous_position = this->position;
+    this->previous_alfa = this->alfa;
+    this->previous_beta = this->beta;
+}
+
 // Update the camera
-void Camera::update()
+void Camera::update(GLdouble interpolation)
 {
+    // Interpolate between the previous and the current step, rotating the short way around
+    GLdouble delta_alfa = alfa - previous_alfa;
+    if (delta_alfa > M_PI)
+        delta_alfa -= 2 * M_PI;
+    else if (delta_alfa < -M_PI)
+        delta_alfa += 2 * M_PI;
+    GLdouble frame_alfa = previous_alfa + delta_alfa * interpolation;
+    GLdouble frame_beta = previous_beta + (beta - previous_beta) * interpolation;
+    GLdouble frame_x = previous_position.x + (position.x - previous_position.x) * interpolation;
+    GLdouble frame_y = previous_position.y + (position.y - previous_position.y) * interpolation;
+    GLdouble frame_z = previous_position.z + (position.z - previous_position.z) * interpolation;
+
     // Explicitly set gluLookAt() parameters
-    GLdouble eye_x = position.x - sin(alfa);
-    GLdouble eye_y = position.y;
-    GLdouble eye_z = position.z - cos(alfa);
+    GLdouble eye_x = frame_x - sin(frame_alfa);
+    GLdouble eye_y = frame_y;
+    GLdouble eye_z = frame_z - cos(frame_alfa);
     
-    GLdouble center_x = position.x - LOS_DISTANCE * sin(alfa);
-    GLdouble center_y = position.y + beta;
-    GLdouble center_z = position.z - LOS_DISTANCE * cos(alfa);
+    GLdouble center_x = frame_x - LOS_DISTANCE * sin(frame_alfa);
+    GLdouble center_y = frame_y + frame_beta;
+    GLdouble center_z = frame_z - LOS_DISTANCE * cos(frame_alfa);
     
     GLdouble up_x = 0.0;
     GLdouble up_y = 1.0;
@@ -126,10 +126,16 @@ class Camera
          */
         void decreaseSpeed();
 
+        /**
+         * @brief Store the state of the camera before a simulation step, used to interpolate the frames.
+         */
+        void storeState();
+
         /**
          * @brief Update the camera position.
+         * @param interpolation Fraction of the simulation step elapsed since the last step (1 uses the current state).
          */
-        void update();
+        void update(GLdouble interpolation = 1.0);
         
         /**
          * @brief Get the direction of the camera in the 3D space (x,y,z).
@@ -163,6 +169,8 @@ class Camera
     private:
         Vec3<float> position;                       ///< Camera position (x, y, z).
         GLdouble alfa, beta;                        ///< Camera angles (horizontal, vertical).
+        Vec3<float> previous_position;              ///< Camera position at the previous simulation step.
+        GLdouble previous_alfa, previous_beta;      ///< Camera angles at the previous simulation step.
         GLdouble movement_speed, rotation_speed;    ///< Camera speeds (movement, rotation).
         Terrain *terrain;                           ///< Terrain object reference for collision checks.
 };
@@ -31,7 +31,6 @@
 #define VEGETATION 6
 #define SKETCH 7
 
-#define VEGETATION_SPARSITY 50
 #define BUSH_SIZE 500
 #define WAVE_MACRO_AMPLITUDE 500
 #define WAVE_MICRO_AMPLITUDE 25
@@ -47,10 +46,27 @@
 #define STARTING_TIME 7
 #define TIME_SPEED 2
 
+#define STREAM_BUFFER_SIZE (8 * 1024 * 1024)
+
+// Sketch macros
+#define SKETCH_BUFFER_VERTICES 4096     // Initial capacity of the sketch buffers, doubled when full
+#define SKETCH_MIN_DISTANCE 3           // Minimum distance in reference frame pixels between the kept stroke points
+
 // QuadTree macros
 #define CHUNK_SIZE 25
 #define FOV_ANGLE 90
 
+// Vegetation macros
+#define VEGETATION_INSTANCE_STRIDE 5
+#define VEGETATION_CHUNK_SIZE 32
+#define VEGETATION_RADIUS 600
+#define VEGETATION_LEVELS 3
+#define VEGETATION_NEAR_DISTANCE 8000
+#define VEGETATION_MID_DISTANCE 20000
+#define VEGETATION_FAR_DISTANCE 40000
+#define VEGETATION_UPLOADS_PER_FRAME 4
+#define VEGETATION_SEED 1234
+
 // Camera macros
 #define LOS_DISTANCE 2
 
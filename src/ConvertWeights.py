@@ -0,0 +1,54 @@
+## @package ConvertWeights
+#  Convert the weights of the trained generator (model.h5) into the memory mapped file read by the native inference engine (UNet.cpp).
+#  Usage: python src/ConvertWeights.py [./neural_network/model.h5] [./neural_network/model.bin]
+
+import os
+import struct
+import sys
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import numpy as np
+from Predict import TerrainGANBuilder, conv_layers
+
+## Header of the weights file, must match UNET_MAGIC and UNET_VERSION.
+MAGIC = b"ECNN"
+VERSION = 1
+## Alignment of the tensors in the file, must match UNET_ALIGNMENT.
+ALIGNMENT = 64
+
+def _align(offset):
+    return (offset + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+## Function to convert the weights.
+#  The file holds a 16 bytes header (magic, version, number of layers, padding), a descriptor per convolution (kernel height and
+#  width, input and output channels, offsets of the kernel and of the bias) and the aligned float32 tensors. The kernels are
+#  stored HWIO, like Keras does, in the order the convolutions are created by TerrainGANBuilder.
+def convert(model_path, output_path):
+    generator = TerrainGANBuilder().load_model(model_path)
+
+    layers = conv_layers(generator)
+
+    offset = _align(16 + len(layers) * 32)
+    descriptors = []
+    tensors = []
+    for layer in layers:
+        kernel, bias = [np.ascontiguousarray(weights, dtype='<f4') for weights in layer.get_weights()]
+        kernel_height, kernel_width, in_channels, out_channels = kernel.shape
+        kernel_offset = offset
+        bias_offset = _align(kernel_offset + kernel.nbytes)
+        offset = _align(bias_offset + bias.nbytes)
+        descriptors.append(struct.pack('<IIIIQQ', kernel_height, kernel_width, in_channels, out_channels, kernel_offset, bias_offset))
+        tensors += [(kernel_offset, kernel), (bias_offset, bias)]
+
+    with open(output_path, "wb") as file:
+        file.write(MAGIC + struct.pack('<III', VERSION, len(layers), 0))
+        file.write(b"".join(descriptors))
+        for tensor_offset, tensor in tensors:
+            file.write(b"\0" * (tensor_offset - file.tell()))
+            file.write(tensor.tobytes())
+
+    print("Converted %d convolutions into %s (%.1f MB)" % (len(layers), output_path, os.path.getsize(output_path) / (1024 * 1024)))
+
+
+if __name__ == "__main__":
+    convert(sys.argv[1] if len(sys.argv) > 1 else "./neural_network/model.h5",
+            sys.argv[2] if len(sys.argv) > 2 else "./neural_network/model.bin")
@@ -0,0 +1,258 @@
+/**
+@file
+@brief DynamicResolution source file.
+*/
+
+#include "DynamicResolution.h"
+
+
+DynamicResolution *DynamicResolution::instance = nullptr;
+
+// Default constructor
+DynamicResolution::DynamicResolution()
+{
+    if (DynamicResolution::instance == nullptr)
+        DynamicResolution::instance = this;
+
+    this->is_enabled = true;
+    this->is_active = false;
+    this->scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+    this->adjusted_frame = 0;
+    this->width = 0;
+    this->height = 0;
+    this->framebuffer = 0;
+    this->color_texture = 0;
+    this->depth_texture = 0;
+    this->vao = 0;
+    this->vbo = 0;
+}
+
+// Destructor
+DynamicResolution::~DynamicResolution()
+{
+    release();
+    ResourceRegistry::releaseVertexArray(this->vao);
+    ResourceRegistry::releaseBuffer(this->vbo);
+
+    if (DynamicResolution::instance == this)
+        DynamicResolution::instance = nullptr;
+}
+
+void DynamicResolution::initialize()
+{
+    // Fullscreen quad in normalized device coordinates: x, y, s, t
+    const GLfloat vertices[] = {-1.0f, -1.0f, 0.0f, 0.0f,
+                                 1.0f, -1.0f, 1.0f, 0.0f,
+                                 1.0f,  1.0f, 1.0f, 1.0f,
+                                -1.0f,  1.0f, 0.0f, 1.0f};
+
+    // The vertex array keeps the client state of the quad
+    this->vao = ResourceRegistry::createVertexArray(RESOURCE_SCENE);
+    glBindVertexArray(this->vao);
+    this->vbo = ResourceRegistry::createBuffer(RESOURCE_SCENE);
+    glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+    ResourceRegistry::bufferData(this->vbo, GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (void *)0);
+    glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (void *)(2 * sizeof(GLfloat)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DynamicResolution::begin()
+{
+    update();
+
+    this->is_active = this->is_enabled && this->scale < DYNAMIC_RESOLUTION_MAX_SCALE;
+    if (!this->is_active)
+    {
+        // Free the target once the dynamic resolution is disabled
+        if (!this->is_enabled && this->framebuffer)
+            release();
+        return;
+    }
+
+    // Follow the size of the window
+    int window_width = GlutFramework::getWidth();
+    int window_height = GlutFramework::getHeight();
+    if ((window_width != this->width || window_height != this->height) && !allocate(window_width, window_height))
+    {
+        // Render at the native resolution from now on
+        release();
+        this->is_enabled = false;
+        this->is_active = false;
+        this->scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+        return;
+    }
+
+    // Render into the lower left corner of the target, the aspect ratio and so the projection are unchanged
+    int scaled_width = std::max(1, (int)std::lround(this->width * this->scale));
+    int scaled_height = std::max(1, (int)std::lround(this->height * this->scale));
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glViewport(0, 0, scaled_width, scaled_height);
+
+    // Only clear the part of the target being rendered
+    glScissor(0, 0, scaled_width, scaled_height);
+    glEnable(GL_SCISSOR_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void DynamicResolution::end()
+{
+    if (!this->is_active)
+        return;
+
+    Profiler::begin(PASS_UPSCALE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, this->width, this->height);
+
+    // Draw a plain textured quad, whatever the state left by the world passes (e.g. the wireframe mode)
+    glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT | GL_CURRENT_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_TEXTURE_2D);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glColor3f(1.0f, 1.0f, 1.0f);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // Map the centers of the window pixels onto the centers of the rendered texels, so that the bilinear filter never reads
+    // the texels outside of the rendered corner
+    int scaled_width = std::max(1, (int)std::lround(this->width * this->scale));
+    int scaled_height = std::max(1, (int)std::lround(this->height * this->scale));
+    float scale_s = (scaled_width - 1.0f) / std::max(this->width - 1, 1);
+    float scale_t = (scaled_height - 1.0f) / std::max(this->height - 1, 1);
+    glMatrixMode(GL_TEXTURE);
+    glPushMatrix();
+    glLoadIdentity();
+    glTranslatef(0.5f * (1.0f - scale_s) / this->width, 0.5f * (1.0f - scale_t) / this->height, 0.0f);
+    glScalef(scale_s, scale_t, 1.0f);
+
+    glBindTexture(GL_TEXTURE_2D, this->color_texture);
+    glBindVertexArray(this->vao);
+    glDrawArrays(GL_QUADS, 0, 4);
+    Profiler::countDrawCall();
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Restore the matrices and the state
+    glMatrixMode(GL_TEXTURE);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopAttrib();
+
+    Profiler::end(PASS_UPSCALE);
+}
+
+void DynamicResolution::toggle()
+{
+    instance->is_enabled = !instance->is_enabled;
+    instance->scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+    instance->adjusted_frame = Profiler::getResolvedFrames();
+    printf(COLOR_GREEN "Dynamic resolution %s\n" COLOR_RESET, instance->is_enabled ? "enabled" : "disabled");
+}
+
+bool DynamicResolution::isEnabled()
+{
+    return instance->is_enabled;
+}
+
+float DynamicResolution::getScale()
+{
+    return instance->is_enabled ? instance->scale : DYNAMIC_RESOLUTION_MAX_SCALE;
+}
+
+void DynamicResolution::update()
+{
+    // Without timer queries there is nothing to adapt to
+    if (!this->is_enabled || !Profiler::hasTimerQueries())
+    {
+        this->scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+        return;
+    }
+
+    // Wait for the frames rendered since the last adjustment to be resolved, the profiler may have been reset meanwhile
+    unsigned long resolved_frames = Profiler::getResolvedFrames();
+    if (resolved_frames < this->adjusted_frame)
+        this->adjusted_frame = resolved_frames;
+    if (resolved_frames - this->adjusted_frame < DYNAMIC_RESOLUTION_INTERVAL)
+        return;
+    this->adjusted_frame = resolved_frames;
+
+    double gpu_ms = Profiler::getLatest().frame_gpu_ms;
+    if (gpu_ms <= 0.0)
+        return;
+
+    // The cost of the world is roughly proportional to its pixels, the square of the scale
+    if (gpu_ms > DYNAMIC_RESOLUTION_BUDGET_MS)
+        this->scale *= (float)std::sqrt(DYNAMIC_RESOLUTION_BUDGET_MS / gpu_ms);
+    else if (gpu_ms < DYNAMIC_RESOLUTION_BUDGET_MS * DYNAMIC_RESOLUTION_HEADROOM)
+        this->scale += DYNAMIC_RESOLUTION_STEP;
+    this->scale = std::min(std::max(this->scale, DYNAMIC_RESOLUTION_MIN_SCALE), DYNAMIC_RESOLUTION_MAX_SCALE);
+}
+
+bool DynamicResolution::allocate(int width, int height)
+{
+    release();
+    this->width = std::max(width, 1);
+    this->height = std::max(height, 1);
+
+    // Color attachment, filtered by the upscaling quad
+    this->color_texture = ResourceRegistry::createTexture(RESOURCE_SCENE);
+    glBindTexture(GL_TEXTURE_2D, this->color_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, this->width, this->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    ResourceRegistry::setTextureSize(this->color_texture, (size_t)this->width * this->height * 4);
+
+    // Depth and stencil attachment, never sampled
+    this->depth_texture = ResourceRegistry::createTexture(RESOURCE_SCENE);
+    glBindTexture(GL_TEXTURE_2D, this->depth_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, this->width, this->height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    ResourceRegistry::setTextureSize(this->depth_texture, (size_t)this->width * this->height * 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    this->framebuffer = ResourceRegistry::createFramebuffer(RESOURCE_SCENE);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->color_texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, this->depth_texture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << COLOR_RED << "Dynamic resolution target incomplete (0x" << std::hex << status << std::dec << "), rendering at the native resolution" << COLOR_RESET << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void DynamicResolution::release()
+{
+    ResourceRegistry::releaseFramebuffer(this->framebuffer);
+    ResourceRegistry::releaseTexture(this->color_texture);
+    ResourceRegistry::releaseTexture(this->depth_texture);
+    this->width = 0;
+    this->height = 0;
+}
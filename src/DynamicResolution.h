@@ -0,0 +1,123 @@
+/**
+@file
+@brief DynamicResolution header file.
+*/
+
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <GL/glew.h>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include "GlutFramework.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "Colors.h"
+
+// GPU time budget of a world frame in milliseconds (60 fps with some headroom)
+#define DYNAMIC_RESOLUTION_BUDGET_MS 15.0
+// Bounds of the resolution scale, applied to both sides of the window
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0f
+// Increase of the scale while the frames are well under the budget
+#define DYNAMIC_RESOLUTION_STEP 0.05f
+// Fraction of the budget under which the scale is increased
+#define DYNAMIC_RESOLUTION_HEADROOM 0.8
+// Resolved frames between two adjustments, so that the frames rendered at the previous scale are measured first
+#define DYNAMIC_RESOLUTION_INTERVAL (PROFILER_LATENCY + 1)
+
+/**
+ * @brief DynamicResolution class which renders the world at a resolution adapted to the measured GPU time.
+ *
+ * While the world frames fit in DYNAMIC_RESOLUTION_BUDGET_MS, the world is rendered straight into the window. Otherwise it is
+ * rendered into the lower left corner of an offscreen color and depth-stencil target, scaled down so that its pixels (the square
+ * of the scale) fit the budget, then stretched over the window by a bilinear textured quad. The scale is driven by the GPU frame
+ * times resolved by the profiler, and stays at 1 when they can't be measured. The HUD and the menus are drawn afterwards, at the
+ * native resolution.
+ */
+class DynamicResolution
+{
+public:
+    /**
+     * @brief Construct the DynamicResolution singleton, enabled at the native resolution.
+     */
+    DynamicResolution();
+
+    /**
+     * @brief Destroy the DynamicResolution singleton, releasing the render target.
+     */
+    ~DynamicResolution();
+
+    /**
+     * @brief Create the vertex array of the upscaling quad, must be called once the OpenGL context exists.
+     */
+    void initialize();
+
+    /**
+     * @brief Adjust the scale to the last measured frames and, if scaled, redirect the world passes into the render target.
+     */
+    void begin();
+
+    /**
+     * @brief Stretch the render target over the window, if the world was rendered into it.
+     */
+    void end();
+
+    /**
+     * @brief Enable or disable the dynamic resolution, the world is rendered at the native resolution while disabled.
+     */
+    static void toggle();
+
+    /**
+     * @brief Check if the dynamic resolution is enabled.
+     *
+     * @return true If enabled
+     * @return false Otherwise
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Get the current resolution scale.
+     *
+     * @return float Scale of the sides of the window, in [DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE]
+     */
+    static float getScale();
+
+private:
+    static DynamicResolution *instance;     ///< Used to access the DynamicResolution object from the static functions
+
+    bool is_enabled;                        ///< Whether the scale adapts to the GPU time
+    bool is_active;                         ///< Whether the current frame is rendered into the target
+    float scale;                            ///< Current resolution scale
+    unsigned long adjusted_frame;           ///< Resolved frames at the last adjustment
+    int width;                              ///< Width of the render target, the native one
+    int height;                             ///< Height of the render target, the native one
+    GLuint framebuffer;                     ///< Framebuffer object of the render target
+    GLuint color_texture;                   ///< Color attachment, sampled by the upscaling quad
+    GLuint depth_texture;                   ///< Depth and stencil attachment (the water reflection uses the stencil)
+    GLuint vao;                             ///< Vertex array of the upscaling quad
+    GLuint vbo;                             ///< Positions and texture coordinates of the upscaling quad
+
+    /**
+     * @brief Adjust the scale to the last resolved GPU frame time.
+     */
+    void update();
+
+    /**
+     * @brief (Re)allocate the render target at the given size.
+     *
+     * @param width Width of the window
+     * @param height Height of the window
+     * @return true If the framebuffer is complete
+     * @return false Otherwise
+     */
+    bool allocate(int width, int height);
+
+    /**
+     * @brief Release the render target.
+     */
+    void release();
+};
+
+#endif // DYNAMICRESOLUTION_H
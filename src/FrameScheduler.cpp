@@ -0,0 +1,129 @@
+/**
+@file
+@brief FrameScheduler source file.
+*/
+
+#include "FrameScheduler.h"
+
+
+FrameScheduler *FrameScheduler::instance = nullptr;
+
+// Default constructor
+FrameScheduler::FrameScheduler()
+{
+    if (FrameScheduler::instance == nullptr)
+        FrameScheduler::instance = this;
+}
+
+// Destructor
+FrameScheduler::~FrameScheduler()
+{
+    FrameScheduler::instance = nullptr;
+}
+
+void FrameScheduler::initialize(Camera *camera, InputHandler *input_handler, Renderer *renderer)
+{
+    this->camera = camera;
+    this->input_handler = input_handler;
+    this->renderer = renderer;
+
+    this->last_time = std::chrono::steady_clock::now();
+    this->next_frame_time = this->last_time;
+    this->accumulator = 0.0;
+    this->frame_rate = 0.0f;
+    this->is_visible = true;
+
+    // Let the swaps wait for the refresh, the cap then only matters above the refresh rate
+    this->has_vsync = FrameScheduler::enableVsync();
+    if (!this->has_vsync)
+        std::cerr << COLOR_YELLOW << "Swap control not supported, frames are paced by the frame rate cap only" << COLOR_RESET << std::endl;
+
+    glutIdleFunc(FrameScheduler::idleCallback);
+    glutVisibilityFunc(FrameScheduler::visibilityCallback);
+}
+
+float FrameScheduler::getFrameRate()
+{
+    return instance->frame_rate;
+}
+
+bool FrameScheduler::step()
+{
+    if (!InputRecorder::isStepReady())
+        return false;
+
+    // Keep the state of the previous step to interpolate the frames in between
+    this->camera->storeState();
+    this->input_handler->handleKeyboard();
+    this->renderer->update(1.0f / SIMULATION_RATE);
+    InputRecorder::endStep();
+    return true;
+}
+
+bool FrameScheduler::enableVsync()
+{
+    if (GLXEW_EXT_swap_control)
+        glXSwapIntervalEXT(glXGetCurrentDisplay(), glXGetCurrentDrawable(), 1);
+    else if (GLXEW_MESA_swap_control)
+        glXSwapIntervalMESA(1);
+    else if (GLXEW_SGI_swap_control)
+        glXSwapIntervalSGI(1);
+    else
+        return false;
+    return true;
+}
+
+void FrameScheduler::idleCallback()
+{
+    // The world is capped, the menus and the hidden window are throttled
+    int target_rate = MAX_FRAME_RATE;
+    if (!instance->is_visible)
+        target_rate = HIDDEN_FRAME_RATE;
+    else if (instance->renderer->current_menu_page != RENDERING_SCREEN)
+        target_rate = MENU_FRAME_RATE;
+    std::chrono::steady_clock::duration frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / target_rate));
+
+    // Sleep until the next frame is due instead of spinning, a slice at a time so that GLUT keeps handling the events
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now < instance->next_frame_time)
+    {
+        std::chrono::steady_clock::duration max_sleep = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(MAX_IDLE_SLEEP));
+        std::this_thread::sleep_until(std::min(instance->next_frame_time, now + max_sleep));
+        now = std::chrono::steady_clock::now();
+        if (now < instance->next_frame_time)
+            return;
+    }
+    instance->next_frame_time += frame_interval;
+    // Don't try to catch up with the missed frames
+    if (instance->next_frame_time < now)
+        instance->next_frame_time = now + frame_interval;
+
+    // Run the fixed steps covering the elapsed time
+    double elapsed = std::chrono::duration<double>(now - instance->last_time).count();
+    instance->last_time = now;
+    instance->accumulator += std::min(elapsed, MAX_FRAME_TIME);
+    while (instance->accumulator >= 1.0 / SIMULATION_RATE)
+    {
+        // Hold the simulation while a replay waits for a generation
+        if (!instance->step())
+        {
+            instance->accumulator = 0.0;
+            break;
+        }
+        instance->accumulator -= 1.0 / SIMULATION_RATE;
+    }
+
+    // Interpolate the frame between the last two steps
+    instance->renderer->setInterpolation(instance->accumulator * SIMULATION_RATE);
+
+    if (elapsed > 0.0)
+        instance->frame_rate = instance->frame_rate * 0.9f + (1.0f / elapsed) * 0.1f;
+
+    if (instance->is_visible)
+        glutPostRedisplay();
+}
+
+void FrameScheduler::visibilityCallback(int state)
+{
+    instance->is_visible = state == GLUT_VISIBLE;
+}
@@ -0,0 +1,113 @@
+/**
+@file
+@brief FrameScheduler header file.
+*/
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <GL/glew.h>
+#include <GL/glxew.h>
+#include <GL/freeglut.h>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "Camera.h"
+#include "InputHandler.h"
+#include "Renderer.h"
+#include "Colors.h"
+
+// Rate of the fixed simulation steps (camera, day/night cycle, water and vegetation)
+#define SIMULATION_RATE 60
+// Longest frame time simulated at once, so that a stall doesn't trigger an endless catch up
+#define MAX_FRAME_TIME 0.25
+// Frame rate cap of the world
+#define MAX_FRAME_RATE 144
+// Frame rate of the menu pages, which only show the clips (VIDEO_DEFAULT_FPS) and the sketches
+#define MENU_FRAME_RATE 40
+// Frame rate while the window is hidden, where only the simulation keeps running
+#define HIDDEN_FRAME_RATE 4
+// Longest sleep of the idle callback in seconds, GLUT handles the pending events in between
+#define MAX_IDLE_SLEEP 0.004
+
+/**
+ * @brief FrameScheduler class which paces the frames and advances the simulation with a fixed time step.
+ *
+ * The GLUT idle callback sleeps in short slices until the next frame is due, returning to GLUT in between so that the inputs are
+ * still handled at the low frame rates, then runs as many fixed steps as the elapsed time requires
+ * (inputs, camera, day/night cycle, water and vegetation) and requests a single redisplay. The renderer interpolates between the
+ * last two steps, so that the motion stays smooth whatever the frame rate, and the simulation speed doesn't depend on it.
+ * Frames are capped to MAX_FRAME_RATE in the world (or to the refresh rate when vsync is available) and throttled on the menus.
+ */
+class FrameScheduler
+{
+public:
+    /**
+     * @brief Construct the FrameScheduler singleton.
+     */
+    FrameScheduler();
+
+    /**
+     * @brief Destroy the FrameScheduler singleton.
+     */
+    ~FrameScheduler();
+
+    /**
+     * @brief Initialize the scheduler, enable vsync if available and set the glut idle and visibility callbacks.
+     *
+     * @param camera Camera object reference
+     * @param input_handler InputHandler object reference
+     * @param renderer Renderer object reference
+     */
+    void initialize(Camera *camera, InputHandler *input_handler, Renderer *renderer);
+
+    /**
+     * @brief Get the frame rate averaged over the last frames.
+     *
+     * @return float
+     */
+    static float getFrameRate();
+
+private:
+    static FrameScheduler *instance;                        ///< Used to access the FrameScheduler object from the static callback functions
+    Camera *camera;                                         ///< A reference to the camera object
+    InputHandler *input_handler;                            ///< A reference to the input handler object
+    Renderer *renderer;                                     ///< A reference to the renderer object
+
+    std::chrono::steady_clock::time_point last_time;        ///< Time of the last simulated frame
+    std::chrono::steady_clock::time_point next_frame_time;  ///< Time at which the next frame is due
+    double accumulator;                                     ///< Time not simulated yet, less than a step after each frame
+    float frame_rate;                                       ///< Frame rate averaged over the last frames
+    bool is_visible;                                        ///< Whether the window is visible
+    bool has_vsync;                                         ///< Whether the swaps are synchronized with the refresh rate
+
+    /**
+     * @brief Run a fixed simulation step.
+     *
+     * @return true If the step ran
+     * @return false If a replay waits for a generation to complete
+     */
+    bool step();
+
+    /**
+     * @brief Enable the synchronization of the swaps with the refresh rate.
+     *
+     * @return true If a swap control extension is available
+     * @return false Otherwise
+     */
+    static bool enableVsync();
+
+    /**
+     * @brief Implements the idle function which paces the frames and runs the simulation steps.
+     */
+    static void idleCallback();
+
+    /**
+     * @brief Implements the visibility function which stops the redraws while the window is hidden.
+     *
+     * @param state GLUT_VISIBLE or GLUT_NOT_VISIBLE
+     */
+    static void visibilityCallback(int state);
+};
+
+#endif // FRAMESCHEDULER_H
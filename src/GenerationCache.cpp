@@ -0,0 +1,171 @@
+/**
+@file
+@brief GenerationCache source file.
+*/
+
+#include "GenerationCache.h"
+
+
+size_t GenerationCache::budget = GENERATION_CACHE_BUDGET;
+std::atomic<int> GenerationCache::hits(0);
+std::atomic<int> GenerationCache::misses(0);
+std::atomic<size_t> GenerationCache::bytes(0);
+std::mutex GenerationCache::mutex;
+
+void GenerationCache::setBudget(size_t budget)
+{
+    GenerationCache::budget = budget;
+}
+
+bool GenerationCache::isEnabled()
+{
+    return budget > 0;
+}
+
+std::string GenerationCache::getKey(const std::vector<float> &input, uint32_t seed, const std::string &model_key)
+{
+    // The size of the world is part of the tensor size, the weights and the seed complete the content
+    char key[64];
+    snprintf(key, sizeof(key), "|%zu|%u|%016llx", input.size(), seed, (unsigned long long)BlockCompressor::hash(input.data(), input.size() * sizeof(float)));
+    return model_key + key;
+}
+
+bool GenerationCache::load(const std::string &key, cv::Mat &heightmap)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string path = getCachePath(key);
+    std::ifstream file(path, std::ios::binary);
+
+    // Check the header and the full key, to rule out stale files and hash collisions
+    uint32_t header[4] = {0, 0, 0, 0};
+    uint32_t key_size = 0;
+    file.read(reinterpret_cast<char *>(header), sizeof(header));
+    file.read(reinterpret_cast<char *>(&key_size), sizeof(key_size));
+    bool is_valid = file && header[0] == GENERATION_CACHE_MAGIC && header[1] == GENERATION_CACHE_VERSION && key_size == key.size();
+    if (is_valid)
+    {
+        std::string stored_key(key_size, '\0');
+        file.read(&stored_key[0], key_size);
+        is_valid = file && stored_key == key;
+    }
+    if (is_valid)
+    {
+        heightmap.create(header[2], header[3], CV_32FC1);
+        file.read(reinterpret_cast<char *>(heightmap.data), heightmap.total() * sizeof(float));
+        is_valid = (bool)file;
+    }
+    if (!is_valid)
+    {
+        heightmap.release();
+        misses++;
+        return false;
+    }
+
+    // Mark the file as the most recently used
+    utime(path.c_str(), nullptr);
+    hits++;
+    return true;
+}
+
+std::vector<size_t> GenerationCache::loadBatch(const std::vector<std::string> &keys, std::vector<cv::Mat> &heightmaps)
+{
+    std::vector<size_t> missing;
+    heightmaps.assign(keys.size(), cv::Mat());
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i].empty() || !load(keys[i], heightmaps[i]))
+            missing.push_back(i);
+    return missing;
+}
+
+void GenerationCache::save(const std::string &key, const cv::Mat &heightmap)
+{
+    if (heightmap.empty() || !heightmap.isContinuous())
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string directory = GENERATION_CACHE_DIRECTORY;
+    mkdir(directory.substr(0, directory.rfind('/')).c_str(), 0755);
+    mkdir(GENERATION_CACHE_DIRECTORY, 0755);
+
+    // Write to a temporary file first so that a concurrent run never reads a partial file
+    std::string path = getCachePath(key);
+    std::string temporary_path = path + ".tmp";
+    std::ofstream file(temporary_path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << COLOR_YELLOW << "Failed to write the generation cache " << path << COLOR_RESET << std::endl;
+        return;
+    }
+
+    uint32_t header[4] = {GENERATION_CACHE_MAGIC, GENERATION_CACHE_VERSION, (uint32_t)heightmap.rows, (uint32_t)heightmap.cols};
+    uint32_t key_size = key.size();
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(&key_size), sizeof(key_size));
+    file.write(key.data(), key.size());
+    file.write(reinterpret_cast<const char *>(heightmap.data), heightmap.total() * sizeof(float));
+    file.close();
+
+    std::rename(temporary_path.c_str(), path.c_str());
+    evict(path);
+}
+
+int GenerationCache::getHits()
+{
+    return hits;
+}
+
+int GenerationCache::getMisses()
+{
+    return misses;
+}
+
+size_t GenerationCache::getBytes()
+{
+    return bytes;
+}
+
+std::string GenerationCache::getCachePath(const std::string &key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)BlockCompressor::hash(key.data(), key.size()));
+    return std::string(GENERATION_CACHE_DIRECTORY) + "/" + name + ".hm";
+}
+
+void GenerationCache::evict(const std::string &kept_path)
+{
+    DIR *directory = opendir(GENERATION_CACHE_DIRECTORY);
+    if (directory == nullptr)
+        return;
+
+    // Files of the cache, from the most to the least recently used
+    struct CacheFile
+    {
+        int64_t time;
+        size_t size;
+        std::string path;
+    };
+    std::vector<CacheFile> files;
+    for (struct dirent *entry = readdir(directory); entry != nullptr; entry = readdir(directory))
+    {
+        std::string name = entry->d_name;
+        std::string path = std::string(GENERATION_CACHE_DIRECTORY) + "/" + name;
+        struct stat info;
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".hm") == 0 && stat(path.c_str(), &info) == 0)
+            files.push_back({path == kept_path ? INT64_MAX : info.st_mtim.tv_sec * 1000000000ll + info.st_mtim.tv_nsec, (size_t)info.st_size, path});
+    }
+    closedir(directory);
+    std::stable_sort(files.begin(), files.end(), [](const CacheFile &a, const CacheFile &b) { return a.time > b.time; });
+
+    // Keep the most recent files within the budget, the file just saved always stays
+    size_t total = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (i > 0 && total + files[i].size > budget)
+        {
+            std::remove(files[i].path.c_str());
+            continue;
+        }
+        total += files[i].size;
+    }
+    bytes = total;
+}
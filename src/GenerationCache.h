@@ -0,0 +1,140 @@
+/**
+@file
+@brief GenerationCache header file.
+*/
+
+#ifndef GENERATIONCACHE_H
+#define GENERATIONCACHE_H
+
+#include <opencv2/opencv.hpp>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "BlockCompressor.h"
+#include "Colors.h"
+
+// Folder of the cached heightmaps, next to the transcoded textures
+#define GENERATION_CACHE_DIRECTORY "./assets/cache/generation"
+// Cache file signature and version, to be bumped whenever the generator output changes
+#define GENERATION_CACHE_MAGIC 0x43474345u
+#define GENERATION_CACHE_VERSION 1
+// Default size of the cache on disk in bytes, the least recently used heightmaps are evicted beyond it
+#define GENERATION_CACHE_BUDGET (256ull * 1024 * 1024)
+
+/**
+ * @brief GenerationCache class which keeps the generated heightmaps on disk, addressed by what generated them.
+ *
+ * The key of a generation is the hash of the rasterized sketches (the four channels, at the size of the world) together with
+ * the seed of the noise and the key of the generator weights, so the same sketches and seed give back the same heightmap
+ * without running the generator, even in a later session. Every file holds its full key, to rule out hash collisions. A hit
+ * refreshes the modification time of its file, and the least recently used files are evicted once the cache exceeds its budget.
+ */
+class GenerationCache
+{
+public:
+    /**
+     * @brief Set the size of the cache on disk, must be set before the first generation.
+     *
+     * @param budget Bytes kept on disk, 0 disables the cache
+     */
+    static void setBudget(size_t budget);
+
+    /**
+     * @brief Check if the cache is enabled.
+     *
+     * @return true If the budget isn't 0
+     * @return false Otherwise
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Build the key of a generation.
+     *
+     * @param input Rasterized sketches, the model input tensor of the world
+     * @param seed Seed of the model noise
+     * @param model_key Key of the generator weights (see BlockCompressor::getFileKey)
+     * @return std::string
+     */
+    static std::string getKey(const std::vector<float> &input, uint32_t seed, const std::string &model_key);
+
+    /**
+     * @brief Load a heightmap from the cache, counting a hit or a miss.
+     *
+     * @param key Key of the generation
+     * @param heightmap Loaded float heightmap
+     * @return true If the heightmap was in the cache
+     * @return false If it is missing or stale
+     */
+    static bool load(const std::string &key, cv::Mat &heightmap);
+
+    /**
+     * @brief Load the heightmaps of a batch from the cache, counting a hit or a miss for each of them.
+     *
+     * @param keys Key of the generation of each heightmap, an empty key is a miss that isn't counted (cache disabled)
+     * @param heightmaps Loaded float heightmap of each key, empty for the missing ones
+     * @return std::vector<size_t> Indices of the missing heightmaps, to be generated
+     */
+    static std::vector<size_t> loadBatch(const std::vector<std::string> &keys, std::vector<cv::Mat> &heightmaps);
+
+    /**
+     * @brief Save a heightmap into the cache, then evict the least recently used ones beyond the budget.
+     *
+     * @param key Key of the generation
+     * @param heightmap Float heightmap
+     */
+    static void save(const std::string &key, const cv::Mat &heightmap);
+
+    /**
+     * @brief Get the number of generations found in the cache.
+     *
+     * @return int
+     */
+    static int getHits();
+
+    /**
+     * @brief Get the number of generations missing from the cache.
+     *
+     * @return int
+     */
+    static int getMisses();
+
+    /**
+     * @brief Get the size of the cache on disk, as of the last save.
+     *
+     * @return size_t Bytes
+     */
+    static size_t getBytes();
+
+private:
+    static size_t budget;                   ///< Bytes kept on disk, 0 if disabled
+    static std::atomic<int> hits;           ///< Generations found in the cache
+    static std::atomic<int> misses;         ///< Generations missing from the cache
+    static std::atomic<size_t> bytes;       ///< Size of the cache on disk
+    static std::mutex mutex;                ///< Serializes the accesses to the cache folder
+
+    /**
+     * @brief Get the path of the cache file of a key.
+     *
+     * @param key Key of the generation
+     * @return std::string
+     */
+    static std::string getCachePath(const std::string &key);
+
+    /**
+     * @brief Remove the least recently used files until the cache fits its budget.
+     *
+     * @param kept_path Path of the file just saved, never removed
+     */
+    static void evict(const std::string &kept_path);
+};
+
+#endif // GENERATIONCACHE_H
@@ -0,0 +1,267 @@
+/**
+@file
+@brief GenerationQueue source file.
+*/
+
+#include "GenerationQueue.h"
+
+
+GenerationQueue* GenerationQueue::instance = nullptr;
+
+// Default constructor
+GenerationQueue::GenerationQueue()
+{
+    if (GenerationQueue::instance == nullptr)
+        GenerationQueue::instance = this;
+
+    this->inference = nullptr;
+    this->is_stopping = false;
+    this->is_cancelled = false;
+    this->stage = GENERATION_STAGE_IDLE;
+    this->terrain = nullptr;
+    this->is_failed = false;
+}
+
+// Destructor
+GenerationQueue::~GenerationQueue()
+{
+    // Stop the worker, the job in progress stops at its next check
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.clear();
+        this->is_stopping = true;
+        this->is_cancelled = true;
+    }
+    this->condition.notify_all();
+    if (this->thread.joinable())
+        this->thread.join();
+
+    if (this->inference != nullptr)
+        this->inference->setCancelFlag(nullptr);
+    delete this->terrain;
+
+    if (GenerationQueue::instance == this)
+        GenerationQueue::instance = nullptr;
+}
+
+void GenerationQueue::initialize(Inference *inference)
+{
+    this->inference = inference;
+    this->inference->setCancelFlag(&this->is_cancelled);
+    this->thread = std::thread(&GenerationQueue::run, this);
+}
+
+void GenerationQueue::generate(const std::vector<float> &input, const std::vector<uint32_t> &seeds)
+{
+    cancel();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back({GENERATION_JOB_GENERATE, input, seeds, cv::Mat()});
+        this->stage = GENERATION_STAGE_INFERENCE;
+    }
+    this->condition.notify_one();
+}
+
+void GenerationQueue::build(const cv::Mat &heightmap)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back({GENERATION_JOB_BUILD, std::vector<float>(), std::vector<uint32_t>(), heightmap});
+        this->stage = GENERATION_STAGE_HEIGHTMAP;
+    }
+    this->condition.notify_one();
+}
+
+void GenerationQueue::reset()
+{
+    cancel();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back({GENERATION_JOB_RESET, std::vector<float>(), std::vector<uint32_t>(), cv::Mat()});
+    }
+    this->condition.notify_one();
+}
+
+void GenerationQueue::cancel()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    // The resets are kept, the engine must still forget the previous sketches
+    this->jobs.erase(std::remove_if(this->jobs.begin(), this->jobs.end(), [](const GenerationJob &job) { return job.type != GENERATION_JOB_RESET; }), this->jobs.end());
+    this->is_cancelled = true;
+    this->stage = GENERATION_STAGE_IDLE;
+
+    // Drop a terrain or a failure nobody took yet, together with the enter key press its completion scheduled
+    if (this->terrain != nullptr || this->is_failed)
+    {
+        delete this->terrain;
+        this->terrain = nullptr;
+        this->is_failed = false;
+        InputRecorder::consumeGenerated();
+    }
+}
+
+Terrain *GenerationQueue::takeTerrain()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    Terrain *terrain = this->terrain;
+    this->terrain = nullptr;
+    if (terrain != nullptr)
+        this->stage = GENERATION_STAGE_IDLE;
+    return terrain;
+}
+
+bool GenerationQueue::takeFailure()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    bool is_failed = this->is_failed;
+    this->is_failed = false;
+    return is_failed;
+}
+
+int GenerationQueue::getStage()
+{
+    return instance == nullptr ? GENERATION_STAGE_IDLE : instance->stage.load();
+}
+
+const char *GenerationQueue::getStageName(int stage)
+{
+    switch (stage)
+    {
+        case GENERATION_STAGE_INFERENCE:
+            return "inference";
+        case GENERATION_STAGE_HEIGHTMAP:
+            return "heightmap";
+        case GENERATION_STAGE_TEXTURE:
+            return "texture bake";
+        case GENERATION_STAGE_WATER:
+            return "water";
+        case GENERATION_STAGE_MESHES:
+            return "meshes";
+        default:
+            return "idle";
+    }
+}
+
+void GenerationQueue::run()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->condition.wait(lock, [this] { return this->is_stopping || !this->jobs.empty(); });
+        if (this->is_stopping)
+            break;
+
+        // A cancellation from now on stops this job
+        GenerationJob job = std::move(this->jobs.front());
+        this->jobs.pop_front();
+        this->is_cancelled = false;
+        lock.unlock();
+
+        process(job);
+
+        lock.lock();
+    }
+}
+
+void GenerationQueue::process(const GenerationJob &job)
+{
+    if (job.type == GENERATION_JOB_RESET)
+    {
+        this->inference->reset();
+        return;
+    }
+    if (job.type == GENERATION_JOB_BUILD)
+    {
+        buildTerrain(job.heightmap);
+        return;
+    }
+
+    if (!setStage(GENERATION_STAGE_INFERENCE))
+        return;
+
+    // The variants are generated in one batch, the terrain is built once the user chooses one of them
+    if (job.seeds.size() > 1)
+    {
+        std::vector<cv::Mat> heightmaps = this->inference->predictBatch(job.input, job.seeds);
+        if (!heightmaps.empty())
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->is_cancelled)
+                return;
+            VariantGallery::setVariants(heightmaps);
+            this->stage = GENERATION_STAGE_IDLE;
+            return;
+        }
+        fail();
+        return;
+    }
+
+    buildTerrain(this->inference->predict(job.input, job.seeds[0]));
+}
+
+void GenerationQueue::buildTerrain(const cv::Mat &heightmap)
+{
+    // A cancelled prediction also returns an empty heightmap, only a failure is reported
+    if (heightmap.empty())
+    {
+        fail();
+        return;
+    }
+    if (!setStage(GENERATION_STAGE_HEIGHTMAP))
+        return;
+
+    Terrain *terrain = new Terrain();
+    terrain->setScale(WORLD_SCALE, TEXTURE_SCALE);
+    terrain->loadHeightmap(heightmap);
+
+    bool is_built = setStage(GENERATION_STAGE_TEXTURE);
+    if (is_built)
+        terrain->loadTexture();
+    is_built = is_built && setStage(GENERATION_STAGE_WATER);
+    if (is_built)
+        terrain->loadWatermap();
+    if (!is_built)
+    {
+        delete terrain;
+        printf(COLOR_YELLOW "Generation cancelled\n" COLOR_RESET);
+        fflush(stdout);
+        return;
+    }
+    printf("Water level: %d\n", terrain->getWaterLevel());
+
+    // Hand the terrain over, the next simulation step presses enter and the main thread builds the meshes
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->is_cancelled)
+    {
+        delete terrain;
+        return;
+    }
+    delete this->terrain;
+    this->terrain = terrain;
+    this->stage = GENERATION_STAGE_MESHES;
+    InputRecorder::setGenerated();
+}
+
+void GenerationQueue::fail()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->is_cancelled)
+        return;
+    printf(COLOR_RED "Error: The terrain could not be generated\n" COLOR_RESET);
+    fflush(stdout);
+
+    // The next simulation step presses enter, which finds the failure and goes back to the sketches
+    this->is_failed = true;
+    this->stage = GENERATION_STAGE_IDLE;
+    InputRecorder::setGenerated();
+}
+
+bool GenerationQueue::setStage(int stage)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->is_cancelled)
+        return false;
+    this->stage = stage;
+    return true;
+}
@@ -0,0 +1,189 @@
+/**
+@file
+@brief GenerationQueue header file.
+*/
+
+#ifndef GENERATIONQUEUE_H
+#define GENERATIONQUEUE_H
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Constants.h"
+#include "Inference.h"
+#include "InputRecorder.h"
+#include "Terrain.h"
+#include "VariantGallery.h"
+#include "Colors.h"
+
+// Stages of a generation, in order, reported on the loading screen
+#define GENERATION_STAGE_IDLE -1
+#define GENERATION_STAGE_INFERENCE 0
+#define GENERATION_STAGE_HEIGHTMAP 1
+#define GENERATION_STAGE_TEXTURE 2
+#define GENERATION_STAGE_WATER 3
+#define GENERATION_STAGE_MESHES 4
+#define GENERATION_STAGE_COUNT 5
+
+// Kinds of jobs run by the worker
+#define GENERATION_JOB_GENERATE 0
+#define GENERATION_JOB_BUILD 1
+#define GENERATION_JOB_RESET 2
+
+/**
+ * @brief Job waiting for the generation worker.
+ */
+typedef struct
+{
+    int type;                       ///< GENERATION_JOB_GENERATE, GENERATION_JOB_BUILD or GENERATION_JOB_RESET
+    std::vector<float> input;       ///< Rasterized sketches to generate from (GENERATION_JOB_GENERATE)
+    std::vector<uint32_t> seeds;    ///< Seed of the model noise of each variant (GENERATION_JOB_GENERATE)
+    cv::Mat heightmap;              ///< Heightmap to build the terrain of (GENERATION_JOB_BUILD)
+} GenerationJob;
+
+/**
+ * @brief GenerationQueue class which runs the terrain generations on a worker thread, one job after the other.
+ *
+ * A generation job runs the generator, then builds the terrain in stages: the heightmap, the texture bake and the water. The
+ * worker publishes the stage it is in, drawn on the loading screen, and hands the finished terrain over under the queue mutex;
+ * the main thread draws one more loading frame showing the meshes stage, then takes it with takeTerrain and builds the meshes
+ * (quadtree, water and vegetation), which need the OpenGL context. In the variant mode the job hands the variants to the VariantGallery instead, and a build job builds the chosen one.
+ * A job whose generator fails is reported with takeFailure, and the user goes back to the page the generation was started from.
+ *
+ * Cancelling drops the queued jobs and raises a flag checked between the stages, before each convolution of the native
+ * generator and between the tile batches of a large world, so the job in progress stops early and its result is discarded. A
+ * completion is only notified to the InputRecorder under the queue mutex, so a cancelled job never presses enter, even in a
+ * replay. The inference engine is only reset by a job of the worker, never while it predicts.
+ */
+class GenerationQueue
+{
+public:
+    /**
+     * @brief Construct the GenerationQueue singleton, without worker.
+     */
+    GenerationQueue();
+
+    /**
+     * @brief Destroy the GenerationQueue singleton, cancelling the jobs and joining the worker.
+     */
+    ~GenerationQueue();
+
+    /**
+     * @brief Start the worker.
+     *
+     * @param inference Inference engine run by the jobs, only used by the worker from now on
+     */
+    void initialize(Inference *inference);
+
+    /**
+     * @brief Cancel the jobs, then queue the generation of new sketches.
+     *
+     * @param input Rasterized sketches (see Renderer::rasterizeSketches)
+     * @param seeds Seed of the model noise of each variant, the variants go to the VariantGallery if there are more than one
+     */
+    void generate(const std::vector<float> &input, const std::vector<uint32_t> &seeds);
+
+    /**
+     * @brief Queue the build of the terrain of a chosen variant.
+     *
+     * @param heightmap Float heightmap of the variant
+     */
+    void build(const cv::Mat &heightmap);
+
+    /**
+     * @brief Cancel the jobs, then queue the reset of the inference engine for new sketches.
+     */
+    void reset();
+
+    /**
+     * @brief Cancel the queued jobs and the job in progress, dropping a terrain waiting for the main thread.
+     */
+    void cancel();
+
+    /**
+     * @brief Take the terrain of the last completed job, must be called by the main thread which then builds its meshes.
+     *
+     * @return Terrain* Terrain built by the worker, owned by the caller, nullptr if none is ready
+     */
+    Terrain *takeTerrain();
+
+    /**
+     * @brief Check if the last job failed to generate a heightmap, clearing the failure, must be called by the main thread.
+     *
+     * A failure is notified to the InputRecorder like a completion, so the enter key press it schedules finds no terrain.
+     *
+     * @return true If the last job failed
+     * @return false Otherwise
+     */
+    bool takeFailure();
+
+    /**
+     * @brief Get the stage of the generation in progress.
+     *
+     * @return int GENERATION_STAGE_INFERENCE to GENERATION_STAGE_MESHES, GENERATION_STAGE_IDLE if no generation is in progress
+     */
+    static int getStage();
+
+    /**
+     * @brief Get the name of a stage.
+     *
+     * @param stage Stage of a generation
+     * @return const char*
+     */
+    static const char *getStageName(int stage);
+
+private:
+    static GenerationQueue *instance;       ///< Used to access the GenerationQueue object from the static functions
+
+    Inference *inference;                   ///< Inference engine run by the jobs
+    std::thread thread;                     ///< Worker thread
+    std::mutex mutex;                       ///< Protects the jobs, the stage, the finished terrain and the failure
+    std::condition_variable condition;      ///< Wakes the worker up on a new job or on stop
+    std::deque<GenerationJob> jobs;         ///< Jobs waiting for the worker
+    bool is_stopping;                       ///< Whether the worker must exit
+    std::atomic<bool> is_cancelled;         ///< Cancels the job in progress, lowered when the worker takes the next job
+    std::atomic<int> stage;                 ///< Stage of the generation in progress
+    Terrain *terrain;                       ///< Finished terrain waiting for the main thread, nullptr if none
+    bool is_failed;                         ///< Whether the last job failed, waiting for the main thread
+
+    /**
+     * @brief Worker thread: wait for the jobs and run them in order.
+     */
+    void run();
+
+    /**
+     * @brief Run a job.
+     *
+     * @param job Job taken from the queue
+     */
+    void process(const GenerationJob &job);
+
+    /**
+     * @brief Build a terrain stage by stage and hand it over to the main thread.
+     *
+     * @param heightmap Generated heightmap, the job fails if empty
+     */
+    void buildTerrain(const cv::Mat &heightmap);
+
+    /**
+     * @brief Report the failure of the job in progress to the main thread, unless it was cancelled.
+     */
+    void fail();
+
+    /**
+     * @brief Enter a stage of the job in progress.
+     *
+     * @param stage Stage entered
+     * @return true If the job goes on
+     * @return false If it was cancelled
+     */
+    bool setStage(int stage);
+};
+
+#endif // GENERATIONQUEUE_H
@@ -3,9 +3,8 @@
 @brief GlutFramework source file.
 */
 
-#include <GL/glew.h>
-#include <GL/freeglut.h>
 #include "GlutFramework.h"
+#include "InputRecorder.h"
 
 
 GlutFramework* GlutFramework::instance = nullptr;
@@ -15,6 +14,11 @@ GlutFramework::GlutFramework()
 {
     if (GlutFramework::instance == nullptr)
         GlutFramework::instance = this;
+
+    this->is_headless = false;
+    this->headless_width = 0;
+    this->headless_height = 0;
+    this->headless_swap = nullptr;
 }
 
 // Destructor
@@ -35,6 +39,56 @@ void GlutFramework::initialize(int argc, char** argv)
     glewExperimental = GL_TRUE;
     glewInit();
 
+    GlutFramework::initializeState();
+}
+
+bool GlutFramework::initializeHeadless(int width, int height, void (*swap_buffers)())
+{
+    this->is_headless = true;
+    this->headless_width = width;
+    this->headless_height = height;
+    this->headless_swap = swap_buffers;
+
+    // Without a GLX display glewInit only fails on the GLX extensions, the OpenGL ones are loaded
+    glewExperimental = GL_TRUE;
+    GLenum error = glewInit();
+    if (error != GLEW_OK && error != GLEW_ERROR_NO_GLX_DISPLAY)
+    {
+        std::cerr << COLOR_RED << "Failed to initialize GLEW: " << glewGetErrorString(error) << COLOR_RESET << std::endl;
+        return false;
+    }
+
+    GlutFramework::initializeState();
+    GlutFramework::resize(width, height);
+
+    return true;
+}
+
+bool GlutFramework::isHeadless()
+{
+    return instance != nullptr && instance->is_headless;
+}
+
+int GlutFramework::getWidth()
+{
+    return isHeadless() ? instance->headless_width : glutGet(GLUT_WINDOW_WIDTH);
+}
+
+int GlutFramework::getHeight()
+{
+    return isHeadless() ? instance->headless_height : glutGet(GLUT_WINDOW_HEIGHT);
+}
+
+void GlutFramework::swapBuffers()
+{
+    if (isHeadless())
+        instance->headless_swap();
+    else
+        glutSwapBuffers();
+}
+
+void GlutFramework::initializeState()
+{
     // Set the clear color for the color buffer to white with 0 alpha (fully opaque)
     glClearColor(0.0, 0.0, 0.0, 0.0);
     
@@ -85,6 +139,9 @@ void GlutFramework::initialize(int argc, char** argv)
 // OpenGL window reshape routine.
 void GlutFramework::resize(int w, int h)
 {
+    // Keep track of the window size, to rescale the mouse positions of the recording when it is replayed
+    InputRecorder::record(EVENT_RESIZE, 0, 0, w, h);
+
     // Set up the viewport to cover the entire window.
     glViewport(0, 0, w, h);
     
@@ -104,7 +161,8 @@ void GlutFramework::resize(int w, int h)
     glLoadIdentity();
     
     // Mark the window for redisplay.
-    glutPostRedisplay();
+    if (!isHeadless())
+        glutPostRedisplay();
 }
 
 // Run the GLUT event processing loop
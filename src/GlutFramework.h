@@ -6,13 +6,19 @@
 #ifndef GLUTFRAMEWORK_H
 #define GLUTFRAMEWORK_H
 
-#include "InputHandler.h"
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+#include <iostream>
+#include "Colors.h"
 
 
 /**
  * @brief Glut framework class which encapsulates glut statefulness.
  *
  * This class is a singleton that handles the initialization and the encapsulation of the glut framework.
+ * It can also run on a headless context, rendering into an offscreen surface instead of a glut window, for the benchmark:
+ * the window size and the swaps then go through the static functions below rather than through glut. The benchmark creates the
+ * offscreen EGL context itself, so that only it links EGL.
  */
 class GlutFramework
 {
@@ -39,6 +45,47 @@ class GlutFramework
          */
         void initialize(int argc, char** argv);
 
+        /**
+         * @brief Initialize a headless OpenGL context, created and made current by the caller on an offscreen surface.
+         * 
+         * No window is created and no glut callback is ever called.
+         * 
+         * @param width Width of the offscreen surface
+         * @param height Height of the offscreen surface
+         * @param swap_buffers Function swapping the buffers of the offscreen surface
+         * @return true If the OpenGL functions were loaded
+         * @return false Otherwise
+         */
+        bool initializeHeadless(int width, int height, void (*swap_buffers)());
+
+        /**
+         * @brief Check if the context is headless.
+         * 
+         * @return true If rendering into the offscreen surface
+         * @return false If rendering into the glut window
+         */
+        static bool isHeadless();
+
+        /**
+         * @brief Get the width of the window or of the offscreen surface.
+         * 
+         * @return int
+         */
+        static int getWidth();
+
+        /**
+         * @brief Get the height of the window or of the offscreen surface.
+         * 
+         * @return int
+         */
+        static int getHeight();
+
+        /**
+         * @brief Swap the buffers of the window or of the offscreen surface.
+         * 
+         */
+        static void swapBuffers();
+
         /**
          * @brief Resize the glut window.
          * 
@@ -55,6 +102,16 @@ class GlutFramework
     
     private:
         static GlutFramework* instance; ///< Singleton instance of the GlutFramework class.
+        bool is_headless;               ///< Whether rendering into the offscreen surface
+        int headless_width;             ///< Width of the offscreen surface
+        int headless_height;            ///< Height of the offscreen surface
+        void (*headless_swap)();        ///< Swaps the buffers of the offscreen surface
+
+        /**
+         * @brief Set the initial OpenGL state, shared by the window and the headless context.
+         * 
+         */
+        static void initializeState();
 };
 
 #endif // GLUTFRAMEWORK_H
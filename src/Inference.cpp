@@ -6,44 +6,571 @@
 #include "Inference.h"
 
 
+bool Inference::is_saving = false;
+bool Inference::is_validating = false;
+int Inference::world_tiles = 1;
+
 Inference::Inference()
 {
+    this->module = nullptr;
+    this->cold_ms = 0.0;
+    this->predictions = 0;
+    this->cancel_flag = nullptr;
+
+    // Python is only needed without a C++ backend, or to validate it
+    bool is_loaded = false;
+#ifdef USE_ONNXRUNTIME
+    is_loaded = onnx.load(INFERENCE_ONNX_PATH);
+    if (is_loaded)
+    {
+        this->model_key = BlockCompressor::getFileKey(INFERENCE_ONNX_PATH);
+        printf(COLOR_GREEN "Generator ready (ONNX Runtime, %s)\n" COLOR_RESET, INFERENCE_ONNX_PATH);
+    }
+#endif
+    if (!is_loaded && network.load(INFERENCE_WEIGHTS_PATH))
+    {
+        is_loaded = true;
+        this->model_key = BlockCompressor::getFileKey(INFERENCE_WEIGHTS_PATH);
+        printf(COLOR_GREEN "Generator ready (native, %s)\n" COLOR_RESET, INFERENCE_WEIGHTS_PATH);
+    }
+    if (!is_loaded)
+        this->model_key = BlockCompressor::getFileKey(INFERENCE_MODEL_PATH);
+    this->is_python = !is_loaded || is_validating;
+    if (!this->is_python)
+        return;
+
     Py_Initialize();                               // Initialize the Python interpreter
     PyEval_InitThreads();                          // Initialize the Python threading system
     Py_DECREF(PyImport_ImportModule("threading")); // Import the 'threading' module
     state = PyEval_SaveThread();                   // Save the current thread state
+
+    // Build the generator in background while the user is on the landing and sketch pages
+    this->warmup_start = std::chrono::steady_clock::now();
+    this->warmup_thread = std::thread(&Inference::warmUp, this);
 }
 
 Inference::~Inference()
 {
+    if (warmup_thread.joinable())
+        warmup_thread.join();
+    if (save_thread.joinable())
+        save_thread.join();
+    if (!is_python)
+        return;
+
     PyEval_RestoreThread(state); // Restore the saved thread state
+    Py_XDECREF(module);          // Release the resident generator
     Py_FinalizeEx();             // Finalize the Python interpreter
 }
 
 void Inference::reset()
 {
-    PyEval_RestoreThread(state); // Restore the saved thread state
-    state = PyEval_SaveThread(); // Save the current thread state
+    // New sketches are coming, drop the encoder activations of the previous ones
+    network.clearCache();
+    if (!is_python)
+        return;
+
+    // Called by the generation worker, the saved thread state belongs to the main thread
+    if (module && !warmup_thread.joinable())
+    {
+        PyGILState_STATE gil_state = PyGILState_Ensure(); // Acquire the Global Interpreter Lock (GIL)
+        PyObject *result = PyObject_CallMethod(module, "clear_cache", nullptr);
+        if (result == nullptr)
+            PyErr_Print();
+        Py_XDECREF(result);
+        PyGILState_Release(gil_state); // Release the Global Interpreter Lock (GIL)
+    }
+}
+
+void Inference::setCancelFlag(const std::atomic<bool> *cancel_flag)
+{
+    this->cancel_flag = cancel_flag;
+    network.setCancelFlag(cancel_flag);
+}
+
+void Inference::setSaving(bool is_saving)
+{
+    Inference::is_saving = is_saving;
+}
+
+void Inference::setValidation(bool is_validating)
+{
+    Inference::is_validating = is_validating;
+}
+
+void Inference::setWorldTiles(int world_tiles)
+{
+    Inference::world_tiles = std::max(world_tiles, 1);
+}
+
+int Inference::getWorldSize()
+{
+    return INFERENCE_MAP_SIZE + (world_tiles - 1) * (INFERENCE_MAP_SIZE - INFERENCE_TILE_OVERLAP);
+}
+
+void Inference::warmUp()
+{
+    PyGILState_STATE gil_state = PyGILState_Ensure(); // Acquire the Global Interpreter Lock (GIL)
+
+    // Import the module once, its generator stays resident
+    PyObject *sys_path = PySys_GetObject("path");
+    PyObject *directory = PyUnicode_FromString(INFERENCE_SCRIPT_DIR);
+    PyList_Append(sys_path, directory);
+    Py_DECREF(directory);
+    module = PyImport_ImportModule(INFERENCE_MODULE);
+
+    // Build the generator, load its weights and compile its forward pass
+    PyObject *result = module ? PyObject_CallMethod(module, "load", "s", INFERENCE_MODEL_PATH) : nullptr;
+    if (result == nullptr)
+    {
+        PyErr_Print();
+        Py_CLEAR(module);
+    }
+    Py_XDECREF(result);
+
+    PyGILState_Release(gil_state); // Release the Global Interpreter Lock (GIL)
+
+    cold_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - warmup_start).count();
+    if (module)
+        printf(COLOR_GREEN "Generator ready in %.0f ms (cold start)\n" COLOR_RESET, cold_ms);
+    else
+        printf(COLOR_RED "Error: Could not load the generator\n" COLOR_RESET);
+    fflush(stdout);
+}
+
+cv::Mat Inference::predict(const std::vector<float> &input, uint32_t seed)
+{
+    // The same sketches with the same seed and weights were already generated: read the heightmap back
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string key = getCacheKey(input, seed);
+    cv::Mat heightmap;
+    if (!key.empty() && GenerationCache::load(key, heightmap))
+    {
+        double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf(COLOR_GREEN "Heightmap read from the generation cache in %.0f ms (%d hits, %d misses)\n" COLOR_RESET, total_ms,
+               GenerationCache::getHits(), GenerationCache::getMisses());
+        fflush(stdout);
+        save(heightmap);
+        return heightmap;
+    }
+
+    heightmap = generate(input, seed);
+    if (!key.empty() && !heightmap.empty())
+        GenerationCache::save(key, heightmap);
+    save(heightmap);
+    return heightmap;
+}
+
+cv::Mat Inference::generate(const std::vector<float> &input, uint32_t seed)
+{
+    // Worlds larger than the model input are generated tile by tile
+    if (input.size() > (size_t)INFERENCE_MAP_SIZE * INFERENCE_MAP_SIZE * UNET_INPUT_CHANNELS)
+        return predictTiled(input, seed);
+
+    cv::Mat heightmap;
+    const char *backend = nullptr;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#ifdef USE_ONNXRUNTIME
+    if (onnx.isLoaded())
+    {
+        heightmap = onnx.predict(input, seed);
+        backend = "ONNX Runtime";
+    }
+#endif
+    if (backend == nullptr && network.isLoaded())
+    {
+        // A re-roll of the same sketches only runs the decoder
+        backend = network.isCached(input) ? "native, re-roll from the cached encoder activations" : "native";
+        heightmap = network.predict(input, seed);
+    }
+
+    if (backend != nullptr && isCancelled())
+    {
+        printf(COLOR_YELLOW "Inference cancelled\n" COLOR_RESET);
+        fflush(stdout);
+        return cv::Mat();
+    }
+
+    // The Python generator can only take over if its interpreter was started (validation mode)
+    if (backend != nullptr && heightmap.empty())
+    {
+        printf(COLOR_RED "Error: Inference failed (%s)%s\n" COLOR_RESET, backend, is_python ? ", falling back to Python" : "");
+        fflush(stdout);
+        if (!is_python)
+            return cv::Mat();
+        backend = nullptr;
+    }
+
+    if (backend != nullptr)
+    {
+        double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        predictions++;
+        printf(COLOR_GREEN "Inference complete in %.0f ms (%s, prediction %d)\n" COLOR_RESET, total_ms, backend, predictions);
+        fflush(stdout);
+
+        if (is_validating && !heightmap.empty())
+        {
+            // Only time the warm Python generator
+            if (warmup_thread.joinable())
+                warmup_thread.join();
+            std::chrono::steady_clock::time_point reference_start = std::chrono::steady_clock::now();
+            std::vector<cv::Mat> references = predictPython(input, std::vector<uint32_t>(1, seed), false);
+            cv::Mat reference = references.empty() ? cv::Mat() : references[0];
+            double reference_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reference_start).count();
+            if (!reference.empty())
+                validate(heightmap, reference, total_ms, reference_ms);
+        }
+    }
+    else
+    {
+        std::vector<cv::Mat> heightmaps = predictPython(input, std::vector<uint32_t>(1, seed), false);
+        if (!heightmaps.empty())
+            heightmap = heightmaps[0];
+    }
+
+    clearBorder(heightmap);
+    return heightmap;
+}
+
+std::vector<cv::Mat> Inference::predictBatch(const std::vector<float> &input, const std::vector<uint32_t> &seeds)
+{
+    // Read back the variants generated already, only the missing ones run
+    std::vector<std::string> keys;
+    for (uint32_t seed : seeds)
+        keys.push_back(getCacheKey(input, seed));
+    std::vector<cv::Mat> heightmaps;
+    std::vector<size_t> missing = GenerationCache::loadBatch(keys, heightmaps);
+    if (missing.size() < seeds.size())
+    {
+        printf(COLOR_GREEN "%zu of %zu variants read from the generation cache (%d hits, %d misses)\n" COLOR_RESET,
+               seeds.size() - missing.size(), seeds.size(), GenerationCache::getHits(), GenerationCache::getMisses());
+        fflush(stdout);
+    }
+    if (missing.empty())
+        return heightmaps;
+
+    std::vector<uint32_t> missing_seeds;
+    for (size_t index : missing)
+        missing_seeds.push_back(seeds[index]);
+    std::vector<cv::Mat> generated = generateBatch(input, missing_seeds);
+    if (generated.size() != missing_seeds.size())
+        return std::vector<cv::Mat>();
+    for (size_t i = 0; i < generated.size(); i++)
+    {
+        heightmaps[missing[i]] = generated[i];
+        if (!keys[missing[i]].empty())
+            GenerationCache::save(keys[missing[i]], generated[i]);
+    }
+    return heightmaps;
 }
 
-void Inference::predict()
+std::vector<cv::Mat> Inference::generateBatch(const std::vector<float> &input, const std::vector<uint32_t> &seeds)
 {
+    std::vector<cv::Mat> heightmaps;
+
+    // Each variant of a large world is already a batch of tiles
+    if (input.size() > (size_t)INFERENCE_MAP_SIZE * INFERENCE_MAP_SIZE * UNET_INPUT_CHANNELS)
+    {
+        for (size_t i = 0; i < seeds.size(); i++)
+        {
+            cv::Mat heightmap = predictTiled(input, seeds[i]);
+            if (heightmap.empty())
+                return std::vector<cv::Mat>();
+            heightmaps.push_back(heightmap);
+        }
+        return heightmaps;
+    }
+
+    const char *backend = nullptr;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#ifdef USE_ONNXRUNTIME
+    if (onnx.isLoaded())
+    {
+        heightmaps = onnx.predict(input, seeds);
+        backend = "ONNX Runtime, one batched run";
+    }
+#endif
+    if (backend == nullptr && network.isLoaded())
+    {
+        // The encoder runs once for all the variants, then only the decoder runs for each of them
+        backend = "native, shared encoder";
+        for (uint32_t seed : seeds)
+        {
+            cv::Mat heightmap = network.predict(input, seed);
+            if (heightmap.empty())
+            {
+                heightmaps.clear();
+                break;
+            }
+            heightmaps.push_back(heightmap);
+        }
+    }
+
+    // The Python generator can only take over if its interpreter was started (validation mode)
+    if (backend != nullptr && heightmaps.empty() && !isCancelled())
+    {
+        printf(COLOR_RED "Error: Inference of %zu variants failed (%s)%s\n" COLOR_RESET, seeds.size(), backend, is_python ? ", falling back to Python" : "");
+        fflush(stdout);
+        if (is_python)
+            backend = nullptr;
+    }
+
+    if (backend == nullptr)
+        heightmaps = predictPython(input, seeds, false);
+    else if (!heightmaps.empty())
+    {
+        double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        predictions++;
+        printf(COLOR_GREEN "Inference of %zu variants complete in %.0f ms, %.0f ms per variant (%s, prediction %d)\n" COLOR_RESET,
+               seeds.size(), total_ms, total_ms / seeds.size(), backend, predictions);
+        fflush(stdout);
+    }
+
+    for (cv::Mat &heightmap : heightmaps)
+        clearBorder(heightmap);
+    return heightmaps;
+}
+
+cv::Mat Inference::predictTiled(const std::vector<float> &input, uint32_t seed)
+{
+    const int size = (int)std::lround(std::sqrt(input.size() / (double)UNET_INPUT_CHANNELS));
+    const int tile = INFERENCE_MAP_SIZE;
+    const size_t tile_size = (size_t)tile * tile * UNET_INPUT_CHANNELS;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Tiles along each side, spread evenly so that neighbours overlap by at least INFERENCE_TILE_OVERLAP
+    int count = (int)std::ceil((double)(size - INFERENCE_TILE_OVERLAP) / (tile - INFERENCE_TILE_OVERLAP));
+    std::vector<int> offsets(count, 0);
+    for (int i = 1; i < count; i++)
+        offsets[i] = (int)std::lround((double)i * (size - tile) / (count - 1));
+
+    // Feathering weight along each axis of a tile: none on its unreliable border, rising to 1 across the overlap. The floor keeps
+    // the border of the world, covered by a single tile, defined until it is blacked out
+    std::vector<float> ramp(tile);
+    for (int i = 0; i < tile; i++)
+    {
+        int distance = std::min(i, tile - 1 - i);
+        ramp[i] = std::min(std::max((distance + 1.0f - INFERENCE_BORDER) / (INFERENCE_TILE_OVERLAP - INFERENCE_BORDER), 1e-4f), 1.0f);
+    }
+
+    cv::Mat heights = cv::Mat::zeros(size, size, CV_32FC1);
+    cv::Mat weights = cv::Mat::zeros(size, size, CV_32FC1);
+    std::vector<float> tiles;
+    tiles.reserve(tile_size * INFERENCE_TILE_BATCH);
+    std::vector<uint32_t> seeds;
+    std::vector<cv::Point> origins;
+    const char *backend = nullptr;
+
+    for (int index = 0; index < count * count; index++)
+    {
+        // Cut the tile out of the sketches, each tile draws its own noise
+        cv::Point origin(offsets[index % count], offsets[index / count]);
+        for (int y = 0; y < tile; y++)
+        {
+            std::vector<float>::const_iterator row = input.begin() + ((size_t)(origin.y + y) * size + origin.x) * UNET_INPUT_CHANNELS;
+            tiles.insert(tiles.end(), row, row + tile * UNET_INPUT_CHANNELS);
+        }
+        seeds.push_back(seed + index);
+        origins.push_back(origin);
+        if ((int)seeds.size() < INFERENCE_TILE_BATCH && index + 1 < count * count)
+            continue;
+
+        // A cancelled world stops between the batches, whatever the backend
+        std::vector<cv::Mat> heightmaps = isCancelled() ? std::vector<cv::Mat>() : predictTiles(tiles, seeds, backend);
+        if (heightmaps.size() != seeds.size())
+            return cv::Mat();
+
+        // Accumulate the weighted heights of the batch
+        for (size_t i = 0; i < heightmaps.size(); i++)
+            for (int y = 0; y < tile; y++)
+            {
+                const float *tile_row = heightmaps[i].ptr<float>(y);
+                float *height_row = heights.ptr<float>(origins[i].y + y) + origins[i].x;
+                float *weight_row = weights.ptr<float>(origins[i].y + y) + origins[i].x;
+                for (int x = 0; x < tile; x++)
+                {
+                    float weight = ramp[y] * ramp[x];
+                    height_row[x] += weight * tile_row[x];
+                    weight_row[x] += weight;
+                }
+            }
+
+        tiles.clear();
+        seeds.clear();
+        origins.clear();
+    }
+
+    cv::Mat heightmap;
+    cv::divide(heights, weights, heightmap);
+    clearBorder(heightmap);
+
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    predictions++;
+    printf(COLOR_GREEN "Inference of a %d px world complete in %.0f ms, %dx%d tiles, %.0f ms per tile (%s, prediction %d)\n" COLOR_RESET,
+           size, total_ms, count, count, total_ms / (count * count), backend, predictions);
+    fflush(stdout);
+    return heightmap;
+}
+
+std::vector<cv::Mat> Inference::predictTiles(const std::vector<float> &tiles, const std::vector<uint32_t> &seeds, const char *&backend)
+{
+#ifdef USE_ONNXRUNTIME
+    if (onnx.isLoaded())
+    {
+        backend = "ONNX Runtime, batched tiles";
+        return onnx.predictBatch(tiles, seeds);
+    }
+#endif
+    if (network.isLoaded())
+    {
+        // The tiles run one after the other, each convolution on every core
+        backend = "native";
+        const size_t tile_size = tiles.size() / seeds.size();
+        std::vector<cv::Mat> heightmaps;
+        for (size_t i = 0; i < seeds.size(); i++)
+        {
+            std::vector<float> tile(tiles.begin() + i * tile_size, tiles.begin() + (i + 1) * tile_size);
+            cv::Mat heightmap = network.predict(tile, seeds[i]);
+            if (heightmap.empty())
+                break;
+            heightmaps.push_back(heightmap);
+        }
+        // The encoder activations of a tile are of no use to the next world
+        network.clearCache();
+        return heightmaps.size() == seeds.size() ? heightmaps : std::vector<cv::Mat>();
+    }
+
+    backend = "Python, batched tiles";
+    return predictPython(tiles, seeds, true);
+}
+
+std::vector<cv::Mat> Inference::predictPython(const std::vector<float> &input, const std::vector<uint32_t> &seeds, bool is_tiled)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Wait for the generator if the user was faster than its warm-up
+    if (warmup_thread.joinable())
+        warmup_thread.join();
+    double wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // The generator writes the heights of the variants straight into this matrix, one below the other
+    const int size = INFERENCE_MAP_SIZE;
+    cv::Mat output(size * (int)seeds.size(), size, CV_32FC1);
+    bool is_predicted = false;
+
     PyGILState_STATE gil_state;
     gil_state = PyGILState_Ensure(); // Acquire the Global Interpreter Lock (GIL)
-    FILE *file = fopen("./src/Predict.py", "r");
-    
-    // Check if the Python script file was opened successfully
-    if (file)
+
+    if (module)
     {
-        PyRun_SimpleFile(file, "./src/Predict.py"); // Execute the Python script
-        fclose(file);
+        // Expose the input tensor and the heightmaps through the buffer protocol, with the seed of the noise of each variant
+        PyObject *tensor = PyMemoryView_FromMemory((char *)input.data(), input.size() * sizeof(float), PyBUF_READ);
+        PyObject *heightmaps = PyMemoryView_FromMemory((char *)output.data, output.total() * sizeof(float), PyBUF_WRITE);
+        PyObject *seed_list = PyList_New(seeds.size());
+        for (size_t i = 0; i < seeds.size(); i++)
+            PyList_SET_ITEM(seed_list, i, PyLong_FromUnsignedLong(seeds[i]));
+        PyObject *result = PyObject_CallMethod(module, is_tiled ? "predict_tiles" : "predict_batch", "(OOO)", tensor, seed_list, heightmaps);
+        Py_DECREF(tensor);
+        Py_DECREF(heightmaps);
+        Py_DECREF(seed_list);
+        if (result == nullptr)
+            PyErr_Print();
+        is_predicted = result != nullptr;
+        Py_XDECREF(result);
     }
     else
     {
-        printf("Error: Could not open Python script file\n");
+        printf("Error: The generator is not loaded\n");
     }
     
     PyGILState_Release(gil_state); // Release the Global Interpreter Lock (GIL)
-    printf(COLOR_GREEN "Inference complete\n" COLOR_RESET);
+
+    if (!is_predicted || seeds.empty())
+        return std::vector<cv::Mat>();
+
+    // Report the latency of the warm generator apart from the cold start
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    predictions++;
+    char variants[64] = "";
+    if (seeds.size() > 1)
+        snprintf(variants, sizeof(variants), ", %zu variants, %.0f ms per variant", seeds.size(), total_ms / seeds.size());
+    if (wait_ms >= 1.0)
+        printf(COLOR_GREEN "Inference complete in %.0f ms (%.0f ms waiting for the warm-up, cold start %.0f ms%s)\n" COLOR_RESET, total_ms, wait_ms, cold_ms, variants);
+    else
+        printf(COLOR_GREEN "Inference complete in %.0f ms (warm, cold start %.0f ms, prediction %d%s)\n" COLOR_RESET, total_ms, cold_ms, predictions, variants);
+    fflush(stdout);
+
+    // The heightmaps share the output matrix, each one is continuous
+    std::vector<cv::Mat> heightmaps;
+    for (size_t i = 0; i < seeds.size(); i++)
+        heightmaps.push_back(output.rowRange(i * size, (i + 1) * size));
+    return heightmaps;
+}
+
+bool Inference::isCancelled()
+{
+    return this->cancel_flag != nullptr && this->cancel_flag->load();
+}
+
+std::string Inference::getCacheKey(const std::vector<float> &input, uint32_t seed)
+{
+    // Validation needs the generators to run
+    if (!GenerationCache::isEnabled() || is_validating)
+        return std::string();
+    return GenerationCache::getKey(input, seed, this->model_key);
+}
+
+void Inference::save(const cv::Mat &heightmap)
+{
+    // Save a copy of the heightmap off the critical path, the matrix is shared with the terrain which only reads it
+    if (!is_saving || heightmap.empty())
+        return;
+
+    if (save_thread.joinable())
+        save_thread.join();
+    save_thread = std::thread([heightmap]() {
+        cv::Mat image;
+        heightmap.convertTo(image, CV_8U);
+        if (!cv::imwrite(INFERENCE_HEIGHTMAP_PATH, image))
+            printf(COLOR_RED "Error: Could not save %s\n" COLOR_RESET, INFERENCE_HEIGHTMAP_PATH);
+    });
+}
+
+void Inference::clearBorder(cv::Mat &heightmap)
+{
+    if (heightmap.empty())
+        return;
+
+    for (int i = 0; i < heightmap.rows; i++)
+    {
+        float *row = heightmap.ptr<float>(i);
+        bool is_border_row = i < INFERENCE_BORDER || i >= heightmap.rows - INFERENCE_BORDER;
+        for (int j = 0; j < heightmap.cols; j++)
+            if (is_border_row || j < INFERENCE_BORDER || j >= heightmap.cols - INFERENCE_BORDER)
+                row[j] = 0.0f;
+    }
+}
+
+void Inference::validate(const cv::Mat &heightmap, const cv::Mat &reference, double backend_ms, double reference_ms)
+{
+    // Both backends draw the same noise, so the heights only differ by the rounding of the float operations
+    double max_error = 0.0;
+    double total_error = 0.0;
+    for (int i = 0; i < heightmap.rows; i++)
+    {
+        const float *row = heightmap.ptr<float>(i);
+        const float *reference_row = reference.ptr<float>(i);
+        for (int j = 0; j < heightmap.cols; j++)
+        {
+            double error = std::fabs((double)row[j] - reference_row[j]);
+            max_error = std::max(max_error, error);
+            total_error += error;
+        }
+    }
+
+    bool is_valid = max_error <= INFERENCE_TOLERANCE;
+    printf("%sValidation %s: max error %.4f, mean error %.5f (tolerance %.1f), %.0f ms against %.0f ms for Python (%.1fx)\n" COLOR_RESET,
+           is_valid ? COLOR_GREEN : COLOR_RED, is_valid ? "passed" : "failed", max_error, total_error / heightmap.total(), INFERENCE_TOLERANCE,
+           backend_ms, reference_ms, reference_ms / std::max(backend_ms, 1e-3));
     fflush(stdout);
-}
\ No newline at end of file
+}
@@ -6,17 +6,63 @@
 #ifndef INFERENCE_H
 #define INFERENCE_H
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <thread>
+#include <vector>
 #include <Python.h>
 #include "Colors.h"
 #include "Constants.h"
+#include "GenerationCache.h"
 #include "Terrain.h"
+#include "UNet.h"
+#include "OnnxGenerator.h"
+
+// Directory and name of the Python module running the generator
+#define INFERENCE_SCRIPT_DIR "./src"
+#define INFERENCE_MODULE "Predict"
+// Weights of the generator, for the Python backend and converted for the native one (see src/ConvertWeights.py)
+#define INFERENCE_MODEL_PATH "./neural_network/model.h5"
+#define INFERENCE_WEIGHTS_PATH "./neural_network/model.bin"
+// Generator exported for ONNX Runtime (python src/Predict.py --export-onnx), used when built with USE_ONNXRUNTIME
+#define INFERENCE_ONNX_PATH "./neural_network/model.onnx"
+// Largest height difference accepted between the native and the Python backends when validating
+#define INFERENCE_TOLERANCE 1.0
+// Side of the model input and output
+#define INFERENCE_MAP_SIZE 450
+// Width of the black border of the heightmaps, where the generator output is unreliable
+#define INFERENCE_BORDER 5
+// Smallest overlap between neighbouring tiles of a larger world, feathered across, and tiles generated per run
+#define INFERENCE_TILE_OVERLAP 90
+#define INFERENCE_TILE_BATCH 4
+// Optional copy of the generated heightmaps on disk
+#define INFERENCE_HEIGHTMAP_PATH "./assets/sketches/heightmap.png"
 
 /**
- * @brief Inference engine class which runs the python prediction.
+ * @brief Inference engine class which runs the generator, natively or through Python.
+ *
+ * When built with USE_ONNXRUNTIME and the exported generator INFERENCE_ONNX_PATH exists, the generator runs through ONNX Runtime
+ * (see OnnxGenerator). Otherwise, when the converted weights INFERENCE_WEIGHTS_PATH exist, it runs natively on the CPU (see
+ * UNet). In both cases Python is never started. Otherwise this class manages the Python interpreter state and keeps the generator resident. As soon as the engine is created (on the
+ * landing page) a background thread imports the Predict module, which builds the generator, loads its weights and compiles and
+ * warms up its forward pass; every prediction then only pays for the forward pass. A prediction requested before the warm-up is
+ * over waits for it. The sketches and the heightmap are exchanged with the module through the buffer protocol: the input tensor
+ * is exposed as a read-only memoryview and the generator writes the float heights straight into a matrix allocated here, handed
+ * to the terrain without ever touching the disk. The heightmap can additionally be saved as png in background.
+ *
+ * The noise only enters the generator at its bottleneck: the native and the Python backends keep the encoder activations of the
+ * last sketches, so that a new variant of the same sketches (a re-roll) only runs the decoder. They are dropped by reset.
+ *
+ * Worlds larger than the model input (see setWorldTiles) are generated tile by tile: the sketches are cut into overlapping
+ * INFERENCE_MAP_SIZE windows, run INFERENCE_TILE_BATCH at a time, and their heightmaps are blended with weights fading out
+ * towards the tile borders, so the seams disappear and the time grows linearly with the area.
  *
- * This class runs the Python script thread that performs the inference and manages the Python interpreter state.
- * The output of the inference is an heightmap stored as png from the Python script into the assets/sketches folder. 
+ * The heightmaps are kept in the GenerationCache, keyed by the sketches, the seed and the weights of the backend, so generating
+ * the same sketches with the same seed again (e.g. after going back to the landing page) reads the heightmap back from the disk.
+ *
+ * In validation mode the Python backend runs too, and the heightmaps and latencies of the C++ backend are compared with its own.
+ * The cache is then bypassed.
  */
 class Inference
 {
@@ -32,17 +78,179 @@ public:
     ~Inference();
 
     /**
-     * @brief Run the inference engine.
+     * @brief Run the inference engine, waiting for the warm-up if it isn't over yet.
+     *
+     * @param input getWorldSize() square input tensor with 4 channels (see Renderer::rasterizeSketches), tiled if larger than 450x450x4
+     * @param seed Seed of the model noise, so that a replayed session generates the same terrain
+     * @return cv::Mat Float heightmap of the size of the input with heights in [0, 255] and the border black, empty if the prediction failed
+     */
+    cv::Mat predict(const std::vector<float> &input, uint32_t seed);
+
+    /**
+     * @brief Generate several variants of the same sketches at once, cheaper per variant than as many predictions.
+     *
+     * The Python and ONNX Runtime backends stack the noises along the batch dimension and run a single forward pass; the native
+     * backend runs the encoder once and the decoder for each variant.
+     *
+     * @param input Model input tensor, as for predict (the variants of a tiled world are generated one after the other)
+     * @param seeds Seed of the noise of each variant, a variant is the heightmap predict generates with its seed
+     * @return std::vector<cv::Mat> Float heightmap of each variant, empty if the prediction failed
      */
-    void predict();
+    std::vector<cv::Mat> predictBatch(const std::vector<float> &input, const std::vector<uint32_t> &seeds);
 
     /**
-     * @brief Reset the inference engine state.
+     * @brief Reset the inference engine state, dropping the cached encoder activations.
      */
     void reset();
 
+    /**
+     * @brief Set a flag cancelling the predictions in progress, checked before each convolution of the native generator and
+     * between the tile batches of a large world (a Python or ONNX Runtime run always completes).
+     *
+     * @param cancel_flag Flag raised to cancel, nullptr for none
+     */
+    void setCancelFlag(const std::atomic<bool> *cancel_flag);
+
+    /**
+     * @brief Enable or disable the background save of the generated heightmaps into INFERENCE_HEIGHTMAP_PATH.
+     *
+     * @param is_saving Whether to save the heightmaps
+     */
+    static void setSaving(bool is_saving);
+
+    /**
+     * @brief Enable or disable the validation of the C++ backend against the Python one, must be set before the engine is created.
+     *
+     * @param is_validating Whether to run both backends and compare their heightmaps
+     */
+    static void setValidation(bool is_validating);
+
+    /**
+     * @brief Set the size of the generated worlds, in model inputs along each side.
+     *
+     * @param world_tiles Tiles along each side of the world, 1 for a single model input
+     */
+    static void setWorldTiles(int world_tiles);
+
+    /**
+     * @brief Get the side of the generated worlds: INFERENCE_MAP_SIZE, plus INFERENCE_MAP_SIZE - INFERENCE_TILE_OVERLAP per extra tile.
+     *
+     * @return int Side of the input tensor and of the heightmap in pixels
+     */
+    static int getWorldSize();
+
 private:
-    PyThreadState *state; ///< Python thread state.
+    static bool is_saving;                              ///< Whether the heightmaps are saved on disk
+    static bool is_validating;                          ///< Whether the native heightmaps are compared with the Python ones
+    static int world_tiles;                             ///< Tiles along each side of the generated worlds
+
+#ifdef USE_ONNXRUNTIME
+    OnnxGenerator onnx;                                 ///< ONNX Runtime generator, loaded if the exported model exists
+#endif
+    UNet network;                                       ///< Native generator, loaded if the converted weights exist
+    bool is_python;                                     ///< Whether the Python interpreter was started
+    PyThreadState *state;                               ///< Python thread state.
+    PyObject *module;                                   ///< Predict module holding the resident generator, nullptr if the warm-up failed
+    std::thread warmup_thread;                          ///< Thread building and warming up the generator
+    std::chrono::steady_clock::time_point warmup_start; ///< Start of the warm-up
+    double cold_ms;                                     ///< Time taken by the warm-up in milliseconds
+    int predictions;                                    ///< Number of predictions run
+    std::thread save_thread;                            ///< Thread saving the last heightmap
+    std::string model_key;                              ///< Key of the weights of the backend, part of the generation cache keys
+    const std::atomic<bool> *cancel_flag;               ///< Flag cancelling the predictions in progress, nullptr if none
+
+    /**
+     * @brief Check if the predictions in progress were cancelled.
+     *
+     * @return true If the cancel flag is raised
+     * @return false Otherwise
+     */
+    bool isCancelled();
+
+    /**
+     * @brief Import the Predict module and build, load and warm up the generator (run by the warm-up thread).
+     */
+    void warmUp();
+
+    /**
+     * @brief Run the generator, without the generation cache.
+     *
+     * @param input Model input tensor, as for predict
+     * @param seed Seed of the model noise
+     * @return cv::Mat Float heightmap with the border black, empty if the prediction failed
+     */
+    cv::Mat generate(const std::vector<float> &input, uint32_t seed);
+
+    /**
+     * @brief Run the generator on several variants, without the generation cache.
+     *
+     * @param input Model input tensor, as for predict
+     * @param seeds Seed of the noise of each variant
+     * @return std::vector<cv::Mat> Float heightmap of each variant with the border black, empty if the prediction failed
+     */
+    std::vector<cv::Mat> generateBatch(const std::vector<float> &input, const std::vector<uint32_t> &seeds);
+
+    /**
+     * @brief Build the generation cache key of the sketches and a seed.
+     *
+     * @param input Model input tensor
+     * @param seed Seed of the model noise
+     * @return std::string Key, empty if the cache is disabled or bypassed
+     */
+    std::string getCacheKey(const std::vector<float> &input, uint32_t seed);
+
+    /**
+     * @brief Generate a world larger than the model input from overlapping tiles, blended with feathered weights.
+     *
+     * @param input Square input tensor larger than the model input
+     * @param seed Seed of the model noise, each tile draws its own noise from the seed and its index
+     * @return cv::Mat Float heightmap of the size of the input with heights in [0, 255], empty if the prediction failed
+     */
+    cv::Mat predictTiled(const std::vector<float> &input, uint32_t seed);
+
+    /**
+     * @brief Run the generator on a batch of tiles with the first available backend.
+     *
+     * @param tiles Model input tensors of the tiles, one after the other
+     * @param seeds Seed of the model noise of each tile
+     * @param backend Name of the backend which ran
+     * @return std::vector<cv::Mat> Float heightmap of each tile, empty if the prediction failed
+     */
+    std::vector<cv::Mat> predictTiles(const std::vector<float> &tiles, const std::vector<uint32_t> &seeds, const char *&backend);
+
+    /**
+     * @brief Run the Python generator, waiting for the warm-up if it isn't over yet.
+     *
+     * @param input Model input tensor, or the tensors of the tiles one after the other
+     * @param seeds Seed of the model noise of each variant (or tile), all generated in one forward pass
+     * @param is_tiled Whether the input holds one tile per seed rather than the sketches shared by the variants
+     * @return std::vector<cv::Mat> Float heightmap of each variant, empty if the prediction failed
+     */
+    std::vector<cv::Mat> predictPython(const std::vector<float> &input, const std::vector<uint32_t> &seeds, bool is_tiled);
+
+    /**
+     * @brief Save a copy of a heightmap in background if enabled, the matrix is shared with the terrain which only reads it.
+     *
+     * @param heightmap Float heightmap
+     */
+    void save(const cv::Mat &heightmap);
+
+    /**
+     * @brief Black out the INFERENCE_BORDER wide border of a heightmap, where the generator output is unreliable.
+     *
+     * @param heightmap Float heightmap
+     */
+    static void clearBorder(cv::Mat &heightmap);
+
+    /**
+     * @brief Compare a heightmap of the C++ backend with the Python one and report the difference and the speedup.
+     *
+     * @param heightmap Heightmap of the C++ backend
+     * @param reference Python heightmap
+     * @param backend_ms Latency of the C++ backend in milliseconds
+     * @param reference_ms Latency of the warm Python backend in milliseconds
+     */
+    static void validate(const cv::Mat &heightmap, const cv::Mat &reference, double backend_ms, double reference_ms);
 };
 
 #endif
@@ -4,7 +4,6 @@
 */
 
 #include "InputHandler.h"
-#include <thread>
 
 
 InputHandler* InputHandler::instance = nullptr;
@@ -14,11 +13,15 @@ InputHandler::InputHandler()
 {
     if (InputHandler::instance == nullptr)
         InputHandler::instance = this;
+
+    this->terrain = nullptr;
 }
 
 // Destructor
 InputHandler::~InputHandler()
 {
+    delete this->terrain;
+
     InputHandler::instance = nullptr;
 }
 
@@ -29,6 +32,8 @@ void InputHandler::initialize(Camera *camera, Renderer *renderer, SoundManager *
     this->inference = new Inference();
     this->sound_manager = sound_manager;
     this->quadtree = quadtree;
+    this->generation_queue.initialize(this->inference);
+    this->generator.seed(InputRecorder::getSeed());
 
     glutKeyboardFunc(InputHandler::handleRegularKeyPress);
     glutKeyboardUpFunc(InputHandler::handleRegularKeyRelease);
@@ -36,7 +41,6 @@ void InputHandler::initialize(Camera *camera, Renderer *renderer, SoundManager *
     glutSpecialUpFunc(InputHandler::handleSpecialKeyRelease);
     glutMouseFunc(InputHandler::mouseClick);
     glutMotionFunc(InputHandler::mouseMotion);
-    glutIdleFunc(InputHandler::idleCallback);
     
     this->sound_manager->playBackgroundMusic();
 }
@@ -44,6 +48,15 @@ void InputHandler::initialize(Camera *camera, Renderer *renderer, SoundManager *
 // Handle keyboard input
 void InputHandler::handleKeyboard()
 {
+    replayEvents();
+    
+    // Once the terrain is generated, simulate an enter key press in the step the recording (if any) will replay it
+    if (!InputRecorder::isReplaying() && InputRecorder::consumeGenerated())
+    {
+        InputRecorder::record(EVENT_GENERATED, 0, 0, 0, 0);
+        keys[13] = true;
+    }
+    
     // If the splashscreen is not shown then handle the movement keyboard inputs
     if (!(renderer->current_menu_page >= 0))
     {        
@@ -91,7 +104,10 @@ void InputHandler::handleKeyboard()
      
      // Exit the program if the Esc key is pressed.
     if (keys[27] || keys['q'])
+    {
+        Renderer::release();
         exit(0);
+    }
     
     // If f is pressed toggle full screen mode on/off
     if (keys['f'])
@@ -118,13 +134,98 @@ void InputHandler::handleKeyboard()
         keys['p'] = false;
     }
     
+    // If i is pressed toggle the profiler statistics on/off
+    if (keys['i'])
+    {
+        renderer->show_stats = !renderer->show_stats;
+        keys['i'] = false;
+    }
+    
+    // If o is pressed start/stop recording the profiled frames
+    if (keys['o'])
+    {
+        Profiler::toggleRecording();
+        keys['o'] = false;
+    }
+    
+    // If m is pressed print the live resources of each subsystem
+    if (keys['m'])
+    {
+        ResourceRegistry::dump();
+        keys['m'] = false;
+    }
+    
+    // If u is pressed toggle the dynamic resolution of the world on/off
+    if (keys['u'])
+    {
+        DynamicResolution::toggle();
+        keys['u'] = false;
+    }
+    
+    // If r is pressed in the world generate another variant of the same sketches, the generator only runs its decoder again
+    if (keys['r'])
+    {
+        if (renderer->current_menu_page == RENDERING_SCREEN)
+        {
+            loading_origin = RENDERING_SCREEN;
+            renderer->current_menu_page = LOADING_SCREEN;
+            printf(COLOR_MAGENTA "Re-rolling the terrain, entering page %d\n" COLOR_RESET, renderer->current_menu_page);
+            fflush(stdout);
+
+            instance->sound_manager->playClickSound();
+            glEnable(GL_MULTISAMPLE);
+            startGeneration();
+        }
+        keys['r'] = false;
+    }
+    
+    // If v is pressed toggle the generation of several variants to choose from
+    if (keys['v'])
+    {
+        variant_count = variant_count > 1 ? 1 : VARIANT_COUNT;
+        printf(COLOR_GREEN "Variant mode %s\n" COLOR_RESET, variant_count > 1 ? "enabled" : "disabled");
+        keys['v'] = false;
+    }
+    
+    // On the loading page the number keys choose the variant the world is built from, as soon as the variants are ready
+    if (renderer->current_menu_page == LOADING_SCREEN)
+        for (int i = 0; i < VARIANT_MAX_COUNT; i++)
+            if (keys['1' + i])
+            {
+                chosen_variant = i;
+                keys['1' + i] = false;
+            }
+    if (chosen_variant >= 0 && VariantGallery::isReady())
+    {
+        cv::Mat heightmap = VariantGallery::choose(chosen_variant);
+        chosen_variant = -1;
+        if (!heightmap.empty())
+        {
+            instance->sound_manager->playClickSound();
+            generation_queue.build(heightmap);
+        }
+    }
+    
+    // If backspace is pressed on the loading page cancel the generation and go back to the page it was started from
+    if (keys[8])
+    {
+        if (renderer->current_menu_page == LOADING_SCREEN)
+        {
+            generation_queue.cancel();
+            chosen_variant = -1;
+            keys[13] = false;
+            leaveLoadingScreen();
+            printf(COLOR_MAGENTA "Generation cancelled, entering page %d\n" COLOR_RESET, renderer->current_menu_page);
+            fflush(stdout);
+
+            instance->sound_manager->playClickSound();
+        }
+        keys[8] = false;
+    }
+    
     // If enter is pressed travel to the next page in the menu
     if (keys[13])
     {        
-        // Take a snapshot of the current screen before incrementing the menu page
-        if (renderer->current_menu_page == RIDGES_SCREEN | renderer->current_menu_page == PEAKS_SCREEN | renderer->current_menu_page == RIVERS_SCREEN | renderer->current_menu_page == BASINS_SCREEN)
-            renderer->takeSnapshot();
-        
         // If the current page is the last page then go back to the first page
         if (renderer->current_menu_page >= 5)
             renderer->current_menu_page  = -1;
@@ -139,7 +240,8 @@ void InputHandler::handleKeyboard()
             case LANDING_SCREEN:
                 instance->sound_manager->playResetSound();
                 instance->sound_manager->playBackgroundMusic();
-                instance->inference->reset();
+                instance->generation_queue.reset();
+                VariantGallery::clear();
                 instance->camera->reset();
                 instance->renderer->resetSketches();
                 // Enable multisampling
@@ -162,18 +264,45 @@ void InputHandler::handleKeyboard()
             case LOADING_SCREEN:
             {
                 instance->sound_manager->playClickSound();
+                instance->loading_origin = BASINS_SCREEN;
 
-                // When the prediction is complete, the thread simulates an enter key press.
-                generation_thread = std::thread([this](){InputHandler::instance->generate();});
+                // Rasterize the sketches on the main thread, where they are edited
+                instance->sketch_tensor = instance->renderer->rasterizeSketches(Inference::getWorldSize());
+                startGeneration();
                 
                 glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
                 break;
             }
             
             case RENDERING_SCREEN:
+            {
+                // The meshes are built right below and block the drawing, show their stage on the loading page first
+                if (GenerationQueue::getStage() == GENERATION_STAGE_MESHES)
+                {
+                    instance->renderer->current_menu_page = LOADING_SCREEN;
+                    instance->renderer->renderFrame();
+                    instance->renderer->current_menu_page = RENDERING_SCREEN;
+                }
+                
+                // Stay on the loading page until the terrain is built (and in the variant mode, until a variant is chosen)
+                Terrain *generated_terrain = instance->generation_queue.takeTerrain();
+                if (generated_terrain == nullptr)
+                {
+                    instance->renderer->current_menu_page = LOADING_SCREEN;
+                    // A failed generation goes back to the page it was started from, where it can be started again
+                    if (instance->generation_queue.takeFailure())
+                    {
+                        instance->leaveLoadingScreen();
+                        printf(COLOR_MAGENTA "Generation failed, entering page %d\n" COLOR_RESET, instance->renderer->current_menu_page);
+                        fflush(stdout);
+                    }
+                    break;
+                }
                 // Disable multisampling
                 glDisable(GL_MULTISAMPLE);
-                generation_thread.join();
+                // Replace the terrain of the previous world, released once nothing references it anymore
+                Terrain *previous_terrain = instance->terrain;
+                instance->terrain = generated_terrain;
                 // Pass the terrain to the camera for collision detection and to the renderer
                 instance->camera->setTerrain(instance->terrain);
                 instance->renderer->setTerrain(instance->terrain);
@@ -196,7 +325,11 @@ void InputHandler::handleKeyboard()
                 instance->sound_manager->setWindAltitude(instance->terrain->getBounds()->max_y);
                 instance->sound_manager->playSuccessSound();
                 instance->sound_manager->playBackgroundMusic();
+                
+                // The quadtree, the vegetation and the water have been rebuilt over the new terrain
+                delete previous_terrain;
                 break;
+            }
         }
         keys[13] = false;
     }
@@ -205,131 +338,183 @@ void InputHandler::handleKeyboard()
 
 void InputHandler::handleRegularKeyPress(unsigned char key, int x, int y)
 {
+    // The live inputs are ignored while replaying, except the Esc key to quit
+    if (InputRecorder::isReplaying())
+    {
+        if (key == 27)
+        {
+            Renderer::release();
+            exit(0);
+        }
+        return;
+    }
+    InputRecorder::record(EVENT_KEY_DOWN, key, 0, x, y);
     instance->keys[key] = true;
 }
 
 void InputHandler::handleRegularKeyRelease(unsigned char key, int x, int y)
 {
+    if (InputRecorder::isReplaying())
+        return;
+    InputRecorder::record(EVENT_KEY_UP, key, 0, x, y);
     instance->keys[key] = false;
 }
 
 void InputHandler::handleSpecialKeyPress(int key, int x, int y)
 {
+    if (InputRecorder::isReplaying())
+        return;
+    InputRecorder::record(EVENT_SPECIAL_DOWN, key, 0, x, y);
     instance->special_keys[key] = true;
 }
 
 void InputHandler::handleSpecialKeyRelease(int key, int x, int y)
 {
+    if (InputRecorder::isReplaying())
+        return;
+    InputRecorder::record(EVENT_SPECIAL_UP, key, 0, x, y);
     instance->special_keys[key] = false;
 }
 
 void InputHandler::mouseClick(int button, int state, int x, int y)
-{    
+{
+    if (InputRecorder::isReplaying())
+        return;
+    InputRecorder::record(EVENT_MOUSE, button, state, x, y);
+    instance->processMouseClick(button, state, x, y);
+}
+
+// Mouse motion callback routine.
+void InputHandler::mouseMotion(int x, int y)
+{
+    if (InputRecorder::isReplaying())
+        return;
+    InputRecorder::record(EVENT_MOTION, 0, 0, x, y);
+    instance->processMouseMotion(x, y);
+}
+
+void InputHandler::processMouseClick(int button, int state, int x, int y)
+{
     // If the left mouse button is pressed then set the is_mouse_down flag to true and store the mouse coordinates
     if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN)
     {
-        instance->is_mouse_down = true;
-        instance->mouse_x = x;
-        instance->mouse_y = y;
-        
-        float width = glutGet(GLUT_WINDOW_WIDTH);
-        float height = glutGet(GLUT_WINDOW_HEIGHT);
-        
-        if (x > width * LEFT_SKETCH_BORDER && x < width * RIGHT_SKETCH_BORDER && y > height * TOP_SKETCH_BORDER && y < height * BOTTOM_SKETCH_BORDER)
-        {
-            short current_page = instance->renderer->current_menu_page;
-            if (current_page == RIDGES_SCREEN | current_page == RIVERS_SCREEN)
-            {
-                // If the mouse is outside the sketch area then return
-                // Otherwise sketch the pixel
-                instance->renderer->sketch(x / width, 1 - y / height);
-            
-            }
-            if (current_page == PEAKS_SCREEN | current_page == BASINS_SCREEN)
-            {
-                // Generate random noise between 0 and 0.1
-                for (int i = 0; i < 3; i++)
-                {
-                    float dx = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 0.04 - 0.02;
-                    float dy = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 0.04 - 0.02;
-                    instance->renderer->sketch(x / width + dx, 1 - y / height + dy);
-                }
-            }
-        }
+        this->is_mouse_down = true;
+        this->mouse_x = x;
+        this->mouse_y = y;
+        sketch(x, y);
     }
     // If the left mouse button is released then set the is_mouse_down flag to false
     else if (button == GLUT_LEFT_BUTTON && state == GLUT_UP)
     {
-        instance->is_mouse_down = false;
-        short current_page = instance->renderer->current_menu_page;
+        this->is_mouse_down = false;
+        short current_page = this->renderer->current_menu_page;
         if (current_page == RIDGES_SCREEN | current_page == PEAKS_SCREEN | current_page == RIVERS_SCREEN | current_page == BASINS_SCREEN)
         {
-            instance->renderer->sketch(0xFFFFFFFFu, 0xFFFFFFFFu);
+            this->renderer->sketch(0xFFFFFFFFu, 0xFFFFFFFFu);
+            this->renderer->previewSketches();
         }
     }
 }
 
-// Mouse motion callback routine.
-void InputHandler::mouseMotion(int x, int y)
+void InputHandler::processMouseMotion(int x, int y)
 {
-    short current_page = instance->renderer->current_menu_page;
+    short current_page = this->renderer->current_menu_page;
     // If the rendering screen is shown then update the camera angles based on the mouse movement
     if (current_page == RENDERING_SCREEN)
     {
-        if (instance->is_mouse_down)
+        if (this->is_mouse_down)
         {
             // Update the camera horizontal_angle based on the mouse movement
-            instance->camera->rotateLeftRight((x - instance->mouse_x)*0.1);
-            instance->mouse_x = x;
+            this->camera->rotateLeftRight((x - this->mouse_x)*0.1);
+            this->mouse_x = x;
             
             // Update the camera vertical_angle based on the mouse movement
-            instance->camera->rotateUpDown((y - instance->mouse_y)*0.1);
-            instance->mouse_y = y;
+            this->camera->rotateUpDown((y - this->mouse_y)*0.1);
+            this->mouse_y = y;
         }
     }
 
-    float width = glutGet(GLUT_WINDOW_WIDTH);
-    float height = glutGet(GLUT_WINDOW_HEIGHT);
+    sketch(x, y);
+}
+
+void InputHandler::sketch(int x, int y)
+{
+    float width = GlutFramework::getWidth();
+    float height = GlutFramework::getHeight();
+
+    // If the mouse is outside the sketch area then return
+    if (!(x > width * LEFT_SKETCH_BORDER && x < width * RIGHT_SKETCH_BORDER && y > height * TOP_SKETCH_BORDER && y < height * BOTTOM_SKETCH_BORDER))
+        return;
 
-    if (x > width * LEFT_SKETCH_BORDER && x < width * RIGHT_SKETCH_BORDER && y > height * TOP_SKETCH_BORDER && y < height * BOTTOM_SKETCH_BORDER)
+    // Otherwise sketch the pixel
+    short current_page = this->renderer->current_menu_page;
+    if (current_page == RIDGES_SCREEN | current_page == RIVERS_SCREEN)
     {
-        short current_page = instance->renderer->current_menu_page;
-        if (current_page == RIDGES_SCREEN | current_page == RIVERS_SCREEN)
+        this->renderer->sketch(x / width, 1 - y / height);
+    }
+    if (current_page == PEAKS_SCREEN | current_page == BASINS_SCREEN)
+    {
+        // Scatter a few points around the mouse, with the seeded generator so that a replay draws the same ones
+        std::uniform_real_distribution<float> jitter(-0.02f, 0.02f);
+        for (int i = 0; i < 3; i++)
         {
-            // If the mouse is outside the sketch area then return
-            // Otherwise sketch the pixel
-            instance->renderer->sketch(x / width, 1 - y / height);
+            float dx = jitter(this->generator);
+            float dy = jitter(this->generator);
+            this->renderer->sketch(x / width + dx, 1 - y / height + dy);
         }
-        if (current_page == PEAKS_SCREEN | current_page == BASINS_SCREEN)
+    }
+}
+
+void InputHandler::replayEvents()
+{
+    InputEvent event;
+    while (InputRecorder::poll(event))
+    {
+        switch (event.type)
         {
-            // Generate random noise between 0 and 0.1
-            for (int i = 0; i < 3; i++)
-            {
-                float dx = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 0.04 - 0.02;
-                float dy = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 0.04 - 0.02;
-                instance->renderer->sketch(x / width + dx, 1 - y / height + dy);
-            }
+            case EVENT_KEY_DOWN:
+                keys[event.code] = true;
+                break;
+            case EVENT_KEY_UP:
+                keys[event.code] = false;
+                break;
+            case EVENT_SPECIAL_DOWN:
+                special_keys[event.code] = true;
+                break;
+            case EVENT_SPECIAL_UP:
+                special_keys[event.code] = false;
+                break;
+            case EVENT_MOUSE:
+                processMouseClick(event.code, event.state, event.x, event.y);
+                break;
+            case EVENT_MOTION:
+                processMouseMotion(event.x, event.y);
+                break;
+            case EVENT_GENERATED:
+                keys[13] = true;
+                break;
         }
     }
 }
 
-// Idle function
-void InputHandler::idleCallback()
-{  
-    instance->handleKeyboard();
-    glutPostRedisplay();
+void InputHandler::startGeneration()
+{
+    // The seeds are drawn on the main thread, whose generator also jitters the sketches
+    noise_seeds.clear();
+    for (int i = 0; i < variant_count; i++)
+        noise_seeds.push_back(generator());
+    chosen_variant = -1;
+
+    // Supersedes the generation in progress, if any. When the terrain is built, the next simulation step presses enter
+    generation_queue.generate(sketch_tensor, noise_seeds);
 }
 
-// Generate the terrain
-void InputHandler::generate()
+void InputHandler::leaveLoadingScreen()
 {
-    instance->terrain = new Terrain();
-    
-    std::thread inference_thread([](Inference *inference) { inference->predict(); }, instance->inference);
-    inference_thread.join();
-    
-    std::thread terrain_thread([](Terrain *terrain) { terrain->initialize(WORLD_SCALE, TEXTURE_SCALE); }, instance->terrain);
-    terrain_thread.join();
-    
-    instance->keys[13] = true;
-}
\ No newline at end of file
+    VariantGallery::clear();
+    renderer->current_menu_page = loading_origin;
+
+    // Back to the world of the re-roll, drawn without multisampling like when it was entered
+    if (loading_origin == RENDERING_SCREEN)
+        glDisable(GL_MULTISAMPLE);
+}
@@ -11,14 +11,19 @@
 #include "Colors.h"
 #include "Constants.h"
 #include "Inference.h"
+#include "GenerationQueue.h"
 #include "SoundManager.h"
+#include "InputRecorder.h"
+#include "ResourceRegistry.h"
 #include <GL/freeglut.h>
-#include <thread>
+#include <random>
 
 /**
  * @brief Input handler class which handles the user input.
  *
- * This class handles the user input and manages the callbacks for the keyboard, mouse, idle and sound events together with callbacks from other objects.
+ * This class handles the user input and manages the callbacks for the keyboard, mouse and sound events together with callbacks from other objects.
+ * The keyboard state is polled by the frame scheduler at every simulation step (see handleKeyboard).
+ * The events go through the InputRecorder, which records them or, while replaying, substitutes the recorded ones for them.
  */
 class InputHandler
 {
@@ -48,13 +53,22 @@ class InputHandler
          */
         void initialize(Camera *camera, Renderer *renderer, SoundManager *sound_manager, QuadTree *quadtree);
 
+        /**
+         * @brief Handles the keyboard input.
+         * 
+         * Checks if the user pressed a key and calls the appropriate function. Called once per fixed simulation step, so that
+         * the camera speed doesn't depend on the frame rate.
+         * 
+         */
+        void handleKeyboard();
+
     private:
         static InputHandler *instance;           ///< Used to access the InputHandler object from the static callback functions
         Camera *camera;                          ///< a reference to the camera object
         Renderer *renderer;                      ///< a reference to the renderer object
         Inference *inference;                    ///< a reference to the inference object
         SoundManager *sound_manager;             ///< a reference to the sound engine object
-        Terrain *terrain;
+        Terrain *terrain;                        ///< terrain of the current world
         QuadTree *quadtree;
 
         bool keys[256];                     ///< an array to keep track of regular key presses
@@ -65,16 +79,15 @@ class InputHandler
         bool is_polygon_filled = true;      ///< keeps track of whether or not the polygon is filled
         bool is_fullscreen = true;          ///< keeps track of whether or not the window is in is_fullscreen mode
 
-        std::thread generation_thread;      ///< handles the input event associated to generation of the terrain in a separate thread
+        GenerationQueue generation_queue;   ///< runs the generations of the terrain on its worker thread
+        std::vector<float> sketch_tensor;   ///< sketches rasterized into the model input when the loading page is entered
+        std::mt19937 generator;             ///< random generator of the session (sketch jitter and model noise), seeded by the recorder
+        std::vector<uint32_t> noise_seeds;  ///< seed of the model noise of each variant of the current generation
+        int variant_count = 1;              ///< variants generated at once, chosen on the loading page when more than one
+        int chosen_variant = -1;            ///< variant chosen before the variants were ready (replayed sessions), -1 if none
+        short loading_origin = BASINS_SCREEN;   ///< page the loading page was entered from, where a cancel or a failure goes back
         
         
-        /**
-         * @brief Handles the keyboard input.
-         * 
-         * Checks if the user pressed a key and calls the appropriate function.
-         * 
-         */
-        void handleKeyboard();
 
         /**
          * @brief Handles the regular key press by setting the corresponding key in the keys array to true.
@@ -131,16 +144,50 @@ class InputHandler
         static void mouseMotion(int x, int y);
 
         /**
-         * @brief Idle callback function which is called when the program is idle and checks if the user pressed a key.
+         * @brief Applies a mouse click, live or replayed.
+         * 
+         * @param button Button pressed
+         * @param state State of the button (pressed, released, etc.)
+         * @param x x position of the mouse
+         * @param y y position of the mouse
+         */
+        void processMouseClick(int button, int state, int x, int y);
+
+        /**
+         * @brief Applies a mouse motion, live or replayed.
+         * 
+         * @param x x position of the mouse
+         * @param y y position of the mouse
+         */
+        void processMouseMotion(int x, int y);
+
+        /**
+         * @brief Sketches a point on the canvas of the current page, jittered on the peaks and basins pages.
+         * 
+         * @param x x position of the mouse
+         * @param y y position of the mouse
+         */
+        void sketch(int x, int y);
+
+        /**
+         * @brief Applies the recorded events due before the current simulation step.
+         * 
+         */
+        void replayEvents();
+
+        /**
+         * @brief Draws the seeds of the variants and queues the generation of the rasterized sketches.
          * 
+         * In the variant mode the variants are handed to the gallery of the loading page, and the terrain is built once one is chosen.
          */
-        static void idleCallback();
+        void startGeneration();
 
         /**
-         * @brief Implements the generation of the terrain in a separate thread as a consequence of the user key press.
+         * @brief Go back from the loading page to the page it was entered from, after a cancel or a failure.
          * 
+         * The last sketch page keeps the sketches to generate them again, the world page keeps the world a re-roll started from.
          */
-        static void generate();
+        void leaveLoadingScreen();
 };
 
 #endif // INPUTHANDLER_H
\ No newline at end of file
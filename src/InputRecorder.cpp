@@ -0,0 +1,192 @@
+/**
+@file
+@brief InputRecorder source file.
+*/
+
+#include "InputRecorder.h"
+
+
+InputRecorder *InputRecorder::instance = nullptr;
+
+// Default constructor
+InputRecorder::InputRecorder()
+{
+    if (InputRecorder::instance == nullptr)
+        InputRecorder::instance = this;
+
+    this->mode = RECORDER_OFF;
+    this->seed = std::random_device()();
+    this->step = 0;
+    this->next_event = 0;
+    this->recorded_width = 0;
+    this->recorded_height = 0;
+    this->is_generated = false;
+}
+
+// Destructor
+InputRecorder::~InputRecorder()
+{
+    if (this->file.is_open())
+    {
+        this->file.close();
+        printf(COLOR_GREEN "Session recorded (%u steps)\n" COLOR_RESET, this->step);
+    }
+
+    InputRecorder::instance = nullptr;
+}
+
+bool InputRecorder::startRecording(const std::string &path)
+{
+    this->file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!this->file.is_open())
+    {
+        std::cerr << COLOR_RED << "Failed to create the recording " << path << COLOR_RESET << std::endl;
+        return false;
+    }
+
+    // Header: magic, version and seed
+    uint32_t version = RECORDER_VERSION;
+    this->file.write(RECORDER_MAGIC, 4);
+    this->file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    this->file.write(reinterpret_cast<const char *>(&this->seed), sizeof(this->seed));
+
+    this->mode = RECORDER_RECORDING;
+    this->start_time = std::chrono::steady_clock::now();
+
+    // Initial window size, the following ones are recorded by the reshape callback
+    record(EVENT_RESIZE, 0, 0, GlutFramework::getWidth(), GlutFramework::getHeight());
+    printf(COLOR_GREEN "Recording the session to %s (seed %u)\n" COLOR_RESET, path.c_str(), this->seed);
+    return true;
+}
+
+bool InputRecorder::startReplay(const std::string &path)
+{
+    std::ifstream input(path, std::ios::in | std::ios::binary);
+    char magic[4];
+    uint32_t version = 0;
+    input.read(magic, 4);
+    input.read(reinterpret_cast<char *>(&version), sizeof(version));
+    input.read(reinterpret_cast<char *>(&this->seed), sizeof(this->seed));
+
+    if (!input || memcmp(magic, RECORDER_MAGIC, 4) != 0 || version != RECORDER_VERSION)
+    {
+        std::cerr << COLOR_RED << "Failed to load the recording " << path << COLOR_RESET << std::endl;
+        return false;
+    }
+
+    InputEvent event;
+    this->events.clear();
+    while (input.read(reinterpret_cast<char *>(&event), sizeof(InputEvent)))
+        this->events.push_back(event);
+
+    this->mode = RECORDER_REPLAYING;
+    this->next_event = 0;
+    this->recorded_width = GlutFramework::getWidth();
+    this->recorded_height = GlutFramework::getHeight();
+    printf(COLOR_GREEN "Replaying %s: %zu events (seed %u)\n" COLOR_RESET, path.c_str(), this->events.size(), this->seed);
+    return true;
+}
+
+bool InputRecorder::isRecording()
+{
+    return instance != nullptr && instance->mode == RECORDER_RECORDING;
+}
+
+bool InputRecorder::isReplaying()
+{
+    return instance != nullptr && instance->mode == RECORDER_REPLAYING;
+}
+
+uint32_t InputRecorder::getSeed()
+{
+    return instance->seed;
+}
+
+void InputRecorder::record(int type, int code, int state, int x, int y)
+{
+    if (!isRecording())
+        return;
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    InputEvent event;
+    event.step = instance->step;
+    event.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - instance->start_time).count();
+    event.type = type;
+    event.code = code;
+    event.state = state;
+    event.padding = 0;
+    event.x = x;
+    event.y = y;
+    instance->file.write(reinterpret_cast<const char *>(&event), sizeof(InputEvent));
+}
+
+bool InputRecorder::poll(InputEvent &event)
+{
+    if (!isReplaying())
+        return false;
+
+    // Keep track of the recorded window size
+    while (instance->next_event < instance->events.size() && instance->events[instance->next_event].type == EVENT_RESIZE && instance->events[instance->next_event].step <= instance->step)
+    {
+        instance->recorded_width = std::max((int)instance->events[instance->next_event].x, 1);
+        instance->recorded_height = std::max((int)instance->events[instance->next_event].y, 1);
+        instance->next_event++;
+    }
+
+    if (instance->next_event == instance->events.size())
+    {
+        // Give the inputs back to the user
+        instance->mode = RECORDER_OFF;
+        printf(COLOR_GREEN "Replay complete (%u steps)\n" COLOR_RESET, instance->step);
+        return false;
+    }
+
+    event = instance->events[instance->next_event];
+    if (event.step > instance->step)
+        return false;
+
+    if (event.type == EVENT_GENERATED)
+    {
+        std::lock_guard<std::mutex> lock(instance->mutex);
+        instance->is_generated = false;
+    }
+
+    // Rescale the mouse position to the current window
+    event.x = (int16_t)((float)event.x * GlutFramework::getWidth() / instance->recorded_width);
+    event.y = (int16_t)((float)event.y * GlutFramework::getHeight() / instance->recorded_height);
+    instance->next_event++;
+    return true;
+}
+
+bool InputRecorder::isStepReady()
+{
+    if (!isReplaying() || instance->next_event == instance->events.size())
+        return true;
+
+    const InputEvent &event = instance->events[instance->next_event];
+    if (event.step > instance->step || event.type != EVENT_GENERATED)
+        return true;
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    return instance->is_generated;
+}
+
+void InputRecorder::setGenerated()
+{
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    instance->is_generated = true;
+}
+
+bool InputRecorder::consumeGenerated()
+{
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    bool is_generated = instance->is_generated;
+    instance->is_generated = false;
+    return is_generated;
+}
+
+void InputRecorder::endStep()
+{
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    instance->step++;
+}
@@ -0,0 +1,182 @@
+/**
+@file
+@brief InputRecorder header file.
+*/
+
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "GlutFramework.h"
+#include "Colors.h"
+
+// Recorder modes
+#define RECORDER_OFF 0
+#define RECORDER_RECORDING 1
+#define RECORDER_REPLAYING 2
+
+// Recorded event types
+#define EVENT_KEY_DOWN 0        ///< Regular key press (code: key)
+#define EVENT_KEY_UP 1          ///< Regular key release (code: key)
+#define EVENT_SPECIAL_DOWN 2    ///< Special key press (code: glut key)
+#define EVENT_SPECIAL_UP 3      ///< Special key release (code: glut key)
+#define EVENT_MOUSE 4           ///< Mouse button (code: button, state: glut state)
+#define EVENT_MOTION 5          ///< Mouse motion with a button down
+#define EVENT_GENERATED 6       ///< Terrain generation completed, the enter key is pressed for the user
+#define EVENT_RESIZE 7          ///< Window resized (x, y: size), used to rescale the mouse positions
+
+// Header of the recordings
+#define RECORDER_MAGIC "ECIR"
+#define RECORDER_VERSION 1
+
+/**
+ * @brief Input event of a recording, 16 bytes on disk.
+ */
+typedef struct
+{
+    uint32_t step;      ///< Simulation step before which the event is handled
+    uint32_t time_ms;   ///< Time since the start of the recording in milliseconds
+    uint8_t type;       ///< Event type
+    uint8_t code;       ///< Key or button
+    uint8_t state;      ///< Button state
+    uint8_t padding;    ///< Unused
+    int16_t x;          ///< x position of the mouse in window pixels
+    int16_t y;          ///< y position of the mouse in window pixels
+} InputEvent;
+
+/**
+ * @brief InputRecorder class which records the input events of a session and replays them deterministically.
+ *
+ * Events are stamped with the fixed simulation step they precede, rather than with the wall time, so that a replay handles
+ * each of them between the same two steps whatever the frame rate. Every random generator of a session (sketch jitter and model
+ * noise) derives from a single seed stored in the header. The window size is recorded too, so that the mouse positions can be
+ * rescaled to the window of the replay. While replaying, the live inputs are ignored and the simulation waits for the terrain
+ * generations where they completed.
+ */
+class InputRecorder
+{
+public:
+    /**
+     * @brief Construct the InputRecorder singleton, with a random seed and no recording.
+     */
+    InputRecorder();
+
+    /**
+     * @brief Destroy the InputRecorder singleton, flushing the recording.
+     */
+    ~InputRecorder();
+
+    /**
+     * @brief Start recording the session into a file.
+     *
+     * @param path Path of the recording
+     * @return true If the file was created
+     * @return false Otherwise
+     */
+    bool startRecording(const std::string &path);
+
+    /**
+     * @brief Load a recording and replay it from the first step.
+     *
+     * @param path Path of the recording
+     * @return true If the recording was loaded
+     * @return false Otherwise
+     */
+    bool startReplay(const std::string &path);
+
+    /**
+     * @brief Check if the session is being recorded.
+     *
+     * @return true If recording
+     * @return false Otherwise
+     */
+    static bool isRecording();
+
+    /**
+     * @brief Check if a recording is being replayed, in which case the live inputs are ignored.
+     *
+     * @return true If replaying
+     * @return false Otherwise
+     */
+    static bool isReplaying();
+
+    /**
+     * @brief Get the seed of the session, from which every random generator derives.
+     *
+     * @return uint32_t
+     */
+    static uint32_t getSeed();
+
+    /**
+     * @brief Record an event before the next simulation step.
+     *
+     * @param type Event type
+     * @param code Key or button
+     * @param state Button state
+     * @param x x position of the mouse
+     * @param y y position of the mouse
+     */
+    static void record(int type, int code, int state, int x, int y);
+
+    /**
+     * @brief Get the next replayed event due before the current simulation step.
+     *
+     * @param event Replayed event, with the mouse position rescaled to the window
+     * @return true If an event is due
+     * @return false If the events of the step are over
+     */
+    static bool poll(InputEvent &event);
+
+    /**
+     * @brief Check if the current simulation step can run: a replay waits for a generation where the recording saw it complete.
+     *
+     * @return true If the step can run
+     * @return false If the generation is still running
+     */
+    static bool isStepReady();
+
+    /**
+     * @brief Notify the completion of a terrain generation (called by the generation thread).
+     */
+    static void setGenerated();
+
+    /**
+     * @brief Check if a generation completed since the last call, outside of a replay where the recorded completions are polled.
+     *
+     * @return true If a generation completed
+     * @return false Otherwise
+     */
+    static bool consumeGenerated();
+
+    /**
+     * @brief Advance to the next simulation step.
+     */
+    static void endStep();
+
+private:
+    static InputRecorder *instance;                         ///< Used to access the InputRecorder object from the static functions
+
+    int mode;                                               ///< RECORDER_OFF, RECORDER_RECORDING or RECORDER_REPLAYING
+    uint32_t seed;                                          ///< Seed of the session
+    uint32_t step;                                          ///< Index of the next simulation step
+    std::mutex mutex;                                       ///< Protects the recording and the generation flag, set by the generation thread
+    std::ofstream file;                                     ///< Recording being written
+    std::chrono::steady_clock::time_point start_time;       ///< Start of the recording
+
+    std::vector<InputEvent> events;                         ///< Events being replayed
+    size_t next_event;                                      ///< Index of the next replayed event
+    int recorded_width;                                     ///< Width of the window when the replayed events were recorded
+    int recorded_height;                                    ///< Height of the window when the replayed events were recorded
+    bool is_generated;                                      ///< Whether a generation completed and wasn't replayed yet
+};
+
+#endif // INPUTRECORDER_H
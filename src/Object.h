@@ -20,6 +20,7 @@ typedef struct Object {
     GLuint ibo;             ///< Index buffer object
     GLuint cbo;             ///< Color buffer object
     GLuint nbo;             ///< Normal buffer object
+    GLuint instance_bo;     ///< Instance buffer object
     GLuint texture[2];      ///< Texture ids
     
     // Buffers
@@ -28,6 +29,7 @@ typedef struct Object {
     std::vector<GLfloat> normals;   ///< Normal buffer
     std::vector<GLfloat> textures;  ///< Texture buffer
     std::vector<GLuint> indices;    ///< Index buffer
+    std::vector<GLfloat> instances; ///< Per-instance attributes buffer
 } Object;
 
 #endif // OBJECT_H
\ No newline at end of file
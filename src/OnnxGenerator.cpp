@@ -0,0 +1,144 @@
+/**
+@file
+@brief OnnxGenerator source file.
+*/
+
+#include "OnnxGenerator.h"
+
+#ifdef USE_ONNXRUNTIME
+
+
+int OnnxGenerator::intra_op_threads = ONNX_INTRA_OP_THREADS;
+int OnnxGenerator::inter_op_threads = ONNX_INTER_OP_THREADS;
+int OnnxGenerator::optimization_level = ONNX_OPTIMIZATION_LEVEL;
+
+OnnxGenerator::OnnxGenerator()
+{
+    this->noise.resize((size_t)UNET_NOISE_SIZE * UNET_NOISE_SIZE * UNET_NOISE_CHANNELS);
+}
+
+bool OnnxGenerator::load(const std::string &path)
+{
+    if (access(path.c_str(), R_OK) != 0)
+        return false;
+
+    const GraphOptimizationLevel levels[] = {ORT_DISABLE_ALL, ORT_ENABLE_BASIC, ORT_ENABLE_EXTENDED, ORT_ENABLE_ALL};
+
+    try
+    {
+        this->environment = std::make_unique<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "EarthCraft");
+
+        Ort::SessionOptions options;
+        options.SetIntraOpNumThreads(intra_op_threads);
+        options.SetInterOpNumThreads(inter_op_threads);
+        options.SetExecutionMode(inter_op_threads > 1 ? ORT_PARALLEL : ORT_SEQUENTIAL);
+        options.SetGraphOptimizationLevel(levels[std::min(std::max(optimization_level, 0), 3)]);
+        this->session = std::make_unique<Ort::Session>(*this->environment, path.c_str(), options);
+
+        // The inputs are exported in the order of the generator: the sketches, then the noise
+        Ort::AllocatorWithDefaultOptions allocator;
+        if (this->session->GetInputCount() != 2 || this->session->GetOutputCount() != 1)
+            throw Ort::Exception("unexpected inputs or outputs", ORT_INVALID_GRAPH);
+        this->input_name = this->session->GetInputNameAllocated(0, allocator).get();
+        this->noise_name = this->session->GetInputNameAllocated(1, allocator).get();
+        this->output_name = this->session->GetOutputNameAllocated(0, allocator).get();
+
+        this->binding = std::make_unique<Ort::IoBinding>(*this->session);
+    }
+    catch (const Ort::Exception &exception)
+    {
+        std::cerr << COLOR_RED << "Error: Could not load " << path << " (" << exception.what() << ")" << COLOR_RESET << std::endl;
+        this->binding.reset();
+        this->session.reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool OnnxGenerator::isLoaded()
+{
+    return this->session != nullptr;
+}
+
+cv::Mat OnnxGenerator::predict(const std::vector<float> &input, uint32_t seed)
+{
+    std::vector<cv::Mat> heightmaps = predict(input, std::vector<uint32_t>(1, seed));
+    return heightmaps.empty() ? cv::Mat() : heightmaps[0];
+}
+
+std::vector<cv::Mat> OnnxGenerator::predict(const std::vector<float> &input, const std::vector<uint32_t> &seeds)
+{
+    if (seeds.size() <= 1)
+        return predictBatch(input, seeds);
+
+    // Every variant reads the same sketches with its own noise
+    this->inputs.resize(input.size() * seeds.size());
+    for (size_t i = 0; i < seeds.size(); i++)
+        std::copy(input.begin(), input.end(), this->inputs.begin() + i * input.size());
+    return predictBatch(this->inputs, seeds);
+}
+
+std::vector<cv::Mat> OnnxGenerator::predictBatch(const std::vector<float> &inputs, const std::vector<uint32_t> &seeds)
+{
+    const int size = UNET_MAP_SIZE;
+    const int64_t batch = seeds.size();
+    const size_t input_size = (size_t)size * size * UNET_INPUT_CHANNELS;
+    const size_t noise_size = (size_t)UNET_NOISE_SIZE * UNET_NOISE_SIZE * UNET_NOISE_CHANNELS;
+    if (!isLoaded() || batch == 0 || inputs.size() != input_size * batch)
+        return std::vector<cv::Mat>();
+
+    this->noise.resize(noise_size * batch);
+    for (int64_t i = 0; i < batch; i++)
+    {
+        UNetView noise_view = {this->noise.data() + i * noise_size, UNET_NOISE_SIZE, UNET_NOISE_SIZE, UNET_NOISE_CHANNELS, UNET_NOISE_CHANNELS};
+        UNet::fillNoise(seeds[i], noise_view);
+    }
+
+    // Bind the C++ buffers, ONNX Runtime reads the sketches and the noises and writes the tanh outputs in place, one below the other
+    cv::Mat output(size * batch, size, CV_32FC1);
+    const int64_t input_shape[] = {batch, size, size, UNET_INPUT_CHANNELS};
+    const int64_t noise_shape[] = {batch, UNET_NOISE_SIZE, UNET_NOISE_SIZE, UNET_NOISE_CHANNELS};
+    const int64_t output_shape[] = {batch, size, size};
+
+    try
+    {
+        Ort::MemoryInfo memory = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        Ort::Value input_tensor = Ort::Value::CreateTensor<float>(memory, const_cast<float *>(inputs.data()), inputs.size(), input_shape, 4);
+        Ort::Value noise_tensor = Ort::Value::CreateTensor<float>(memory, this->noise.data(), this->noise.size(), noise_shape, 4);
+        Ort::Value output_tensor = Ort::Value::CreateTensor<float>(memory, (float *)output.data, output.total(), output_shape, 3);
+
+        this->binding->BindInput(this->input_name.c_str(), input_tensor);
+        this->binding->BindInput(this->noise_name.c_str(), noise_tensor);
+        this->binding->BindOutput(this->output_name.c_str(), output_tensor);
+        this->session->Run(Ort::RunOptions{nullptr}, *this->binding);
+        this->binding->ClearBoundInputs();
+        this->binding->ClearBoundOutputs();
+    }
+    catch (const Ort::Exception &exception)
+    {
+        std::cerr << COLOR_RED << "Error: ONNX Runtime inference failed (" << exception.what() << ")" << COLOR_RESET << std::endl;
+        this->binding->ClearBoundInputs();
+        this->binding->ClearBoundOutputs();
+        return std::vector<cv::Mat>();
+    }
+
+    // Heights in [0, 255], the borders are left to the caller (see Inference::clearBorder)
+    output.convertTo(output, CV_32F, 127.5, 127.5);
+
+    // The heightmaps share the output buffer, each one is continuous
+    std::vector<cv::Mat> heightmaps;
+    for (int64_t i = 0; i < batch; i++)
+        heightmaps.push_back(output.rowRange(i * size, (i + 1) * size));
+
+    return heightmaps;
+}
+
+void OnnxGenerator::configure(int intra_op_threads, int inter_op_threads, int optimization_level)
+{
+    OnnxGenerator::intra_op_threads = intra_op_threads;
+    OnnxGenerator::inter_op_threads = inter_op_threads;
+    OnnxGenerator::optimization_level = optimization_level;
+}
+
+#endif // USE_ONNXRUNTIME
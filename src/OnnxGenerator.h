@@ -0,0 +1,114 @@
+/**
+@file
+@brief OnnxGenerator header file.
+*/
+
+#ifndef ONNXGENERATOR_H
+#define ONNXGENERATOR_H
+
+// Threads running each operator (0 lets ONNX Runtime use one per physical core) and the independent operators
+#define ONNX_INTRA_OP_THREADS 0
+#define ONNX_INTER_OP_THREADS 1
+// Graph optimization level: 0 none, 1 basic, 2 extended, 3 all (layouts included)
+#define ONNX_OPTIMIZATION_LEVEL 3
+
+#ifdef USE_ONNXRUNTIME
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+#include "UNet.h"
+#include "Colors.h"
+
+/**
+ * @brief OnnxGenerator class which runs the terrain generator exported to ONNX (see Predict.py) through ONNX Runtime on the CPU.
+ *
+ * The session is created once, with the configured thread pools and optimization level, and reused by every prediction. The
+ * input sketches, the noise and the heightmap are bound to the session as tensors over the C++ buffers, so ONNX Runtime reads
+ * and writes them in place. Several variants, or the tiles of a large world, are generated in one run by stacking their inputs
+ * and their noises along the batch dimension. The noise is the one of the other backends, so a seed generates the same terrain
+ * whatever the backend.
+ * Only compiled with USE_ONNXRUNTIME (make ONNXRUNTIME=<path of the ONNX Runtime release>).
+ */
+class OnnxGenerator
+{
+public:
+    /**
+     * @brief Construct an empty OnnxGenerator object.
+     */
+    OnnxGenerator();
+
+    /**
+     * @brief Create the session of the exported generator.
+     *
+     * @param path Path of the ONNX model
+     * @return true If the session was created
+     * @return false If the model is missing or invalid
+     */
+    bool load(const std::string &path);
+
+    /**
+     * @brief Check if the session exists.
+     *
+     * @return true If loaded
+     * @return false Otherwise
+     */
+    bool isLoaded();
+
+    /**
+     * @brief Generate a heightmap from the input sketches.
+     *
+     * @param input UNET_MAP_SIZE x UNET_MAP_SIZE x UNET_INPUT_CHANNELS input tensor, channels last
+     * @param seed Seed of the noise
+     * @return cv::Mat UNET_MAP_SIZE square float heightmap with heights in [0, 255], empty on failure
+     */
+    cv::Mat predict(const std::vector<float> &input, uint32_t seed);
+
+    /**
+     * @brief Generate several variants of the same sketches in a single run, the noises stacked along the batch dimension.
+     *
+     * @param input UNET_MAP_SIZE x UNET_MAP_SIZE x UNET_INPUT_CHANNELS input tensor, channels last
+     * @param seeds Seed of the noise of each variant
+     * @return std::vector<cv::Mat> Heightmap of each variant, as predict would generate it with its seed, empty on failure
+     */
+    std::vector<cv::Mat> predict(const std::vector<float> &input, const std::vector<uint32_t> &seeds);
+
+    /**
+     * @brief Generate a heightmap from each of several input sketches in a single run, e.g. the tiles of a large world.
+     *
+     * @param inputs Input tensors of the batch, one after the other
+     * @param seeds Seed of the noise of each input
+     * @return std::vector<cv::Mat> Heightmap of each input, empty on failure
+     */
+    std::vector<cv::Mat> predictBatch(const std::vector<float> &inputs, const std::vector<uint32_t> &seeds);
+
+    /**
+     * @brief Configure the sessions created afterwards.
+     *
+     * @param intra_op_threads Threads running each operator, 0 for the ONNX Runtime default
+     * @param inter_op_threads Threads running independent operators, 1 runs the graph sequentially
+     * @param optimization_level Graph optimization level, from 0 (none) to 3 (all)
+     */
+    static void configure(int intra_op_threads, int inter_op_threads, int optimization_level);
+
+private:
+    static int intra_op_threads;                    ///< Threads running each operator
+    static int inter_op_threads;                    ///< Threads running independent operators
+    static int optimization_level;                  ///< Graph optimization level
+
+    std::unique_ptr<Ort::Env> environment;          ///< ONNX Runtime environment, owning the thread pools
+    std::unique_ptr<Ort::Session> session;          ///< Session of the generator, nullptr if not loaded
+    std::unique_ptr<Ort::IoBinding> binding;        ///< Tensors bound to the session
+    std::string input_name;                         ///< Name of the sketches input
+    std::string noise_name;                         ///< Name of the noise input
+    std::string output_name;                        ///< Name of the output
+    std::vector<float> inputs;                      ///< Input tensor repeated for each variant of the last prediction
+    std::vector<float> noise;                       ///< Noises of the last prediction
+};
+
+#endif // USE_ONNXRUNTIME
+
+#endif // ONNXGENERATOR_H
@@ -8,7 +8,6 @@ import tensorflow.keras.backend as K
 from tensorflow.keras.layers import (Concatenate, Conv2D, Input, Layer, MaxPooling2D, ReLU, UpSampling2D, ZeroPadding2D)
 from tensorflow.keras.models import Model
 import numpy as np
-from PIL import Image
 from typing import Dict, Tuple
 
 ## Class to build the CNN GAN model.
@@ -26,6 +25,31 @@ class TerrainGANBuilder:
         
         generator.load_weights(gen_path)  # Load pre-trained weights
         return generator
+
+    ## Build the generator split in two at the noise: the encoder (the down blocks) and the decoder (the up blocks).
+    #  The noise is only concatenated at the bottleneck, so the encoder outputs only depend on the sketches and can be reused to
+    #  generate other variants of the same sketches.
+    #  @return The generator, the encoder (sketches to skip connections and bottleneck) and the decoder (those and the noise to terrain)
+    def load_split_model(self, gen_path):
+        gen_image_shape = (*self._map_shape, 4)
+        gen_inputs, downsampling_outs = self._get_scale_down(gen_image_shape)
+        generator = Model([gen_inputs['image_input'], gen_inputs['noise']], self._get_scale_up(downsampling_outs, 1))
+        generator.load_weights(gen_path)
+
+        # The encoder shares its layers, and so its weights, with the generator
+        features = ['conv1', 'conv2', 'conv3', 'conv4', 'bottleneck']
+        encoder = Model(gen_inputs['image_input'], [downsampling_outs[name] for name in features])
+
+        # The up blocks are built again over inputs of the same shapes, then given the weights of the generator ones
+        decoder_inputs = {name: Input(K.int_shape(downsampling_outs[name])[1:]) for name in features}
+        noise = Input(K.int_shape(gen_inputs['noise'])[1:])
+        decoder_outs = dict(decoder_inputs, conv5=Concatenate()([decoder_inputs['bottleneck'], noise]))
+        decoder = Model([decoder_inputs[name] for name in features] + [noise], self._get_scale_up(decoder_outs, 1))
+        decoder_convs = conv_layers(decoder)
+        for target, source in zip(decoder_convs, conv_layers(generator)[-len(decoder_convs):]):
+            target.set_weights(source.get_weights())
+
+        return generator, encoder, decoder
     
     def _add_conv_layer(self, layer: Layer, x) -> Layer:
         out = layer(x)  # Apply the convolutional layer
@@ -56,6 +80,7 @@ class TerrainGANBuilder:
         conv4, pool4 = self._get_scale_down_block(pool3, 512)
         conv5 = self._add_conv_layer(Conv2D(1024, 3, padding='same'), pool4)                    # Apply convolution
         conv5 = self._add_conv_layer(Conv2D(1024, 3, padding='same'), conv5)                    # Apply another convolution
+        bottleneck = conv5                                                                      # Last output depending only on the sketches
         noise = Input((K.int_shape(conv5)[1], K.int_shape(conv5)[2], K.int_shape(conv5)[3]))    # Create noise input
         conv5 = Concatenate()([conv5, noise])                                                   # Concatenate with noise input
 
@@ -64,7 +89,8 @@ class TerrainGANBuilder:
             'conv2': conv2,
             'conv3': conv3,
             'conv4': conv4,
-            'conv5': conv5
+            'conv5': conv5,
+            'bottleneck': bottleneck
         }
         
         ins = {
@@ -104,48 +130,126 @@ class TerrainGANBuilder:
         reshaped_output = tf.keras.layers.Reshape((450, 450))(conv10)           # Reshape the output
         return reshaped_output
 
-## Function to predict the heightmap from the input sketches.
-#  The function loads the trained model and generates the heightmap. It is called from the c++ code.
-def predict():
-    
-    print("Predicting...")
-     
-    # Load model
+## Function to list the convolutions of a model in the order they were created (the automatic names conv2d, conv2d_1, ... follow it).
+def conv_layers(model):
+    layers = [layer for layer in model.layers if isinstance(layer, Conv2D)]
+    return sorted(layers, key=lambda layer: int(layer.name.rsplit('_', 1)[1]) if '_' in layer.name else 0)
+
+## Generator kept resident between the predictions, built once by load.
+generator = None
+## Compiled forward passes of the encoder and of the decoder.
+encode = None
+decode = None
+## Last sketches and their encoder outputs, reused while the sketches don't change (re-roll).
+cached_sketch = None
+cached_features = None
+
+## Function to build the generator and compile its forward passes, called once from the c++ code in background.
+#  The generator is split into its encoder and its decoder, so that a re-roll of the same sketches only runs the decoder.
+#  The forward passes are traced for the fixed input shapes (any batch size, for the variants and the tiles) and JIT compiled with XLA
+#  when supported (plain graph otherwise), then run once so that the first generation doesn't pay for the tracing, the
+#  compilation and the allocations.
+def load(model_path):
+    global generator, encode, decode
+
     builder = TerrainGANBuilder()
-    generator = builder.load_model("./neural_network/model.h5")
-    
-    # File names
-    file_names = ["ridges.png", "rivers.png", "peaks.png", "basins.png"]
-    
-    # Load input images
-    channels = [np.array(Image.open("./assets/sketches/" + file_names[i]).convert("L")) for i in range(4)]
-    channels = np.stack(channels, axis=-1)
-    input_image = np.expand_dims(channels, axis=0)
-    input_image = input_image / 255.0
-    
-    # Load noise
-    noise = np.random.normal(0, 1, (1, 28, 28, 1024))
-    
-    # Predict
-    output = generator([input_image, noise])
-    
-    # Save
-    output = np.squeeze(np.uint8(output * 127.5 + 127.5), axis=0)
-    
-    # make the borders (5 px wide) black
-    output[0:5, :] = 0
-    output[:, 0:5] = 0
-    output[445:450, :] = 0
-    output[:, 445:450] = 0
-    
-    image = Image.fromarray(output, mode='L')
-    
-    # Save image
-    with open("./assets/sketches/heightmap.png", "wb") as file:
-        image.save(file, "PNG")
-        file.flush()
-        os.fsync(file.fileno())
-    
+    generator, encoder, decoder = builder.load_split_model(model_path)
+
+    image_signature = [tf.TensorSpec((None, 450, 450, 4), tf.float32)]
+    feature_signature = [tf.TensorSpec((None, *tensor.shape[1:]), tf.float32) for tensor in decoder.inputs]
+    image = tf.zeros((1, 450, 450, 4), tf.float32)
+    try:
+        encode = tf.function(lambda image: encoder(image, training=False), input_signature=image_signature, jit_compile=True)
+        decode = tf.function(lambda conv1, conv2, conv3, conv4, bottleneck, noise: decoder([conv1, conv2, conv3, conv4, bottleneck, noise], training=False), input_signature=feature_signature, jit_compile=True)
+        decode(*encode(image), tf.zeros((1, 28, 28, 1024), tf.float32))
+    except Exception:
+        encode = tf.function(lambda image: encoder(image, training=False), input_signature=image_signature)
+        decode = tf.function(lambda conv1, conv2, conv3, conv4, bottleneck, noise: decoder([conv1, conv2, conv3, conv4, bottleneck, noise], training=False), input_signature=feature_signature)
+        decode(*encode(image), tf.zeros((1, 28, 28, 1024), tf.float32))
+
+## Function to drop the cached encoder outputs, called from the c++ code when the sketches are reset.
+def clear_cache():
+    global cached_sketch, cached_features
+    cached_sketch = None
+    cached_features = None
+
+## Function to predict the heightmap from the input sketches with the resident generator. It is called from the c++ code.
+#  The tensors are exchanged through the buffer protocol, without any copy on the c++ side.
+#  @param sketch_tensor Input sketches (ridges, rivers, peaks, basins) rasterized by the c++ code as 450x450x4 float32, already in [0, 1]
+#  @param noise_seed Seed of the noise, so that a replayed session generates the same terrain
+#  @param heightmap Writable 450x450 float32 buffer of the c++ code, receiving the heights in [0, 255]
+def predict(sketch_tensor, noise_seed, heightmap):
+    predict_batch(sketch_tensor, [noise_seed], heightmap)
+
+## Function to predict several variants of the same sketches in a single forward pass, one per seed. It is called from the c++ code.
+#  The noises are stacked along the batch dimension and the encoder outputs are repeated to match, so a variant is the heightmap
+#  predict would generate with its seed.
+#  @param sketch_tensor Input sketches, as for predict
+#  @param noise_seeds Seed of the noise of each variant
+#  @param heightmaps Writable len(noise_seeds)x450x450 float32 buffer of the c++ code, receiving the heights in [0, 255]
+def predict_batch(sketch_tensor, noise_seeds, heightmaps):
+
+    print("Predicting %d variant%s..." % (len(noise_seeds), "s" if len(noise_seeds) > 1 else ""))
+
+    input_image = np.frombuffer(sketch_tensor, dtype=np.float32).reshape(1, 450, 450, 4)
+    noise = _noise(noise_seeds)
+
+    # Only run the encoder if the sketches changed since the last prediction
+    global cached_sketch, cached_features
+    if cached_sketch is not None and np.array_equal(cached_sketch, input_image):
+        print("Re-roll: reusing the cached encoder activations")
+    else:
+        cached_features = encode(tf.constant(input_image))
+        cached_sketch = input_image.copy()
+
+    # Predict every variant at once
+    features = [tf.repeat(feature, len(noise_seeds), axis=0) for feature in cached_features]
+    _write_heights(decode(*features, tf.constant(noise)).numpy(), heightmaps)
+
+## Function to predict the tiles of a world larger than the generator input in a single forward pass. It is called from the c++ code,
+#  which cuts the tiles out of the sketches and blends their heightmaps. The encoder cache is left untouched.
+#  @param sketch_tensors Input sketches of each tile, as for predict, one after the other
+#  @param noise_seeds Seed of the noise of each tile
+#  @param heightmaps Writable len(noise_seeds)x450x450 float32 buffer of the c++ code, receiving the heights in [0, 255]
+def predict_tiles(sketch_tensors, noise_seeds, heightmaps):
+
+    print("Predicting %d tiles..." % len(noise_seeds))
+
+    input_images = np.frombuffer(sketch_tensors, dtype=np.float32).reshape(len(noise_seeds), 450, 450, 4)
+    output = decode(*encode(tf.constant(input_images)), tf.constant(_noise(noise_seeds))).numpy()
+    _write_heights(output, heightmaps)
+
+def _noise(noise_seeds):
+    return np.concatenate([np.random.RandomState(seed).normal(0, 1, (1, 28, 28, 1024)).astype(np.float32) for seed in noise_seeds])
+
+def _write_heights(output, heightmaps):
+    # Write the heights straight into the c++ heightmaps, without quantizing them; the c++ code blacks out the borders
+    heights = np.frombuffer(heightmaps, dtype=np.float32).reshape(output.shape[0], 450, 450)
+    np.multiply(output, 127.5, out=heights)
+    heights += 127.5
+
+
+## Function to export the generator to ONNX once, for the ONNX Runtime backend of the c++ code (see OnnxGenerator.cpp).
+#  The inputs keep the order and the shapes of the forward pass, the sketches then the noise, with a free batch dimension so that
+#  several variants can be generated at once.
+#  @param model_path Weights of the generator
+#  @param onnx_path Path of the exported model
+def export(model_path, onnx_path):
+    import tf2onnx
+
+    generator = TerrainGANBuilder().load_model(model_path)
+    signature = [tf.TensorSpec((None, 450, 450, 4), tf.float32, name="image"), tf.TensorSpec((None, 28, 28, 1024), tf.float32, name="noise")]
+    tf2onnx.convert.from_keras(generator, input_signature=signature, opset=13, output_path=onnx_path)
+    print("Exported the generator to %s" % onnx_path)
+
 
 if __name__ == "__main__":
-    predict()
\ No newline at end of file
+    import sys
+    if len(sys.argv) > 1 and sys.argv[1] == "--export-onnx":
+        export("./neural_network/model.h5", sys.argv[2] if len(sys.argv) > 2 else "./neural_network/model.onnx")
+        sys.exit(0)
+
+    load("./neural_network/model.h5")
+    heightmap = bytearray(450 * 450 * 4)
+    predict(np.zeros((1, 450, 450, 4), dtype=np.float32).tobytes(), 0, heightmap)
+    print("Heights in [%.2f, %.2f]" % (np.frombuffer(heightmap, dtype=np.float32).min(), np.frombuffer(heightmap, dtype=np.float32).max()))
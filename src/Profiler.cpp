@@ -0,0 +1,341 @@
+/**
+@file
+@brief Profiler source file.
+*/
+
+#include "Profiler.h"
+
+
+Profiler *Profiler::instance = nullptr;
+
+// Names of the passes, in the order of their indexes
+static const char *pass_names[PROFILER_PASSES] = {"menu", "skydome", "orbit", "water waves", "water stencil", "water reflection", "water surface", "terrain", "vegetation", "hud", "upscale"};
+
+// Every field must be visited by combine, update it together with ProfilerFrame
+static_assert(sizeof(ProfilerFrame) == (2 * PROFILER_PASSES + 8) * sizeof(double), "combine doesn't cover every field of ProfilerFrame");
+
+// Apply an operation to every field of a frame, together with the same field of another frame
+template <typename Operation>
+static void combine(ProfilerFrame &result, const ProfilerFrame &frame, Operation operation)
+{
+    for (int pass = 0; pass < PROFILER_PASSES; pass++)
+    {
+        operation(result.cpu_ms[pass], frame.cpu_ms[pass]);
+        operation(result.gpu_ms[pass], frame.gpu_ms[pass]);
+    }
+    operation(result.frame_cpu_ms, frame.frame_cpu_ms);
+    operation(result.frame_gpu_ms, frame.frame_gpu_ms);
+    operation(result.interval_ms, frame.interval_ms);
+    operation(result.primitives, frame.primitives);
+    operation(result.draw_calls, frame.draw_calls);
+    operation(result.uploads, frame.uploads);
+    operation(result.upload_bytes, frame.upload_bytes);
+    operation(result.sync_waits, frame.sync_waits);
+}
+
+// Default constructor
+Profiler::Profiler()
+{
+    if (Profiler::instance == nullptr)
+        Profiler::instance = this;
+
+    this->has_timer_queries = false;
+    this->frame_index = 0;
+    this->resolve_index = 0;
+    this->history_count = 0;
+    this->history_head = 0;
+    memset(this->pass_queries, 0, sizeof(this->pass_queries));
+    memset(this->frame_queries, 0, sizeof(this->frame_queries));
+    memset(this->primitives_queries, 0, sizeof(this->primitives_queries));
+    memset(this->is_pass_used, 0, sizeof(this->is_pass_used));
+    memset(&this->average, 0, sizeof(ProfilerFrame));
+    memset(&this->maximum, 0, sizeof(ProfilerFrame));
+    memset(&this->history_sum, 0, sizeof(ProfilerFrame));
+    memset(&this->total, 0, sizeof(ProfilerFrame));
+    memset(&this->peak, 0, sizeof(ProfilerFrame));
+    this->resolved_frames = 0;
+}
+
+// Destructor
+Profiler::~Profiler()
+{
+    if (this->primitives_queries[0])
+    {
+        glDeleteQueries(PROFILER_LATENCY * PROFILER_PASSES * 2, &this->pass_queries[0][0][0]);
+        glDeleteQueries(PROFILER_LATENCY * 2, &this->frame_queries[0][0]);
+        glDeleteQueries(PROFILER_LATENCY, this->primitives_queries);
+    }
+    if (this->csv.is_open())
+        this->csv.close();
+
+    Profiler::instance = nullptr;
+}
+
+void Profiler::initialize()
+{
+    // Without timer queries only the CPU times and the counters are available
+    this->has_timer_queries = GLEW_ARB_timer_query;
+    if (!this->has_timer_queries)
+        std::cerr << COLOR_YELLOW << "Timer queries not supported, GPU times won't be profiled" << COLOR_RESET << std::endl;
+
+    glGenQueries(PROFILER_LATENCY * PROFILER_PASSES * 2, &this->pass_queries[0][0][0]);
+    glGenQueries(PROFILER_LATENCY * 2, &this->frame_queries[0][0]);
+    glGenQueries(PROFILER_LATENCY, this->primitives_queries);
+
+    this->frame_start = std::chrono::steady_clock::now();
+}
+
+void Profiler::beginFrame()
+{
+    // Make room for the frame: its slot is still in flight only if the GPU is more than PROFILER_LATENCY frames behind
+    if (instance->frame_index - instance->resolve_index >= PROFILER_LATENCY)
+    {
+        instance->resolve(instance->resolve_index % PROFILER_LATENCY, true);
+        instance->resolve_index++;
+    }
+
+    int slot = instance->frame_index % PROFILER_LATENCY;
+    ProfilerFrame &frame = instance->frames[slot];
+    memset(&frame, 0, sizeof(ProfilerFrame));
+    memset(instance->is_pass_used[slot], 0, sizeof(instance->is_pass_used[slot]));
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    frame.interval_ms = std::chrono::duration<double, std::milli>(now - instance->frame_start).count();
+    instance->frame_start = now;
+
+    if (instance->has_timer_queries)
+        glQueryCounter(instance->frame_queries[slot][0], GL_TIMESTAMP);
+    glBeginQuery(GL_PRIMITIVES_GENERATED, instance->primitives_queries[slot]);
+}
+
+void Profiler::endFrame()
+{
+    int slot = instance->frame_index % PROFILER_LATENCY;
+    ProfilerFrame &frame = instance->frames[slot];
+
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+    if (instance->has_timer_queries)
+        glQueryCounter(instance->frame_queries[slot][1], GL_TIMESTAMP);
+
+    frame.frame_cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - instance->frame_start).count();
+
+    // Add the vertex data streamed during the frame
+    StreamStats stats = StreamBuffer::getStats();
+    frame.uploads += stats.uploads;
+    frame.upload_bytes += stats.bytes_streamed;
+    frame.sync_waits = stats.sync_waits;
+
+    instance->frame_index++;
+
+    // Resolve the frames the GPU is done with, oldest first
+    while (instance->resolve_index < instance->frame_index && instance->resolve(instance->resolve_index % PROFILER_LATENCY, false))
+        instance->resolve_index++;
+}
+
+void Profiler::begin(int pass)
+{
+    int slot = instance->frame_index % PROFILER_LATENCY;
+    instance->is_pass_used[slot][pass] = true;
+    instance->pass_start[pass] = std::chrono::steady_clock::now();
+
+    if (instance->has_timer_queries)
+        glQueryCounter(instance->pass_queries[slot][pass][0], GL_TIMESTAMP);
+}
+
+void Profiler::end(int pass)
+{
+    int slot = instance->frame_index % PROFILER_LATENCY;
+    instance->frames[slot].cpu_ms[pass] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - instance->pass_start[pass]).count();
+
+    if (instance->has_timer_queries)
+        glQueryCounter(instance->pass_queries[slot][pass][1], GL_TIMESTAMP);
+}
+
+void Profiler::countDrawCall()
+{
+    instance->frames[instance->frame_index % PROFILER_LATENCY].draw_calls++;
+}
+
+void Profiler::countUpload(size_t bytes)
+{
+    ProfilerFrame &frame = instance->frames[instance->frame_index % PROFILER_LATENCY];
+    frame.uploads++;
+    frame.upload_bytes += bytes;
+}
+
+void Profiler::toggleRecording()
+{
+    if (instance->csv.is_open())
+    {
+        instance->csv.close();
+        printf(COLOR_GREEN "Profiler recording saved to %s\n" COLOR_RESET, PROFILER_CSV_PATH);
+        return;
+    }
+
+    instance->csv.open(PROFILER_CSV_PATH, std::ios::out | std::ios::trunc);
+    if (!instance->csv.is_open())
+    {
+        std::cerr << COLOR_RED << "Failed to open " << PROFILER_CSV_PATH << COLOR_RESET << std::endl;
+        return;
+    }
+
+    // Header: a CPU and a GPU column per pass, then the counters
+    instance->csv << "frame,interval_ms,frame_cpu_ms,frame_gpu_ms";
+    for (int pass = 0; pass < PROFILER_PASSES; pass++)
+        instance->csv << "," << pass_names[pass] << " cpu_ms," << pass_names[pass] << " gpu_ms";
+    instance->csv << ",primitives,draw_calls,uploads,upload_bytes,sync_waits\n";
+
+    printf(COLOR_GREEN "Profiler recording to %s\n" COLOR_RESET, PROFILER_CSV_PATH);
+}
+
+bool Profiler::isRecording()
+{
+    return instance->csv.is_open();
+}
+
+const ProfilerFrame &Profiler::getAverage()
+{
+    return instance->average;
+}
+
+const ProfilerFrame &Profiler::getMaximum()
+{
+    return instance->maximum;
+}
+
+const char *Profiler::getPassName(int pass)
+{
+    return pass_names[pass];
+}
+
+void Profiler::flush()
+{
+    while (instance->resolve_index < instance->frame_index)
+    {
+        instance->resolve(instance->resolve_index % PROFILER_LATENCY, true);
+        instance->resolve_index++;
+    }
+}
+
+void Profiler::reset()
+{
+    instance->history_count = 0;
+    instance->history_head = 0;
+    instance->resolved_frames = 0;
+    memset(&instance->average, 0, sizeof(ProfilerFrame));
+    memset(&instance->maximum, 0, sizeof(ProfilerFrame));
+    memset(&instance->history_sum, 0, sizeof(ProfilerFrame));
+    memset(&instance->total, 0, sizeof(ProfilerFrame));
+    memset(&instance->peak, 0, sizeof(ProfilerFrame));
+}
+
+const ProfilerFrame &Profiler::getTotal()
+{
+    return instance->total;
+}
+
+const ProfilerFrame &Profiler::getPeak()
+{
+    return instance->peak;
+}
+
+unsigned long Profiler::getResolvedFrames()
+{
+    return instance->resolved_frames;
+}
+
+const ProfilerFrame &Profiler::getLatest()
+{
+    return instance->history[(instance->history_head + PROFILER_HISTORY - 1) % PROFILER_HISTORY];
+}
+
+bool Profiler::hasTimerQueries()
+{
+    return instance->has_timer_queries;
+}
+
+bool Profiler::resolve(int slot, bool wait)
+{
+    ProfilerFrame &frame = this->frames[slot];
+
+    // The frame is done when its last query is
+    if (!wait)
+    {
+        GLuint last_query = this->has_timer_queries ? this->frame_queries[slot][1] : this->primitives_queries[slot];
+        GLint is_available = 0;
+        glGetQueryObjectiv(last_query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+        if (!is_available)
+            return false;
+    }
+
+    GLuint64 primitives = 0;
+    glGetQueryObjectui64v(this->primitives_queries[slot], GL_QUERY_RESULT, &primitives);
+    frame.primitives = (double)primitives;
+
+    if (this->has_timer_queries)
+    {
+        frame.frame_gpu_ms = getElapsed(this->frame_queries[slot][0], this->frame_queries[slot][1]);
+        for (int pass = 0; pass < PROFILER_PASSES; pass++)
+            if (this->is_pass_used[slot][pass])
+                frame.gpu_ms[pass] = getElapsed(this->pass_queries[slot][pass][0], this->pass_queries[slot][pass][1]);
+    }
+
+    // Record the frame
+    if (this->csv.is_open())
+    {
+        this->csv << this->resolve_index << "," << frame.interval_ms << "," << frame.frame_cpu_ms << "," << frame.frame_gpu_ms;
+        for (int pass = 0; pass < PROFILER_PASSES; pass++)
+            this->csv << "," << frame.cpu_ms[pass] << "," << frame.gpu_ms[pass];
+        this->csv << "," << frame.primitives << "," << frame.draw_calls << "," << frame.uploads << "," << frame.upload_bytes << "," << frame.sync_waits << "\n";
+    }
+
+    // Totals since the last reset
+    combine(this->total, frame, [](double &total, double value) { total += value; });
+    combine(this->peak, frame, [](double &peak, double value) { peak = std::max(peak, value); });
+    this->resolved_frames++;
+
+    // Push the frame into the history, replacing the oldest one once the ring is full
+    ProfilerFrame &slot_frame = this->history[this->history_head];
+    bool is_leaving_maximum = false;
+    if (this->history_count == PROFILER_HISTORY)
+    {
+        combine(this->history_sum, slot_frame, [](double &sum, double value) { sum -= value; });
+        combine(this->maximum, slot_frame, [&is_leaving_maximum](double &maximum, double value) { is_leaving_maximum = is_leaving_maximum || value >= maximum; });
+    }
+    slot_frame = frame;
+    this->history_head = (this->history_head + 1) % PROFILER_HISTORY;
+    this->history_count = std::min(this->history_count + 1, PROFILER_HISTORY);
+
+    // Keep a running sum of the history, summed again once per lap so that the rounding errors of the subtractions don't pile up
+    if (this->history_head == 0)
+    {
+        memset(&this->history_sum, 0, sizeof(ProfilerFrame));
+        for (int i = 0; i < this->history_count; i++)
+            combine(this->history_sum, this->history[i], [](double &sum, double value) { sum += value; });
+    }
+    else
+        combine(this->history_sum, frame, [](double &sum, double value) { sum += value; });
+    double count = this->history_count;
+    combine(this->average, this->history_sum, [count](double &average, double sum) { average = sum / count; });
+
+    // The maximum only needs a new scan of the history when the frame leaving it held the maximum of a field
+    if (is_leaving_maximum)
+    {
+        memset(&this->maximum, 0, sizeof(ProfilerFrame));
+        for (int i = 0; i < this->history_count; i++)
+            combine(this->maximum, this->history[i], [](double &maximum, double value) { maximum = std::max(maximum, value); });
+    }
+    else
+        combine(this->maximum, frame, [](double &maximum, double value) { maximum = std::max(maximum, value); });
+
+    return true;
+}
+
+double Profiler::getElapsed(GLuint begin_query, GLuint end_query)
+{
+    GLuint64 begin_time = 0;
+    GLuint64 end_time = 0;
+    glGetQueryObjectui64v(begin_query, GL_QUERY_RESULT, &begin_time);
+    glGetQueryObjectui64v(end_query, GL_QUERY_RESULT, &end_time);
+    return end_time > begin_time ? (end_time - begin_time) / 1e6 : 0.0;
+}
@@ -0,0 +1,245 @@
+/**
+@file
+@brief Profiler header file.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include "StreamBuffer.h"
+#include "Colors.h"
+
+// Profiled passes of a frame
+#define PASS_MENU 0
+#define PASS_SKYDOME 1
+#define PASS_ORBIT 2
+#define PASS_WATER_WAVES 3
+#define PASS_WATER_STENCIL 4
+#define PASS_WATER_REFLECTION 5
+#define PASS_WATER_SURFACE 6
+#define PASS_TERRAIN 7
+#define PASS_VEGETATION 8
+#define PASS_HUD 9
+#define PASS_UPSCALE 10
+#define PROFILER_PASSES 11
+// Frames in flight before the timer queries of a frame are read back
+#define PROFILER_LATENCY 4
+// Frames covered by the rolling statistics
+#define PROFILER_HISTORY 120
+// File the resolved frames are recorded into
+#define PROFILER_CSV_PATH "./profiler.csv"
+
+/**
+ * @brief Timings and counters of a profiled frame.
+ */
+typedef struct
+{
+    double cpu_ms[PROFILER_PASSES];     ///< CPU time of each pass in milliseconds
+    double gpu_ms[PROFILER_PASSES];     ///< GPU time of each pass in milliseconds
+    double frame_cpu_ms;                ///< CPU time of the whole frame, swap included
+    double frame_gpu_ms;                ///< GPU time of the whole frame
+    double interval_ms;                 ///< Time since the previous frame started
+    double primitives;                  ///< Primitives generated by the draw calls
+    double draw_calls;                  ///< Number of draw calls
+    double uploads;                     ///< Number of buffer and texture uploads
+    double upload_bytes;                ///< Bytes uploaded to the GPU
+    double sync_waits;                  ///< Times the stream buffer waited for the GPU
+} ProfilerFrame;
+
+/**
+ * @brief Profiler class which measures the CPU and GPU time of the passes of each frame.
+ *
+ * Each pass is wrapped by begin/end: the CPU time is measured right away, while the GPU time is measured with a pair of timestamp
+ * queries (so that passes may nest) read back PROFILER_LATENCY frames later, when the GPU is done with them, to never stall the
+ * pipeline. A primitives query spans the whole frame. Resolved frames feed rolling statistics over the last PROFILER_HISTORY frames
+ * and can be recorded into PROFILER_CSV_PATH.
+ */
+class Profiler
+{
+public:
+    /**
+     * @brief Construct the Profiler singleton.
+     */
+    Profiler();
+
+    /**
+     * @brief Destroy the Profiler singleton, deleting the queries and closing the recording.
+     */
+    ~Profiler();
+
+    /**
+     * @brief Create the queries, must be called once the OpenGL context exists.
+     */
+    void initialize();
+
+    /**
+     * @brief Start profiling a frame.
+     */
+    static void beginFrame();
+
+    /**
+     * @brief Finish profiling a frame, after the swap, and resolve the frames whose queries are available.
+     */
+    static void endFrame();
+
+    /**
+     * @brief Start a pass (at most once per frame).
+     *
+     * @param pass Pass index
+     */
+    static void begin(int pass);
+
+    /**
+     * @brief Finish a pass.
+     *
+     * @param pass Pass index
+     */
+    static void end(int pass);
+
+    /**
+     * @brief Count a draw call of the current frame.
+     */
+    static void countDrawCall();
+
+    /**
+     * @brief Count an upload of the current frame.
+     *
+     * @param bytes Uploaded bytes
+     */
+    static void countUpload(size_t bytes);
+
+    /**
+     * @brief Start or stop recording the resolved frames into PROFILER_CSV_PATH.
+     */
+    static void toggleRecording();
+
+    /**
+     * @brief Check if the resolved frames are being recorded.
+     *
+     * @return true If the recording is open
+     * @return false Otherwise
+     */
+    static bool isRecording();
+
+    /**
+     * @brief Get the average of the last PROFILER_HISTORY resolved frames.
+     *
+     * @return const ProfilerFrame&
+     */
+    static const ProfilerFrame &getAverage();
+
+    /**
+     * @brief Get the maximum of the last PROFILER_HISTORY resolved frames.
+     *
+     * @return const ProfilerFrame&
+     */
+    static const ProfilerFrame &getMaximum();
+
+    /**
+     * @brief Get the name of a pass.
+     *
+     * @param pass Pass index
+     * @return const char*
+     */
+    static const char *getPassName(int pass);
+
+    /**
+     * @brief Wait for the frames in flight and resolve them.
+     */
+    static void flush();
+
+    /**
+     * @brief Clear the statistics, the history and the totals (e.g. after a warm-up).
+     */
+    static void reset();
+
+    /**
+     * @brief Get the sum of the frames resolved since the last reset.
+     *
+     * @return const ProfilerFrame&
+     */
+    static const ProfilerFrame &getTotal();
+
+    /**
+     * @brief Get the maximum of the frames resolved since the last reset.
+     *
+     * @return const ProfilerFrame&
+     */
+    static const ProfilerFrame &getPeak();
+
+    /**
+     * @brief Get the number of frames resolved since the last reset.
+     *
+     * @return unsigned long
+     */
+    static unsigned long getResolvedFrames();
+
+    /**
+     * @brief Get the last resolved frame.
+     *
+     * @return const ProfilerFrame&
+     */
+    static const ProfilerFrame &getLatest();
+
+    /**
+     * @brief Check if the GPU times are measured.
+     *
+     * @return true If ARB_timer_query is supported
+     * @return false Otherwise
+     */
+    static bool hasTimerQueries();
+
+private:
+    static Profiler *instance;                                              ///< Used to access the Profiler object from the static functions
+
+    bool has_timer_queries;                                                 ///< Whether ARB_timer_query is supported
+    GLuint pass_queries[PROFILER_LATENCY][PROFILER_PASSES][2];              ///< Begin and end timestamps of each pass
+    GLuint frame_queries[PROFILER_LATENCY][2];                              ///< Begin and end timestamps of each frame
+    GLuint primitives_queries[PROFILER_LATENCY];                            ///< Primitives generated by each frame
+    bool is_pass_used[PROFILER_LATENCY][PROFILER_PASSES];                   ///< Whether the pass ran in the frame
+    ProfilerFrame frames[PROFILER_LATENCY];                                 ///< Frames in flight, waiting for their queries
+    unsigned long frame_index;                                              ///< Index of the current frame
+    unsigned long resolve_index;                                            ///< Index of the oldest frame not resolved yet
+
+    std::chrono::steady_clock::time_point frame_start;                      ///< CPU start of the current frame
+    std::chrono::steady_clock::time_point pass_start[PROFILER_PASSES];      ///< CPU start of each pass of the current frame
+
+    ProfilerFrame history[PROFILER_HISTORY];                                ///< Resolved frames, as a ring
+    int history_count;                                                      ///< Number of frames in the history
+    int history_head;                                                       ///< Slot of the next resolved frame
+    ProfilerFrame average;                                                  ///< Average of the history
+    ProfilerFrame maximum;                                                  ///< Maximum of the history
+    ProfilerFrame history_sum;                                              ///< Sum of the history, updated as the frames enter and leave it
+    ProfilerFrame total;                                                    ///< Sum of the frames resolved since the last reset
+    ProfilerFrame peak;                                                     ///< Maximum of the frames resolved since the last reset
+    unsigned long resolved_frames;                                          ///< Frames resolved since the last reset
+
+    std::ofstream csv;                                                      ///< Recording of the resolved frames
+
+    /**
+     * @brief Read back the queries of a frame and add it to the statistics.
+     *
+     * @param slot Slot of the frame
+     * @param wait Whether to wait for the results or give up when they're not available yet
+     * @return true If the frame was resolved
+     * @return false If the results weren't available
+     */
+    bool resolve(int slot, bool wait);
+
+    /**
+     * @brief Read a pair of timestamp queries.
+     *
+     * @param begin_query Query of the first timestamp
+     * @param end_query Query of the second timestamp
+     * @return double Time elapsed between the two timestamps in milliseconds
+     */
+    static double getElapsed(GLuint begin_query, GLuint end_query);
+};
+
+#endif // PROFILER_H
@@ -15,6 +15,8 @@
 #include "Constants.h"
 #include "Object.h"
 #include "Terrain.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
 
 // Forward declaration
 class QuadTree;
@@ -47,6 +49,7 @@ class QuadNode
         QuadNode *SE_child; ///< South-East child node
         
         Object object; ///< Object contained in the node, containing all the opengl buffers of the node
+        GLsizei index_count; ///< Number of indices of the leaf mesh, whose CPU copy is released once uploaded
         
         QuadTree *quadtree; ///< Reference to the parent class
 
@@ -69,7 +72,29 @@ class QuadNode
         ~QuadNode();
         
         /**
-         * @brief Recursively subdivide the node into 4 children nodes when needed (when the node is in the frustum) and draw the node's object
+         * @brief Generate the vertices, texture coordinates, indices and normals of a leaf node's mesh
+         * 
+         * @param terrain Reference to the terrain object
+         * @param delta_x Number of vertices of the node along the columns
+         * @param delta_z Number of vertices of the node along the rows
+         */
+        void buildMesh(Terrain *terrain, int delta_x, int delta_z);
+        
+        /**
+         * @brief Recursively upload the leaf meshes into their opengl buffers
+         * 
+         */
+        void upload();
+        
+        /**
+         * @brief Recursively collect the leaves in the frustum, skipping the children of the nodes out of it
+         * 
+         * @param leaves Leaves in the frustum
+         */
+        void cull(std::vector<QuadNode *> &leaves);
+        
+        /**
+         * @brief Draw the leaf node's object
          * 
          */
         void draw();
@@ -91,6 +116,7 @@ private:
     Vec2<float> camera_position;    ///< Position of the camera in world coordinates
     Vec2<float> camera_direction;   ///< Direction of the camera in world coordinates
     GLuint texture_id;              ///< Texture id of the terrain's texture
+    std::vector<QuadNode *> visible_leaves; ///< Leaves in the frustum, collected on each frame
     
 
 public:
@@ -114,6 +140,28 @@ public:
      */
     void initialize(Terrain *terrain);
     
+    /**
+     * @brief Build the nodes and the leaf meshes without uploading them (used by the micro-benchmarks)
+     * 
+     * @param terrain Reference to the terrain object
+     */
+    void build(Terrain *terrain);
+    
+    /**
+     * @brief Update the camera's position and direction used by the frustum test
+     * 
+     * @param camera_position Position of the camera in world coordinates
+     * @param camera_direction Direction of the camera in world coordinates
+     */
+    void setCamera(Vec2<float> camera_position, Vec2<float> camera_direction);
+    
+    /**
+     * @brief Collect the leaves in the frustum of the camera
+     * 
+     * @param leaves Leaves in the frustum
+     */
+    void cull(std::vector<QuadNode *> &leaves);
+    
     /**
      * @brief Update the camera's position and direction and render the QuadTree by calling the draw() function of the root node
      * 
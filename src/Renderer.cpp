@@ -20,6 +20,25 @@ Renderer::Renderer()
 // Destructor
 Renderer::~Renderer()
 {
+    // The OpenGL objects are normally released already, while the context still existed
+    release();
+    
+    // Deallocate opencv objects
+    menu_clips[LANDING_SCREEN].release();
+    menu_clips[RIDGES_SCREEN].release();
+    menu_clips[PEAKS_SCREEN].release();
+    menu_clips[RIVERS_SCREEN].release();
+    menu_clips[BASINS_SCREEN].release();
+    menu_clips[LOADING_SCREEN].release();
+
+    Renderer::instance = nullptr;
+}
+
+void Renderer::release()
+{
+    if (instance == nullptr || instance->objects.empty())
+        return;
+    
     // Disable the vertex arrays
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
@@ -30,28 +49,15 @@ Renderer::~Renderer()
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     
-    // Deallocate memory
-    objects.clear();
-    
-    // Delete the vertex array objects
-    glDeleteVertexArrays(1, &objects[SUN].vao);
-    glDeleteVertexArrays(1, &objects[MOON].vao);
-    glDeleteVertexArrays(1, &objects[SPLASHSCREEN].vao);
-    glDeleteVertexArrays(1, &objects[CANVAS].vao);
-    glDeleteVertexArrays(1, &objects[SKYDOME].vao);
-    glDeleteVertexArrays(1, &objects[WATER].vao);
-    glDeleteVertexArrays(1, &objects[VEGETATION].vao);
+    // Stop the vegetation workers and delete the chunk buffers and the vegetation program
+    instance->has_vegetation = false;
+    instance->vegetation.reset();
+    instance->vegetation_shader.release();
     
-    // Deallocate opencv objects
-    menu_clips[LANDING_SCREEN].release();
-    menu_clips[RIDGES_SCREEN].release();
-    menu_clips[PEAKS_SCREEN].release();
-    menu_clips[RIVERS_SCREEN].release();
-    menu_clips[BASINS_SCREEN].release();
-    menu_clips[LOADING_SCREEN].release();
-    menu_frame.release();
-
-    Renderer::instance = nullptr;
+    // Delete the opengl objects, then deallocate memory
+    for (Object &object : instance->objects)
+        ResourceRegistry::releaseObject(object);
+    instance->objects.clear();
 }
 
 void Renderer::setTerrain(Terrain *terrain)
@@ -76,12 +82,33 @@ void Renderer::initialize(Camera *camera, QuadTree *quadtree)
     this->initializeSplashscreen();
     this->initializeCanvas();
     this->initializeSkydome();
+    this->initializeSketches();
+    
+    // Load the shader programs, the vegetation instances also need the attribute divisor (OpenGL 3.3)
+    this->has_vegetation = GLEW_VERSION_3_3 && this->vegetation_shader.load("./assets/shaders/vegetation.vert", "./assets/shaders/vegetation.frag");
+    if (!this->has_vegetation)
+        printf(COLOR_YELLOW "Vegetation disabled (%s)\n" COLOR_RESET, GLEW_VERSION_3_3 ? "the vegetation shader failed to load" : "instanced arrays not supported");
+    
+    // Allocate the stream buffer for the per-frame vertex data (grows by itself if a frame needs more)
+    this->stream_buffer.initialize(STREAM_BUFFER_SIZE);
+    
+    // Create the upscaling quad of the dynamic resolution, the render target is allocated once the world exceeds its budget
+    this->dynamic_resolution.initialize();
+    this->variant_gallery.initialize();
+    this->sketch_preview.initialize();
     
-    // Set the glut timer callback for the sun animaton
-    glutTimerFunc(100, Renderer::timerCallback, 0);
+    // Reset the simulated times, advanced by the frame scheduler
+    this->setTime(STARTING_TIME);
+    this->wave_time = this->previous_wave_time = 0.0f;
+    this->vegetation_time = this->previous_vegetation_time = 0.0f;
+    this->interpolation = 1.0f;
     
-    // Set the glut display callback
-    glutDisplayFunc(Renderer::draw);
+    // Set the glut display callback, the headless frames are rendered on demand
+    if (!GlutFramework::isHeadless())
+    {
+        glutDisplayFunc(Renderer::draw);
+        glutCloseFunc(Renderer::release);
+    }
     
     const siv::PerlinNoise::seed_type seed = 12345;
     this->perlin_noise = siv::PerlinNoise(seed);
@@ -89,178 +116,121 @@ void Renderer::initialize(Camera *camera, QuadTree *quadtree)
 
 void Renderer::initializeWater()
 {
-    // Retrieve the map
-    Vec3<float> *map = this->terrain->getWatermap();
-    
-    int dim = this->terrain->getDim();
+    buildWater(this->terrain, objects[WATER]);
     
-    objects[WATER].vertices.clear();
-    objects[WATER].indices.clear();
-    objects[WATER].textures.clear();
-    objects[WATER].normals.clear();
-    
-    // Find depression points by comparing each low point with the neighbors
-    for (int i = 0; i < dim; i++)
-    {
-        for (int j = 0; j < dim; j++)
-        {
-            objects[WATER].vertices.push_back(map[i * dim + j].x);
-            objects[WATER].vertices.push_back(map[i * dim + j].y);
-            objects[WATER].vertices.push_back(map[i * dim + j].z);
-            
-            objects[WATER].textures.push_back((float)i / dim * 100);
-            objects[WATER].textures.push_back((float)j / dim * 100);
-            
-            objects[WATER].normals.push_back(0.0f);
-            objects[WATER].normals.push_back(0.0f);
-            objects[WATER].normals.push_back(0.0f);
-        }
-    }
-    
-    // Generate indices for triangle strips
-    for (int z = 0; z < dim - 1; z++) // 449
+    // The water texture and buffer objects are created once and reused by every world
+    if (!objects[WATER].vao)
     {
-        // Start a new strip
-        objects[WATER].indices.push_back(z * dim);
-        for (int x = 0; x < dim; x++) // 902
-        {
-            // Add vertices to strip
-            objects[WATER].indices.push_back((z + 1) * dim + x);
-            objects[WATER].indices.push_back(z * dim + x);
-        }
-        // Use primitive restart to start a new strip
-        objects[WATER].indices.push_back(0xFFFFFFFFu);
-    }
-    
-    // Generate and bind a texture object
-    glGenTextures(1, &objects[WATER].texture[0]);
-    glBindTexture(GL_TEXTURE_2D, objects[WATER].texture[0]);
-    
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    cv::Mat water_texture = cv::imread("./assets/textures/water.jpg");
-    cv::cvtColor(water_texture, water_texture, cv::COLOR_BGR2BGRA);
+        // Generate and bind a texture object
+        objects[WATER].texture[0] = ResourceRegistry::createTexture(RESOURCE_WATER);
+        glBindTexture(GL_TEXTURE_2D, objects[WATER].texture[0]);
+        
+        // Set texture parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        
+        cv::Mat water_texture;
+        cv::cvtColor(AssetManager::loadImage("./assets/textures/water.jpg").get(), water_texture, cv::COLOR_BGR2BGRA);
 
-    // Set the alpha channel to 0.5
-    for (int i = 0; i < water_texture.rows; i++)
-    {
-        for (int j = 0; j < water_texture.cols; j++)
+        // Set the alpha channel to 0.5
+        for (int i = 0; i < water_texture.rows; i++)
         {
-            water_texture.at<cv::Vec4b>(i, j)[3] = 128;
+            for (int j = 0; j < water_texture.cols; j++)
+            {
+                water_texture.at<cv::Vec4b>(i, j)[3] = 128;
+            }
         }
-    }
 
-    // Upload the texture image data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, water_texture.cols, water_texture.rows, 0, GL_BGRA, GL_UNSIGNED_BYTE, water_texture.data);
+        // Upload the texture image data, block-compressed
+        size_t bytes = BlockCompressor::uploadImage(water_texture, BlockCompressor::getFileKey("./assets/textures/water.jpg") + "|alpha128", true);
+        ResourceRegistry::setTextureSize(objects[WATER].texture[0], bytes);
 
-    // Generate the vertex array object for the mesh
-    glGenVertexArrays(1, &objects[WATER].vao);
+        // Generate the vertex array object for the mesh
+        objects[WATER].vao = ResourceRegistry::createVertexArray(RESOURCE_WATER);
+        
+        // Generate the buffer objects: vertices and normals change every frame and are streamed by drawWater
+        objects[WATER].tbo = ResourceRegistry::createBuffer(RESOURCE_WATER);
+        objects[WATER].ibo = ResourceRegistry::createBuffer(RESOURCE_WATER);
+    }
+    
     // Bind the vertex array object for the mesh
     glBindVertexArray(objects[WATER].vao);
-    
-    // Generate the buffer objects
-    glGenBuffers(1, &objects[WATER].vbo);
-    glGenBuffers(1, &objects[WATER].tbo);
-    glGenBuffers(1, &objects[WATER].ibo);
-    glGenBuffers(1, &objects[WATER].nbo);
-
-    // Bind and fill the vertex buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, objects[WATER].vbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[WATER].vertices.size() * sizeof(float), objects[WATER].vertices.data(), GL_STREAM_DRAW);
-    glVertexPointer(3, GL_FLOAT, 0, 0);
 
-    // Bind and fill the texture coordinate buffer object
+    // Bind and fill the texture coordinate buffer object, scrolled by the texture matrix while drawing
     glBindBuffer(GL_ARRAY_BUFFER, objects[WATER].tbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[WATER].textures.size() * sizeof(float), objects[WATER].textures.data(), GL_STREAM_DRAW);
+    ResourceRegistry::bufferData(objects[WATER].tbo, GL_ARRAY_BUFFER, objects[WATER].textures.size() * sizeof(float), objects[WATER].textures.data(), GL_STATIC_DRAW);
     glTexCoordPointer(2, GL_FLOAT, 0, 0);
     
-    // Bind and fill the normals buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, objects[WATER].nbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[WATER].normals.size() * sizeof(float), objects[WATER].normals.data(), GL_STREAM_DRAW);
-    glNormalPointer(GL_FLOAT, 0, 0);
-    
     // Bind and fill indices buffer.
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, objects[WATER].ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, objects[WATER].indices.size() * sizeof(GLuint), objects[WATER].indices.data(), GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[WATER].ibo, GL_ELEMENT_ARRAY_BUFFER, objects[WATER].indices.size() * sizeof(GLuint), objects[WATER].indices.data(), GL_STATIC_DRAW);
 
     // Unbind everything
     glBindVertexArray(0);
 }
 
-void Renderer::initializeVegetation()
+void Renderer::buildWater(Terrain *terrain, Object &water)
 {
     // Retrieve the map
-    Vec3<float> *map = this->terrain->getHeightmap();
-    int water_level = this->terrain->getWaterLevel();
-
-    int dim = this->terrain->getDim();
+    Vec3<float> *map = terrain->getWatermap();
     
-    objects[VEGETATION].vertices.clear();
-    objects[VEGETATION].textures.clear();
+    int dim = terrain->getDim();
     
+    water.vertices.clear();
+    water.indices.clear();
+    water.textures.clear();
+    water.normals.clear();
+    
+    // Find depression points by comparing each low point with the neighbors
     for (int i = 0; i < dim; i++)
     {
         for (int j = 0; j < dim; j++)
         {
-            if (rand() % VEGETATION_SPARSITY == 0)
-            {
-                if (map[i * dim + j].y > water_level + WAVE_MACRO_AMPLITUDE)
-                {
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].x + BUSH_SIZE);
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].y);
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].z);
-                    
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].x + BUSH_SIZE);
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].y + BUSH_SIZE);
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].z);
-                    
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].x - BUSH_SIZE);
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].y + BUSH_SIZE);
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].z);
-                    
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].x - BUSH_SIZE);
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].y);
-                    objects[VEGETATION].vertices.push_back(map[i * dim + j].z);
-                    
-                    if (map[i * dim + j].y < this->terrain->getBounds()->max_y * 0.4)
-                    {
-                        objects[VEGETATION].textures.push_back(0.5f);
-                        objects[VEGETATION].textures.push_back(1.0f);
-                        
-                        objects[VEGETATION].textures.push_back(0.5f);
-                        objects[VEGETATION].textures.push_back(0.0f);
-                        
-                        objects[VEGETATION].textures.push_back(0.0f);
-                        objects[VEGETATION].textures.push_back(0.0f);
-                        
-                        objects[VEGETATION].textures.push_back(0.0f);
-                        objects[VEGETATION].textures.push_back(1.0f);
-                    }
-                    else
-                    {   
-                        objects[VEGETATION].textures.push_back(1.0f);
-                        objects[VEGETATION].textures.push_back(1.0f);
-                        
-                        objects[VEGETATION].textures.push_back(1.0f);
-                        objects[VEGETATION].textures.push_back(0.0f);
-                        
-                        objects[VEGETATION].textures.push_back(0.5f);
-                        objects[VEGETATION].textures.push_back(0.0f);
-                        
-                        objects[VEGETATION].textures.push_back(0.5f);
-                        objects[VEGETATION].textures.push_back(1.0f);
-                    }
-                }
-            }
+            water.vertices.push_back(map[i * dim + j].x);
+            water.vertices.push_back(map[i * dim + j].y);
+            water.vertices.push_back(map[i * dim + j].z);
+            
+            water.textures.push_back((float)i / dim * 100);
+            water.textures.push_back((float)j / dim * 100);
+            
+            water.normals.push_back(0.0f);
+            water.normals.push_back(0.0f);
+            water.normals.push_back(0.0f);
         }
     }
     
+    // Generate indices for triangle strips
+    for (int z = 0; z < dim - 1; z++) // 449
+    {
+        // Start a new strip
+        water.indices.push_back(z * dim);
+        for (int x = 0; x < dim; x++) // 902
+        {
+            // Add vertices to strip
+            water.indices.push_back((z + 1) * dim + x);
+            water.indices.push_back(z * dim + x);
+        }
+        // Use primitive restart to start a new strip
+        water.indices.push_back(0xFFFFFFFFu);
+    }
+}
+
+void Renderer::initializeVegetation()
+{
+    if (!this->has_vegetation)
+        return;
+
+    // Build the chunk grid over the new terrain: the chunks themselves are scattered lazily as the camera gets close
+    this->vegetation.initialize(this->terrain, &this->vegetation_shader);
+    
+    // The texture is created once and reused by every world
+    if (objects[VEGETATION].texture[0])
+        return;
+    
     // Generate and bind a texture object
-    glGenTextures(1, &objects[VEGETATION].texture[0]);
+    objects[VEGETATION].texture[0] = ResourceRegistry::createTexture(RESOURCE_VEGETATION);
     glBindTexture(GL_TEXTURE_2D, objects[VEGETATION].texture[0]);
     
     // Set texture parameters
@@ -269,59 +239,44 @@ void Renderer::initializeVegetation()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     
-    // Load grass texture in opencv using 4 channels
-    cv::Mat grass_texture = cv::imread("./assets/textures/grass.png", cv::IMREAD_UNCHANGED);
+    // Retrieve the grass texture with its 4 channels
+    cv::Mat grass_texture = AssetManager::loadImage("./assets/textures/grass.png", cv::IMREAD_UNCHANGED).get();
 
-    // Upload the texture image data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, grass_texture.cols, grass_texture.rows, 0, GL_BGRA, GL_UNSIGNED_BYTE, grass_texture.data);
+    // Upload the texture image data, block-compressed
+    size_t bytes = BlockCompressor::uploadImage(grass_texture, BlockCompressor::getFileKey("./assets/textures/grass.png"), true);
+    ResourceRegistry::setTextureSize(objects[VEGETATION].texture[0], bytes);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    // Generate the vertex array object for the mesh
-    glGenVertexArrays(1, &objects[VEGETATION].vao);
-    // Bind the vertex array object for the mesh
-    glBindVertexArray(objects[VEGETATION].vao);
+void Renderer::initializeOrbit(int orbit_height)
+{
+    // Only the orbit height depends on the world: it is applied while drawing
+    this->orbit_height = orbit_height;
     
-    // Generate the buffer objects
-    glGenBuffers(1, &objects[VEGETATION].vbo);
-    glGenBuffers(1, &objects[VEGETATION].tbo);
+    // The sun and the moon are created once and reused by every world
+    if (objects[SUN].vao)
+        return;
     
-    // Bind and fill the vertex buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, objects[VEGETATION].vbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[VEGETATION].vertices.size() * sizeof(float), objects[VEGETATION].vertices.data(), GL_STREAM_DRAW);
-    glVertexPointer(3, GL_FLOAT, 0, 0);
-
-    // Bind and fill the texture coordinate buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, objects[VEGETATION].tbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[VEGETATION].textures.size() * sizeof(float), objects[VEGETATION].textures.data(), GL_STREAM_DRAW);
-    glTexCoordPointer(2, GL_FLOAT, 0, 0);
-
-    // Unbind everything
-    glBindVertexArray(0);
+    this->initializeModel(SUN, "./assets/textures/sun.png", "./assets/models/sun.obj");
+    this->initializeModel(MOON, "./assets/textures/moon.jpg", "./assets/models/moon.obj");
 }
 
-void Renderer::initializeOrbit(int orbit_height)
+void Renderer::initializeModel(short object, const char *texture_path, const char *model_path)
 {
-
-    // SUN OBJECT
+    // Request both assets before waiting for any of them
+    std::shared_future<cv::Mat> texture_asset = AssetManager::loadImage(texture_path);
+    std::shared_future<std::shared_ptr<const MeshAsset>> mesh_asset = AssetManager::loadMesh(model_path);
     
-    // Clear the sun object before initializing it
-    objects[SUN].vertices.clear();
-    objects[SUN].indices.clear();
-    objects[SUN].textures.clear();
-
-    // Load sun texture image
-    cv::Mat sun_texture = cv::imread("./assets/textures/sun.png");
+    // Retrieve the texture image
+    cv::Mat texture = texture_asset.get();
     
     // Check if the image was loaded successfully
-    if (sun_texture.empty())
-    {
-        // Handle error
-        std::cerr << "Failed to load texture image." << std::endl;
+    if (texture.empty())
         return;
-    }
 
     // Generate and bind a texture object
-    glGenTextures(1, &objects[SUN].texture[0]);
-    glBindTexture(GL_TEXTURE_2D, objects[SUN].texture[0]);
+    objects[object].texture[0] = ResourceRegistry::createTexture(RESOURCE_SKY);
+    glBindTexture(GL_TEXTURE_2D, objects[object].texture[0]);
 
     // Set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -329,182 +284,42 @@ void Renderer::initializeOrbit(int orbit_height)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Upload the texture image data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, sun_texture.cols, sun_texture.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, sun_texture.data);
-
-    Assimp::Importer importer;
+    // Upload the texture image data, block-compressed
+    size_t bytes = BlockCompressor::uploadImage(texture, BlockCompressor::getFileKey(texture_path), false);
+    ResourceRegistry::setTextureSize(objects[object].texture[0], bytes);
 
-    // Load the .obj file
-    const aiScene *sun_scene = importer.ReadFile("./assets/models/sun.obj", aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
-    // Check if the scene was loaded successfully
-    if (!sun_scene || sun_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !sun_scene->mRootNode)
-        std::cout << "Error loading scene: " << importer.GetErrorString() << std::endl;
-
-    // For each mesh in the scene
-    for (unsigned int i = 0; i < sun_scene->mNumMeshes; ++i)
-    {
-        const aiMesh *mesh = sun_scene->mMeshes[i];
-
-        // For each vertexin the mesh
-        for (unsigned int j = 0; j < mesh->mNumVertices; ++j)
-        {
-            // Extract vertices
-            aiVector3D Vec = mesh->mVertices[j];
-            objects[SUN].vertices.push_back(Vec.x);
-            objects[SUN].vertices.push_back(Vec.y - orbit_height*2);
-            objects[SUN].vertices.push_back(Vec.z);
-
-            // Extract texture coordinates
-            if (mesh->HasTextureCoords(0))
-            {
-                aiVector3D texCoord = mesh->mTextureCoords[0][j];
-                objects[SUN].textures.push_back(texCoord.x);
-                objects[SUN].textures.push_back(texCoord.y);
-            }
-        }
-
-        // For each face in the mesh
-        for (unsigned int j = 0; j < mesh->mNumFaces; ++j)
-        {
-            const aiFace &face = mesh->mFaces[j];
-
-            // Assume triangular faces
-            if (face.mNumIndices == 3)
-            {
-                objects[SUN].indices.push_back(face.mIndices[0]);
-                objects[SUN].indices.push_back(face.mIndices[1]);
-                objects[SUN].indices.push_back(face.mIndices[2]);
-            }
-        }
-    }
-    
-    // Generate the vertex array object for the sun
-    glGenVertexArrays(1, &objects[SUN].vao);
-    // Bind the vertex array object for the sun
-    glBindVertexArray(objects[SUN].vao);
-
-    // Generate the buffer objects
-    glGenBuffers(1, &objects[SUN].vbo);
-    glGenBuffers(1, &objects[SUN].tbo);
-    glGenBuffers(1, &objects[SUN].ibo);
-
-    // Bind and fill the vertex buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, objects[SUN].vbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[SUN].vertices.size() * sizeof(float), objects[SUN].vertices.data(), GL_STATIC_DRAW);
-    glVertexPointer(3, GL_FLOAT, 0, 0);
-
-    // Bind and fill the texture coordinate buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, objects[SUN].tbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[SUN].textures.size() * sizeof(float), objects[SUN].textures.data(), GL_STATIC_DRAW);
-    glTexCoordPointer(2, GL_FLOAT, 0, 0);
-    
-    // Bind and fill indices buffer.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, objects[SUN].ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, objects[SUN].indices.size() * sizeof(GLuint), objects[SUN].indices.data(), GL_STATIC_DRAW);
-
-    // Unbind everything
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-    // MOON OBJECT
-    
-    // Clear the moon object before initializing it
-    objects[MOON].vertices.clear();
-    objects[MOON].indices.clear();
-    objects[MOON].textures.clear();
-
-    // Load skydome texture image
-    cv::Mat moon_texture = cv::imread("./assets/textures/moon.jpg");
-    
-    // Check if the image was loaded successfully
-    if (moon_texture.empty())
-    {
-        // Handle error
-        std::cerr << "Failed to load texture image." << std::endl;
+    // Retrieve the mesh
+    std::shared_ptr<const MeshAsset> mesh = mesh_asset.get();
+    if (!mesh)
         return;
-    }
     
-    // Generate and bind a texture object
-    glGenTextures(1, &objects[MOON].texture[0]);
-    glBindTexture(GL_TEXTURE_2D, objects[MOON].texture[0]);
-
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Upload the texture image data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, moon_texture.cols, moon_texture.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, moon_texture.data);
-
-    // Load the .obj file
-    const aiScene *moon_scene = importer.ReadFile("./assets/models/moon.obj", aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
-    // Check if the scene was loaded successfully
-    if (!moon_scene || moon_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !moon_scene->mRootNode)
-        std::cout << "Error loading scene: " << importer.GetErrorString() << std::endl;
-
-    // For each mesh in the scene
-    for (unsigned int i = 0; i < moon_scene->mNumMeshes; ++i)
-    {
-        const aiMesh *mesh = moon_scene->mMeshes[i];
-
-        // For each vertexin the mesh
-        for (unsigned int j = 0; j < mesh->mNumVertices; ++j)
-        {
-            // Extract vertices
-            aiVector3D Vec = mesh->mVertices[j];
-            objects[MOON].vertices.push_back(Vec.x);
-            objects[MOON].vertices.push_back(Vec.y + orbit_height*2);
-            objects[MOON].vertices.push_back(Vec.z);
-            
-            // Extract texture coordinates
-            if (mesh->HasTextureCoords(0))
-            {
-                aiVector3D texCoord = mesh->mTextureCoords[0][j];
-                objects[MOON].textures.push_back(texCoord.x);
-                objects[MOON].textures.push_back(texCoord.y);
-            }
-        }
-
-        // For each face in the mesh
-        for (unsigned int j = 0; j < mesh->mNumFaces; ++j)
-        {
-            const aiFace &face = mesh->mFaces[j];
-
-            // Assume triangular faces
-            if (face.mNumIndices == 3)
-            {
-                objects[MOON].indices.push_back(face.mIndices[0]);
-                objects[MOON].indices.push_back(face.mIndices[1]);
-                objects[MOON].indices.push_back(face.mIndices[2]);
-            }
-        }
-    }
-
-    // Generate the vertex array object for the sun
-    glGenVertexArrays(1, &objects[MOON].vao);
-    // Bind the vertex array object for the sun
-    glBindVertexArray(objects[MOON].vao);
+    objects[object].vertices = mesh->vertices;
+    objects[object].textures = mesh->textures;
+    objects[object].indices = mesh->indices;
+    
+    // Generate the vertex array object
+    objects[object].vao = ResourceRegistry::createVertexArray(RESOURCE_SKY);
+    // Bind the vertex array object
+    glBindVertexArray(objects[object].vao);
 
     // Generate the buffer objects
-    glGenBuffers(1, &objects[MOON].vbo);
-    glGenBuffers(1, &objects[MOON].tbo);
-    glGenBuffers(1, &objects[MOON].ibo);
+    objects[object].vbo = ResourceRegistry::createBuffer(RESOURCE_SKY);
+    objects[object].tbo = ResourceRegistry::createBuffer(RESOURCE_SKY);
+    objects[object].ibo = ResourceRegistry::createBuffer(RESOURCE_SKY);
 
     // Bind and fill the vertex buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, objects[MOON].vbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[MOON].vertices.size() * sizeof(float), objects[MOON].vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, objects[object].vbo);
+    ResourceRegistry::bufferData(objects[object].vbo, GL_ARRAY_BUFFER, objects[object].vertices.size() * sizeof(float), objects[object].vertices.data(), GL_STATIC_DRAW);
     glVertexPointer(3, GL_FLOAT, 0, 0);
 
     // Bind and fill the texture coordinate buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, objects[MOON].tbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[MOON].textures.size() * sizeof(float), objects[MOON].textures.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, objects[object].tbo);
+    ResourceRegistry::bufferData(objects[object].tbo, GL_ARRAY_BUFFER, objects[object].textures.size() * sizeof(float), objects[object].textures.data(), GL_STATIC_DRAW);
     glTexCoordPointer(2, GL_FLOAT, 0, 0);
-
+    
     // Bind and fill indices buffer.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, objects[MOON].ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, objects[MOON].indices.size() * sizeof(GLuint), objects[MOON].indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, objects[object].ibo);
+    ResourceRegistry::bufferData(objects[object].ibo, GL_ELEMENT_ARRAY_BUFFER, objects[object].indices.size() * sizeof(GLuint), objects[object].indices.data(), GL_STATIC_DRAW);
 
     // Unbind everything
     glBindVertexArray(0);
@@ -514,32 +329,37 @@ void Renderer::initializeOrbit(int orbit_height)
 
 void Renderer::initializeSkydome()
 {
-    // Load skydome texture image
-    cv::Mat day_texture = cv::imread("./assets/textures/day.jpg");
+    // Request every skydome asset before waiting for any of them
+    std::shared_future<cv::Mat> day_asset = AssetManager::loadImage("./assets/textures/day.jpg");
+    std::shared_future<cv::Mat> night_asset = AssetManager::loadImage("./assets/textures/night.jpg");
+    std::shared_future<std::shared_ptr<const MeshAsset>> mesh_asset = AssetManager::loadMesh("./assets/models/skydome.obj");
+    
+    // Retrieve the day texture image
+    cv::Mat day_texture;
     // Check if the image was loaded successfully
-    if (day_texture.empty())
+    if (day_asset.get().empty())
     {
         // Handle error
         std::cerr << "Failed to load skydome texture image." << std::endl;
         return;
     }
-    // Add alpha channel to day_texture in place
-    cv::cvtColor(day_texture, day_texture, cv::COLOR_BGR2BGRA);
+    // Add alpha channel to day_texture
+    cv::cvtColor(day_asset.get(), day_texture, cv::COLOR_BGR2BGRA);
     
-    // Load night texture image
-    cv::Mat night_texture = cv::imread("./assets/textures/night.jpg");
+    // Retrieve the night texture image
+    cv::Mat night_texture;
     // Check if the image was loaded successfully
-    if (night_texture.empty())
+    if (night_asset.get().empty())
     {
         // Handle error
         std::cerr << "Failed to load night texture image." << std::endl;
         return;
     }
-    // Add alpha channel to night_texture in place
-    cv::cvtColor(night_texture, night_texture, cv::COLOR_BGR2BGRA);
+    // Add alpha channel to night_texture
+    cv::cvtColor(night_asset.get(), night_texture, cv::COLOR_BGR2BGRA);
 
     // Generate and bind a texture object
-    glGenTextures(1, &objects[SKYDOME].texture[0]);
+    objects[SKYDOME].texture[0] = ResourceRegistry::createTexture(RESOURCE_SKY);
     glBindTexture(GL_TEXTURE_2D, objects[SKYDOME].texture[0]);
     
     // Set texture parameters
@@ -548,11 +368,12 @@ void Renderer::initializeSkydome()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
-    // Upload the texture image data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, day_texture.cols, day_texture.rows, 0, GL_BGRA, GL_UNSIGNED_BYTE, day_texture.data);
+    // Upload the texture image data, block-compressed (the alpha channel is opaque)
+    size_t bytes = BlockCompressor::uploadImage(day_texture, BlockCompressor::getFileKey("./assets/textures/day.jpg"), false);
+    ResourceRegistry::setTextureSize(objects[SKYDOME].texture[0], bytes);
 
     // Generate and bind a texture object for the night texture
-    glGenTextures(1, &objects[SKYDOME].texture[1]);
+    objects[SKYDOME].texture[1] = ResourceRegistry::createTexture(RESOURCE_SKY);
     glBindTexture(GL_TEXTURE_2D, objects[SKYDOME].texture[1]);
     
     // Set texture parameters for the night texture (similar to day texture parameters)
@@ -561,83 +382,54 @@ void Renderer::initializeSkydome()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
-    // Upload the night texture image data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, night_texture.cols, night_texture.rows, 0, GL_BGRA, GL_UNSIGNED_BYTE, night_texture.data);
+    // Upload the night texture image data, block-compressed (the alpha channel is opaque)
+    bytes = BlockCompressor::uploadImage(night_texture, BlockCompressor::getFileKey("./assets/textures/night.jpg"), false);
+    ResourceRegistry::setTextureSize(objects[SKYDOME].texture[1], bytes);
 
-    // Assimp importer
-    Assimp::Importer importer;
-
-    // Load the .obj file
-    const aiScene *scene = importer.ReadFile("./assets/models/skydome.obj", aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
-    // Check if the scene was loaded successfully
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
-    {
-        std::cerr << "Error loading skydome model: " << importer.GetErrorString() << std::endl;
+    // Retrieve the skydome mesh
+    std::shared_ptr<const MeshAsset> mesh = mesh_asset.get();
+    if (!mesh)
         return;
-    }
 
-    // For each mesh in the scene
-    for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+    // Scale the vertices
+    objects[SKYDOME].vertices.resize(mesh->vertices.size());
+    for (unsigned int i = 0; i < mesh->vertices.size(); i++)
+        objects[SKYDOME].vertices[i] = mesh->vertices[i] * 4;
+    
+    // Swap the texture coordinates
+    objects[SKYDOME].textures.resize(mesh->textures.size());
+    for (unsigned int i = 0; i < mesh->textures.size(); i += 2)
     {
-        const aiMesh *mesh = scene->mMeshes[i];
-        
-        // For each vertexin the mesh
-        for (unsigned int j = 0; j < mesh->mNumVertices; ++j)
-        {
-            // Extract vertices
-            aiVector3D Vec = mesh->mVertices[j];
-            objects[SKYDOME].vertices.push_back(Vec.x*4);
-            objects[SKYDOME].vertices.push_back(Vec.y*4);
-            objects[SKYDOME].vertices.push_back(Vec.z*4);
-
-            // Extract texture coordinates
-            if (mesh->HasTextureCoords(0))
-            {
-                aiVector3D texCoord = mesh->mTextureCoords[0][j];
-                objects[SKYDOME].textures.push_back(texCoord.y);
-                objects[SKYDOME].textures.push_back(texCoord.x);
-            }
-        }
-
-        // For each face in the mesh
-        for (unsigned int j = 0; j < mesh->mNumFaces; ++j)
-        {
-            const aiFace &face = mesh->mFaces[j];
-
-            // Assume triangular faces
-            if (face.mNumIndices == 3)
-            {
-                objects[SKYDOME].indices.push_back(face.mIndices[0]);
-                objects[SKYDOME].indices.push_back(face.mIndices[1]);
-                objects[SKYDOME].indices.push_back(face.mIndices[2]);
-            }
-        }
+        objects[SKYDOME].textures[i] = mesh->textures[i + 1];
+        objects[SKYDOME].textures[i + 1] = mesh->textures[i];
     }
     
+    objects[SKYDOME].indices = mesh->indices;
+    
     // Generate the vertex array object for the skydome
-    glGenVertexArrays(1, &objects[SKYDOME].vao);
+    objects[SKYDOME].vao = ResourceRegistry::createVertexArray(RESOURCE_SKY);
     
     // Bind the vertex array object for the skydome
     glBindVertexArray(objects[SKYDOME].vao);
 
     // Generate the buffer objects
-    glGenBuffers(1, &objects[SKYDOME].vbo);
-    glGenBuffers(1, &objects[SKYDOME].tbo);
-    glGenBuffers(1, &objects[SKYDOME].ibo);
+    objects[SKYDOME].vbo = ResourceRegistry::createBuffer(RESOURCE_SKY);
+    objects[SKYDOME].tbo = ResourceRegistry::createBuffer(RESOURCE_SKY);
+    objects[SKYDOME].ibo = ResourceRegistry::createBuffer(RESOURCE_SKY);
 
     // Bind and fill the vertex buffer object
     glBindBuffer(GL_ARRAY_BUFFER, objects[SKYDOME].vbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[SKYDOME].vertices.size() * sizeof(float), objects[SKYDOME].vertices.data(), GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[SKYDOME].vbo, GL_ARRAY_BUFFER, objects[SKYDOME].vertices.size() * sizeof(float), objects[SKYDOME].vertices.data(), GL_STATIC_DRAW);
     glVertexPointer(3, GL_FLOAT, 0, 0);
     
     // Bind and fill the texture coordinate buffer object
     glBindBuffer(GL_ARRAY_BUFFER, objects[SKYDOME].tbo);
-    glBufferData(GL_ARRAY_BUFFER, objects[SKYDOME].textures.size() * sizeof(float), objects[SKYDOME].textures.data(), GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[SKYDOME].tbo, GL_ARRAY_BUFFER, objects[SKYDOME].textures.size() * sizeof(float), objects[SKYDOME].textures.data(), GL_STATIC_DRAW);
     glTexCoordPointer(2, GL_FLOAT, 0, 0);
     
     // Bind and fill the index buffer object
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, objects[SKYDOME].ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, objects[SKYDOME].indices.size() * sizeof(unsigned int), objects[SKYDOME].indices.data(), GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[SKYDOME].ibo, GL_ELEMENT_ARRAY_BUFFER, objects[SKYDOME].indices.size() * sizeof(unsigned int), objects[SKYDOME].indices.data(), GL_STATIC_DRAW);
 
     // Unbind everything
     glBindVertexArray(0);
@@ -647,21 +439,21 @@ void Renderer::initializeSkydome()
 
 void Renderer::initializeSplashscreen()
 {
-    // Load the splashscreen video and the first frame
+    // Load the splashscreen video and start decoding it right away
     instance->menu_clips[LANDING_SCREEN].open("./assets/menu/Splashscreen.mp4");
-    instance->menu_clips[LANDING_SCREEN].read(instance->menu_frame);
+    instance->menu_clips[LANDING_SCREEN].setPlaying(true);
 
     // Generate the vertex array object for the SPLASHSCREEN
-    glGenVertexArrays(1, &objects[SPLASHSCREEN].vao);
+    objects[SPLASHSCREEN].vao = ResourceRegistry::createVertexArray(RESOURCE_MENU);
     // Bind the vertex array object for the SPLASHSCREEN
     glBindVertexArray(objects[SPLASHSCREEN].vao);
     
     // Generate the vertex buffer objects
-    glGenBuffers(1, &objects[SPLASHSCREEN].vbo);
+    objects[SPLASHSCREEN].vbo = ResourceRegistry::createBuffer(RESOURCE_MENU);
     // Generate the texture buffer objects
-    glGenBuffers(1, &objects[SPLASHSCREEN].tbo);
+    objects[SPLASHSCREEN].tbo = ResourceRegistry::createBuffer(RESOURCE_MENU);
     // Generate the texture buffer objects
-    glGenBuffers(1, &objects[SPLASHSCREEN].cbo);
+    objects[SPLASHSCREEN].cbo = ResourceRegistry::createBuffer(RESOURCE_MENU);
 
     // Create vertexdata for the quad
     std::vector<GLfloat> vertices(8);
@@ -676,21 +468,21 @@ void Renderer::initializeSplashscreen()
     // Bind the vertex buffer object
     glBindBuffer(GL_ARRAY_BUFFER, objects[SPLASHSCREEN].vbo);
     // Copy data into the vertex buffer
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[SPLASHSCREEN].vbo, GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
     // Specify vertexpointer location
     glVertexPointer(2, GL_FLOAT, 0, 0);
 
     // Bind the color buffer object
     glBindBuffer(GL_ARRAY_BUFFER, objects[SPLASHSCREEN].cbo);
     // Copy data into the color buffer
-    glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[SPLASHSCREEN].cbo, GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
     // Specify color pointer location
     glColorPointer(4, GL_FLOAT, 0, 0);
 
     // Bind the texture buffer object
     glBindBuffer(GL_ARRAY_BUFFER, objects[SPLASHSCREEN].tbo);
     // Copy data into the texture buffer
-    glBufferData(GL_ARRAY_BUFFER, texture_coords.size() * sizeof(GLfloat), texture_coords.data(), GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[SPLASHSCREEN].tbo, GL_ARRAY_BUFFER, texture_coords.size() * sizeof(GLfloat), texture_coords.data(), GL_STATIC_DRAW);
     // Specify texture pointer location
     glTexCoordPointer(2, GL_FLOAT, 0, 0);
 
@@ -699,8 +491,6 @@ void Renderer::initializeSplashscreen()
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-
-    glGenTextures(1, &objects[SPLASHSCREEN].texture[0]);
 }
 
 void Renderer::initializeCanvas()
@@ -713,16 +503,16 @@ void Renderer::initializeCanvas()
     instance->menu_clips[LOADING_SCREEN].open("./assets/menu/Loadingscreen.mp4");
 
     // Generate the vertex array object for the canvas
-    glGenVertexArrays(1, &objects[CANVAS].vao);
+    objects[CANVAS].vao = ResourceRegistry::createVertexArray(RESOURCE_MENU);
     // Bind the vertex array object for the canvas
     glBindVertexArray(objects[CANVAS].vao);
 
     // Generate the vertex buffer objects
-    glGenBuffers(1, &objects[CANVAS].vbo);
+    objects[CANVAS].vbo = ResourceRegistry::createBuffer(RESOURCE_MENU);
     // Generate the texture buffer objects
-    glGenBuffers(1, &objects[CANVAS].tbo);
+    objects[CANVAS].tbo = ResourceRegistry::createBuffer(RESOURCE_MENU);
     // Generate the texture buffer objects
-    glGenBuffers(1, &objects[CANVAS].cbo);
+    objects[CANVAS].cbo = ResourceRegistry::createBuffer(RESOURCE_MENU);
 
     // Create vertexdata for the quad
     std::vector<GLfloat> vertices(8);
@@ -737,21 +527,21 @@ void Renderer::initializeCanvas()
     // Bind the vertex buffer object
     glBindBuffer(GL_ARRAY_BUFFER, objects[CANVAS].vbo);
     // Copy data into the vertex buffer
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[CANVAS].vbo, GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
     // Specify vertexpointer location
     glVertexPointer(2, GL_FLOAT, 0, 0);
 
     // Bind the color buffer object
     glBindBuffer(GL_ARRAY_BUFFER, objects[CANVAS].cbo);
     // Copy data into the color buffer
-    glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[CANVAS].cbo, GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
     // Specify color pointer location
     glColorPointer(4, GL_FLOAT, 0, 0);
 
     // Bind the texture buffer object
     glBindBuffer(GL_ARRAY_BUFFER, objects[CANVAS].tbo);
     // Copy data into the texture buffer
-    glBufferData(GL_ARRAY_BUFFER, texture_coords.size() * sizeof(GLfloat), texture_coords.data(), GL_STATIC_DRAW);
+    ResourceRegistry::bufferData(objects[CANVAS].tbo, GL_ARRAY_BUFFER, texture_coords.size() * sizeof(GLfloat), texture_coords.data(), GL_STATIC_DRAW);
     // Specify texture pointer location
     glTexCoordPointer(2, GL_FLOAT, 0, 0);
 
@@ -760,222 +550,254 @@ void Renderer::initializeCanvas()
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-
-    glGenTextures(1, &objects[CANVAS].texture[0]);
 }
 
-void Renderer::takeSnapshot()
+std::vector<float> Renderer::rasterizeSketches(int size)
 {
-    short current_canvas = current_menu_page - 1;
+    // Model input channels, in the order the model was trained with
+    const short channels[SKETCH_INPUT_CHANNELS] = {RIDGES, RIVERS, PEAKS, BASINS};
+    std::vector<float> tensor((size_t)size * size * SKETCH_INPUT_CHANNELS, 0.0f);
 
-    GLint previousViewport[4];
-    glGetIntegerv(GL_VIEWPORT, previousViewport); // Save the previous viewport dimensions [x, y, width, height]
-
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer); // Generate a framebuffer object
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); // Bind the framebuffer for configuration
-
-    // Generate a texture for color rendering
-    unsigned int textureColorbuffer;
-    glGenTextures(1, &textureColorbuffer); // Generate a texture
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer); // Bind the texture for configuration
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1920, 1080, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL); // Allocate texture memory
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Set texture filtering for minification
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Set texture filtering for magnification
-    glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
-
-    // Attach the texture to the currently bound framebuffer object
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
-
-    // Generate a renderbuffer for depth and stencil operations
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo); // Generate a renderbuffer
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo); // Bind the renderbuffer for configuration
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, 1920, 1080); // Allocate storage for the renderbuffer
-    glBindRenderbuffer(GL_RENDERBUFFER, 0); // Unbind the renderbuffer
-
-    // Attach the renderbuffer to the framebuffer's depth and stencil attachment point
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-    // Check if the framebuffer is complete and usable
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-
-    // Set up rendering parameters and draw
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); // Rebind the framebuffer for rendering
-    glClearColor(1, 1, 1, 1); // Set the clear color
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the color and depth buffers
-    glViewport(0, 0, 1920, 1080); // Set the viewport to match the framebuffer size
-    instance->drawSketch(current_canvas); // Render the sketch using the specified canvas
-    
-
-    // Define the snapshot matrix
-    cv::Mat snapshot(800, 800, CV_8UC3);
-    // Read the pixels from the framebuffer
-    glReadPixels(123, 140, 800, 800, GL_BGR, GL_UNSIGNED_BYTE, snapshot.data);
-    // Flip the image vertically
-    cv::flip(snapshot, snapshot, 0);
-    // Convert to grayscale
-    cv::cvtColor(snapshot, snapshot, cv::COLOR_BGR2GRAY);
-    // Convert any non-white pixel to black
-    cv::threshold(snapshot, snapshot, 254, 255, cv::THRESH_BINARY);
-    // Invert the image
-    cv::bitwise_not(snapshot, snapshot);
-    // Rescale to 450x450
-    cv::resize(snapshot, snapshot, cv::Size(450, 450), 0, 0, cv::INTER_AREA);
-    // Define filename string based on current menu page
-    std::string filename;
-    switch (current_menu_page)
+    for (int i = 0; i < SKETCH_INPUT_CHANNELS; i++)
     {
-    case RIDGES_SCREEN:
-        filename = "./assets/sketches/ridges.png";
-        break;
-    case PEAKS_SCREEN:
-        filename = "./assets/sketches/peaks.png";
-        break;
-    case RIVERS_SCREEN:
-        filename = "./assets/sketches/rivers.png";
-        break;
-    case BASINS_SCREEN:
-        filename = "./assets/sketches/basins.png";
-        break;
+        const Object &sketch = objects[SKETCH + channels[i]];
+        SketchRasterizer::rasterize(sketch.vertices, sketch.indices, channels[i] == RIDGES || channels[i] == RIVERS, tensor, i, size);
     }
-    // Save the image as a file
-    cv::imwrite(filename, snapshot);
 
-    // Restore the previous viewport
-    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    // The full generation supersedes the preview, stop it so that they don't share the cores
+    this->sketch_preview.clear();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return tensor;
 }
 
-void Renderer::cycleDayNight()
+void Renderer::previewSketches()
+{
+    // Same channels as rasterizeSketches, the strokes are copied for the preview thread
+    const short channels[SKETCH_INPUT_CHANNELS] = {RIDGES, RIVERS, PEAKS, BASINS};
+    std::vector<PreviewLayer> layers(SKETCH_INPUT_CHANNELS);
+
+    for (int i = 0; i < SKETCH_INPUT_CHANNELS; i++)
+    {
+        const Object &sketch = objects[SKETCH + channels[i]];
+        layers[i].vertices = sketch.vertices;
+        layers[i].indices = sketch.indices;
+        layers[i].is_line = channels[i] == RIDGES || channels[i] == RIVERS;
+    }
+
+    this->sketch_preview.submit(layers);
+}
+
+void Renderer::cycleDayNight(float step)
 {
     // Cycle the day/night cycle using the time variable which sets the rotation for the orbit and the alpha value for the night texture
-    this->time += 0.005f * TIME_SPEED;
-    if (this->time > 24.f)
-        this->time -= 24.0f;
+    this->day_time += 0.2f * TIME_SPEED * step;
+    if (this->day_time > 24.f)
+        this->day_time -= 24.0f;
 }
 
 void Renderer::setTime(int time)
 {
-    this->time = time % 24;
+    this->day_time = time % 24;
+    this->previous_day_time = this->day_time;
+    this->time = this->day_time;
+}
+
+void Renderer::update(float step)
+{
+    // Keep the state of the previous step to interpolate the frames in between
+    this->previous_day_time = this->day_time;
+    this->previous_wave_time = this->wave_time;
+    this->previous_vegetation_time = this->vegetation_time;
+    
+    this->animateMenu();
+    this->cycleDayNight(step);
+    
+    // Advance the water waves and the wind blowing on the vegetation
+    this->wave_time += 1.2f * step;
+    this->vegetation_time += 2.4f * step;
+}
+
+void Renderer::setInterpolation(float interpolation)
+{
+    this->interpolation = interpolation;
+}
+
+void Renderer::renderFrame()
+{
+    Renderer::draw();
 }
 
 void Renderer::sketch(float x, float y)
 {
-    // current page is used as index for the sketch vertices, colors and indices arrays and "-1" removes the case of the landing screen
+    // current page is used as index for the sketch vertices and indices arrays and "-1" removes the case of the landing screen
     short current_canvas = current_menu_page - 1;
+    Object &layer = objects[SKETCH + current_canvas];
+    SketchLayer &state = sketch_layers[current_canvas];
+    bool is_stroke_open = !layer.indices.empty() && layer.indices.back() != 0xFFFFFFFFu;
+
+    // The stroke has ended: keep its last point even if it was decimated and restart the strip
+    if (x == 0xFFFFFFFFu)
+    {
+        if (state.has_pending)
+            addSketchVertex(current_canvas, state.pending_x, state.pending_y);
+        if (is_stroke_open || state.has_pending)
+            layer.indices.emplace_back(0xFFFFFFFFu);
+        state.has_pending = false;
+        return;
+    }
 
+    if (current_canvas == RIDGES || current_canvas == RIVERS)
+    {
+        // Drop the points closer than SKETCH_MIN_DISTANCE pixels to the last kept point of the stroke
+        if (is_stroke_open)
+        {
+            GLuint last = layer.indices.back();
+            float dx = (x - layer.vertices[last * 3]) * SKETCH_FRAME_WIDTH;
+            float dy = (y - layer.vertices[last * 3 + 1]) * SKETCH_FRAME_HEIGHT;
+            if (dx * dx + dy * dy < SKETCH_MIN_DISTANCE * SKETCH_MIN_DISTANCE)
+            {
+                state.has_pending = true;
+                state.pending_x = x;
+                state.pending_y = y;
+                return;
+            }
+        }
+        state.has_pending = false;
+    }
+    else
+    {
+        // Drop the points falling into a cell of the canvas which already holds one
+        const int cells = SKETCH_AREA_SIZE / SKETCH_MIN_DISTANCE + 1;
+        int col = (int)std::floor((x * SKETCH_FRAME_WIDTH - SKETCH_AREA_X) / SKETCH_MIN_DISTANCE);
+        int row = (int)std::floor((y * SKETCH_FRAME_HEIGHT - SKETCH_AREA_Y) / SKETCH_MIN_DISTANCE);
+        if (col >= 0 && row >= 0 && col < cells && row < cells)
+        {
+            if (state.occupied[row * cells + col])
+                return;
+            state.occupied[row * cells + col] = true;
+        }
+    }
+
+    addSketchVertex(current_canvas, x, y);
+}
+
+void Renderer::addSketchVertex(short current_canvas, float x, float y)
+{
     objects[SKETCH + current_canvas].vertices.emplace_back(x);
     objects[SKETCH + current_canvas].vertices.emplace_back(y);
     // The sketch must be drawn together with the canvas; to ensure
     // that the depth buffer is updated correctly, the sketch is drawn with a non 0 z-coordinate
     objects[SKETCH + current_canvas].vertices.emplace_back(0.5);
 
-    // If the current canvas is 0, set color to dark green, if 1 set color to brown, if 2 set color to light blue, if 3 set color dark blue
-    if (current_canvas == RIDGES)
+    objects[SKETCH + current_canvas].indices.emplace_back(objects[SKETCH + current_canvas].vertices.size() / 3 - 1);
+}
+
+void Renderer::resetSketches()
+{
+    // Clear sketch buffers, the GPU buffers keep their capacity
+    for (short current_canvas = 0; current_canvas < 4; current_canvas++)
     {
-        objects[SKETCH + current_canvas].colors.emplace_back(0);
-        objects[SKETCH + current_canvas].colors.emplace_back(0.5);
-        objects[SKETCH + current_canvas].colors.emplace_back(0);
+        objects[SKETCH + current_canvas].vertices.clear();
+        objects[SKETCH + current_canvas].indices.clear();
+
+        sketch_layers[current_canvas].uploaded_vertices = 0;
+        sketch_layers[current_canvas].uploaded_indices = 0;
+        sketch_layers[current_canvas].has_pending = false;
+        std::fill(sketch_layers[current_canvas].occupied.begin(), sketch_layers[current_canvas].occupied.end(), false);
     }
-    else if (current_canvas == PEAKS)
+
+    this->sketch_preview.clear();
+}
+
+void Renderer::initializeSketches()
+{
+    const int cells = SKETCH_AREA_SIZE / SKETCH_MIN_DISTANCE + 1;
+
+    for (short current_canvas = 0; current_canvas < 4; current_canvas++)
     {
-        objects[SKETCH + current_canvas].colors.emplace_back(0.5);
-        objects[SKETCH + current_canvas].colors.emplace_back(0.25);
-        objects[SKETCH + current_canvas].colors.emplace_back(0);
+        Object &layer = objects[SKETCH + current_canvas];
+        SketchLayer &state = sketch_layers[current_canvas];
+
+        // Generate the vertex array object and the buffers of the layer
+        layer.vao = ResourceRegistry::createVertexArray(RESOURCE_SKETCH);
+        glBindVertexArray(layer.vao);
+
+        state.vertex_capacity = SKETCH_BUFFER_VERTICES;
+        layer.vbo = ResourceRegistry::createBuffer(RESOURCE_SKETCH);
+        glBindBuffer(GL_ARRAY_BUFFER, layer.vbo);
+        ResourceRegistry::bufferData(layer.vbo, GL_ARRAY_BUFFER, state.vertex_capacity * 3 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+
+        state.index_capacity = SKETCH_BUFFER_VERTICES;
+        layer.ibo = ResourceRegistry::createBuffer(RESOURCE_SKETCH);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, layer.ibo);
+        ResourceRegistry::bufferData(layer.ibo, GL_ELEMENT_ARRAY_BUFFER, state.index_capacity * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        state.uploaded_vertices = 0;
+        state.uploaded_indices = 0;
+        state.has_pending = false;
+        state.occupied.assign(cells * cells, false);
     }
-    else if (current_canvas == RIVERS)
+}
+
+void Renderer::updateSketchBuffers(short current_canvas)
+{
+    Object &layer = objects[SKETCH + current_canvas];
+    SketchLayer &state = sketch_layers[current_canvas];
+    size_t vertex_count = layer.vertices.size() / 3;
+    size_t index_count = layer.indices.size();
+
+    // Double the capacity when the layer outgrows its buffers, the whole layer is uploaded again
+    if (vertex_count > state.vertex_capacity)
     {
-        objects[SKETCH + current_canvas].colors.emplace_back(0.3);
-        objects[SKETCH + current_canvas].colors.emplace_back(0.5);
-        objects[SKETCH + current_canvas].colors.emplace_back(0.8);
+        while (state.vertex_capacity < vertex_count)
+            state.vertex_capacity *= 2;
+        ResourceRegistry::bufferData(layer.vbo, GL_ARRAY_BUFFER, state.vertex_capacity * 3 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+        state.uploaded_vertices = 0;
     }
-    else if (current_canvas == BASINS)
+    if (index_count > state.index_capacity)
     {
-        objects[SKETCH + current_canvas].colors.emplace_back(0);
-        objects[SKETCH + current_canvas].colors.emplace_back(0);
-        objects[SKETCH + current_canvas].colors.emplace_back(0.7);
+        while (state.index_capacity < index_count)
+            state.index_capacity *= 2;
+        ResourceRegistry::bufferData(layer.ibo, GL_ELEMENT_ARRAY_BUFFER, state.index_capacity * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+        state.uploaded_indices = 0;
     }
-    
-    if (x != 0xFFFFFFFFu)
-        objects[SKETCH + current_canvas].indices.emplace_back(objects[SKETCH + current_canvas].vertices.size() / 3 - 1);
-    else
-        objects[SKETCH + current_canvas].indices.emplace_back(0xFFFFFFFFu);
-}
 
-void Renderer::resetSketches()
-{
-    // Clear sketch buffers
-    for (short current_canvas = 0; current_canvas < 4; current_canvas++)
+    // Append the vertices and indices added since the last frame
+    if (vertex_count > state.uploaded_vertices)
     {
-        objects[SKETCH + current_canvas].vertices.clear();
-        objects[SKETCH + current_canvas].colors.clear();
-        objects[SKETCH + current_canvas].indices.clear();
+        glBufferSubData(GL_ARRAY_BUFFER, state.uploaded_vertices * 3 * sizeof(GLfloat), (vertex_count - state.uploaded_vertices) * 3 * sizeof(GLfloat), &layer.vertices[state.uploaded_vertices * 3]);
+        Profiler::countUpload((vertex_count - state.uploaded_vertices) * 3 * sizeof(GLfloat));
+        state.uploaded_vertices = vertex_count;
+    }
+    if (index_count > state.uploaded_indices)
+    {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, state.uploaded_indices * sizeof(GLuint), (index_count - state.uploaded_indices) * sizeof(GLuint), &layer.indices[state.uploaded_indices]);
+        Profiler::countUpload((index_count - state.uploaded_indices) * sizeof(GLuint));
+        state.uploaded_indices = index_count;
     }
 }
 
 void Renderer::animateMenu()
 {
-    switch (instance->current_menu_page)
+    // Decode the clip of the current page and prefetch the one of the next page, pause the others
+    short next_menu_page = instance->current_menu_page == RENDERING_SCREEN ? LANDING_SCREEN : instance->current_menu_page + 1;
+    for (short page = LANDING_SCREEN; page <= LOADING_SCREEN; page++)
+        instance->menu_clips[page].setPlaying(page == instance->current_menu_page || page == next_menu_page);
+    
+    // Restart the clips which are shown again at every loop
+    if (instance->current_menu_page == RENDERING_SCREEN && instance->menu_clips[LOADING_SCREEN].hasFrame())
     {
-    case LANDING_SCREEN:
-        if (!instance->menu_clips[LANDING_SCREEN].read(instance->menu_frame))
-        {
-            instance->menu_clips[LANDING_SCREEN].set(cv::CAP_PROP_POS_FRAMES, 0);
-            instance->menu_clips[LANDING_SCREEN].read(instance->menu_frame);
-        }
-        break;
-    case RIDGES_SCREEN:
-        if (!instance->menu_clips[RIDGES_SCREEN].read(instance->menu_frame))
-        {
-            instance->menu_clips[RIDGES_SCREEN].set(cv::CAP_PROP_POS_FRAMES, 0);
-            instance->menu_clips[RIDGES_SCREEN].read(instance->menu_frame);
-        }
-        break;
-    case PEAKS_SCREEN:
-        if (!instance->menu_clips[PEAKS_SCREEN].read(instance->menu_frame))
-        {
-            instance->menu_clips[PEAKS_SCREEN].set(cv::CAP_PROP_POS_FRAMES, 0);
-            instance->menu_clips[PEAKS_SCREEN].read(instance->menu_frame);
-        }
-        break;
-    case RIVERS_SCREEN:
-        if (!instance->menu_clips[RIVERS_SCREEN].read(instance->menu_frame))
-        {
-            instance->menu_clips[RIVERS_SCREEN].set(cv::CAP_PROP_POS_FRAMES, 0);
-            instance->menu_clips[RIVERS_SCREEN].read(instance->menu_frame);
-        }
-        break;
-    case BASINS_SCREEN:
-        if (!instance->menu_clips[BASINS_SCREEN].read(instance->menu_frame))
-        {
-            instance->menu_clips[BASINS_SCREEN].set(cv::CAP_PROP_POS_FRAMES, 0);
-            instance->menu_clips[BASINS_SCREEN].read(instance->menu_frame);
-        }
-        break;
-    case LOADING_SCREEN:
-        if (!instance->menu_clips[LOADING_SCREEN].read(instance->menu_frame))
-        {
-            instance->menu_clips[LOADING_SCREEN].set(cv::CAP_PROP_POS_FRAMES, 0);
-            instance->menu_clips[LOADING_SCREEN].read(instance->menu_frame);
-        }
-        break;
-    default:
-        instance->menu_clips[LOADING_SCREEN].set(cv::CAP_PROP_POS_FRAMES, 0);
-        instance->menu_clips[LANDING_SCREEN].set(cv::CAP_PROP_POS_FRAMES, 0);
-        instance->menu_frame.release();
-        break;
+        instance->menu_clips[LOADING_SCREEN].rewind();
+        instance->menu_clips[LANDING_SCREEN].rewind();
     }
 }
 
-void Renderer::timerCallback(int value)
+bool Renderer::hasMenuFrame()
 {
-    instance->animateMenu();
-    instance->cycleDayNight();
-    glutPostRedisplay();
-    glutTimerFunc(25, Renderer::timerCallback, 0);
+    return instance->current_menu_page != RENDERING_SCREEN && instance->menu_clips[instance->current_menu_page].hasFrame();
 }
 
 void Renderer::drawTerrain()
@@ -992,7 +814,8 @@ void Renderer::drawTerrain()
         glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse_material);
     }
     
-    float ambient_light = (1 - std::abs(static_cast<float>(instance->time) / 24.f - 0.5f))*0.25f;
+    GLfloat light_position[4], light_color[4], ambient_light;
+    getLight(light_position, light_color, ambient_light);
     GLfloat ambient_material[] = {ambient_light, ambient_light, ambient_light, 1.0f};
     glMaterialfv(GL_FRONT, GL_AMBIENT, ambient_material);
     
@@ -1004,36 +827,12 @@ void Renderer::drawTerrain()
     instance->quadtree->render(position, direction);
 }
 
-void Renderer::drawWater()
+void Renderer::animateWater(const Object &water, const siv::PerlinNoise &perlin_noise, float time, std::vector<float> &vertices, std::vector<float> &normals)
 {
-    static float time = 0;
-    glEnable(GL_BLEND);
-    
-    // Bind the water texture
-    glBindTexture(GL_TEXTURE_2D, instance->objects[WATER].texture[0]);
-    
-    // Bind the water VAO
-    glBindVertexArray(instance->objects[WATER].vao);
+    // Start from the rest positions
+    vertices = water.vertices;
     
-    // Enable two vertex arrays: co-ordinates and color.
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-    glEnableClientState(GL_NORMAL_ARRAY);
-    
-    // Bind the texture buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, instance->objects[WATER].tbo);
-    // Update textures coordinates
-    for (unsigned int i = 0; i < instance->objects[WATER].textures.size(); i += 2)
-    {
-        instance->objects[WATER].textures[i] += 0.01f;
-        instance->objects[WATER].textures[i + 1] += 0.01f;
-    }
-    glBufferData(GL_ARRAY_BUFFER, instance->objects[WATER].textures.size() * sizeof(float), instance->objects[WATER].textures.data(), GL_STREAM_DRAW);
-    
-    // Bind the vertex buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, instance->objects[WATER].vbo);
     // Perlin noise parameters for macro waves
-    vector<float> vertices = instance->objects[WATER].vertices;
     float macro_amplitude = WAVE_MACRO_AMPLITUDE; // Adjust the amplitude to control the wave height
     float macro_frequency = 0.0005f; // Adjust the frequency to control the wave speed
     // Micro wave parameters for sin and cos
@@ -1041,34 +840,29 @@ void Renderer::drawWater()
     float micro_frequency_x = 0.01f; // Adjust the frequency of micro waves in X direction
     float micro_frequency_z = 0.01f; // Adjust the frequency of micro waves in Z direction
     
-    for (unsigned int i = 0; i < instance->objects[WATER].vertices.size(); i += 3)
+    for (unsigned int i = 0; i < water.vertices.size(); i += 3)
     {
-        float x = instance->objects[WATER].vertices[i];
-        float z = instance->objects[WATER].vertices[i + 2];
-        float macro_wave = macro_amplitude * instance->perlin_noise.noise3D_01(x * macro_frequency, z * macro_frequency, time);
+        float x = water.vertices[i];
+        float z = water.vertices[i + 2];
+        float macro_wave = macro_amplitude * perlin_noise.noise3D_01(x * macro_frequency, z * macro_frequency, time);
         float micro_wave_x = micro_amplitude * sin(x * micro_frequency_x + time);
         float micro_wave_z = micro_amplitude * cos(z * micro_frequency_z + time);
 
         // Combine perlin noise and micro waves
         vertices[i + 1] += macro_wave + micro_wave_x + micro_wave_z;
     }
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
-    
-    time += 0.02f;
     
-    // Bind the normal buffer object
-    glBindBuffer(GL_ARRAY_BUFFER, instance->objects[WATER].nbo);
     // Calculate updated normals for every triangle 
-    std::vector<float> normals = instance->objects[WATER].normals;
-    for (int i = 0; i < instance->objects[WATER].indices.size() - 3; i += 2)
+    normals.assign(water.normals.size(), 0.0f);
+    for (int i = 0; i < water.indices.size() - 3; i += 2)
     {
-        if (instance->objects[WATER].indices[i + 1] == 0xFFFFFFFFu)
+        if (water.indices[i + 1] == 0xFFFFFFFFu)
             continue;
 
         // Get the indices of the triangle
-        int i1 = instance->objects[WATER].indices[i];
-        int i2 = instance->objects[WATER].indices[i + 1];
-        int i3 = instance->objects[WATER].indices[i + 2];
+        int i1 = water.indices[i];
+        int i2 = water.indices[i + 1];
+        int i3 = water.indices[i + 2];
 
         // Get the vertices of the triangle into Vec3 objects
         Vec3<float> v1;
@@ -1102,8 +896,44 @@ void Renderer::drawWater()
         normals[i3 * 3 + 1] += normal.y;
         normals[i3 * 3 + 2] += normal.z;
     }
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_STREAM_DRAW);
+}
+
+void Renderer::drawWater()
+{
+    Profiler::begin(PASS_WATER_WAVES);
+    float time = instance->previous_wave_time + (instance->wave_time - instance->previous_wave_time) * instance->interpolation;
+    glEnable(GL_BLEND);
+    
+    // Bind the water texture
+    glBindTexture(GL_TEXTURE_2D, instance->objects[WATER].texture[0]);
+    
+    // Bind the water VAO
+    glBindVertexArray(instance->objects[WATER].vao);
+    
+    // Enable two vertex arrays: co-ordinates and color.
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    
+    // Scroll the water texture with the texture matrix instead of rewriting the texture coordinates
+    float texture_offset = time * 0.5f;
+    
+    // Displace the vertices and update the normals
+    static std::vector<float> vertices;
+    static std::vector<float> normals;
+    animateWater(instance->objects[WATER], instance->perlin_noise, time, vertices, normals);
+    
+    // Stream the displaced vertices
+    GLintptr vertices_offset = instance->stream_buffer.upload(GL_ARRAY_BUFFER, vertices.data(), vertices.size() * sizeof(float));
+    glVertexPointer(3, GL_FLOAT, 0, (void *)vertices_offset);
     
+    // Stream the normals
+    GLintptr normals_offset = instance->stream_buffer.upload(GL_ARRAY_BUFFER, normals.data(), normals.size() * sizeof(float));
+    glNormalPointer(GL_FLOAT, 0, (void *)normals_offset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    Profiler::end(PASS_WATER_WAVES);
+    
+    Profiler::begin(PASS_WATER_STENCIL);
     // Disable writing of the frame and depth buffers as only the 
     // stencil buffer need be written next.
     glEnable(GL_STENCIL_TEST); // Enable stencil testing
@@ -1118,6 +948,7 @@ void Renderer::drawWater()
     
     glEnable(GL_PRIMITIVE_RESTART);                                                       
     glDrawElements(GL_TRIANGLE_STRIP, instance->objects[WATER].indices.size(), GL_UNSIGNED_INT, 0);
+    Profiler::countDrawCall();
     glDisable(GL_PRIMITIVE_RESTART);
     
     // Enable writing of the frame and depth buffers - actually drawing now begins.
@@ -1125,7 +956,9 @@ void Renderer::drawWater()
     
     glStencilFunc(GL_EQUAL, 1, 1); // The stencil test passes only if the corresponding stencil buffer tag is 1.
     glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP); // The stencil buffer itself is not updated.	
+    Profiler::end(PASS_WATER_STENCIL);
     
+    Profiler::begin(PASS_WATER_REFLECTION);
     glPushMatrix();
         glDisable(GL_LIGHTING);
         glScalef(1.0, -1.0, 1.0);
@@ -1137,6 +970,7 @@ void Renderer::drawWater()
         // Draw the skydome with blending enabled
         glBindTexture(GL_TEXTURE_2D, instance->objects[SKYDOME].texture[0]);
         glDrawElements(GL_TRIANGLES, instance->objects[SKYDOME].indices.size(), GL_UNSIGNED_INT, 0);
+        Profiler::countDrawCall();
         
         // Calculate the alpha value for the night texture
         float normalized_time = static_cast<float>(instance->time) / 24.0f;
@@ -1166,6 +1000,7 @@ void Renderer::drawWater()
         // Draw the skydome with blending enabled
         glBindTexture(GL_TEXTURE_2D, instance->objects[SKYDOME].texture[1]);
         glDrawElements(GL_TRIANGLES, instance->objects[SKYDOME].indices.size(), GL_UNSIGNED_INT, 0);
+        Profiler::countDrawCall();
         
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -1184,7 +1019,7 @@ void Renderer::drawWater()
         // Change front face to clockwise
         glFrontFace(GL_CW);
         glEnable(GL_CLIP_PLANE0);
-        double surface_level = instance->terrain->getWaterLevel() + macro_amplitude + micro_amplitude*2;
+        double surface_level = instance->terrain->getWaterLevel() + WAVE_MACRO_AMPLITUDE + WAVE_MICRO_AMPLITUDE*2;
         double equation[4] = { 0.0, -1.0, 0.0, surface_level};
         glClipPlane(GL_CLIP_PLANE0, equation);
         glTranslatef(0.0, 2*surface_level, 0.0);
@@ -1197,17 +1032,30 @@ void Renderer::drawWater()
     
     
     glDisable(GL_STENCIL_TEST); // Disable the stencil test
+    Profiler::end(PASS_WATER_REFLECTION);
     
+    Profiler::begin(PASS_WATER_SURFACE);
     // Bind the water texture
     glBindTexture(GL_TEXTURE_2D, instance->objects[WATER].texture[0]);
 
     // Bind the water VAO
     glBindVertexArray(instance->objects[WATER].vao);
     
+    // Scroll the texture coordinates
+    glMatrixMode(GL_TEXTURE);
+    glPushMatrix();
+    glTranslatef(texture_offset, texture_offset, 0.0f);
+    glMatrixMode(GL_MODELVIEW);
+    
     glEnable(GL_PRIMITIVE_RESTART);                                                                 // Enable primitive restart
     glDrawElements(GL_TRIANGLE_STRIP, instance->objects[WATER].indices.size(), GL_UNSIGNED_INT, 0); // Draw the triangles
+    Profiler::countDrawCall();
     glDisable(GL_PRIMITIVE_RESTART);
     
+    glMatrixMode(GL_TEXTURE);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
     glDisableClientState(GL_NORMAL_ARRAY);
@@ -1216,71 +1064,41 @@ void Renderer::drawWater()
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
     glDisable(GL_BLEND);
-
+    Profiler::end(PASS_WATER_SURFACE);
 }
 
 void Renderer::drawVegetation()
 {
-    static float time = 0;
+    if (!instance->has_vegetation)
+        return;
+
+    float time = instance->previous_vegetation_time + (instance->vegetation_time - instance->previous_vegetation_time) * instance->interpolation;
     // Enable blending
     glEnable(GL_BLEND);
     
     // Bind the vegetation texture
     glBindTexture(GL_TEXTURE_2D, instance->objects[VEGETATION].texture[0]);
     
-    // Bind the vegetation VAO
-    glBindVertexArray(instance->objects[VEGETATION].vao);
+    // Bind the vegetation program and update the wind time
+    instance->vegetation_shader.use();
+    glUniform1i(instance->vegetation_shader.getUniform("atlas"), 0);
+    glUniform1f(instance->vegetation_shader.getUniform("time"), time);
     
-    // Enable two vertex arrays: coordinates and texture coordinates.
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-    
-    vector<float> vertices = instance->objects[VEGETATION].vertices;
+    // Light the bushes with the same sun/moon and ambient light as the fixed function terrain
+    GLfloat light_position[4], light_color[4], ambient_light;
+    getLight(light_position, light_color, ambient_light);
+    glUniform3fv(instance->vegetation_shader.getUniform("light_position"), 1, light_position);
+    glUniform3fv(instance->vegetation_shader.getUniform("light_color"), 1, light_color);
+    glUniform1f(instance->vegetation_shader.getUniform("ambient_light"), ambient_light);
     
-    // Update the vertices such that the vegetation is always facing the camera
+    // Stream in the chunks around the camera and draw the visible ones
+    Vec2<float> position = instance->camera->getPosition2D();
     Vec2<float> direction = instance->camera->getDirection2D();
-    float radians = atan2(direction.v, direction.u);
-    float degrees = abs(fmod(radians * (180.0f / M_PI) + 270.0f, 360.0f) - 180.0f) / 180.0f;
-    
-    for (unsigned int i = 0; i < instance->objects[VEGETATION].vertices.size(); i += 12)
-    {
-        vertices[i] -= degrees * BUSH_SIZE * 2;                 // x1
-        vertices[i + 2] += direction.u * BUSH_SIZE;             // z1
-        vertices[i + 3] -= degrees * BUSH_SIZE * 2;             // x2
-        vertices[i + 5] += direction.u * BUSH_SIZE;             // z2
-        
-        vertices[i + 6] += degrees * BUSH_SIZE * 2;             // x3
-        vertices[i + 8] -= direction.u * BUSH_SIZE;             // z3
-        vertices[i + 9] += degrees * BUSH_SIZE * 2;             // x4
-        vertices[i + 11] -= direction.u * BUSH_SIZE;            // z4
-    }
+    instance->vegetation.update(position);
+    instance->vegetation.draw(position, direction);
     
-    // Bind the VBO and modify the vertices such that the vegetation is always facing the camera
-    glBindBuffer(GL_ARRAY_BUFFER, instance->objects[VEGETATION].vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
-    
-    vector<float> textures = instance->objects[VEGETATION].textures;
-    // Cycle over each texture quad
-    for (unsigned int i = 0; i < instance->objects[VEGETATION].textures.size(); i += 8)
-    {
-        textures[i + 2] += 0.05f * sin(time);
-        textures[i + 4] += 0.05f * sin(time);
-    }
-    
-    time+=0.04f;
-    
-    //Bind the TBO and modify the texture coordinates
-    glBindBuffer(GL_ARRAY_BUFFER, instance->objects[VEGETATION].tbo);
-    glBufferData(GL_ARRAY_BUFFER, textures.size() * sizeof(float), textures.data(), GL_STREAM_DRAW);
-    
-    // Draw quads with glDrawArrays
-    glDrawArrays(GL_QUADS, 0, vertices.size() / 3);
-    
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-    
-    // Unbind the vertex array object and texture
-    glBindVertexArray(0);
+    // Unbind the program and texture
+    Shader::unuse();
     glBindTexture(GL_TEXTURE_2D, 0);
     
     glDisable(GL_BLEND);
@@ -1295,6 +1113,7 @@ void Renderer::drawOrbit()
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
         glRotatef(angle, 0, 0, 1);
+        glTranslatef(0, -instance->orbit_height * 2, 0);
         
         // Bind the sun texture
         glBindTexture(GL_TEXTURE_2D, instance->objects[SUN].texture[0]);
@@ -1307,6 +1126,7 @@ void Renderer::drawOrbit()
         glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
         glDrawElements(GL_TRIANGLE_STRIP, instance->objects[SUN].indices.size(), GL_UNSIGNED_INT, 0); // Draw the triangles
+        Profiler::countDrawCall();
         
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -1321,6 +1141,7 @@ void Renderer::drawOrbit()
     glPushMatrix();
         
         glRotatef(angle, 0, 0, 1);
+        glTranslatef(0, instance->orbit_height * 2, 0);
 
         // Bind the sun texture
         glBindTexture(GL_TEXTURE_2D, instance->objects[MOON].texture[0]);
@@ -1333,6 +1154,7 @@ void Renderer::drawOrbit()
         glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
         glDrawElements(GL_TRIANGLE_STRIP, instance->objects[MOON].indices.size(), GL_UNSIGNED_INT, 0); // Draw the triangles
+        Profiler::countDrawCall();
         
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -1362,6 +1184,7 @@ void Renderer::drawSkydome()
     // Draw the skydome with blending enabled
     glBindTexture(GL_TEXTURE_2D, instance->objects[SKYDOME].texture[0]);
     glDrawElements(GL_TRIANGLES, instance->objects[SKYDOME].indices.size(), GL_UNSIGNED_INT, 0);
+    Profiler::countDrawCall();
     
     // Calculate the alpha value for the night texture
     float normalized_time = static_cast<float>(instance->time) / 24.0f;
@@ -1391,6 +1214,7 @@ void Renderer::drawSkydome()
     
     glBindTexture(GL_TEXTURE_2D, instance->objects[SKYDOME].texture[1]);
     glDrawElements(GL_TRIANGLES, instance->objects[SKYDOME].indices.size(), GL_UNSIGNED_INT, 0);
+    Profiler::countDrawCall();
     
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -1408,30 +1232,26 @@ void Renderer::drawSkydome()
 
 void Renderer::drawSplashscreen()
 {
-    if (!instance->menu_frame.empty())
+    // Upload the next frame of the clip if it is due
+    instance->menu_clips[LANDING_SCREEN].update();
+    
+    if (instance->hasMenuFrame())
     {
         // Save the previous projection matrix
         glMatrixMode(GL_PROJECTION);
         glPushMatrix();
         
         // Set the projection matrix to orthographic
-        float width = glutGet(GLUT_WINDOW_WIDTH);
-        float height = glutGet(GLUT_WINDOW_HEIGHT);
+        float width = GlutFramework::getWidth();
+        float height = GlutFramework::getHeight();
         glLoadIdentity();
         glOrtho(0, width, 0, height, -1, 1);
 
-        // Update texture data
-        glBindTexture(GL_TEXTURE_2D, instance->objects[SPLASHSCREEN].texture[0]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, instance->menu_frame.cols, instance->menu_frame.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, instance->menu_frame.data);
+        // Bind the texture holding the current frame of the clip
+        glBindTexture(GL_TEXTURE_2D, instance->menu_clips[LANDING_SCREEN].getTexture());
 
         // Update width and height values in a single line
-        std::vector<GLfloat> vertices = {0, 0, width, 0, width, height, 0, height};
-        // Bind the vertex buffer object
-        glBindBuffer(GL_ARRAY_BUFFER, instance->objects[SPLASHSCREEN].vbo);
-        // Update the vertex buffer data
-        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(GLfloat), vertices.data());
+        GLfloat vertices[] = {0, 0, width, 0, width, height, 0, height};
 
         // Enable the vertex arrays
         glEnableClientState(GL_VERTEX_ARRAY);
@@ -1440,8 +1260,15 @@ void Renderer::drawSplashscreen()
 
         // Render the splash screen
         glBindVertexArray(instance->objects[SPLASHSCREEN].vao);
+        
+        // Stream the quad vertices
+        GLintptr offset = instance->stream_buffer.upload(GL_ARRAY_BUFFER, vertices, sizeof(vertices));
+        glVertexPointer(2, GL_FLOAT, 0, (void *)offset);
+        
         glDrawArrays(GL_QUADS, 0, 4);
+        Profiler::countDrawCall();
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -1457,7 +1284,10 @@ void Renderer::drawSplashscreen()
 
 void Renderer::drawCanvas()
 {
-    if (!instance->menu_frame.empty())
+    // Upload the next frame of the clip if it is due
+    instance->menu_clips[instance->current_menu_page].update();
+    
+    if (instance->hasMenuFrame())
     {
         // Reset the modelview matrix
         glMatrixMode(GL_MODELVIEW);
@@ -1468,19 +1298,16 @@ void Renderer::drawCanvas()
         glPushMatrix();
 
         // Set the projection matrix to orthographic
-        float width = glutGet(GLUT_WINDOW_WIDTH);
-        float height = glutGet(GLUT_WINDOW_HEIGHT);
+        float width = GlutFramework::getWidth();
+        float height = GlutFramework::getHeight();
         glLoadIdentity();
         glOrtho(0, width, 0, height, -1, 1);
 
-        // Update texture dataz
-        glBindTexture(GL_TEXTURE_2D, instance->objects[CANVAS].texture[0]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, instance->menu_frame.cols, instance->menu_frame.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, instance->menu_frame.data);
+        // Bind the texture holding the current frame of the clip
+        glBindTexture(GL_TEXTURE_2D, instance->menu_clips[instance->current_menu_page].getTexture());
 
         // Update width and height values in a single line
-        std::vector<GLfloat> vertices = {0, 0, width, 0, width, height, 0, height};
+        GLfloat vertices[] = {0, 0, width, 0, width, height, 0, height};
 
         // Enable the vertex arrays
         glEnableClientState(GL_VERTEX_ARRAY);
@@ -1490,12 +1317,12 @@ void Renderer::drawCanvas()
         // Render the splash screen
         glBindVertexArray(instance->objects[CANVAS].vao);
 
-        // Bind the vertex buffer object
-        glBindBuffer(GL_ARRAY_BUFFER, instance->objects[CANVAS].vbo);
-        // Update the vertex buffer data
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+        // Stream the quad vertices
+        GLintptr offset = instance->stream_buffer.upload(GL_ARRAY_BUFFER, vertices, sizeof(vertices));
+        glVertexPointer(2, GL_FLOAT, 0, (void *)offset);
         
         glDrawArrays(GL_QUADS, 0, 4);
+        Profiler::countDrawCall();
         
         glBindVertexArray(0);
         
@@ -1514,56 +1341,37 @@ void Renderer::drawCanvas()
 
 void Renderer::drawSketch(short current_canvas)
 {
-    if (!instance->menu_frame.empty())
+    if (instance->hasMenuFrame())
     {
-        // Reset the modelview matrix
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
+        // Color of each layer: dark green ridges, brown peaks, light blue rivers and dark blue basins
+        static const GLfloat colors[4][3] = {{0.0f, 0.5f, 0.0f}, {0.5f, 0.25f, 0.0f}, {0.3f, 0.5f, 0.8f}, {0.0f, 0.0f, 0.7f}};
 
         // Save the previous projection matrix
         glMatrixMode(GL_PROJECTION);
         glPushMatrix();
             // Set the projection matrix to orthographic
-            float width = glutGet(GLUT_WINDOW_WIDTH);
-            float height = glutGet(GLUT_WINDOW_HEIGHT);
+            float width = GlutFramework::getWidth();
+            float height = GlutFramework::getHeight();
             glLoadIdentity();
             glOrtho(0, width, 0, height, -1, 1);
 
-            // Update sketch_vertices to fit the screen: vertices is the non-normalized version of sketch_vertices
-            vector<float> vertices(instance->objects[SKETCH + current_canvas].vertices.size());
-            
-            for (int i = 0; i < instance->objects[SKETCH + current_canvas].vertices.size(); i = i + 3)
-            {
-                vertices[i] = instance->objects[SKETCH + current_canvas].vertices[i] * width;
-                vertices[i + 1] = instance->objects[SKETCH + current_canvas].vertices[i + 1] * height;
-                vertices[i + 2] = instance->objects[SKETCH + current_canvas].vertices[i + 2];
-            }
+            // Scale the normalized vertices to fit the screen
+            glMatrixMode(GL_MODELVIEW);
+            glLoadIdentity();
+            glScalef(width, height, 1.0f);
+
+            // Render the sketch
+            glBindVertexArray(instance->objects[SKETCH + current_canvas].vao);
+            glBindBuffer(GL_ARRAY_BUFFER, instance->objects[SKETCH + current_canvas].vbo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, instance->objects[SKETCH + current_canvas].ibo);
+
+            // Upload the points added since the last frame
+            instance->updateSketchBuffers(current_canvas);
 
             // Enable the vertex arrays
             glEnableClientState(GL_VERTEX_ARRAY);
-            glEnableClientState(GL_COLOR_ARRAY);
-            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-
-            // Render the sketch
-            glBindVertexArray(instance->objects[SKETCH].vao);
-            
-            // Bind the vertex buffer object
-            glBindBuffer(GL_ARRAY_BUFFER, instance->objects[SKETCH].vbo);
-            // Update the vertex buffer data for points
-            glBufferData(GL_ARRAY_BUFFER, instance->objects[SKETCH + current_canvas].vertices.size() * sizeof(GLfloat), vertices.data(), GL_STREAM_DRAW);
-            // Set the vertexattribute pointer for positions
-            glVertexPointer(3, GL_FLOAT, 0, vertices.data());
-            
-            // Bind the vertex buffer object
-            glBindBuffer(GL_ARRAY_BUFFER, instance->objects[SKETCH].cbo);
-            // Update the vertex buffer data for points
-            glBufferData(GL_ARRAY_BUFFER, instance->objects[SKETCH + current_canvas].colors.size() * sizeof(GLfloat), instance->objects[SKETCH + current_canvas].colors.data(), GL_STREAM_DRAW);
-            // Set the vertexattribute pointer for colors
-            glColorPointer(3, GL_FLOAT, 0, instance->objects[SKETCH + current_canvas].colors.data());
-            
-            // Bind the index buffer object
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, instance->objects[SKETCH].ibo);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, instance->objects[SKETCH + current_canvas].indices.size() * sizeof(GLuint), instance->objects[SKETCH + current_canvas].indices.data(), GL_STREAM_DRAW);
+            glVertexPointer(3, GL_FLOAT, 0, 0);
+            glColor3fv(colors[current_canvas]);
 
             // Enable primitive restart
             glEnable(GL_PRIMITIVE_RESTART);
@@ -1573,22 +1381,27 @@ void Renderer::drawSketch(short current_canvas)
             if (current_canvas == RIDGES || current_canvas == RIVERS)
             {
                 // Increment line width
-                glLineWidth(5.0f);
+                glLineWidth(SKETCH_LINE_WIDTH);
                 // Draw the sketch using indices
-                glDrawElements(GL_LINE_STRIP, instance->objects[SKETCH + current_canvas].indices.size(), GL_UNSIGNED_INT, instance->objects[SKETCH + current_canvas].indices.data());
+                glDrawElements(GL_LINE_STRIP, instance->objects[SKETCH + current_canvas].indices.size(), GL_UNSIGNED_INT, 0);
+                Profiler::countDrawCall();
             }
             if (current_canvas == PEAKS || current_canvas == BASINS)
             {
                 // Increment points size
-                glPointSize(5.0f);
+                glPointSize(SKETCH_POINT_SIZE);
                 // Draw the sketch using indices
-                glDrawElements(GL_POINTS, instance->objects[SKETCH + current_canvas].indices.size(), GL_UNSIGNED_INT, instance->objects[SKETCH + current_canvas].indices.data());
+                glDrawElements(GL_POINTS, instance->objects[SKETCH + current_canvas].indices.size(), GL_UNSIGNED_INT, 0);
+                Profiler::countDrawCall();
             }
             glDisable(GL_PRIMITIVE_RESTART);
             
+            glColor3f(1.0f, 1.0f, 1.0f);
             glDisableClientState(GL_VERTEX_ARRAY);
-            glDisableClientState(GL_COLOR_ARRAY);
-            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+            
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
             
             // Restore the previous projection matrix
             glMatrixMode(GL_PROJECTION);
@@ -1596,15 +1409,67 @@ void Renderer::drawSketch(short current_canvas)
     }
 }
 
+void Renderer::drawPreview()
+{
+    if (instance->hasMenuFrame())
+        instance->sketch_preview.draw();
+}
+
+void Renderer::drawProgress()
+{
+    // The glut fonts need the glut window
+    int stage = GenerationQueue::getStage();
+    if (GlutFramework::isHeadless() || stage == GENERATION_STAGE_IDLE)
+        return;
+
+    // One bar cell per stage, the current one half filled
+    char bar[GENERATION_STAGE_COUNT * 4 + 1];
+    for (int i = 0; i < GENERATION_STAGE_COUNT; i++)
+        snprintf(bar + i * 4, 5, "%s", i < stage ? "####" : i == stage ? "##  " : "    ");
+    char line[128];
+    snprintf(line, sizeof(line), "[%s] %d/%d %s", bar, stage + 1, GENERATION_STAGE_COUNT, GenerationQueue::getStageName(stage));
+
+    int screen_width = GlutFramework::getWidth();
+    int screen_height = GlutFramework::getHeight();
+    int text_width = glutBitmapLength(GLUT_BITMAP_9_BY_15, reinterpret_cast<const unsigned char *>(line));
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+        glLoadIdentity();
+        glOrtho(0, screen_width, 0, screen_height, -1, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+            glLoadIdentity();
+            glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_LIGHTING);
+            glDisable(GL_TEXTURE_2D);
+            glColor3f(1.0f, 1.0f, 1.0f);
+
+            // Centered at the bottom of the screen, where the variants are shown once ready
+            glRasterPos2f((screen_width - text_width) / 2.0f, 40.0f);
+            glutBitmapString(GLUT_BITMAP_9_BY_15, reinterpret_cast<const unsigned char *>(line));
+
+            glPopAttrib();
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
 void Renderer::drawTime()
 {
+    // The glut fonts need the glut window
+    if (GlutFramework::isHeadless())
+        return;
+
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
         glLoadIdentity();
         
-        //get screen size with glut
-        int screen_width = glutGet(GLUT_WINDOW_WIDTH);
-        int screen_height = glutGet(GLUT_WINDOW_HEIGHT);
+        //get screen size
+        int screen_width = GlutFramework::getWidth();
+        int screen_height = GlutFramework::getHeight();
 
         // Set the text position in screen coordinates
         GLfloat text_width = glutStrokeLength(GLUT_STROKE_MONO_ROMAN, reinterpret_cast<const unsigned char *>("hh:mm:ss"));
@@ -1650,55 +1515,138 @@ void Renderer::drawTime()
     glMatrixMode(GL_MODELVIEW);
 }
 
-void Renderer::renderLight()
+void Renderer::drawStats()
 {
-    // Set the light position based on the mesh size
-    static float diffuse_light_y = instance->terrain->getWorldDim()/2;
-    
-    glMatrixMode(GL_MODELVIEW);
+    // The glut fonts need the glut window
+    if (GlutFramework::isHeadless())
+        return;
+
+    glMatrixMode(GL_PROJECTION);
     glPushMatrix();
-        // Draw the light source
-        GLfloat light_position[4];
-        // Initialize the light position to the sun's position
-        light_position[0] = 0;
-        light_position[2] = 0;
-        light_position[3] = 1;
+        glLoadIdentity();
         
-        GLfloat spot_direction[3] = {0.0f, -1.0f, 0.0f};
-        glLightfv(GL_LIGHT0, GL_SPOT_DIRECTION, spot_direction);
+        int screen_width = GlutFramework::getWidth();
+        int screen_height = GlutFramework::getHeight();
+        
+        // Set up an orthographic projection
+        glOrtho(0, screen_width, 0, screen_height, -1, 1);
 
-        // If daytime, use diffuse sunlight
-        if (instance->time > 6 && instance->time < 18)
-        {
-            float light[] = {1.0, 0.9, 0.8, 1.0};
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+            glLoadIdentity();
+            glColor3f(1.0f, 1.0f, 1.0f);
+            
+            // Rolling statistics of the last resolved frames: average and, in brackets, maximum
+            const ProfilerFrame &average = Profiler::getAverage();
+            const ProfilerFrame &maximum = Profiler::getMaximum();
+            std::vector<std::string> lines;
+            char line[128];
+            
+            snprintf(line, sizeof(line), "%-16s %6.2f (%6.2f) %6.2f (%6.2f)  %5.1f fps", "frame cpu/gpu ms", average.frame_cpu_ms, maximum.frame_cpu_ms, average.frame_gpu_ms, maximum.frame_gpu_ms, average.interval_ms > 0.0 ? 1000.0 / average.interval_ms : 0.0);
+            lines.push_back(line);
+            for (int pass = 0; pass < PROFILER_PASSES; pass++)
+            {
+                // Skip the passes of the other pages
+                if (maximum.cpu_ms[pass] == 0.0 && maximum.gpu_ms[pass] == 0.0)
+                    continue;
+                snprintf(line, sizeof(line), "%-16s %6.2f (%6.2f) %6.2f (%6.2f)", Profiler::getPassName(pass), average.cpu_ms[pass], maximum.cpu_ms[pass], average.gpu_ms[pass], maximum.gpu_ms[pass]);
+                lines.push_back(line);
+            }
+            snprintf(line, sizeof(line), "primitives %.0f, draw calls %.0f", average.primitives, average.draw_calls);
+            lines.push_back(line);
+            snprintf(line, sizeof(line), "uploads %.0f (%.2f MB), stream waits %.1f%s", average.uploads, average.upload_bytes / (1024.0 * 1024.0), average.sync_waits, Profiler::isRecording() ? ", recording" : "");
+            lines.push_back(line);
+            snprintf(line, sizeof(line), "memory gpu %.1f MB, host %.1f MB", ResourceRegistry::getGpuBytes() / (1024.0 * 1024.0), ResourceRegistry::getHostBytes() / (1024.0 * 1024.0));
+            lines.push_back(line);
+            snprintf(line, sizeof(line), "resolution %.0f%%%s", DynamicResolution::getScale() * 100.0f, DynamicResolution::isEnabled() ? "" : " (fixed)");
+            lines.push_back(line);
+            if (GenerationCache::isEnabled())
+            {
+                snprintf(line, sizeof(line), "generation cache %d hits, %d misses, %.1f MB", GenerationCache::getHits(), GenerationCache::getMisses(), GenerationCache::getBytes() / (1024.0 * 1024.0));
+                lines.push_back(line);
+            }
+            
+            // Draw the table with a fixed width font on the right of the time text
+            for (size_t i = 0; i < lines.size(); i++)
+            {
+                glRasterPos2f(screen_width / 2.0f + 200.0f, screen_height - 30.0f - i * 15.0f);
+                glutBitmapString(GLUT_BITMAP_8_BY_13, reinterpret_cast<const unsigned char *>(lines[i].c_str()));
+            }
 
-            glLightfv(GL_LIGHT0, GL_DIFFUSE, light);
-            light_position[1] = diffuse_light_y;
-        }
-        // If nighttime, use diffuse moonlight
-        else
-        {
-            float light[] = {0.25, 0.5, 0.75, 1.0};
-            glLightfv(GL_LIGHT0, GL_DIFFUSE, light);
-            light_position[1] = -diffuse_light_y;
-        }
-        
-        float angle = instance->time / 24.f * 360 + 180;
-        glRotatef(angle, 0, 0, 1);
-        glLightfv(GL_LIGHT0, GL_POSITION, light_position);
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
     glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+void Renderer::renderLight()
+{
+    GLfloat light_position[4], light_color[4], ambient_light;
+    getLight(light_position, light_color, ambient_light);
+    
+    GLfloat spot_direction[3] = {0.0f, -1.0f, 0.0f};
+    glLightfv(GL_LIGHT0, GL_SPOT_DIRECTION, spot_direction);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, light_color);
+    
+    // The position is transformed by the camera only, it is already in world space
+    glMatrixMode(GL_MODELVIEW);
+    glLightfv(GL_LIGHT0, GL_POSITION, light_position);
+}
+
+void Renderer::getLight(GLfloat position[4], GLfloat color[4], GLfloat &ambient)
+{
+    // Set the light position based on the mesh size
+    static float diffuse_light_y = instance->terrain->getWorldDim()/2;
+    float height = diffuse_light_y;
+    
+    // If daytime, use diffuse sunlight
+    if (instance->time > 6 && instance->time < 18)
+    {
+        color[0] = 1.0f;
+        color[1] = 0.9f;
+        color[2] = 0.8f;
+    }
+    // If nighttime, use diffuse moonlight
+    else
+    {
+        color[0] = 0.25f;
+        color[1] = 0.5f;
+        color[2] = 0.75f;
+        height = -diffuse_light_y;
+    }
+    color[3] = 1.0f;
+    
+    // The light source orbits around the z axis with the time of the day
+    float angle = (instance->time / 24.f * 360 + 180) * (M_PI / 180.0);
+    position[0] = -height * std::sin(angle);
+    position[1] = height * std::cos(angle);
+    position[2] = 0.0f;
+    position[3] = 1.0f;
+    
+    ambient = (1 - std::abs(static_cast<float>(instance->time) / 24.f - 0.5f))*0.25f;
 }
 
 void Renderer::draw()
 {
+    Profiler::beginFrame();
+    
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
     glColor3f(1.0, 1.0, 1.0);
     // Set the modelview matrix
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
     
-    // Update the camera based on the inputs
-    instance->camera->update();
+    // Interpolate the time of the day between the last two steps, across midnight too
+    float day_delta = instance->day_time - instance->previous_day_time;
+    if (day_delta < 0.0f)
+        day_delta += 24.0f;
+    instance->time = std::fmod(instance->previous_day_time + day_delta * instance->interpolation, 24.0f);
+    
+    // Update the camera based on the inputs, interpolated between the last two steps
+    instance->camera->update(instance->interpolation);
+    
+    if (instance->current_menu_page != RENDERING_SCREEN)
+        Profiler::begin(PASS_MENU);
     
     // Switch on the current menu page
     switch (instance->current_menu_page)
@@ -1707,33 +1655,53 @@ void Renderer::draw()
         instance->drawSplashscreen();
         break;
     case RENDERING_SCREEN:
+        // Render the world at the dynamic resolution, the HUD stays at the native one
+        instance->dynamic_resolution.begin();
+        Profiler::begin(PASS_SKYDOME);
         instance->drawSkydome();
+        Profiler::end(PASS_SKYDOME);
+        Profiler::begin(PASS_ORBIT);
         instance->drawOrbit();
+        Profiler::end(PASS_ORBIT);
         glEnable(GL_LIGHTING);
         instance->drawWater();
+        Profiler::begin(PASS_TERRAIN);
         instance->drawTerrain();
+        Profiler::end(PASS_TERRAIN);
+        Profiler::begin(PASS_VEGETATION);
         instance->drawVegetation();
+        Profiler::end(PASS_VEGETATION);
         instance->renderLight();
         glDisable(GL_LIGHTING);
+        instance->dynamic_resolution.end();
+        Profiler::begin(PASS_HUD);
         instance->drawTime();
+        if (instance->show_stats)
+            instance->drawStats();
+        Profiler::end(PASS_HUD);
         break;
     case LOADING_SCREEN:
         instance->drawCanvas();
+        instance->variant_gallery.draw();
+        instance->drawProgress();
         break;
     case RIDGES_SCREEN:
         instance->drawCanvas();
         instance->drawSketch(RIDGES);
+        instance->drawPreview();
         break;
     case PEAKS_SCREEN:
         instance->drawCanvas();
         instance->drawSketch(PEAKS);
         instance->drawSketch(RIDGES);
+        instance->drawPreview();
         break;
     case RIVERS_SCREEN:
         instance->drawCanvas();
         instance->drawSketch(RIVERS);
         instance->drawSketch(PEAKS);
         instance->drawSketch(RIDGES);
+        instance->drawPreview();
         break;
     case BASINS_SCREEN:
         instance->drawCanvas();
@@ -1741,8 +1709,22 @@ void Renderer::draw()
         instance->drawSketch(RIVERS);
         instance->drawSketch(PEAKS);
         instance->drawSketch(RIDGES);
+        instance->drawPreview();
         break;
     }
     
-    glutSwapBuffers();
+    if (instance->current_menu_page != RENDERING_SCREEN)
+    {
+        Profiler::end(PASS_MENU);
+        if (instance->show_stats)
+            instance->drawStats();
+    }
+    
+    GlutFramework::swapBuffers();
+    
+    // Fence the streamed data of this frame
+    StreamBuffer::endFrame();
+    
+    // Close the profiled frame, after the streamed data statistics are final
+    Profiler::endFrame();
 }
\ No newline at end of file
@@ -20,13 +20,43 @@
 #include "random"
 
 #include "Camera.h"
+#include "GlutFramework.h"
 #include "Object.h"
+#include "AssetManager.h"
+#include "BlockCompressor.h"
+#include "DynamicResolution.h"
+#include "GenerationCache.h"
+#include "GenerationQueue.h"
+#include "VariantGallery.h"
+#include "SketchPreview.h"
+#include "Profiler.h"
+#include "Shader.h"
+#include "SketchRasterizer.h"
+#include "StreamBuffer.h"
+#include "VideoStream.h"
+#include "Vegetation.h"
 #include "QuadTree.h"
+#include "ResourceRegistry.h"
 #include "Terrain.h"
 #include "Constants.h"
 #include "Vec.hpp"
 #include "PerlinNoise.hpp"
 
+/**
+ * @brief GPU state of a sketch layer, whose buffers grow and are appended incrementally.
+ */
+typedef struct
+{
+    size_t uploaded_vertices;       ///< Vertices already copied into the vertex buffer
+    size_t uploaded_indices;        ///< Indices already copied into the index buffer
+    size_t vertex_capacity;         ///< Capacity of the vertex buffer in vertices
+    size_t index_capacity;          ///< Capacity of the index buffer in indices
+    bool has_pending;               ///< Whether the last point of the stroke was dropped by the decimation
+    float pending_x;                ///< x-coordinate of the dropped point, kept when the stroke ends
+    float pending_y;                ///< y-coordinate of the dropped point, kept when the stroke ends
+    std::vector<bool> occupied;     ///< Cells of the canvas already holding a point (peaks and basins)
+} SketchLayer;
+
 /**
  * @brief Renderer class which handles the rendering of the scene and all of the objects.
  * 
@@ -36,6 +66,7 @@ class Renderer
 {
 public:
     short current_menu_page = 0; ///< Keeps track of the current page in the menu
+    bool show_stats = false;     ///< Whether the profiler statistics are displayed
     
     /**
      * @brief Renderer singleton constructor.
@@ -50,7 +81,7 @@ public:
     /**
      * @brief Initialize the renderer.
      * 
-     * Set the camera and quadtree references, allocate space for objects, set the timer func and populate fixed objects (skydome, splashscreen and canvas).
+     * Set the camera and quadtree references, allocate space for objects and populate fixed objects (skydome, splashscreen and canvas).
      * 
      * @param camera Camera object reference
      * @param quadtree Quadtree object reference
@@ -58,18 +89,47 @@ public:
     void initialize(Camera *camera, QuadTree *quadtree);
 
     /**
-     * @brief Take a snapshot of the current canvas.
+     * @brief Release the OpenGL objects of the renderer and of the vegetation, while the context still exists.
+     * 
+     * Called before the program exits and when the window is closed, the destructor then has nothing left to delete.
+     */
+    static void release();
+
+    /**
+     * @brief Rasterize the sketches of every canvas into the model input tensor.
+     * 
+     * The strokes are rasterized on the CPU in the reference frame used by the canvas, so the result doesn't depend on the window size.
+     * The live preview is cancelled, the full generation supersedes it.
      * 
-     * This function takes a snapshot of the current canvas by rendering the scene to a framebuffer object
-     * independent of the current window (so that window stretch doesn't affect the snapshot) and saves it to the disk into the assets/sketches folder.
+     * @param size Side of the tensor, 450 for one model input, larger for the tiled worlds (see Inference::getWorldSize)
+     * @return std::vector<float> size x size x 4 tensor (ridges, rivers, peaks, basins) with values in [0, 1]
      */
-    void takeSnapshot();
+    std::vector<float> rasterizeSketches(int size);
 
     /**
      * @brief Initialize the water object.
      */
     void initializeWater();
 
+    /**
+     * @brief Generate the water mesh (vertices at the water level, texture coordinates and triangle strips) of a terrain.
+     * 
+     * @param terrain Terrain object reference
+     * @param water Water object whose buffers are filled
+     */
+    static void buildWater(Terrain *terrain, Object &water);
+
+    /**
+     * @brief Displace the water vertices with the macro (perlin noise) and micro (sin/cos) waves and recalculate the normals.
+     * 
+     * @param water Water object, at rest
+     * @param perlin_noise Perlin noise generator of the macro waves
+     * @param time Wave time
+     * @param vertices Displaced vertices
+     * @param normals Normals of the displaced vertices
+     */
+    static void animateWater(const Object &water, const siv::PerlinNoise &perlin_noise, float time, std::vector<float> &vertices, std::vector<float> &normals);
+
     /**
      * @brief Initialize the orbit object consisting of a sun and of a moon rotating in an orbit.
      * 
@@ -79,6 +139,9 @@ public:
 
     /**
      * @brief Initialize the vegetation objects consting of different random located bushes.
+     * 
+     * Each bush is stored as a single instance (root position, size and species). The bushes are grouped in terrain chunks
+     * which are scattered on worker threads and uploaded once, the first time the camera gets close to them.
      */
     void initializeVegetation();
 
@@ -96,16 +159,43 @@ public:
      */
     void setTime(int time);
 
+    /**
+     * @brief Run a fixed simulation step: animate the menus and advance the day/night cycle, the water waves and the wind.
+     * 
+     * @param step Duration of the step in seconds
+     */
+    void update(float step);
+
+    /**
+     * @brief Set how far the next frame is between the last two simulation steps.
+     * 
+     * @param interpolation Fraction of the step elapsed since the last one, in [0, 1)
+     */
+    void setInterpolation(float interpolation);
+
+    /**
+     * @brief Render and swap a frame right away, without going through the glut display callback (used by the headless benchmark).
+     */
+    void renderFrame();
+
     /**
      * @brief Add new drawn pixels to the current canvas.
      * 
+     * Strokes are decimated: stroke points closer than SKETCH_MIN_DISTANCE pixels to the previous one and points falling into a cell
+     * of the canvas already holding one are dropped. (0xFFFFFFFF, 0xFFFFFFFF) ends the current stroke.
+     * 
      * @param x x-coordinate of the pixel
      * @param y y-coordinate of the pixel
      */
     void sketch(float x, float y);
 
     /**
-     * @brief Clear the sketches buffer (used when restarting the loop).
+     * @brief Submit the sketches of every canvas to the live preview, called at the end of each stroke.
+     */
+    void previewSketches();
+
+    /**
+     * @brief Clear the sketches buffer and the live preview (used when restarting the loop).
      */
     void resetSketches();
 
@@ -115,11 +205,35 @@ private:
     Terrain *terrain;                   ///< A reference to the terrain object
     QuadTree *quadtree;                 ///< A reference to the quadtree object
     std::vector<Object> objects;        ///< The vector of objects to be rendered
-    cv::VideoCapture menu_clips[6];     ///< The vector of menu clips to be rendered
-    cv::Mat menu_frame;                 ///< The current menu frame to be rendered
-    float time;                         ///< Time variable used to track time of the day and apply time-based effects
+    VideoStream menu_clips[6];          ///< The menu clips, decoded in background and streamed into their textures
+    float time;                         ///< Time of the day of the current frame, used to apply time-based effects
+    float day_time;                     ///< Time of the day at the last simulation step
+    float previous_day_time;            ///< Time of the day at the previous simulation step
+    float wave_time;                    ///< Time of the water waves at the last simulation step
+    float previous_wave_time;           ///< Time of the water waves at the previous simulation step
+    float vegetation_time;              ///< Time of the wind blowing on the vegetation at the last simulation step
+    float previous_vegetation_time;     ///< Time of the wind at the previous simulation step
+    float interpolation;                ///< Fraction of the simulation step elapsed at the current frame
+    int orbit_height;                   ///< Height of the sun and moon orbit in world coordinates
     siv::PerlinNoise perlin_noise;      ///< Perlin noise object used to generate the water waves
+    Shader vegetation_shader;           ///< Shader program billboarding and animating the vegetation instances
+    bool has_vegetation;                ///< Whether the vegetation is drawn: its shader is loaded and instanced arrays are supported
+    Vegetation vegetation;              ///< Chunked vegetation scattered around the camera
+    StreamBuffer stream_buffer;         ///< Ring buffer streaming the per-frame vertex data (water and screen quads)
+    SketchLayer sketch_layers[4];       ///< GPU state of the sketch layers
+    DynamicResolution dynamic_resolution; ///< Offscreen target the world is rendered into when it exceeds the GPU budget
+    VariantGallery variant_gallery;       ///< Thumbnails of the variants of a batched generation, over the loading screen
+    SketchPreview sketch_preview;         ///< Low resolution terrain generated in background from the sketches, right of the canvas
     
+    /**
+     * @brief Initialize a textured model object from the assets decoded by the asset manager.
+     * 
+     * @param object Index of the object
+     * @param texture_path Texture image path
+     * @param model_path Model path
+     */
+    void initializeModel(short object, const char *texture_path, const char *model_path);
+
     /**
      * @brief Initialize the skydome object.
      */
@@ -135,10 +249,35 @@ private:
      */
     void initializeCanvas();
 
+    /**
+     * @brief Initialize the vertex array objects and the growing buffers of the sketch layers.
+     */
+    void initializeSketches();
+
+    /**
+     * @brief Append a point to a sketch layer.
+     * 
+     * @param current_canvas Sketch layer
+     * @param x x-coordinate of the point
+     * @param y y-coordinate of the point
+     */
+    void addSketchVertex(short current_canvas, float x, float y);
+
+    /**
+     * @brief Append the points added since the last frame to the buffers of a layer, growing them when full.
+     * 
+     * The vertex array object and the buffers of the layer must be bound.
+     * 
+     * @param current_canvas Sketch layer
+     */
+    void updateSketchBuffers(short current_canvas);
+
     /**
      * @brief Update the time continuosly.
+     * 
+     * @param step Duration of the simulation step in seconds
      */
-    void cycleDayNight();
+    void cycleDayNight(float step);
 
     /**
      * @brief Draw the terrain mesh by means of the quadtree.
@@ -172,11 +311,26 @@ private:
      */
     static void drawSketch(short current_canvas);
 
+    /**
+     * @brief Draw the live preview of the sketches right of the canvas.
+     */
+    static void drawPreview();
+
+    /**
+     * @brief Draw the stage of the generation in progress and a progress bar at the bottom of the loading screen.
+     */
+    static void drawProgress();
+
     /**
      * @brief Draw the time text on the top center of the screen.
      */
     static void drawTime();
 
+    /**
+     * @brief Draw the profiler statistics (pass timings and counters of the last frames) on the right of the time text.
+     */
+    static void drawStats();
+
     /**
      * @brief Draw the water and handle its realtime simualted physics and reflections.
      */
@@ -184,6 +338,9 @@ private:
 
     /**
      * @brief Draw the vegetation and handle the realtime simualted wind blowing on the bushes.
+     * 
+     * Each visible chunk is drawn with a single instanced draw call, with fewer bushes the farther it is:
+     * billboarding and wind are computed per instance by the vegetation shader.
      */
     static void drawVegetation();
 
@@ -191,19 +348,29 @@ private:
      * @brief Handle overall lighting its parameters.
      */
     static void renderLight();
+
+    /**
+     * @brief Get the lighting of the current time of the day, shared by the fixed function terrain and the vegetation shader.
+     * 
+     * @param position World position of the diffuse light source (the sun or the moon), homogeneous
+     * @param color Color of the diffuse light source
+     * @param ambient Ambient light intensity
+     */
+    static void getLight(GLfloat position[4], GLfloat color[4], GLfloat &ambient);
     
     /**
-     * @brief Animate menu frames.
+     * @brief Play the clip of the current menu page, prefetch the clip of the next page and pause the others.
      */
     static void animateMenu();
-    
+
     /**
-     * @brief Implements the timer function which periodically animates the menus and carries the time flowing.
+     * @brief Check if the clip of the current menu page has a frame to display.
      * 
-     * @param value Timer value (unused)
+     * @return true If the current page is a menu page and its clip has a frame
+     * @return false Otherwise
      */
-    static void timerCallback(int value);
-
+    static bool hasMenuFrame();
+    
     /**
      * @brief Draw the entire scene.
      */
@@ -0,0 +1,340 @@
+/**
+@file
+@brief ResourceRegistry source file.
+*/
+
+#include "ResourceRegistry.h"
+
+
+ResourceRegistry *ResourceRegistry::instance = nullptr;
+
+// Key of an OpenGL object: the ids of the different kinds overlap
+static uint64_t getKey(int kind, GLuint id)
+{
+    return ((uint64_t)kind << 32) | id;
+}
+
+// Bytes in MiB, for the reports
+static double toMegabytes(size_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+// Default constructor
+ResourceRegistry::ResourceRegistry()
+{
+    if (ResourceRegistry::instance == nullptr)
+        ResourceRegistry::instance = this;
+
+    for (int subsystem = 0; subsystem < RESOURCE_SUBSYSTEMS; subsystem++)
+    {
+        for (int kind = 0; kind < RESOURCE_KINDS; kind++)
+        {
+            this->counts[subsystem][kind] = 0;
+            this->bytes[subsystem][kind] = 0;
+        }
+        this->gpu_budgets[subsystem] = 0;
+        this->host_budgets[subsystem] = 0;
+    }
+    for (int i = 0; i <= RESOURCE_SUBSYSTEMS; i++)
+    {
+        this->is_over_gpu_budget[i] = false;
+        this->is_over_host_budget[i] = false;
+    }
+
+    this->gpu_peak = 0;
+    this->host_peak = 0;
+    this->gpu_budget = GPU_MEMORY_BUDGET;
+    this->host_budget = HOST_MEMORY_BUDGET;
+}
+
+// Destructor
+ResourceRegistry::~ResourceRegistry()
+{
+    ResourceRegistry::instance = nullptr;
+}
+
+GLuint ResourceRegistry::createBuffer(int subsystem)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    add(RESOURCE_BUFFER, buffer, subsystem);
+    return buffer;
+}
+
+GLuint ResourceRegistry::createTexture(int subsystem)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    add(RESOURCE_TEXTURE, texture, subsystem);
+    return texture;
+}
+
+GLuint ResourceRegistry::createVertexArray(int subsystem)
+{
+    GLuint vertex_array;
+    glGenVertexArrays(1, &vertex_array);
+    add(RESOURCE_VERTEX_ARRAY, vertex_array, subsystem);
+    return vertex_array;
+}
+
+GLuint ResourceRegistry::createFramebuffer(int subsystem)
+{
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    add(RESOURCE_FRAMEBUFFER, framebuffer, subsystem);
+    return framebuffer;
+}
+
+void ResourceRegistry::bufferData(GLuint buffer, GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+    glBufferData(target, size, data, usage);
+    resize(RESOURCE_BUFFER, buffer, size);
+}
+
+void ResourceRegistry::bufferStorage(GLuint buffer, GLenum target, GLsizeiptr size, const void *data, GLbitfield flags)
+{
+    glBufferStorage(target, size, data, flags);
+    resize(RESOURCE_BUFFER, buffer, size);
+}
+
+void ResourceRegistry::setTextureSize(GLuint texture, size_t bytes)
+{
+    resize(RESOURCE_TEXTURE, texture, bytes);
+}
+
+void ResourceRegistry::releaseBuffer(GLuint &buffer)
+{
+    if (!buffer)
+        return;
+    remove(RESOURCE_BUFFER, buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void ResourceRegistry::releaseTexture(GLuint &texture)
+{
+    if (!texture)
+        return;
+    remove(RESOURCE_TEXTURE, texture);
+    glDeleteTextures(1, &texture);
+    texture = 0;
+}
+
+void ResourceRegistry::releaseVertexArray(GLuint &vertex_array)
+{
+    if (!vertex_array)
+        return;
+    remove(RESOURCE_VERTEX_ARRAY, vertex_array);
+    glDeleteVertexArrays(1, &vertex_array);
+    vertex_array = 0;
+}
+
+void ResourceRegistry::releaseFramebuffer(GLuint &framebuffer)
+{
+    if (!framebuffer)
+        return;
+    remove(RESOURCE_FRAMEBUFFER, framebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    framebuffer = 0;
+}
+
+void ResourceRegistry::releaseObject(Object &object)
+{
+    releaseVertexArray(object.vao);
+    releaseBuffer(object.vbo);
+    releaseBuffer(object.tbo);
+    releaseBuffer(object.ibo);
+    releaseBuffer(object.cbo);
+    releaseBuffer(object.nbo);
+    releaseBuffer(object.instance_bo);
+    releaseTexture(object.texture[0]);
+    releaseTexture(object.texture[1]);
+}
+
+void ResourceRegistry::track(const void *key, int subsystem, size_t bytes)
+{
+    if (instance == nullptr || key == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    std::unordered_map<const void *, ResourceEntry>::iterator entry = instance->buffers.find(key);
+    if (entry == instance->buffers.end())
+    {
+        instance->buffers[key] = ResourceEntry{subsystem, RESOURCE_HOST, bytes};
+        instance->counts[subsystem][RESOURCE_HOST]++;
+    }
+    else
+    {
+        // The buffer was reallocated, possibly by another subsystem
+        instance->bytes[entry->second.subsystem][RESOURCE_HOST] -= entry->second.bytes;
+        instance->counts[entry->second.subsystem][RESOURCE_HOST]--;
+        instance->counts[subsystem][RESOURCE_HOST]++;
+        entry->second.subsystem = subsystem;
+        entry->second.bytes = bytes;
+    }
+    instance->bytes[subsystem][RESOURCE_HOST] += bytes;
+    instance->checkBudgets(subsystem, false);
+}
+
+void ResourceRegistry::untrack(const void *key)
+{
+    if (instance == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    std::unordered_map<const void *, ResourceEntry>::iterator entry = instance->buffers.find(key);
+    if (entry == instance->buffers.end())
+        return;
+
+    instance->bytes[entry->second.subsystem][RESOURCE_HOST] -= entry->second.bytes;
+    instance->counts[entry->second.subsystem][RESOURCE_HOST]--;
+    instance->checkBudgets(entry->second.subsystem, false);
+    instance->buffers.erase(entry);
+}
+
+void ResourceRegistry::setBudget(size_t gpu_bytes, size_t host_bytes)
+{
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    instance->gpu_budget = gpu_bytes;
+    instance->host_budget = host_bytes;
+}
+
+void ResourceRegistry::setBudget(int subsystem, size_t gpu_bytes, size_t host_bytes)
+{
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    instance->gpu_budgets[subsystem] = gpu_bytes;
+    instance->host_budgets[subsystem] = host_bytes;
+}
+
+size_t ResourceRegistry::getGpuBytes(int subsystem)
+{
+    if (instance == nullptr)
+        return 0;
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    return instance->sum(subsystem, true);
+}
+
+size_t ResourceRegistry::getHostBytes(int subsystem)
+{
+    if (instance == nullptr)
+        return 0;
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    return instance->sum(subsystem, false);
+}
+
+void ResourceRegistry::dump()
+{
+    if (instance == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    printf(COLOR_CYAN "%-12s %16s %16s %8s %8s %16s\n" COLOR_RESET, "subsystem", "buffers", "textures", "vaos", "fbos", "host");
+    for (int subsystem = 0; subsystem < RESOURCE_SUBSYSTEMS; subsystem++)
+    {
+        const size_t *counts = instance->counts[subsystem];
+        const size_t *bytes = instance->bytes[subsystem];
+        printf("%-12s %5zu %8.2f MiB %5zu %8.2f MiB %8zu %8zu %5zu %8.2f MiB\n", getSubsystemName(subsystem),
+               counts[RESOURCE_BUFFER], toMegabytes(bytes[RESOURCE_BUFFER]), counts[RESOURCE_TEXTURE], toMegabytes(bytes[RESOURCE_TEXTURE]),
+               counts[RESOURCE_VERTEX_ARRAY], counts[RESOURCE_FRAMEBUFFER], counts[RESOURCE_HOST], toMegabytes(bytes[RESOURCE_HOST]));
+    }
+
+    printf("GPU:  %.2f MiB (peak %.2f MiB, budget ", toMegabytes(instance->sum(-1, true)), toMegabytes(instance->gpu_peak));
+    if (instance->gpu_budget)
+        printf("%.2f MiB)\n", toMegabytes(instance->gpu_budget));
+    else
+        printf("none)\n");
+    printf("Host: %.2f MiB (peak %.2f MiB, budget ", toMegabytes(instance->sum(-1, false)), toMegabytes(instance->host_peak));
+    if (instance->host_budget)
+        printf("%.2f MiB)\n", toMegabytes(instance->host_budget));
+    else
+        printf("none)\n");
+    fflush(stdout);
+}
+
+const char *ResourceRegistry::getSubsystemName(int subsystem)
+{
+    static const char *names[RESOURCE_SUBSYSTEMS] = {"terrain", "water", "sky", "vegetation", "menu", "sketch", "streaming", "scene", "inference"};
+    return names[subsystem];
+}
+
+void ResourceRegistry::add(int kind, GLuint id, int subsystem)
+{
+    if (instance == nullptr || !id)
+        return;
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    instance->objects[getKey(kind, id)] = ResourceEntry{subsystem, kind, 0};
+    instance->counts[subsystem][kind]++;
+}
+
+void ResourceRegistry::resize(int kind, GLuint id, size_t size)
+{
+    if (instance == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    std::unordered_map<uint64_t, ResourceEntry>::iterator entry = instance->objects.find(getKey(kind, id));
+    if (entry == instance->objects.end())
+        return;
+
+    instance->bytes[entry->second.subsystem][kind] += size - entry->second.bytes;
+    entry->second.bytes = size;
+    instance->checkBudgets(entry->second.subsystem, true);
+}
+
+void ResourceRegistry::remove(int kind, GLuint id)
+{
+    if (instance == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    std::unordered_map<uint64_t, ResourceEntry>::iterator entry = instance->objects.find(getKey(kind, id));
+    if (entry == instance->objects.end())
+        return;
+
+    instance->bytes[entry->second.subsystem][kind] -= entry->second.bytes;
+    instance->counts[entry->second.subsystem][kind]--;
+    instance->checkBudgets(entry->second.subsystem, true);
+    instance->objects.erase(entry);
+}
+
+size_t ResourceRegistry::sum(int subsystem, bool is_gpu)
+{
+    size_t total = 0;
+    for (int current = 0; current < RESOURCE_SUBSYSTEMS; current++)
+    {
+        if (subsystem >= 0 && current != subsystem)
+            continue;
+        if (is_gpu)
+            total += this->bytes[current][RESOURCE_BUFFER] + this->bytes[current][RESOURCE_TEXTURE];
+        else
+            total += this->bytes[current][RESOURCE_HOST];
+    }
+    return total;
+}
+
+void ResourceRegistry::checkBudgets(int subsystem, bool is_gpu)
+{
+    size_t subsystem_bytes = sum(subsystem, is_gpu);
+    size_t total_bytes = sum(-1, is_gpu);
+    size_t subsystem_budget = is_gpu ? this->gpu_budgets[subsystem] : this->host_budgets[subsystem];
+    size_t total_budget = is_gpu ? this->gpu_budget : this->host_budget;
+    bool *is_over_budget = is_gpu ? this->is_over_gpu_budget : this->is_over_host_budget;
+    const char *memory = is_gpu ? "GPU" : "Host";
+
+    size_t &peak = is_gpu ? this->gpu_peak : this->host_peak;
+    peak = std::max(peak, total_bytes);
+
+    // Warn once when a budget is exceeded, again if it is exceeded after going back under it
+    bool is_over = subsystem_budget && subsystem_bytes > subsystem_budget;
+    if (is_over && !is_over_budget[subsystem])
+        fprintf(stderr, COLOR_YELLOW "%s memory of the %s subsystem over budget: %.2f MiB / %.2f MiB\n" COLOR_RESET, memory,
+                getSubsystemName(subsystem), toMegabytes(subsystem_bytes), toMegabytes(subsystem_budget));
+    is_over_budget[subsystem] = is_over;
+
+    is_over = total_budget && total_bytes > total_budget;
+    if (is_over && !is_over_budget[RESOURCE_SUBSYSTEMS])
+        fprintf(stderr, COLOR_YELLOW "%s memory over budget: %.2f MiB / %.2f MiB\n" COLOR_RESET, memory, toMegabytes(total_bytes), toMegabytes(total_budget));
+    is_over_budget[RESOURCE_SUBSYSTEMS] = is_over;
+}
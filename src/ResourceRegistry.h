@@ -0,0 +1,327 @@
+/**
+@file
+@brief ResourceRegistry header file.
+*/
+
+#ifndef RESOURCEREGISTRY_H
+#define RESOURCEREGISTRY_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include "Object.h"
+#include "Colors.h"
+
+// Subsystems the resources are tagged with
+#define RESOURCE_TERRAIN 0
+#define RESOURCE_WATER 1
+#define RESOURCE_SKY 2
+#define RESOURCE_VEGETATION 3
+#define RESOURCE_MENU 4
+#define RESOURCE_SKETCH 5
+#define RESOURCE_STREAMING 6
+#define RESOURCE_SCENE 7
+#define RESOURCE_INFERENCE 8
+#define RESOURCE_SUBSYSTEMS 9
+
+// Kinds of resources
+#define RESOURCE_BUFFER 0
+#define RESOURCE_TEXTURE 1
+#define RESOURCE_VERTEX_ARRAY 2
+#define RESOURCE_FRAMEBUFFER 3
+#define RESOURCE_HOST 4
+#define RESOURCE_KINDS 5
+
+// Default budgets of the whole session in bytes, 0 disables a budget
+#define GPU_MEMORY_BUDGET (512ull * 1024 * 1024)
+#define HOST_MEMORY_BUDGET (1024ull * 1024 * 1024)
+
+/**
+ * @brief Accounting of a tracked resource.
+ */
+typedef struct
+{
+    int subsystem;  ///< Subsystem which owns the resource
+    int kind;       ///< Kind of resource
+    size_t bytes;   ///< Size in bytes, 0 until the storage is allocated
+} ResourceEntry;
+
+/**
+ * @brief ResourceRegistry class through which the OpenGL objects and the large CPU buffers are allocated and released.
+ *
+ * Every resource is tagged with the subsystem owning it, so that the live bytes of each subsystem and kind (buffers, textures,
+ * vertex arrays, framebuffers and host memory) are known at any time. The GPU and host memory can be bounded by budgets, for the
+ * whole session and for each subsystem: a warning is printed whenever a budget is exceeded. The registry can be dumped to the
+ * console. Resources released without a registry (e.g. by the tools which don't create one) are simply not accounted.
+ */
+class ResourceRegistry
+{
+public:
+    /**
+     * @brief Construct the ResourceRegistry singleton, with the default budgets.
+     */
+    ResourceRegistry();
+
+    /**
+     * @brief Destroy the ResourceRegistry singleton.
+     */
+    ~ResourceRegistry();
+
+    /**
+     * @brief Create a buffer object, accounted once its storage is allocated with bufferData or bufferStorage.
+     *
+     * @param subsystem Owner of the buffer
+     * @return GLuint
+     */
+    static GLuint createBuffer(int subsystem);
+
+    /**
+     * @brief Create a texture object, accounted once its size is set with setTextureSize.
+     *
+     * @param subsystem Owner of the texture
+     * @return GLuint
+     */
+    static GLuint createTexture(int subsystem);
+
+    /**
+     * @brief Create a vertex array object.
+     *
+     * @param subsystem Owner of the vertex array
+     * @return GLuint
+     */
+    static GLuint createVertexArray(int subsystem);
+
+    /**
+     * @brief Create a framebuffer object.
+     *
+     * @param subsystem Owner of the framebuffer
+     * @return GLuint
+     */
+    static GLuint createFramebuffer(int subsystem);
+
+    /**
+     * @brief Allocate the storage of a buffer bound to the target with glBufferData and account its size.
+     *
+     * @param buffer Buffer bound to the target
+     * @param target Binding target
+     * @param size Size in bytes
+     * @param data Initial data, or nullptr
+     * @param usage Usage hint
+     */
+    static void bufferData(GLuint buffer, GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+
+    /**
+     * @brief Allocate the immutable storage of a buffer bound to the target with glBufferStorage and account its size.
+     *
+     * @param buffer Buffer bound to the target
+     * @param target Binding target
+     * @param size Size in bytes
+     * @param data Initial data, or nullptr
+     * @param flags Storage flags
+     */
+    static void bufferStorage(GLuint buffer, GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+    /**
+     * @brief Account the size of a texture after its images have been uploaded.
+     *
+     * @param texture Texture object
+     * @param bytes Size in bytes, mip chain included
+     */
+    static void setTextureSize(GLuint texture, size_t bytes);
+
+    /**
+     * @brief Delete a buffer object and set its id to 0, nothing is done if the id is already 0.
+     *
+     * @param buffer Buffer object
+     */
+    static void releaseBuffer(GLuint &buffer);
+
+    /**
+     * @brief Delete a texture object and set its id to 0, nothing is done if the id is already 0.
+     *
+     * @param texture Texture object
+     */
+    static void releaseTexture(GLuint &texture);
+
+    /**
+     * @brief Delete a vertex array object and set its id to 0, nothing is done if the id is already 0.
+     *
+     * @param vertex_array Vertex array object
+     */
+    static void releaseVertexArray(GLuint &vertex_array);
+
+    /**
+     * @brief Delete a framebuffer object and set its id to 0, nothing is done if the id is already 0.
+     *
+     * @param framebuffer Framebuffer object
+     */
+    static void releaseFramebuffer(GLuint &framebuffer);
+
+    /**
+     * @brief Delete every OpenGL object of an Object.
+     *
+     * @param object Object whose vertex array, buffers and textures are released
+     */
+    static void releaseObject(Object &object);
+
+    /**
+     * @brief Allocate a CPU array tracked by the registry, to be released with release.
+     *
+     * @tparam T Type of the elements
+     * @param subsystem Owner of the array
+     * @param count Number of elements
+     * @return T*
+     */
+    template <typename T>
+    static T *allocate(int subsystem, size_t count)
+    {
+        T *array = new T[count];
+        track(array, subsystem, count * sizeof(T));
+        return array;
+    }
+
+    /**
+     * @brief Release a CPU array allocated by allocate and set the pointer to nullptr.
+     *
+     * @tparam T Type of the elements
+     * @param array Array, nothing is done if nullptr
+     */
+    template <typename T>
+    static void release(T *&array)
+    {
+        if (array == nullptr)
+            return;
+        untrack(array);
+        delete[] array;
+        array = nullptr;
+    }
+
+    /**
+     * @brief Track a CPU buffer owned by another container (e.g. a cv::Mat), tracking it again updates its size.
+     *
+     * @param key Address identifying the buffer
+     * @param subsystem Owner of the buffer
+     * @param bytes Size in bytes
+     */
+    static void track(const void *key, int subsystem, size_t bytes);
+
+    /**
+     * @brief Stop tracking a CPU buffer.
+     *
+     * @param key Address identifying the buffer
+     */
+    static void untrack(const void *key);
+
+    /**
+     * @brief Set the budgets of the whole session.
+     *
+     * @param gpu_bytes GPU memory budget in bytes, 0 disables it
+     * @param host_bytes Host memory budget in bytes, 0 disables it
+     */
+    static void setBudget(size_t gpu_bytes, size_t host_bytes);
+
+    /**
+     * @brief Set the budgets of a subsystem.
+     *
+     * @param subsystem Subsystem
+     * @param gpu_bytes GPU memory budget in bytes, 0 disables it
+     * @param host_bytes Host memory budget in bytes, 0 disables it
+     */
+    static void setBudget(int subsystem, size_t gpu_bytes, size_t host_bytes);
+
+    /**
+     * @brief Get the live GPU memory of a subsystem.
+     *
+     * @param subsystem Subsystem, or -1 for the whole session
+     * @return size_t Bytes
+     */
+    static size_t getGpuBytes(int subsystem = -1);
+
+    /**
+     * @brief Get the live host memory of a subsystem.
+     *
+     * @param subsystem Subsystem, or -1 for the whole session
+     * @return size_t Bytes
+     */
+    static size_t getHostBytes(int subsystem = -1);
+
+    /**
+     * @brief Print the live resources and bytes of each subsystem, the peaks and the budgets.
+     */
+    static void dump();
+
+    /**
+     * @brief Get the name of a subsystem.
+     *
+     * @param subsystem Subsystem
+     * @return const char*
+     */
+    static const char *getSubsystemName(int subsystem);
+
+private:
+    static ResourceRegistry *instance;                              ///< Used to access the ResourceRegistry object from the static functions
+
+    std::mutex mutex;                                               ///< Protects the accounting, CPU buffers are allocated by worker threads
+    std::unordered_map<uint64_t, ResourceEntry> objects;            ///< OpenGL objects, by kind and id
+    std::unordered_map<const void *, ResourceEntry> buffers;        ///< CPU buffers, by address
+
+    size_t counts[RESOURCE_SUBSYSTEMS][RESOURCE_KINDS];             ///< Live resources of each subsystem and kind
+    size_t bytes[RESOURCE_SUBSYSTEMS][RESOURCE_KINDS];              ///< Live bytes of each subsystem and kind
+    size_t gpu_peak;                                                ///< Peak of the GPU memory
+    size_t host_peak;                                               ///< Peak of the host memory
+
+    size_t gpu_budget;                                              ///< GPU memory budget of the session
+    size_t host_budget;                                             ///< Host memory budget of the session
+    size_t gpu_budgets[RESOURCE_SUBSYSTEMS];                        ///< GPU memory budget of each subsystem
+    size_t host_budgets[RESOURCE_SUBSYSTEMS];                       ///< Host memory budget of each subsystem
+    bool is_over_gpu_budget[RESOURCE_SUBSYSTEMS + 1];               ///< Whether each budget was exceeded, so that it is only warned once
+    bool is_over_host_budget[RESOURCE_SUBSYSTEMS + 1];              ///< Whether each budget was exceeded, the last one is the session
+
+    /**
+     * @brief Add an OpenGL object to the registry.
+     *
+     * @param kind Kind of object
+     * @param id Object id
+     * @param subsystem Owner of the object
+     */
+    static void add(int kind, GLuint id, int subsystem);
+
+    /**
+     * @brief Change the size of an OpenGL object.
+     *
+     * @param kind Kind of object
+     * @param id Object id
+     * @param size Size in bytes
+     */
+    static void resize(int kind, GLuint id, size_t size);
+
+    /**
+     * @brief Remove an OpenGL object from the registry.
+     *
+     * @param kind Kind of object
+     * @param id Object id
+     */
+    static void remove(int kind, GLuint id);
+
+    /**
+     * @brief Sum the live bytes of a subsystem (mutex held).
+     *
+     * @param subsystem Subsystem, or -1 for the whole session
+     * @param is_gpu Whether to sum the GPU or the host memory
+     * @return size_t Bytes
+     */
+    size_t sum(int subsystem, bool is_gpu);
+
+    /**
+     * @brief Update the peaks and warn about the exceeded budgets after the bytes of a subsystem changed (mutex held).
+     *
+     * @param subsystem Subsystem
+     * @param is_gpu Whether the GPU or the host memory changed
+     */
+    void checkBudgets(int subsystem, bool is_gpu);
+};
+
+#endif // RESOURCEREGISTRY_H
@@ -0,0 +1,118 @@
+/**
+@file
+@brief Shader source file.
+*/
+
+#include "Shader.h"
+
+
+// Default constructor
+Shader::Shader()
+{
+    this->program = 0;
+}
+
+// Destructor
+Shader::~Shader()
+{
+    release();
+}
+
+void Shader::release()
+{
+    if (this->program)
+        glDeleteProgram(this->program);
+    this->program = 0;
+}
+
+bool Shader::load(const char *vertex_path, const char *fragment_path)
+{
+    GLuint vertex_shader = compile(GL_VERTEX_SHADER, vertex_path);
+    GLuint fragment_shader = compile(GL_FRAGMENT_SHADER, fragment_path);
+    
+    if (!vertex_shader || !fragment_shader)
+    {
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        return false;
+    }
+    
+    // Link the two stages into a program
+    this->program = glCreateProgram();
+    glAttachShader(this->program, vertex_shader);
+    glAttachShader(this->program, fragment_shader);
+    glLinkProgram(this->program);
+    
+    // The shader objects are not needed anymore once linked
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    
+    // Check the link status
+    GLint status;
+    glGetProgramiv(this->program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        glGetProgramInfoLog(this->program, sizeof(log), nullptr, log);
+        std::cerr << COLOR_RED << "Failed to link " << vertex_path << " and " << fragment_path << ":\n" << log << COLOR_RESET << std::endl;
+        glDeleteProgram(this->program);
+        this->program = 0;
+        return false;
+    }
+    
+    return true;
+}
+
+GLuint Shader::compile(GLenum type, const char *path)
+{
+    // Read the whole source file
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << COLOR_RED << "Failed to open shader source " << path << COLOR_RESET << std::endl;
+        return 0;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string source = stream.str();
+    const char *source_data = source.c_str();
+    
+    // Compile the stage
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source_data, nullptr);
+    glCompileShader(shader);
+    
+    // Check the compile status
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << COLOR_RED << "Failed to compile " << path << ":\n" << log << COLOR_RESET << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    
+    return shader;
+}
+
+void Shader::use()
+{
+    glUseProgram(this->program);
+}
+
+void Shader::unuse()
+{
+    glUseProgram(0);
+}
+
+GLint Shader::getUniform(const char *name)
+{
+    return glGetUniformLocation(this->program, name);
+}
+
+GLint Shader::getAttribute(const char *name)
+{
+    return glGetAttribLocation(this->program, name);
+}
@@ -0,0 +1,89 @@
+/**
+@file
+@brief Shader header file.
+*/
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <GL/glew.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <string>
+#include "Colors.h"
+
+/**
+ * @brief Shader program class which loads, compiles and links a vertex and a fragment shader.
+ *
+ * The rest of the pipeline is still fixed function: programs are only bound around the passes that need them
+ * (e.g. the instanced vegetation) and unbound right after, so that legacy state keeps working everywhere else.
+ */
+class Shader
+{
+public:
+    /**
+     * @brief Construct a new Shader object.
+     */
+    Shader();
+
+    /**
+     * @brief Destroy the Shader object and its program, if not released yet.
+     */
+    ~Shader();
+
+    /**
+     * @brief Delete the program, must be called while the OpenGL context still exists.
+     */
+    void release();
+
+    /**
+     * @brief Load, compile and link the shader program.
+     * 
+     * @param vertex_path File path of the vertex shader source
+     * @param fragment_path File path of the fragment shader source
+     * @return true If the program was linked successfully
+     * @return false If the sources could not be read, compiled or linked
+     */
+    bool load(const char *vertex_path, const char *fragment_path);
+
+    /**
+     * @brief Bind the shader program.
+     */
+    void use();
+
+    /**
+     * @brief Unbind any shader program, restoring the fixed function pipeline.
+     */
+    static void unuse();
+
+    /**
+     * @brief Get the location of a uniform variable.
+     * 
+     * @param name Name of the uniform
+     * @return GLint 
+     */
+    GLint getUniform(const char *name);
+
+    /**
+     * @brief Get the location of a vertex attribute.
+     * 
+     * @param name Name of the attribute
+     * @return GLint 
+     */
+    GLint getAttribute(const char *name);
+
+private:
+    GLuint program; ///< Program object id
+
+    /**
+     * @brief Compile a single shader stage from a source file.
+     * 
+     * @param type Shader stage (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)
+     * @param path File path of the shader source
+     * @return GLuint The shader object id, 0 on failure
+     */
+    GLuint compile(GLenum type, const char *path);
+};
+
+#endif // SHADER_H
@@ -0,0 +1,271 @@
+/**
+@file
+@brief SketchPreview source file.
+*/
+
+#include "SketchPreview.h"
+
+
+// Default constructor
+SketchPreview::SketchPreview()
+{
+    this->has_request = false;
+    this->is_stopping = false;
+    this->is_cancelled = false;
+    this->is_pending = false;
+    this->texture = 0;
+    this->vao = 0;
+    this->vbo = 0;
+}
+
+// Destructor
+SketchPreview::~SketchPreview()
+{
+    // Stop the thread, the run in progress stops before its next convolution
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->is_stopping = true;
+        this->is_cancelled = true;
+    }
+    this->condition.notify_all();
+    if (this->thread.joinable())
+        this->thread.join();
+
+    ResourceRegistry::releaseTexture(this->texture);
+    ResourceRegistry::releaseVertexArray(this->vao);
+    ResourceRegistry::releaseBuffer(this->vbo);
+}
+
+void SketchPreview::initialize()
+{
+    // Unit quad: x, y, s, t, the first row of the preview is its top
+    const GLfloat vertices[] = {0.0f, 0.0f, 0.0f, 1.0f,
+                                1.0f, 0.0f, 1.0f, 1.0f,
+                                1.0f, 1.0f, 1.0f, 0.0f,
+                                0.0f, 1.0f, 0.0f, 0.0f};
+
+    this->vao = ResourceRegistry::createVertexArray(RESOURCE_MENU);
+    glBindVertexArray(this->vao);
+    this->vbo = ResourceRegistry::createBuffer(RESOURCE_MENU);
+    glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+    ResourceRegistry::bufferData(this->vbo, GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (void *)0);
+    glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (void *)(2 * sizeof(GLfloat)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The Python and ONNX Runtime generators are built for the full size, only the native one runs at the preview size
+    if (!this->network.load(PREVIEW_WEIGHTS_PATH))
+    {
+        printf(COLOR_YELLOW "Sketch preview disabled (%s not found)\n" COLOR_RESET, PREVIEW_WEIGHTS_PATH);
+        return;
+    }
+    this->network.setCancelFlag(&this->is_cancelled);
+    this->thread = std::thread(&SketchPreview::run, this);
+}
+
+void SketchPreview::submit(const std::vector<PreviewLayer> &layers)
+{
+    if (!this->thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->layers = layers;
+        this->request_time = std::chrono::steady_clock::now();
+        this->has_request = true;
+        this->is_cancelled = true;
+    }
+    this->condition.notify_one();
+}
+
+void SketchPreview::clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->layers.clear();
+        this->has_request = false;
+        this->is_cancelled = true;
+        this->image.release();
+        this->is_pending = false;
+    }
+    ResourceRegistry::releaseTexture(this->texture);
+}
+
+void SketchPreview::draw()
+{
+    // Upload the finished preview
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->is_pending)
+        {
+            this->is_pending = false;
+            if (this->texture == 0)
+            {
+                this->texture = ResourceRegistry::createTexture(RESOURCE_MENU);
+                glBindTexture(GL_TEXTURE_2D, this->texture);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            }
+            glBindTexture(GL_TEXTURE_2D, this->texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, this->image.cols, this->image.rows, 0, GL_RGB, GL_UNSIGNED_BYTE, this->image.data);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            ResourceRegistry::setTextureSize(this->texture, this->image.total() * 3);
+            Profiler::countUpload(this->image.total() * 3);
+            this->image.release();
+        }
+    }
+    if (this->texture == 0)
+        return;
+
+    // Right of the canvas, aligned with its top, placed in the reference frame like the canvas
+    float width = GlutFramework::getWidth();
+    float height = GlutFramework::getHeight();
+    float x = (SKETCH_AREA_X + SKETCH_AREA_SIZE + PREVIEW_MARGIN) * width / SKETCH_FRAME_WIDTH;
+    float y = (SKETCH_AREA_Y + SKETCH_AREA_SIZE - PREVIEW_DISPLAY_SIZE) * height / SKETCH_FRAME_HEIGHT;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_POLYGON_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_BLEND);
+    glEnable(GL_TEXTURE_2D);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glColor3f(1.0f, 1.0f, 1.0f);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, width, 0, height, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glTranslatef(x, y, 0.0f);
+    glScalef(PREVIEW_DISPLAY_SIZE * width / SKETCH_FRAME_WIDTH, PREVIEW_DISPLAY_SIZE * height / SKETCH_FRAME_HEIGHT, 1.0f);
+
+    glBindVertexArray(this->vao);
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+    glDrawArrays(GL_QUADS, 0, 4);
+    Profiler::countDrawCall();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+void SketchPreview::run()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->condition.wait(lock, [this] { return this->is_stopping || this->has_request; });
+
+        // Debounce: wait until no stroke has ended for PREVIEW_DEBOUNCE_MS, each new stroke moves the deadline
+        while (!this->is_stopping && this->has_request)
+        {
+            std::chrono::steady_clock::time_point deadline = this->request_time + std::chrono::milliseconds(PREVIEW_DEBOUNCE_MS);
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+            this->condition.wait_until(lock, deadline);
+        }
+        if (this->is_stopping)
+            break;
+        if (!this->has_request)
+            continue;
+
+        // Take the sketches, a submission from now on cancels this run
+        std::vector<PreviewLayer> layers = std::move(this->layers);
+        std::chrono::steady_clock::time_point request_time = this->request_time;
+        this->layers.clear();
+        this->has_request = false;
+        this->is_cancelled = false;
+        lock.unlock();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        double rasterization_ms = 0.0;
+        cv::Mat image = generate(layers, rasterization_ms);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        lock.lock();
+        if (image.empty() || this->is_cancelled)
+            continue;
+        this->image = image;
+        this->is_pending = true;
+
+        // Latency from the end of the stroke to the preview, the upload waits for the next frame
+        double debounce_ms = std::chrono::duration<double, std::milli>(start - request_time).count();
+        double generation_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        printf(COLOR_GREEN "Sketch preview ready %.0f ms after the stroke (debounce %.0f ms, rasterization %.0f ms, inference %.0f ms)\n" COLOR_RESET,
+               debounce_ms + generation_ms, debounce_ms, rasterization_ms, generation_ms - rasterization_ms);
+        fflush(stdout);
+    }
+}
+
+cv::Mat SketchPreview::generate(const std::vector<PreviewLayer> &layers, double &rasterization_ms)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Rasterize the strokes like the full generation, then area average them down to the preview size
+    std::vector<float> tensor((size_t)SKETCH_INPUT_SIZE * SKETCH_INPUT_SIZE * SKETCH_INPUT_CHANNELS, 0.0f);
+    for (int i = 0; i < (int)layers.size() && i < SKETCH_INPUT_CHANNELS; i++)
+        SketchRasterizer::rasterize(layers[i].vertices, layers[i].indices, layers[i].is_line, tensor, i, SKETCH_INPUT_SIZE);
+    cv::Mat sketches(SKETCH_INPUT_SIZE, SKETCH_INPUT_SIZE, CV_32FC4, tensor.data());
+    cv::Mat resized;
+    cv::resize(sketches, resized, cv::Size(PREVIEW_SIZE, PREVIEW_SIZE), 0, 0, cv::INTER_AREA);
+    std::vector<float> input((float *)resized.data, (float *)resized.data + resized.total() * SKETCH_INPUT_CHANNELS);
+
+    rasterization_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    cv::Mat heightmap = this->network.predict(input, PREVIEW_SEED);
+    if (heightmap.empty())
+        return cv::Mat();
+    return shade(heightmap);
+}
+
+cv::Mat SketchPreview::shade(const cv::Mat &heightmap)
+{
+    // Height tints: lowlands, highlands and summits
+    const float low[3] = {0.25f, 0.45f, 0.2f};
+    const float middle[3] = {0.55f, 0.45f, 0.3f};
+    const float high[3] = {0.95f, 0.95f, 0.95f};
+    // Light from the top left, and exaggeration of the slopes
+    const float light[3] = {-0.577f, -0.577f, 0.577f};
+    const float relief = 0.1f;
+
+    int size = heightmap.rows;
+    cv::Mat image(size, size, CV_8UC3);
+    for (int i = 0; i < size; i++)
+    {
+        const float *row = heightmap.ptr<float>(i);
+        const float *above = heightmap.ptr<float>(std::max(i - 1, 0));
+        const float *below = heightmap.ptr<float>(std::min(i + 1, size - 1));
+        unsigned char *pixel = image.ptr<unsigned char>(i);
+        for (int j = 0; j < size; j++)
+        {
+            // Normal from the central differences
+            float dx = (row[std::min(j + 1, size - 1)] - row[std::max(j - 1, 0)]) * relief;
+            float dy = (below[j] - above[j]) * relief;
+            float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+            float lighting = std::max(0.0f, (-dx * light[0] - dy * light[1] + light[2]) / length);
+
+            float t = std::min(std::max(row[j] / 255.0f, 0.0f), 1.0f);
+            for (int c = 0; c < 3; c++)
+            {
+                float tint = t < 0.5f ? low[c] + (middle[c] - low[c]) * t * 2.0f : middle[c] + (high[c] - middle[c]) * (t - 0.5f) * 2.0f;
+                pixel[j * 3 + c] = (unsigned char)std::min(255.0f, tint * (0.35f + 0.65f * lighting) * 255.0f);
+            }
+        }
+    }
+
+    return image;
+}
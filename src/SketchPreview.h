@@ -0,0 +1,131 @@
+/**
+@file
+@brief SketchPreview header file.
+*/
+
+#ifndef SKETCHPREVIEW_H
+#define SKETCHPREVIEW_H
+
+#include <GL/glew.h>
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "GlutFramework.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "SketchRasterizer.h"
+#include "UNet.h"
+#include "Colors.h"
+
+// Weights of the native generator, the same as INFERENCE_WEIGHTS_PATH
+#define PREVIEW_WEIGHTS_PATH "./neural_network/model.bin"
+// Side of the preview heightmap, about half the model input (must pass UNet::isValidSize)
+#define PREVIEW_SIZE 226
+// Time without new strokes before a preview starts, in milliseconds
+#define PREVIEW_DEBOUNCE_MS 250
+// Seed of the preview noise, fixed so that only the sketches change the preview
+#define PREVIEW_SEED 0
+// Side of the preview and space between the canvas and the preview, in reference frame pixels
+#define PREVIEW_DISPLAY_SIZE 300
+#define PREVIEW_MARGIN 60
+
+/**
+ * @brief Strokes of a sketch layer, copied for the preview thread.
+ */
+typedef struct
+{
+    std::vector<GLfloat> vertices;  ///< Normalized sketch vertices (x, y, z)
+    std::vector<GLuint> indices;    ///< Sketch indices, strokes are separated by 0xFFFFFFFF
+    bool is_line;                   ///< Whether the layer is drawn as line strips or points
+} PreviewLayer;
+
+/**
+ * @brief SketchPreview class which generates a low resolution terrain from the sketches while they are drawn.
+ *
+ * Each ended stroke submits a copy of the sketch layers to a background thread. The thread waits PREVIEW_DEBOUNCE_MS without new
+ * strokes, rasterizes the layers, shrinks them to PREVIEW_SIZE and runs its own native generator (the cache of the full
+ * generation is left untouched). A new stroke cancels the run in progress, which stops before its next convolution. The
+ * heightmap is hillshaded and tinted by height into a small image, uploaded by the main thread at the next frame and drawn
+ * right of the canvas, so the main loop never waits for the preview.
+ */
+class SketchPreview
+{
+public:
+    /**
+     * @brief Construct an empty SketchPreview object.
+     */
+    SketchPreview();
+
+    /**
+     * @brief Destroy the SketchPreview object, cancelling and joining the preview thread and releasing the texture.
+     */
+    ~SketchPreview();
+
+    /**
+     * @brief Load the native generator, start the preview thread and create the vertex array of the preview quad.
+     *
+     * Must be called once the OpenGL context exists. The preview is disabled if the native weights are missing.
+     */
+    void initialize();
+
+    /**
+     * @brief Submit the sketches to preview, cancelling the preview in progress, called by the main thread at the end of a stroke.
+     *
+     * @param layers Strokes of the sketch layers, in the channel order of the model input
+     */
+    void submit(const std::vector<PreviewLayer> &layers);
+
+    /**
+     * @brief Cancel the preview in progress and hide the preview, must be called by the main thread.
+     */
+    void clear();
+
+    /**
+     * @brief Upload the new preview if any and draw it right of the canvas, in screen coordinates.
+     */
+    void draw();
+
+private:
+    UNet network;                                           ///< Native generator of the preview, separate from the one of Inference
+    std::thread thread;                                     ///< Preview thread
+    std::mutex mutex;                                       ///< Protects the submitted sketches and the finished preview
+    std::condition_variable condition;                      ///< Wakes the preview thread up on a new submission or on stop
+    std::vector<PreviewLayer> layers;                       ///< Sketches waiting to be previewed
+    std::chrono::steady_clock::time_point request_time;     ///< End of the last stroke
+    bool has_request;                                       ///< Whether sketches are waiting to be previewed
+    bool is_stopping;                                       ///< Whether the preview thread must exit
+    std::atomic<bool> is_cancelled;                         ///< Cancels the run in progress, raised by each submission
+    cv::Mat image;                                          ///< Finished preview (RGB, 8 bit), waiting for its upload
+    bool is_pending;                                        ///< Whether the finished preview changed since the last upload
+    GLuint texture;                                         ///< Uploaded preview, 0 if none
+    GLuint vao;                                             ///< Vertex array of the preview quad
+    GLuint vbo;                                             ///< Positions and texture coordinates of the preview quad
+
+    /**
+     * @brief Preview thread: wait for the sketches, debounce, generate and publish the preview.
+     */
+    void run();
+
+    /**
+     * @brief Generate the preview of the sketches.
+     *
+     * @param layers Strokes of the sketch layers
+     * @param rasterization_ms Time spent rasterizing and shrinking the sketches
+     * @return cv::Mat Shaded preview (RGB, 8 bit), empty if the run was cancelled
+     */
+    cv::Mat generate(const std::vector<PreviewLayer> &layers, double &rasterization_ms);
+
+    /**
+     * @brief Shade a heightmap: a hillshade lit from the top left, tinted from green lowlands to brown and white highlands.
+     *
+     * @param heightmap Float heightmap with heights in [0, 255]
+     * @return cv::Mat Shaded heightmap (RGB, 8 bit)
+     */
+    static cv::Mat shade(const cv::Mat &heightmap);
+};
+
+#endif // SKETCHPREVIEW_H
@@ -0,0 +1,103 @@
+/**
+@file
+@brief SketchRasterizer source file.
+*/
+
+#include "SketchRasterizer.h"
+
+
+void SketchRasterizer::rasterize(const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices, bool is_line, std::vector<float> &tensor, int channel, int size)
+{
+    // Binary mask of the canvas area, as it was read back from the frame, scaled up with the tensor for the larger worlds
+    int mask_size = std::max(SKETCH_AREA_SIZE, (int)std::lround((double)SKETCH_AREA_SIZE * size / SKETCH_INPUT_SIZE));
+    float scale = (float)mask_size / SKETCH_AREA_SIZE;
+    cv::Mat mask = cv::Mat::zeros(mask_size, mask_size, CV_8UC1);
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (indices[i] == 0xFFFFFFFFu)
+            continue;
+
+        if (!is_line)
+            drawPoint(mask, toMask(vertices, indices[i], scale));
+        // Line strips connect each vertex to the previous one of the same stroke
+        else if (i > 0 && indices[i - 1] != 0xFFFFFFFFu)
+            drawLine(mask, toMask(vertices, indices[i - 1], scale), toMask(vertices, indices[i], scale));
+    }
+
+    // Average the mask down to the tensor size
+    cv::Mat input;
+    cv::resize(mask, input, cv::Size(size, size), 0, 0, cv::INTER_AREA);
+
+    // Write the channel, quantized like the 8 bit sketches the model was trained on
+    for (int row = 0; row < size; row++)
+    {
+        const uint8_t *pixel = input.ptr<uint8_t>(row);
+        float *output = &tensor[(size_t)row * size * SKETCH_INPUT_CHANNELS + channel];
+        for (int col = 0; col < size; col++)
+            output[col * SKETCH_INPUT_CHANNELS] = pixel[col] / 255.0f;
+    }
+}
+
+cv::Point2f SketchRasterizer::toMask(const std::vector<GLfloat> &vertices, GLuint index, float scale)
+{
+    // Scale to the reference frame, then move the origin to the top left corner of the canvas area and scale to the mask
+    float x = vertices[index * 3] * SKETCH_FRAME_WIDTH - SKETCH_AREA_X;
+    float y = SKETCH_AREA_Y + SKETCH_AREA_SIZE - vertices[index * 3 + 1] * SKETCH_FRAME_HEIGHT;
+    return cv::Point2f(x * scale, y * scale);
+}
+
+void SketchRasterizer::fill(cv::Mat &mask, int x0, int y0, int x1, int y1)
+{
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, mask.cols);
+    y1 = std::min(y1, mask.rows);
+
+    for (int row = y0; row < y1; row++)
+    {
+        uint8_t *pixel = mask.ptr<uint8_t>(row);
+        for (int col = x0; col < x1; col++)
+            pixel[col] = 255;
+    }
+}
+
+void SketchRasterizer::drawLine(cv::Mat &mask, cv::Point2f a, cv::Point2f b)
+{
+    const int half_width = (SKETCH_LINE_WIDTH - 1) / 2;
+    bool is_x_major = std::fabs(b.x - a.x) >= std::fabs(b.y - a.y);
+
+    // Walk the major axis one pixel center at a time
+    if (!is_x_major)
+    {
+        std::swap(a.x, a.y);
+        std::swap(b.x, b.y);
+    }
+    if (a.x > b.x)
+        std::swap(a, b);
+
+    float slope = b.x > a.x ? (b.y - a.y) / (b.x - a.x) : 0.0f;
+    int first = (int)std::floor(a.x);
+    int last = (int)std::floor(b.x);
+
+    for (int major = first; major <= last; major++)
+    {
+        float center = std::min(std::max(major + 0.5f, a.x), b.x);
+        int minor = (int)std::floor(a.y + (center - a.x) * slope);
+
+        // Span of SKETCH_LINE_WIDTH pixels along the minor axis
+        if (is_x_major)
+            fill(mask, major, minor - half_width, major + 1, minor - half_width + SKETCH_LINE_WIDTH);
+        else
+            fill(mask, minor - half_width, major, minor - half_width + SKETCH_LINE_WIDTH, major + 1);
+    }
+}
+
+void SketchRasterizer::drawPoint(cv::Mat &mask, cv::Point2f p)
+{
+    // Square of SKETCH_POINT_SIZE pixels around the pixel holding the point
+    const int half_size = (SKETCH_POINT_SIZE - 1) / 2;
+    int x = (int)std::floor(p.x) - half_size;
+    int y = (int)std::floor(p.y) - half_size;
+    fill(mask, x, y, x + SKETCH_POINT_SIZE, y + SKETCH_POINT_SIZE);
+}
@@ -0,0 +1,95 @@
+/**
+@file
+@brief SketchRasterizer header file.
+*/
+
+#ifndef SKETCHRASTERIZER_H
+#define SKETCHRASTERIZER_H
+
+#include <GL/glew.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Side of the model input in pixels
+#define SKETCH_INPUT_SIZE 450
+// Number of model input channels (ridges, rivers, peaks, basins)
+#define SKETCH_INPUT_CHANNELS 4
+// Reference frame the normalized sketch coordinates are scaled to, independent of the window
+#define SKETCH_FRAME_WIDTH 1920
+#define SKETCH_FRAME_HEIGHT 1080
+// Square area of the reference frame holding the canvas (bottom left corner and side, in pixels)
+#define SKETCH_AREA_X 123
+#define SKETCH_AREA_Y 140
+#define SKETCH_AREA_SIZE 800
+// Stroke sizes in reference frame pixels, shared with Renderer::drawSketch
+#define SKETCH_LINE_WIDTH 5
+#define SKETCH_POINT_SIZE 5
+
+/**
+ * @brief SketchRasterizer class which converts the sketch strokes into the model input tensor.
+ *
+ * The strokes are rasterized on the CPU into a binary mask of the canvas area of the reference frame, following the OpenGL rules
+ * for aliased wide lines (a span of SKETCH_LINE_WIDTH pixels along the minor axis for each pixel along the major axis) and square points.
+ * The mask is then area-averaged down to SKETCH_INPUT_SIZE, so the result is what the canvas looked like on screen without
+ * rendering it, reading it back or saving it to the disk.
+ * Larger worlds are rasterized at a larger size from a mask scaled up to match, so the strokes keep the width in pixels the
+ * model was trained with and the sketched features keep their scale.
+ */
+class SketchRasterizer
+{
+public:
+    /**
+     * @brief Rasterize a sketch layer into one channel of the model input tensor.
+     *
+     * @param vertices Normalized sketch vertices (x, y, z)
+     * @param indices Sketch indices, strokes are separated by 0xFFFFFFFF
+     * @param is_line Whether the layer is drawn as line strips (ridges, rivers) or points (peaks, basins)
+     * @param tensor size x size x SKETCH_INPUT_CHANNELS tensor, values in [0, 1]
+     * @param channel Channel of the tensor to write
+     * @param size Side of the tensor, SKETCH_INPUT_SIZE for the model input
+     */
+    static void rasterize(const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices, bool is_line, std::vector<float> &tensor, int channel, int size);
+
+private:
+    /**
+     * @brief Map a normalized sketch vertex into the canvas mask.
+     *
+     * @param vertices Normalized sketch vertices
+     * @param index Index of the vertex
+     * @param scale Mask pixels per reference frame pixel
+     * @return cv::Point2f Mask coordinates, with the origin in the top left corner
+     */
+    static cv::Point2f toMask(const std::vector<GLfloat> &vertices, GLuint index, float scale);
+
+    /**
+     * @brief Fill a rectangle of the mask, clipped to its borders.
+     *
+     * @param mask Canvas mask
+     * @param x0 First column
+     * @param y0 First row
+     * @param x1 Last column (excluded)
+     * @param y1 Last row (excluded)
+     */
+    static void fill(cv::Mat &mask, int x0, int y0, int x1, int y1);
+
+    /**
+     * @brief Draw an aliased wide line segment.
+     *
+     * @param mask Canvas mask
+     * @param a First end
+     * @param b Second end
+     */
+    static void drawLine(cv::Mat &mask, cv::Point2f a, cv::Point2f b);
+
+    /**
+     * @brief Draw an aliased square point.
+     *
+     * @param mask Canvas mask
+     * @param p Point center
+     */
+    static void drawPoint(cv::Mat &mask, cv::Point2f p);
+};
+
+#endif // SKETCHRASTERIZER_H
@@ -39,7 +39,7 @@ SoundManager::SoundManager()
 	printf(COLOR_CYAN "Opened \"%s\"\n" COLOR_RESET, device_name);
     
 	// Initialize sources
-	this->sources.resize(4);
+	this->sources.resize(5);
 	
 	alGenSources(1, &sources[MUSIC]);
 	alSourcef(sources[MUSIC], AL_PITCH, 1.f);
@@ -74,16 +74,6 @@ SoundManager::SoundManager()
 	alSourcef(sources[WIND_EFFECT], AL_ROLLOFF_FACTOR, 4.f);
 	alSourcef(sources[WIND_EFFECT], AL_REFERENCE_DISTANCE, 4000.f);
     
-    // Initialize buffers
-	loadSound("./assets/sounds/Menu.wav");
-	loadSound("./assets/sounds/World.wav");
-	loadSound("./assets/sounds/Click.wav");
-	loadSound("./assets/sounds/Pop.wav");
-	loadSound("./assets/sounds/Reset.wav");
-	loadSound("./assets/sounds/Success.wav");
-	loadSound("./assets/sounds/Water.wav");
-	loadSound("./assets/sounds/Wind.wav");
-	
 	// Set listener position (x, y, z)
 	ALfloat listener_position[] = { 0.0f, 0.0f, 0.0f };
 	alListenerfv(AL_POSITION, listener_position);
@@ -114,72 +104,63 @@ SoundManager::~SoundManager()
 	alDeleteSources(1, &sources[WIND_EFFECT]);
 }
 
-void SoundManager::loadSound(const char* filename)
+void SoundManager::initialize()
+{
+	const char *filenames[] = {
+		"./assets/sounds/Menu.wav",
+		"./assets/sounds/World.wav",
+		"./assets/sounds/Click.wav",
+		"./assets/sounds/Pop.wav",
+		"./assets/sounds/Reset.wav",
+		"./assets/sounds/Success.wav",
+		"./assets/sounds/Water.wav",
+		"./assets/sounds/Wind.wav"
+	};
+	
+	// Request every sound first so that they are decoded in parallel
+	std::vector<std::shared_future<std::shared_ptr<const SoundAsset>>> sounds;
+	for (const char *filename : filenames)
+		sounds.push_back(AssetManager::loadSound(filename));
+	
+	// Initialize buffers
+	for (unsigned int i = 0; i < sounds.size(); i++)
+		loadSound(filenames[i], sounds[i].get().get());
+}
+
+void SoundManager::loadSound(const char* filename, const SoundAsset *sound)
 {
 	ALenum err, format;
 	ALuint buffer;
-	SNDFILE* sndfile;
-	SF_INFO sfinfo;
-	short* membuf;
-	sf_count_t num_frames;
-	ALsizei num_bytes;
 	
-	// Open the audio file and check that it's usable
-	sndfile = sf_open(filename, SFM_READ, &sfinfo);
-	if (!sndfile)
-	{
-		fprintf(stderr, "Could not open audio in %s: %s\n", filename, sf_strerror(sndfile));
+	// The asset manager already reported why the sound couldn't be decoded
+	if (!sound)
 		return;
-	}
-	if (sfinfo.frames < 1 || sfinfo.frames >(sf_count_t)(INT_MAX / sizeof(short)) / sfinfo.channels)
-	{
-		fprintf(stderr, "Bad sample count in %s (%" PRId64 ")\n", filename, sfinfo.frames);
-		sf_close(sndfile);
-		return;
-	}
 	
 	// Get the sound format, and figure out the OpenAL format
 	format = AL_NONE;
-	if (sfinfo.channels == 1)
+	if (sound->channels == 1)
 		format = AL_FORMAT_MONO16;
-	else if (sfinfo.channels == 2)
+	else if (sound->channels == 2)
 		format = AL_FORMAT_STEREO16;
-	else if (sfinfo.channels == 3)
+	else if (sound->channels == 3)
 	{
-		if (sf_command(sndfile, SFC_WAVEX_GET_AMBISONIC, NULL, 0) == SF_AMBISONIC_B_FORMAT)
+		if (sound->is_ambisonic)
 			format = AL_FORMAT_BFORMAT2D_16;
 	}
-	else if (sfinfo.channels == 4)
+	else if (sound->channels == 4)
 	{
-		if (sf_command(sndfile, SFC_WAVEX_GET_AMBISONIC, NULL, 0) == SF_AMBISONIC_B_FORMAT)
+		if (sound->is_ambisonic)
 			format = AL_FORMAT_BFORMAT3D_16;
 	}
 	if (!format)
 	{
-		fprintf(stderr, "Unsupported channel count: %d\n", sfinfo.channels);
-		sf_close(sndfile);
-		return;
-	}
-
-	// Decode the whole audio file to a buffer
-	membuf = static_cast<short*>(malloc((size_t)(sfinfo.frames * sfinfo.channels) * sizeof(short)));
-
-	num_frames = sf_readf_short(sndfile, membuf, sfinfo.frames);
-	if (num_frames < 1)
-	{
-		free(membuf);
-		sf_close(sndfile);
-		fprintf(stderr, "Failed to read samples in %s (%" PRId64 ")\n", filename, num_frames);
+		fprintf(stderr, "Unsupported channel count in %s: %d\n", filename, sound->channels);
 		return;
 	}
-	num_bytes = (ALsizei)(num_frames * sfinfo.channels) * (ALsizei)sizeof(short);
 	
-	//Buffer the audio data into a new buffer object, then free the data and close the file
+	//Buffer the audio data into a new buffer object
 	alGenBuffers(1, &buffer);
-	alBufferData(buffer, format, membuf, num_bytes, sfinfo.samplerate);
-
-	free(membuf);
-	sf_close(sndfile);
+	alBufferData(buffer, format, sound->samples.data(), (ALsizei)(sound->samples.size() * sizeof(short)), sound->sample_rate);
 	
 	// Check if an error occured, and clean up if so
 	err = alGetError();
@@ -14,6 +14,7 @@
 #include <climits> 
 #include <iostream>
 #include <vector>
+#include "AssetManager.h"
 #include "Colors.h"
 #include "Constants.h"
 #include "Vec.hpp"
@@ -34,6 +35,11 @@ public:
      * @brief Destroy the Sound Manager object
      */
     ~SoundManager();
+
+    /**
+     * @brief Create the audio buffers from the sounds decoded by the asset manager.
+     */
+    void initialize();
     
     /**
      * @brief Update the listener's position for 3D positional audio of water and wind sound effects.
@@ -77,11 +83,12 @@ private:
     std::vector<ALuint> sources;    ///< OpenAL sources vector containing the sources of the audio
     
     /**
-     * @brief Load the sound from the wav file.
+     * @brief Create an audio buffer from a decoded sound.
      * 
-     * @param filename File path of the wav file
+     * @param filename File path of the wav file, used for error reporting
+     * @param sound Sound decoded by the asset manager
      */
-    void loadSound(const char* filename);
+    void loadSound(const char* filename, const SoundAsset *sound);
 };
 
 #endif
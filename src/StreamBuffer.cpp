@@ -0,0 +1,181 @@
+/**
+@file
+@brief StreamBuffer source file.
+*/
+
+#include "StreamBuffer.h"
+
+
+std::vector<StreamBuffer *> StreamBuffer::stream_buffers;
+StreamStats StreamBuffer::current_stats = {0, 0, 0};
+StreamStats StreamBuffer::frame_stats = {0, 0, 0};
+
+// Default constructor
+StreamBuffer::StreamBuffer()
+{
+    this->buffer = 0;
+    this->region_size = 0;
+    this->is_persistent = false;
+    this->mapping = nullptr;
+    this->region = 0;
+    this->head = 0;
+    for (int i = 0; i < STREAM_REGIONS; i++)
+        this->fences[i] = nullptr;
+}
+
+// Destructor
+StreamBuffer::~StreamBuffer()
+{
+    stream_buffers.erase(std::remove(stream_buffers.begin(), stream_buffers.end(), this), stream_buffers.end());
+    release();
+}
+
+void StreamBuffer::initialize(GLsizeiptr region_size)
+{
+    allocate(region_size);
+    stream_buffers.push_back(this);
+}
+
+void StreamBuffer::allocate(GLsizeiptr region_size)
+{
+    this->region_size = region_size;
+    this->region = 0;
+    this->head = 0;
+    this->is_persistent = GLEW_ARB_buffer_storage;
+
+    this->buffer = ResourceRegistry::createBuffer(RESOURCE_STREAMING);
+    glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+
+    if (this->is_persistent)
+    {
+        // Immutable storage mapped once for the whole lifetime of the buffer
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        ResourceRegistry::bufferStorage(this->buffer, GL_ARRAY_BUFFER, region_size * STREAM_REGIONS, nullptr, flags);
+        this->mapping = static_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, region_size * STREAM_REGIONS, flags));
+    }
+    else
+    {
+        ResourceRegistry::bufferData(this->buffer, GL_ARRAY_BUFFER, region_size * STREAM_REGIONS, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StreamBuffer::retire()
+{
+    for (int i = 0; i < STREAM_REGIONS; i++)
+    {
+        if (this->fences[i])
+            glDeleteSync(this->fences[i]);
+        this->fences[i] = nullptr;
+    }
+
+    if (this->buffer)
+    {
+        if (this->mapping)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            this->mapping = nullptr;
+        }
+        this->retired_buffers.push_back(this->buffer);
+        this->buffer = 0;
+    }
+}
+
+void StreamBuffer::release()
+{
+    retire();
+
+    // The driver keeps the storage alive until the GPU is done with it
+    for (GLuint &buffer : this->retired_buffers)
+        ResourceRegistry::releaseBuffer(buffer);
+    this->retired_buffers.clear();
+}
+
+void StreamBuffer::waitRegion()
+{
+    GLsync &fence = this->fences[this->region];
+    if (!fence)
+        return;
+
+    // Only count the waits which actually block
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        current_stats.sync_waits++;
+        do
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        while (status == GL_TIMEOUT_EXPIRED);
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+GLintptr StreamBuffer::upload(GLenum target, const void *data, GLsizeiptr size)
+{
+    // The first upload of the frame makes sure the GPU is done with the region
+    if (this->head == 0)
+        waitRegion();
+
+    // If the frame outgrows its region, move to a bigger ring: the old buffer may still be referenced by the draw calls
+    // issued earlier in this frame, so it is only deleted at the end of the frame
+    if (this->head + size > this->region_size)
+    {
+        GLsizeiptr required = this->head + size;
+        retire();
+        allocate(std::max(this->region_size * 2, required * 2));
+        printf(COLOR_YELLOW "Stream buffer grown to %ld bytes per frame\n" COLOR_RESET, (long)this->region_size);
+    }
+
+    GLintptr offset = this->region * this->region_size + this->head;
+
+    glBindBuffer(target, this->buffer);
+    if (this->is_persistent)
+    {
+        memcpy(this->mapping + offset, data, size);
+    }
+    else
+    {
+        // Fences guarantee the range is not in use anymore, so no implicit synchronization is needed
+        void *pointer = glMapBufferRange(target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        memcpy(pointer, data, size);
+        glUnmapBuffer(target);
+    }
+
+    this->head += (size + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+
+    current_stats.bytes_streamed += size;
+    current_stats.uploads++;
+
+    return offset;
+}
+
+void StreamBuffer::endFrame()
+{
+    for (StreamBuffer *stream_buffer : stream_buffers)
+    {
+        // Delete the buffers replaced by a bigger ring during the frame
+        for (GLuint &buffer : stream_buffer->retired_buffers)
+            ResourceRegistry::releaseBuffer(buffer);
+        stream_buffer->retired_buffers.clear();
+
+        // Nothing was written in this region, no need to fence it
+        if (stream_buffer->head == 0)
+            continue;
+
+        stream_buffer->fences[stream_buffer->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        stream_buffer->region = (stream_buffer->region + 1) % STREAM_REGIONS;
+        stream_buffer->head = 0;
+    }
+
+    frame_stats = current_stats;
+    current_stats = {0, 0, 0};
+}
+
+StreamStats StreamBuffer::getStats()
+{
+    return frame_stats;
+}
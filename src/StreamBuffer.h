@@ -0,0 +1,121 @@
+/**
+@file
+@brief StreamBuffer header file.
+*/
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <GL/glew.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "ResourceRegistry.h"
+#include "Colors.h"
+
+// Number of frames the ring can hold before the CPU has to wait for the GPU
+#define STREAM_REGIONS 3
+// Alignment of each upload inside the ring
+#define STREAM_ALIGNMENT 256
+
+/**
+ * @brief Streaming statistics of a frame.
+ */
+typedef struct
+{
+    size_t bytes_streamed;  ///< Bytes written into the stream buffers
+    int uploads;            ///< Number of uploads
+    int sync_waits;         ///< Number of times the CPU had to wait for the GPU to release a region
+} StreamStats;
+
+/**
+ * @brief Ring buffer used to stream per-frame vertex data to the GPU.
+ *
+ * The buffer is split into STREAM_REGIONS regions, one per frame in flight. Each frame appends its uploads to the current region;
+ * at the end of the frame the region is fenced and the next one is used, waiting for its fence only if the GPU is still reading it.
+ * When ARB_buffer_storage is available the whole ring is persistently and coherently mapped once, otherwise each upload maps its
+ * range unsynchronized (the fences still guarantee the GPU is done with it). Nothing is reallocated unless a frame outgrows its region.
+ */
+class StreamBuffer
+{
+public:
+    /**
+     * @brief Construct a new Stream Buffer object.
+     */
+    StreamBuffer();
+
+    /**
+     * @brief Destroy the Stream Buffer object.
+     */
+    ~StreamBuffer();
+
+    /**
+     * @brief Allocate the ring.
+     *
+     * @param region_size Initial size in bytes of the data streamed in a single frame
+     */
+    void initialize(GLsizeiptr region_size);
+
+    /**
+     * @brief Copy data into the ring and leave the buffer bound to the target.
+     *
+     * @param target Binding target of the data (e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER)
+     * @param data Source data
+     * @param size Size in bytes of the data
+     * @return GLintptr Offset of the data in the buffer, to be used in the gl*Pointer and glDraw* calls
+     */
+    GLintptr upload(GLenum target, const void *data, GLsizeiptr size);
+
+    /**
+     * @brief Fence the regions written in this frame and move every stream buffer to the next region.
+     *
+     * Must be called once per frame, after the draw calls using the streamed data have been issued.
+     */
+    static void endFrame();
+
+    /**
+     * @brief Get the streaming statistics of the last completed frame.
+     *
+     * @return StreamStats
+     */
+    static StreamStats getStats();
+
+private:
+    GLuint buffer;                      ///< Buffer object id
+    GLsizeiptr region_size;             ///< Size in bytes of a region
+    bool is_persistent;                 ///< Whether the ring is persistently mapped
+    char *mapping;                      ///< Persistent mapping of the whole ring
+    int region;                         ///< Region written in the current frame
+    GLintptr head;                      ///< Write offset inside the current region
+    GLsync fences[STREAM_REGIONS];      ///< Fences signaled when the GPU is done reading each region
+    std::vector<GLuint> retired_buffers; ///< Buffers replaced during the frame, deleted at its end
+
+    static std::vector<StreamBuffer *> stream_buffers;  ///< Every initialized stream buffer
+    static StreamStats current_stats;                   ///< Statistics of the frame being recorded
+    static StreamStats frame_stats;                     ///< Statistics of the last completed frame
+
+    /**
+     * @brief (Re)allocate the buffer object with the given region size.
+     *
+     * @param region_size Size in bytes of a region
+     */
+    void allocate(GLsizeiptr region_size);
+
+    /**
+     * @brief Unmap the buffer object, drop its fences and schedule it for deletion at the end of the frame.
+     */
+    void retire();
+
+    /**
+     * @brief Release the buffer object, its mapping and its fences immediately.
+     */
+    void release();
+
+    /**
+     * @brief Wait until the GPU is done reading the current region.
+     */
+    void waitRegion();
+};
+
+#endif // STREAMBUFFER_H
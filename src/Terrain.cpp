@@ -9,6 +9,9 @@
 // Default constructor
 Terrain::Terrain()
 {
+    this->heightmap = nullptr;
+    this->watermap = nullptr;
+    
     // Initialize the texture tiles
     this->tiles[0].region = HeightRegion{0.0f, 0.20f, 0.30f};
     this->tiles[1].region = HeightRegion{0.15f, 0.35f, 0.45f};
@@ -16,39 +19,55 @@ Terrain::Terrain()
     this->tiles[3].region = HeightRegion{0.50f, 0.70f, 0.80f};
     this->tiles[4].region = HeightRegion{0.70f, 0.85f, 0.90f};
     this->tiles[5].region = HeightRegion{0.85f, 0.95f, 1.0f};
-    
-    this->tiles[0].texture = cv::imread("assets/textures/1.jpg", cv::IMREAD_COLOR);
-    this->tiles[1].texture = cv::imread("assets/textures/2.jpg", cv::IMREAD_COLOR);
-    this->tiles[2].texture = cv::imread("assets/textures/3.jpg", cv::IMREAD_COLOR);
-    this->tiles[3].texture = cv::imread("assets/textures/4.jpg", cv::IMREAD_COLOR);
-    this->tiles[4].texture = cv::imread("assets/textures/5.jpg", cv::IMREAD_COLOR);
-    this->tiles[5].texture = cv::imread("assets/textures/6.jpg", cv::IMREAD_COLOR);
 }
 
 // Destructor
 Terrain::~Terrain()
 {
-    delete[] heightmap;
+    ResourceRegistry::release(this->heightmap);
+    ResourceRegistry::release(this->watermap);
+    releaseTexture();
 }
 
 // Parametrized constructor
 void Terrain::initialize(float world_scale, float texture_scale)
 {
-    this->world_scale = world_scale;
-    this->texture_scale = texture_scale;
+    // Load the terrain heightmap using opencv library
+    initialize(world_scale, texture_scale, cv::imread("./assets/sketches/heightmap.png", cv::IMREAD_GRAYSCALE));
+}
+
+void Terrain::initialize(float world_scale, float texture_scale, const cv::Mat &image)
+{
+    setScale(world_scale, texture_scale);
     
-    loadHeightmap();
+    loadHeightmap(image);
     loadTexture();
     loadWatermap();
+    
+    printf("Water level: %d\n", this->water_level);
 }
 
-void Terrain::loadHeightmap()
+void Terrain::setScale(float world_scale, float texture_scale)
 {
-    // Load the terrain heightmap using opencv library
-    cv::Mat image = cv::imread("./assets/sketches/heightmap.png", cv::IMREAD_GRAYSCALE);
+    this->world_scale = world_scale;
+    this->texture_scale = texture_scale;
+    
+    // Retrieve the texture tiles, decoded once by the asset manager and shared by every terrain
+    for (int i = 0; i < 6; i++)
+        this->tiles[i].texture = AssetManager::loadImage("./assets/textures/" + std::to_string(i + 1) + ".jpg", cv::IMREAD_COLOR).get();
+}
+
+void Terrain::loadHeightmap(const cv::Mat &source)
+{
+    // Check for an error during the load process
+    assert(!source.empty());
+
+    // Work on float heights, so that the generated heightmaps aren't quantized to 8 bits
+    cv::Mat image;
+    source.convertTo(image, CV_32F);
     cv::GaussianBlur(image, image, cv::Size(5, 5), 0); // Adjust the kernel size (5, 5) as needed
 
-    unsigned char* data = image.data;
+    const float* data = image.ptr<float>();
     
     // Check for an error during the load process
     assert(data != nullptr);
@@ -59,8 +78,9 @@ void Terrain::loadHeightmap()
     // Assign one image side to the dim attribute for storing the heightmap lenght
     this->dim = image.rows;
 
-    // Allocate memory for the height map
-    this->heightmap = new Vec3<float>[this->dim * this->dim];
+    // Allocate memory for the height map, releasing the previous one
+    ResourceRegistry::release(this->heightmap);
+    this->heightmap = ResourceRegistry::allocate<Vec3<float>>(RESOURCE_TERRAIN, this->dim * this->dim);
     
     // Initialize the bounds struct
     this->bounds.min_x = FLT_MAX;
@@ -114,12 +134,11 @@ void Terrain::loadWatermap()
     // Find the index corresponding to the 10th percentile
     int percentile_index = static_cast<int>(this->dim * this->dim * FLOODING_FACTOR);
     
-    printf("Water level: %d\n", heights[percentile_index]);
-    
     // The value at the percentile index will be your water level
     this->water_level = heights[percentile_index];
     
-    this->watermap = new Vec3<float>[this->dim * this->dim];
+    ResourceRegistry::release(this->watermap);
+    this->watermap = ResourceRegistry::allocate<Vec3<float>>(RESOURCE_WATER, this->dim * this->dim);
     
     // Fill in the height map
     for (int i = 0; i < this->dim; i++)
@@ -136,9 +155,24 @@ void Terrain::loadWatermap()
 
 void Terrain::loadTexture()
 {    
+    // Key of the baked texture: a world is defined by its heightmap, the texture scale and the tiles
+    std::string key = "terrain|" + std::to_string(BlockCompressor::hash(this->heightmap, this->dim * this->dim * sizeof(Vec3<float>))) + "|" + std::to_string(this->texture_scale);
+    for (int i = 0; i < 6; i++)
+        key += "|" + BlockCompressor::getFileKey("./assets/textures/" + std::to_string(i + 1) + ".jpg");
+    
+    // Skip the baking altogether if this world has already been baked and compressed
+    releaseTexture();
+    if (BlockCompressor::isSupported() && BlockCompressor::load(key, this->compressed_texture))
+    {
+        ResourceRegistry::track(&this->compressed_texture, RESOURCE_TERRAIN, getCompressedSize());
+        printf(COLOR_GREEN "Terrain texture loaded from the cache\n" COLOR_RESET);
+        return;
+    }
+    
     short original_texture_size = tiles[0].texture.rows;
     // Allocate memory for the opencv texture map based on texture_1 size
     this->texture.create(original_texture_size * texture_scale, original_texture_size * texture_scale, CV_8UC3);
+    ResourceRegistry::track(&this->texture, RESOURCE_TERRAIN, this->texture.total() * this->texture.elemSize());
     float terrain_texture_ratio = (float)(this->dim / (float) texture.rows);
     
     int i_map;
@@ -199,6 +233,31 @@ void Terrain::loadTexture()
     }
     // Write texture to file
     // cv::imwrite("./assets/terrain_texture.png", texture);
+    
+    // Compress the texture and its mip chain and cache them for the next time this world is generated
+    if (BlockCompressor::isSupported())
+    {
+        this->compressed_texture = BlockCompressor::compress(this->texture, false);
+        BlockCompressor::save(key, this->compressed_texture);
+        ResourceRegistry::track(&this->compressed_texture, RESOURCE_TERRAIN, getCompressedSize());
+    }
+}
+
+void Terrain::releaseTexture()
+{
+    // Swap the levels out to free their storage
+    std::vector<CompressedLevel>().swap(this->compressed_texture.levels);
+    this->texture.release();
+    ResourceRegistry::untrack(&this->compressed_texture);
+    ResourceRegistry::untrack(&this->texture);
+}
+
+size_t Terrain::getCompressedSize()
+{
+    size_t bytes = 0;
+    for (const CompressedLevel &level : this->compressed_texture.levels)
+        bytes += level.data.size();
+    return bytes;
 }
 
 // Return the height map
@@ -224,6 +283,13 @@ cv::Mat Terrain::getTexture()
     return texture;
 }
 
+CompressedTexture *Terrain::getCompressedTexture()
+{
+    if (this->compressed_texture.levels.empty())
+        return nullptr;
+    return &this->compressed_texture;
+}
+
 // Return the dimension of the height map
 int Terrain::getDim()
 {
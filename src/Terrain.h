@@ -9,6 +9,9 @@
 #include "Vec.hpp"
 #include "Constants.h"
 #include "Colors.h"
+#include "AssetManager.h"
+#include "BlockCompressor.h"
+#include "ResourceRegistry.h"
 #include <cmath>
 #include <opencv2/opencv.hpp>
 #include <vector>
@@ -71,6 +74,24 @@ public:
 	 */
 	void initialize(float world_scale, float texture_scale);
 
+	/**
+	 * @brief Initialize the terrain from a given heightmap instead of the generated png file.
+	 * 
+	 * @param world_scale World scale factor of the terrain.
+	 * @param texture_scale Texture scale factor of the terrain.
+	 * @param image Square 8 bit or float grayscale heightmap, heights in [0, 255].
+	 */
+	void initialize(float world_scale, float texture_scale, const cv::Mat &image);
+
+	/**
+	 * @brief Set the scale factors and retrieve the texture tiles, the first step of initialize for the callers running the
+	 * loadHeightmap, loadTexture and loadWatermap stages one by one.
+	 * 
+	 * @param world_scale World scale factor of the terrain.
+	 * @param texture_scale Texture scale factor of the terrain.
+	 */
+	void setScale(float world_scale, float texture_scale);
+
 	/**
 	 * @brief Get the Heightmap object.
 	 * 
@@ -98,6 +119,13 @@ public:
 	 * @return cv::Mat 
 	 */
 	cv::Mat getTexture();
+
+	/**
+	 * @brief Get the block-compressed texture, if the driver supports it.
+	 * 
+	 * @return CompressedTexture* nullptr if the texture is only available uncompressed
+	 */
+	CompressedTexture *getCompressedTexture();
 	
 	/**
 	 * @brief Get the lenght of the heightmap png.
@@ -142,6 +170,28 @@ public:
 	 */
 	float distanceFromWater(Vec3<float> position);
 
+	/**
+	 * @brief Generate the 3D heightmap from a grayscale image.
+	 * 
+	 * @param source Square 8 bit or float grayscale heightmap, heights in [0, 255].
+	 */
+	void loadHeightmap(const cv::Mat &source);
+
+	/**
+	 * @brief Generate the watermap at the water level, which is calculated as a constant percentile of the terrain heightmap. 
+	 */
+	void loadWatermap();
+
+	/**
+	 * @brief Generate the terrain texture by interpolating the tiles based on the different terrain heights.
+	 */
+	void loadTexture();
+
+	/**
+	 * @brief Release the baked texture and its compressed mip chain, once they have been uploaded.
+	 */
+	void releaseTexture();
+
 private:
 	int dim;								///< Lenght of the heightmap
 	float world_scale;						///< World scale factor
@@ -152,22 +202,15 @@ private:
 	Vec3<float> *heightmap;					///< Heightmap reference
 	Vec3<float> *watermap;					///< Watermap reference
 	cv::Mat texture;						///< OpenCV terrain texture
+	CompressedTexture compressed_texture;	///< Block-compressed terrain texture with its mip chain
 	TextureTile tiles[6];					///< Array of texture tiles used for interpolation
-	
-	/**
-	 * @brief Generate the 3D heightmap from the png file.
-	 */
-	void loadHeightmap();
 
 	/**
-	 * @brief Generate the watermap at the water level, which is calculated as a constant percentile of the terrain heightmap. 
-	 */
-	void loadWatermap();
-
-	/**
-	 * @brief Generate the terrain texture by interpolating the tiles based on the different terrain heights.
+	 * @brief Get the size of the compressed mip chain.
+	 * 
+	 * @return size_t Bytes
 	 */
-	void loadTexture();
+	size_t getCompressedSize();
 };
 
 #endif
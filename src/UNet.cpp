@@ -0,0 +1,572 @@
+/**
+@file
+@brief UNet source file.
+*/
+
+#include "UNet.h"
+
+
+// Kernel side, input and output channels of each convolution, in the order TerrainGANBuilder creates them
+static const int architecture[UNET_LAYERS][3] = {
+    {3, 4, 64}, {3, 64, 64}, {3, 64, 128}, {3, 128, 128}, {3, 128, 256}, {3, 256, 256}, {3, 256, 512}, {3, 512, 512},
+    {3, 512, 1024}, {3, 1024, 1024},
+    {2, 2048, 512}, {3, 1024, 512}, {3, 512, 512},
+    {2, 512, 256}, {3, 512, 256}, {3, 256, 256},
+    {2, 256, 128}, {3, 256, 128}, {3, 128, 128},
+    {2, 128, 64}, {3, 128, 64}, {3, 64, 64}, {3, 64, 32}, {1, 32, 1}};
+
+// Accumulate a block of input channels into a tile, for a full tile of output channels (unrolled and vectorized)
+template <int CHANNELS>
+static inline void accumulate(float (&tile)[UNET_TILE_PIXELS][UNET_TILE_CHANNELS], const float *const (&pixels)[UNET_TILE_PIXELS],
+                              const float *__restrict weights, int block_channels, int out_channels)
+{
+    for (int ci = 0; ci < block_channels; ci++, weights += out_channels)
+        for (int p = 0; p < UNET_TILE_PIXELS; p++)
+        {
+            const float value = pixels[p][ci];
+            for (int c = 0; c < CHANNELS; c++)
+                tile[p][c] += value * weights[c];
+        }
+}
+
+// Same for the last tile of a layer whose output channels aren't a multiple of the tile
+static inline void accumulate(float (&tile)[UNET_TILE_PIXELS][UNET_TILE_CHANNELS], const float *const (&pixels)[UNET_TILE_PIXELS],
+                              const float *__restrict weights, int block_channels, int out_channels, int channels)
+{
+    for (int ci = 0; ci < block_channels; ci++, weights += out_channels)
+        for (int p = 0; p < UNET_TILE_PIXELS; p++)
+        {
+            const float value = pixels[p][ci];
+            for (int c = 0; c < channels; c++)
+                tile[p][c] += value * weights[c];
+        }
+}
+
+// Default constructor
+UNet::UNet()
+{
+    this->mapping = nullptr;
+    this->mapping_size = 0;
+    this->layers = nullptr;
+    this->thread_count = std::max(1, (int)std::thread::hardware_concurrency());
+    this->band_count = 0;
+    this->pending_bands = 0;
+    this->convolution_index = 0;
+    this->is_stopping = false;
+    this->cancel_flag = nullptr;
+}
+
+// Destructor
+UNet::~UNet()
+{
+    stopWorkers();
+    clearCache();
+    release();
+}
+
+bool UNet::load(const std::string &path)
+{
+    clearCache();
+    release();
+
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        this->mapping_size = file_stat.st_size;
+        this->mapping = mmap(nullptr, this->mapping_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (this->mapping == MAP_FAILED)
+            this->mapping = nullptr;
+    }
+    close(file);
+
+    // Header: magic, version, number of layers and padding, followed by the descriptors
+    const char *bytes = static_cast<const char *>(this->mapping);
+    const uint32_t *header = reinterpret_cast<const uint32_t *>(bytes);
+    bool is_valid = this->mapping != nullptr && this->mapping_size >= 16 + UNET_LAYERS * sizeof(UNetLayer) &&
+                    memcmp(bytes, UNET_MAGIC, 4) == 0 && header[1] == UNET_VERSION && header[2] == UNET_LAYERS;
+
+    // Check every layer against the architecture and the bounds of the file
+    this->layers = is_valid ? reinterpret_cast<const UNetLayer *>(bytes + 16) : nullptr;
+    for (int layer = 0; is_valid && layer < UNET_LAYERS; layer++)
+    {
+        const UNetLayer &descriptor = this->layers[layer];
+        uint64_t kernel_size = (uint64_t)descriptor.kernel_height * descriptor.kernel_width * descriptor.in_channels * descriptor.out_channels * sizeof(float);
+        is_valid = descriptor.kernel_height == (uint32_t)architecture[layer][0] && descriptor.kernel_width == (uint32_t)architecture[layer][0] &&
+                   descriptor.in_channels == (uint32_t)architecture[layer][1] && descriptor.out_channels == (uint32_t)architecture[layer][2] &&
+                   descriptor.kernel_offset % sizeof(float) == 0 && descriptor.bias_offset % sizeof(float) == 0 &&
+                   descriptor.kernel_offset + kernel_size <= this->mapping_size &&
+                   descriptor.bias_offset + descriptor.out_channels * sizeof(float) <= this->mapping_size;
+    }
+
+    if (!is_valid)
+    {
+        if (this->mapping != nullptr)
+            std::cerr << COLOR_RED << "The weights " << path << " don't match the generator architecture" << COLOR_RESET << std::endl;
+        release();
+        return false;
+    }
+
+    // The whole file is read by every prediction
+    madvise(this->mapping, this->mapping_size, MADV_WILLNEED);
+    ResourceRegistry::track(this->mapping, RESOURCE_INFERENCE, this->mapping_size);
+    startWorkers();
+    printf(COLOR_GREEN "Native generator loaded from %s (%.1f MB)\n" COLOR_RESET, path.c_str(), this->mapping_size / (1024.0 * 1024.0));
+    return true;
+}
+
+bool UNet::isLoaded()
+{
+    return this->mapping != nullptr;
+}
+
+cv::Mat UNet::predict(const std::vector<float> &input, uint32_t seed)
+{
+    int size = (int)std::lround(std::sqrt(input.size() / (double)UNET_INPUT_CHANNELS));
+    if (!isLoaded() || !isValidSize(size) || input.size() != (size_t)size * size * UNET_INPUT_CHANNELS)
+        return cv::Mat();
+
+    // The encoder only depends on the sketches, a re-roll of the same sketches only runs the decoder
+    if (!isCached(input))
+        encode(input, size);
+    if (isCancelled())
+        return cv::Mat();
+    fillNoise(seed, getView(bottom, UNET_NOISE_CHANNELS));
+    cv::Mat heightmap = decode();
+    return isCancelled() ? cv::Mat() : heightmap;
+}
+
+bool UNet::isValidSize(int size)
+{
+    // Each max pooling halves the size (rounding down) and each upsampling doubles it, the third up block pads a row and a column
+    int size2 = size / 2, size3 = size2 / 2, size4 = size3 / 2, size5 = size4 / 2;
+    return size5 > 0 && size2 * 2 == size && size3 * 2 + 1 == size2 && size4 * 2 == size3 && size5 * 2 == size4;
+}
+
+bool UNet::isCached(const std::vector<float> &input)
+{
+    return !this->encoded_input.empty() && this->encoded_input.size() == input.size() &&
+           memcmp(this->encoded_input.data(), input.data(), input.size() * sizeof(float)) == 0;
+}
+
+void UNet::clearCache()
+{
+    if (this->encoded_input.empty())
+        return;
+    ResourceRegistry::untrack(&this->encoded_input);
+    for (UNetTensor *tensor : {&merge1, &merge2, &merge3, &merge4, &bottom})
+        *tensor = UNetTensor();
+    this->encoded_input = std::vector<float>();
+}
+
+void UNet::setCancelFlag(const std::atomic<bool> *cancel_flag)
+{
+    this->cancel_flag = cancel_flag;
+}
+
+void UNet::encode(const std::vector<float> &input, int size)
+{
+    const int size2 = size / 2, size3 = size2 / 2, size4 = size3 / 2, size5 = size4 / 2;
+    clearCache();
+
+    // The skip connections are written straight into the concatenations of the up blocks, in front of the upsampled path
+    UNetView image = {const_cast<float *>(input.data()), size, size, UNET_INPUT_CHANNELS, UNET_INPUT_CHANNELS};
+    merge1 = createTensor(size, size, 128);
+    merge2 = createTensor(size2, size2, 256);
+    merge3 = createTensor(size3, size3, 512);
+    merge4 = createTensor(size4, size4, 1024);
+    bottom = createTensor(size5, size5, 2 * UNET_NOISE_CHANNELS);
+
+    // Down blocks
+    {
+        UNetTensor conv = createTensor(size, size, 64);
+        convolve(0, image, getView(conv), UNET_RELU);
+        convolve(1, getView(conv), getView(merge1, 0, 64), UNET_RELU);
+    }
+    {
+        UNetTensor pool = createTensor(size2, size2, 64);
+        UNetTensor conv = createTensor(size2, size2, 128);
+        maxPool(getView(merge1, 0, 64), getView(pool));
+        convolve(2, getView(pool), getView(conv), UNET_RELU);
+        convolve(3, getView(conv), getView(merge2, 0, 128), UNET_RELU);
+    }
+    {
+        UNetTensor pool = createTensor(size3, size3, 128);
+        UNetTensor conv = createTensor(size3, size3, 256);
+        maxPool(getView(merge2, 0, 128), getView(pool));
+        convolve(4, getView(pool), getView(conv), UNET_RELU);
+        convolve(5, getView(conv), getView(merge3, 0, 256), UNET_RELU);
+    }
+    {
+        UNetTensor pool = createTensor(size4, size4, 256);
+        UNetTensor conv = createTensor(size4, size4, 512);
+        maxPool(getView(merge3, 0, 256), getView(pool));
+        convolve(6, getView(pool), getView(conv), UNET_RELU);
+        convolve(7, getView(conv), getView(merge4, 0, 512), UNET_RELU);
+    }
+    {
+        UNetTensor pool = createTensor(size5, size5, 512);
+        UNetTensor conv = createTensor(size5, size5, 1024);
+        maxPool(getView(merge4, 0, 512), getView(pool));
+        convolve(8, getView(pool), getView(conv), UNET_RELU);
+        convolve(9, getView(conv), getView(bottom, 0, UNET_NOISE_CHANNELS), UNET_RELU);
+    }
+
+    // Never keep the outputs of a cancelled run
+    if (isCancelled())
+    {
+        for (UNetTensor *tensor : {&merge1, &merge2, &merge3, &merge4, &bottom})
+            *tensor = UNetTensor();
+        return;
+    }
+
+    // The decoder only writes the channels after the skip connections, so the encoder outputs stay valid until the sketches change
+    this->encoded_input = input;
+    size_t bytes = input.size();
+    for (UNetTensor *tensor : {&merge1, &merge2, &merge3, &merge4, &bottom})
+        bytes += tensor->data.size();
+    ResourceRegistry::track(&this->encoded_input, RESOURCE_INFERENCE, bytes * sizeof(float));
+}
+
+cv::Mat UNet::decode()
+{
+    const int size = merge1.height, size2 = merge2.height, size3 = merge3.height, size4 = merge4.height;
+
+    // Up blocks
+    UNetTensor block1 = createTensor(size4, size4, 512);
+    {
+        UNetTensor upsampled = createTensor(size4, size4, 2048);
+        UNetTensor conv = createTensor(size4, size4, 512);
+        upsample(getView(bottom), getView(upsampled));
+        convolve(10, getView(upsampled), getView(merge4, 512), UNET_RELU);
+        convolve(11, getView(merge4), getView(conv), UNET_LINEAR);
+        convolve(12, getView(conv), getView(block1), UNET_LINEAR);
+    }
+    UNetTensor block2 = createTensor(size3, size3, 256);
+    {
+        UNetTensor upsampled = createTensor(size3, size3, 512);
+        UNetTensor conv = createTensor(size3, size3, 256);
+        upsample(getView(block1), getView(upsampled));
+        convolve(13, getView(upsampled), getView(merge3, 256), UNET_RELU);
+        convolve(14, getView(merge3), getView(conv), UNET_LINEAR);
+        convolve(15, getView(conv), getView(block2), UNET_LINEAR);
+    }
+    UNetTensor block3 = createTensor(size2, size2, 128);
+    {
+        // 112 * 2 = 224 at full size, padded back to 225 with a row on top and a column on the left
+        UNetTensor upsampled = createTensor(size3 * 2, size3 * 2, 256);
+        UNetTensor up = createTensor(size3 * 2, size3 * 2, 128);
+        UNetTensor conv = createTensor(size2, size2, 128);
+        upsample(getView(block2), getView(upsampled));
+        convolve(16, getView(upsampled), getView(up), UNET_RELU);
+        zeroPad(getView(up), getView(merge2, 128));
+        convolve(17, getView(merge2), getView(conv), UNET_LINEAR);
+        convolve(18, getView(conv), getView(block3), UNET_LINEAR);
+    }
+    UNetTensor output = createTensor(size, size, 1);
+    {
+        UNetTensor upsampled = createTensor(size, size, 128);
+        UNetTensor conv = createTensor(size, size, 64);
+        UNetTensor conv2 = createTensor(size, size, 64);
+        UNetTensor conv3 = createTensor(size, size, 32);
+        upsample(getView(block3), getView(upsampled));
+        convolve(19, getView(upsampled), getView(merge1, 64), UNET_LINEAR);
+        convolve(20, getView(merge1), getView(conv), UNET_LINEAR);
+        convolve(21, getView(conv), getView(conv2), UNET_LINEAR);
+        convolve(22, getView(conv2), getView(conv3), UNET_LINEAR);
+        convolve(23, getView(conv3), getView(output), UNET_TANH);
+    }
+
+    // Heights in [0, 255], the borders are left to the caller (see Inference::clearBorder)
+    cv::Mat heightmap(size, size, CV_32FC1);
+    for (int i = 0; i < size; i++)
+        for (int j = 0; j < size; j++)
+            heightmap.at<float>(i, j) = output.data[i * size + j] * 127.5f + 127.5f;
+
+    return heightmap;
+}
+
+bool UNet::isCancelled()
+{
+    return this->cancel_flag != nullptr && this->cancel_flag->load();
+}
+
+void UNet::convolve(int layer, const UNetView &input, const UNetView &output, int activation)
+{
+    // The remaining layers of a cancelled run are skipped
+    if (isCancelled())
+        return;
+
+    // Split the output rows into bands, one per thread
+    int threads = std::max(1, std::min((int)this->workers.size() + 1, output.height));
+    if (threads == 1)
+    {
+        convolveRows(layer, input, output, activation, 0, output.height);
+        return;
+    }
+
+    // Hand the other bands over to the workers and compute the first one meanwhile
+    {
+        std::lock_guard<std::mutex> lock(this->pool_mutex);
+        this->band_job = [this, layer, &input, &output, activation, threads](int band) {
+            convolveRows(layer, input, output, activation, output.height * band / threads, output.height * (band + 1) / threads);
+        };
+        this->band_count = threads;
+        this->pending_bands = threads - 1;
+        this->convolution_index++;
+    }
+    this->pool_condition.notify_all();
+    convolveRows(layer, input, output, activation, 0, output.height / threads);
+
+    std::unique_lock<std::mutex> lock(this->pool_mutex);
+    this->done_condition.wait(lock, [this] { return this->pending_bands == 0; });
+}
+
+void UNet::work(int band)
+{
+    unsigned long last_index = 0;
+    std::unique_lock<std::mutex> lock(this->pool_mutex);
+    while (true)
+    {
+        this->pool_condition.wait(lock, [this, last_index] { return this->is_stopping || this->convolution_index != last_index; });
+        if (this->is_stopping)
+            return;
+        last_index = this->convolution_index;
+
+        // A small layer may have fewer rows than threads
+        if (band >= this->band_count)
+            continue;
+
+        lock.unlock();
+        this->band_job(band);
+        lock.lock();
+        if (--this->pending_bands == 0)
+            this->done_condition.notify_one();
+    }
+}
+
+void UNet::startWorkers()
+{
+    if (!this->workers.empty())
+        return;
+
+    this->is_stopping = false;
+    for (int band = 1; band < this->thread_count; band++)
+        this->workers.emplace_back(&UNet::work, this, band);
+}
+
+void UNet::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->pool_mutex);
+        this->is_stopping = true;
+    }
+    this->pool_condition.notify_all();
+    for (std::thread &worker : this->workers)
+        worker.join();
+    this->workers.clear();
+}
+
+void UNet::convolveRows(int layer, const UNetView &input, const UNetView &output, int activation, int first_row, int last_row)
+{
+    const UNetLayer &descriptor = this->layers[layer];
+    const int kernel_height = descriptor.kernel_height;
+    const int kernel_width = descriptor.kernel_width;
+    const int in_channels = descriptor.in_channels;
+    const int out_channels = descriptor.out_channels;
+    const float *kernel = getKernel(layer);
+    const float *bias = getBias(layer);
+
+    // 'same' padding: the extra row and column of the even kernels are padded after
+    const int pad_top = (kernel_height - 1) / 2;
+    const int pad_left = (kernel_width - 1) / 2;
+
+    // Stands for the input pixels outside of the map
+    std::vector<float> zeros(in_channels, 0.0f);
+
+    for (int co = 0; co < out_channels; co += UNET_TILE_CHANNELS)
+    {
+        const int tile_channels = std::min(UNET_TILE_CHANNELS, out_channels - co);
+
+        // The weights of a block of input channels stay in cache while the band is swept
+        for (int ci = 0; ci < in_channels; ci += UNET_BLOCK_CHANNELS)
+        {
+            const int block_channels = std::min(UNET_BLOCK_CHANNELS, in_channels - ci);
+            const bool is_first_block = ci == 0;
+            const bool is_last_block = ci + block_channels == in_channels;
+
+            for (int y = first_row; y < last_row; y++)
+            {
+                float *output_row = output.data + (size_t)y * output.width * output.stride + co;
+
+                for (int x = 0; x < output.width; x += UNET_TILE_PIXELS)
+                {
+                    // Start from the bias, or from the sums of the previous blocks
+                    float tile[UNET_TILE_PIXELS][UNET_TILE_CHANNELS];
+                    for (int p = 0; p < UNET_TILE_PIXELS; p++)
+                        for (int c = 0; c < UNET_TILE_CHANNELS; c++)
+                        {
+                            bool is_inside = x + p < output.width && c < tile_channels;
+                            tile[p][c] = !is_inside ? 0.0f : is_first_block ? bias[co + c] : output_row[(size_t)(x + p) * output.stride + c];
+                        }
+
+                    for (int ky = 0; ky < kernel_height; ky++)
+                    {
+                        int input_y = y + ky - pad_top;
+                        if (input_y < 0 || input_y >= input.height)
+                            continue;
+                        const float *input_row = input.data + (size_t)input_y * input.width * input.stride + ci;
+
+                        for (int kx = 0; kx < kernel_width; kx++)
+                        {
+                            const float *pixels[UNET_TILE_PIXELS];
+                            for (int p = 0; p < UNET_TILE_PIXELS; p++)
+                            {
+                                int input_x = x + p + kx - pad_left;
+                                pixels[p] = input_x >= 0 && input_x < input.width ? input_row + (size_t)input_x * input.stride : zeros.data();
+                            }
+
+                            const float *weights = kernel + ((size_t)(ky * kernel_width + kx) * in_channels + ci) * out_channels + co;
+                            if (tile_channels == UNET_TILE_CHANNELS)
+                                accumulate<UNET_TILE_CHANNELS>(tile, pixels, weights, block_channels, out_channels);
+                            else
+                                accumulate(tile, pixels, weights, block_channels, out_channels, tile_channels);
+                        }
+                    }
+
+                    // Store the tile, activated after the last block
+                    for (int p = 0; p < UNET_TILE_PIXELS && x + p < output.width; p++)
+                    {
+                        float *output_pixel = output_row + (size_t)(x + p) * output.stride;
+                        for (int c = 0; c < tile_channels; c++)
+                        {
+                            float value = tile[p][c];
+                            if (is_last_block && activation == UNET_RELU)
+                                value = std::max(value, 0.0f);
+                            else if (is_last_block && activation == UNET_TANH)
+                                value = std::tanh(value);
+                            output_pixel[c] = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+const float *UNet::getKernel(int layer)
+{
+    return reinterpret_cast<const float *>(static_cast<const char *>(this->mapping) + this->layers[layer].kernel_offset);
+}
+
+const float *UNet::getBias(int layer)
+{
+    return reinterpret_cast<const float *>(static_cast<const char *>(this->mapping) + this->layers[layer].bias_offset);
+}
+
+void UNet::release()
+{
+    if (this->mapping == nullptr)
+        return;
+    ResourceRegistry::untrack(this->mapping);
+    munmap(this->mapping, this->mapping_size);
+    this->mapping = nullptr;
+    this->mapping_size = 0;
+    this->layers = nullptr;
+}
+
+UNetTensor UNet::createTensor(int height, int width, int channels)
+{
+    UNetTensor tensor;
+    tensor.height = height;
+    tensor.width = width;
+    tensor.channels = channels;
+    tensor.data.resize((size_t)height * width * channels);
+    return tensor;
+}
+
+UNetView UNet::getView(UNetTensor &tensor, int first_channel, int channels)
+{
+    return UNetView{tensor.data.data() + first_channel, tensor.height, tensor.width,
+                    channels < 0 ? tensor.channels - first_channel : channels, tensor.channels};
+}
+
+void UNet::maxPool(const UNetView &input, const UNetView &output)
+{
+    for (int y = 0; y < output.height; y++)
+        for (int x = 0; x < output.width; x++)
+        {
+            const float *top = input.data + ((size_t)(2 * y) * input.width + 2 * x) * input.stride;
+            const float *bottom = top + (size_t)input.width * input.stride;
+            float *pixel = output.data + ((size_t)y * output.width + x) * output.stride;
+            for (int c = 0; c < output.channels; c++)
+                pixel[c] = std::max(std::max(top[c], top[input.stride + c]), std::max(bottom[c], bottom[input.stride + c]));
+        }
+}
+
+void UNet::upsample(const UNetView &input, const UNetView &output)
+{
+    for (int y = 0; y < output.height; y++)
+        for (int x = 0; x < output.width; x++)
+            memcpy(output.data + ((size_t)y * output.width + x) * output.stride,
+                   input.data + ((size_t)(y / 2) * input.width + x / 2) * input.stride, output.channels * sizeof(float));
+}
+
+void UNet::zeroPad(const UNetView &input, const UNetView &output)
+{
+    int offset_y = output.height - input.height;
+    int offset_x = output.width - input.width;
+    for (int y = 0; y < output.height; y++)
+        for (int x = 0; x < output.width; x++)
+        {
+            float *pixel = output.data + ((size_t)y * output.width + x) * output.stride;
+            if (y < offset_y || x < offset_x)
+                memset(pixel, 0, output.channels * sizeof(float));
+            else
+                memcpy(pixel, input.data + ((size_t)(y - offset_y) * input.width + x - offset_x) * input.stride, output.channels * sizeof(float));
+        }
+}
+
+void UNet::fillNoise(uint32_t seed, const UNetView &output)
+{
+    // numpy's legacy seeding and Mersenne Twister are the standard ones
+    std::mt19937 generator(seed);
+    auto uniform = [&generator]() {
+        uint32_t high = generator() >> 5;
+        uint32_t low = generator() >> 6;
+        return (high * 67108864.0 + low) / 9007199254740992.0;
+    };
+
+    // Polar Box-Muller, keeping the second value for the next sample like numpy's legacy gauss
+    bool has_gauss = false;
+    double gauss = 0.0;
+    for (int y = 0; y < output.height; y++)
+        for (int x = 0; x < output.width; x++)
+        {
+            float *pixel = output.data + ((size_t)y * output.width + x) * output.stride;
+            for (int c = 0; c < output.channels; c++)
+            {
+                if (has_gauss)
+                {
+                    pixel[c] = (float)gauss;
+                    has_gauss = false;
+                    continue;
+                }
+
+                double x1, x2, r2;
+                do
+                {
+                    x1 = 2.0 * uniform() - 1.0;
+                    x2 = 2.0 * uniform() - 1.0;
+                    r2 = x1 * x1 + x2 * x2;
+                } while (r2 >= 1.0 || r2 == 0.0);
+                double f = std::sqrt(-2.0 * std::log(r2) / r2);
+                gauss = f * x1;
+                has_gauss = true;
+                pixel[c] = (float)(f * x2);
+            }
+        }
+}
@@ -0,0 +1,337 @@
+/**
+@file
+@brief UNet header file.
+*/
+
+#ifndef UNET_H
+#define UNET_H
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ResourceRegistry.h"
+#include "Colors.h"
+
+// Header of the converted weights (see src/ConvertWeights.py)
+#define UNET_MAGIC "ECNN"
+#define UNET_VERSION 1
+// Alignment of the tensors in the weights file, in bytes
+#define UNET_ALIGNMENT 64
+
+// Side of the input and output maps (other sizes passing UNet::isValidSize work too), channels of the input sketches and of the noise
+#define UNET_MAP_SIZE 450
+#define UNET_INPUT_CHANNELS 4
+#define UNET_NOISE_SIZE 28
+#define UNET_NOISE_CHANNELS 1024
+// Number of convolutions of the generator
+#define UNET_LAYERS 24
+
+// Activations of the convolutions
+#define UNET_LINEAR 0
+#define UNET_RELU 1
+#define UNET_TANH 2
+
+// Output pixels and output channels computed at once by the convolution kernel, input channels of a cache block
+#define UNET_TILE_PIXELS 8
+#define UNET_TILE_CHANNELS 32
+#define UNET_BLOCK_CHANNELS 128
+
+/**
+ * @brief Descriptor of a convolution in the weights file, 32 bytes on disk.
+ */
+typedef struct
+{
+    uint32_t kernel_height;     ///< Height of the kernel
+    uint32_t kernel_width;      ///< Width of the kernel
+    uint32_t in_channels;       ///< Input channels
+    uint32_t out_channels;      ///< Output channels
+    uint64_t kernel_offset;     ///< Offset in bytes of the HWIO kernel
+    uint64_t bias_offset;       ///< Offset in bytes of the bias
+} UNetLayer;
+
+/**
+ * @brief Activations of a layer, stored as height x width x channels.
+ */
+typedef struct
+{
+    int height;                 ///< Rows
+    int width;                  ///< Columns
+    int channels;               ///< Channels of a pixel
+    std::vector<float> data;    ///< Values, channels last
+} UNetTensor;
+
+/**
+ * @brief Channel range of a tensor, so that a layer can read or write a slice of a concatenation in place.
+ */
+typedef struct
+{
+    float *data;                ///< First channel of the first pixel
+    int height;                 ///< Rows
+    int width;                  ///< Columns
+    int channels;               ///< Channels of the range
+    int stride;                 ///< Distance between two pixels, in floats
+} UNetView;
+
+/**
+ * @brief UNet class which runs the terrain generator natively on the CPU, without Python.
+ *
+ * The architecture is the fixed one built by TerrainGANBuilder in Predict.py: four down blocks of two ReLU 3x3 convolutions and a
+ * 2x2 max pooling, two ReLU 3x3 convolutions concatenated with the noise, four up blocks of a nearest upsampling, a 2x2
+ * convolution (zero padded to the skip connection in the third block) concatenated with the skip connection and two linear 3x3
+ * convolutions, then a 3x3 convolution and a tanh 1x1 convolution. The weights are converted once from model.h5 and memory mapped.
+ *
+ * The noise only enters at the bottleneck, so the down blocks only depend on the sketches: their outputs are kept between the
+ * predictions and a new variant of unchanged sketches (a re-roll) only runs the up blocks.
+ *
+ * Activations are stored channels last and the kernels HWIO, so that the innermost loop of the convolutions runs over contiguous
+ * output channels and is vectorized. The calling thread and a pool of workers, started once the weights are loaded and reused by
+ * every convolution, each compute a band of output rows, tile by tile (UNET_TILE_PIXELS pixels by
+ * UNET_TILE_CHANNELS channels held in registers), with the input channels split into blocks of UNET_BLOCK_CHANNELS so that the
+ * weights of a block stay in cache while the band is swept. The layers write their outputs straight into the concatenations.
+ */
+class UNet
+{
+public:
+    /**
+     * @brief Construct an empty UNet object.
+     */
+    UNet();
+
+    /**
+     * @brief Destroy the UNet object, stopping the workers and unmapping the weights.
+     */
+    ~UNet();
+
+    /**
+     * @brief Map the converted weights and check them against the architecture.
+     *
+     * @param path Path of the weights file
+     * @return true If the weights were mapped
+     * @return false If the file is missing or doesn't match the architecture
+     */
+    bool load(const std::string &path);
+
+    /**
+     * @brief Check if the weights are loaded.
+     *
+     * @return true If loaded
+     * @return false Otherwise
+     */
+    bool isLoaded();
+
+    /**
+     * @brief Generate a heightmap from the input sketches.
+     *
+     * The network is fully convolutional, so any square input whose side passes isValidSize works, e.g. a half resolution preview.
+     *
+     * @param input Square input tensor with UNET_INPUT_CHANNELS channels last, UNET_MAP_SIZE x UNET_MAP_SIZE for the trained size
+     * @param seed Seed of the noise, drawn like numpy.random.RandomState(seed).normal so that both backends get the same noise
+     * @return cv::Mat Square float heightmap of the size of the input, with heights in [0, 255], empty if the input is invalid or
+     * the run was cancelled
+     */
+    cv::Mat predict(const std::vector<float> &input, uint32_t seed);
+
+    /**
+     * @brief Check if the generator can run on a map size, the pooled sizes must match the upsampled ones (450 and 226 do).
+     *
+     * @param size Side of the input map
+     * @return true If the size is supported
+     * @return false Otherwise
+     */
+    static bool isValidSize(int size);
+
+    /**
+     * @brief Set a flag cancelling the runs in progress, checked before each convolution.
+     *
+     * @param cancel_flag Flag raised to cancel, nullptr for none
+     */
+    void setCancelFlag(const std::atomic<bool> *cancel_flag);
+
+    /**
+     * @brief Check if the encoder activations of the input sketches are cached, so that a prediction only runs the decoder.
+     *
+     * @param input Input tensor
+     * @return true If the last encoded input is the same
+     * @return false Otherwise
+     */
+    bool isCached(const std::vector<float> &input);
+
+    /**
+     * @brief Release the cached encoder activations.
+     */
+    void clearCache();
+
+    /**
+     * @brief Fill a view with the noise of a seed, drawn like numpy.random.RandomState(seed).normal(0, 1).
+     *
+     * @param seed Seed of the noise
+     * @param output Noise activations (also used by the other backends)
+     */
+    static void fillNoise(uint32_t seed, const UNetView &output);
+
+private:
+    void *mapping;                          ///< Mapped weights file
+    size_t mapping_size;                    ///< Size of the mapping in bytes
+    const UNetLayer *layers;                ///< Descriptors of the convolutions
+    int thread_count;                       ///< Threads running the convolutions, the caller included
+    std::vector<std::thread> workers;       ///< Workers computing the bands of the convolutions but the first one
+    std::mutex pool_mutex;                  ///< Protects the convolution handed to the workers
+    std::condition_variable pool_condition; ///< Wakes the workers up on a new convolution or on stop
+    std::condition_variable done_condition; ///< Wakes the caller up once the workers are done with their bands
+    std::function<void(int)> band_job;      ///< Computes a band of the convolution in progress
+    int band_count;                         ///< Bands of the convolution in progress
+    int pending_bands;                      ///< Bands of the convolution in progress still running on the workers
+    unsigned long convolution_index;        ///< Incremented for each convolution, so that every worker takes it once
+    bool is_stopping;                       ///< Whether the workers must exit
+    UNetTensor merge1;                      ///< Concatenation of the last up block, the skip connection half is cached
+    UNetTensor merge2;                      ///< Concatenation of the third up block, same
+    UNetTensor merge3;                      ///< Concatenation of the second up block, same
+    UNetTensor merge4;                      ///< Concatenation of the first up block, same
+    UNetTensor bottom;                      ///< Bottleneck concatenated with the noise, the bottleneck half is cached
+    std::vector<float> encoded_input;       ///< Input of the cached encoder activations, empty if nothing is cached
+    const std::atomic<bool> *cancel_flag;   ///< Flag cancelling the runs in progress, nullptr for none
+
+    /**
+     * @brief Run the down blocks and cache their outputs in the concatenations.
+     *
+     * @param input Input tensor
+     * @param size Side of the input map
+     */
+    void encode(const std::vector<float> &input, int size);
+
+    /**
+     * @brief Run the up blocks over the cached encoder activations and the noise already in the bottleneck.
+     *
+     * @return cv::Mat Heightmap
+     */
+    cv::Mat decode();
+
+    /**
+     * @brief Check if the run in progress was cancelled.
+     *
+     * @return true If the cancel flag is raised
+     * @return false Otherwise
+     */
+    bool isCancelled();
+
+    /**
+     * @brief Run a convolution with 'same' padding and stride 1.
+     *
+     * @param layer Index of the convolution
+     * @param input Input activations, with the channels of the layer
+     * @param output Output activations, same size as the input and with the output channels of the layer
+     * @param activation UNET_LINEAR, UNET_RELU or UNET_TANH
+     */
+    void convolve(int layer, const UNetView &input, const UNetView &output, int activation);
+
+    /**
+     * @brief Worker loop, computing its band of each convolution.
+     *
+     * @param band Band computed by the worker, from 1 (the caller computes the first one)
+     */
+    void work(int band);
+
+    /**
+     * @brief Start the workers, if not running yet.
+     */
+    void startWorkers();
+
+    /**
+     * @brief Stop and join the workers.
+     */
+    void stopWorkers();
+
+    /**
+     * @brief Compute a band of output rows of a convolution (run by each thread).
+     *
+     * @param layer Index of the convolution
+     * @param input Input activations
+     * @param output Output activations
+     * @param activation Activation applied after the last block of input channels
+     * @param first_row First output row of the band
+     * @param last_row Row after the last one of the band
+     */
+    void convolveRows(int layer, const UNetView &input, const UNetView &output, int activation, int first_row, int last_row);
+
+    /**
+     * @brief Get the kernel of a convolution.
+     *
+     * @param layer Index of the convolution
+     * @return const float* HWIO kernel
+     */
+    const float *getKernel(int layer);
+
+    /**
+     * @brief Get the bias of a convolution.
+     *
+     * @param layer Index of the convolution
+     * @return const float* Bias of each output channel
+     */
+    const float *getBias(int layer);
+
+    /**
+     * @brief Unmap the weights.
+     */
+    void release();
+
+    /**
+     * @brief Allocate a tensor.
+     *
+     * @param height Rows
+     * @param width Columns
+     * @param channels Channels of a pixel
+     * @return UNetTensor
+     */
+    static UNetTensor createTensor(int height, int width, int channels);
+
+    /**
+     * @brief Get a channel range of a tensor.
+     *
+     * @param tensor Tensor
+     * @param first_channel First channel of the range
+     * @param channels Channels of the range, -1 for all the channels from the first one
+     * @return UNetView
+     */
+    static UNetView getView(UNetTensor &tensor, int first_channel = 0, int channels = -1);
+
+    /**
+     * @brief 2x2 max pooling with stride 2, the last row and column are dropped if the size is odd.
+     *
+     * @param input Input activations
+     * @param output Output activations, half the size of the input
+     */
+    static void maxPool(const UNetView &input, const UNetView &output);
+
+    /**
+     * @brief 2x nearest neighbour upsampling.
+     *
+     * @param input Input activations
+     * @param output Output activations, twice the size of the input
+     */
+    static void upsample(const UNetView &input, const UNetView &output);
+
+    /**
+     * @brief Copy activations into a larger view, zero filling the rows above and the columns on the left.
+     *
+     * @param input Input activations
+     * @param output Output activations, at least as large as the input
+     */
+    static void zeroPad(const UNetView &input, const UNetView &output);
+};
+
+#endif // UNET_H
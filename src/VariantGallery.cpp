@@ -0,0 +1,212 @@
+/**
+@file
+@brief VariantGallery source file.
+*/
+
+#include "VariantGallery.h"
+
+
+VariantGallery *VariantGallery::instance = nullptr;
+
+// Default constructor
+VariantGallery::VariantGallery()
+{
+    if (VariantGallery::instance == nullptr)
+        VariantGallery::instance = this;
+
+    this->is_pending = false;
+    this->vao = 0;
+    this->vbo = 0;
+}
+
+// Destructor
+VariantGallery::~VariantGallery()
+{
+    release();
+    ResourceRegistry::untrack(&this->heightmaps);
+    ResourceRegistry::releaseVertexArray(this->vao);
+    ResourceRegistry::releaseBuffer(this->vbo);
+
+    if (VariantGallery::instance == this)
+        VariantGallery::instance = nullptr;
+}
+
+void VariantGallery::initialize()
+{
+    // Unit quad: x, y, s, t, the first row of a thumbnail is its top
+    const GLfloat vertices[] = {0.0f, 0.0f, 0.0f, 1.0f,
+                                1.0f, 0.0f, 1.0f, 1.0f,
+                                1.0f, 1.0f, 1.0f, 0.0f,
+                                0.0f, 1.0f, 0.0f, 0.0f};
+
+    this->vao = ResourceRegistry::createVertexArray(RESOURCE_MENU);
+    glBindVertexArray(this->vao);
+    this->vbo = ResourceRegistry::createBuffer(RESOURCE_MENU);
+    glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+    ResourceRegistry::bufferData(this->vbo, GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (void *)0);
+    glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (void *)(2 * sizeof(GLfloat)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VariantGallery::draw()
+{
+    upload();
+    if (this->textures.empty())
+        return;
+
+    // One row of square thumbnails centered at the bottom of the window, the numbers below them
+    float width = GlutFramework::getWidth();
+    float height = GlutFramework::getHeight();
+    int count = this->textures.size();
+    float label_height = glutStrokeHeight(GLUT_STROKE_MONO_ROMAN) * VARIANT_LABEL_SCALE;
+    float side = std::min(height * VARIANT_MAX_HEIGHT, (width - VARIANT_MARGIN * (count + 1)) / count);
+    if (side <= 0.0f)
+        return;
+    float left = (width - count * side - (count - 1) * VARIANT_MARGIN) / 2.0f;
+    float bottom = 2.0f * VARIANT_MARGIN + label_height;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_POLYGON_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_BLEND);
+    glEnable(GL_TEXTURE_2D);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glColor3f(1.0f, 1.0f, 1.0f);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, width, 0, height, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+
+    glBindVertexArray(this->vao);
+    for (int i = 0; i < count; i++)
+    {
+        glLoadIdentity();
+        glTranslatef(left + i * (side + VARIANT_MARGIN), bottom, 0.0f);
+        glScalef(side, side, 1.0f);
+        glBindTexture(GL_TEXTURE_2D, this->textures[i]);
+        glDrawArrays(GL_QUADS, 0, 4);
+        Profiler::countDrawCall();
+    }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The glut fonts need the glut window
+    if (!GlutFramework::isHeadless())
+    {
+        glDisable(GL_TEXTURE_2D);
+        float label_width = glutStrokeWidth(GLUT_STROKE_MONO_ROMAN, '1') * VARIANT_LABEL_SCALE;
+        for (int i = 0; i < count; i++)
+        {
+            glLoadIdentity();
+            glTranslatef(left + i * (side + VARIANT_MARGIN) + (side - label_width) / 2.0f, VARIANT_MARGIN, 0.0f);
+            glScalef(VARIANT_LABEL_SCALE, VARIANT_LABEL_SCALE, VARIANT_LABEL_SCALE);
+            glutStrokeCharacter(GLUT_STROKE_MONO_ROMAN, '1' + i);
+        }
+    }
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+void VariantGallery::setVariants(const std::vector<cv::Mat> &heightmaps)
+{
+    // Shrink the heightmaps off the main thread
+    std::vector<cv::Mat> variants(heightmaps.begin(), heightmaps.begin() + std::min((int)heightmaps.size(), VARIANT_MAX_COUNT));
+    std::vector<cv::Mat> thumbnails;
+    size_t bytes = 0;
+    for (const cv::Mat &heightmap : variants)
+    {
+        cv::Mat resized, thumbnail;
+        cv::resize(heightmap, resized, cv::Size(VARIANT_THUMBNAIL_SIZE, VARIANT_THUMBNAIL_SIZE), 0, 0, cv::INTER_AREA);
+        resized.convertTo(thumbnail, CV_8U);
+        thumbnails.push_back(thumbnail);
+        bytes += heightmap.total() * heightmap.elemSize();
+    }
+
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    instance->heightmaps = variants;
+    instance->thumbnails = thumbnails;
+    instance->is_pending = true;
+    ResourceRegistry::track(&instance->heightmaps, RESOURCE_INFERENCE, bytes);
+}
+
+bool VariantGallery::isReady()
+{
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    return !instance->heightmaps.empty();
+}
+
+cv::Mat VariantGallery::choose(int index)
+{
+    cv::Mat heightmap;
+    {
+        std::lock_guard<std::mutex> lock(instance->mutex);
+        if (index < 0 || index >= (int)instance->heightmaps.size())
+            return cv::Mat();
+
+        // The variants of a batch may share a buffer, only keep the chosen one
+        heightmap = instance->heightmaps[index].clone();
+        printf(COLOR_GREEN "Variant %d of %zu chosen\n" COLOR_RESET, index + 1, instance->heightmaps.size());
+        fflush(stdout);
+    }
+
+    clear();
+    return heightmap;
+}
+
+void VariantGallery::clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(instance->mutex);
+        instance->heightmaps.clear();
+        instance->thumbnails.clear();
+        instance->is_pending = false;
+        ResourceRegistry::untrack(&instance->heightmaps);
+    }
+    instance->release();
+}
+
+void VariantGallery::upload()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->is_pending)
+        return;
+    this->is_pending = false;
+
+    release();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (const cv::Mat &thumbnail : this->thumbnails)
+    {
+        GLuint texture = ResourceRegistry::createTexture(RESOURCE_MENU);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, thumbnail.cols, thumbnail.rows, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, thumbnail.data);
+        ResourceRegistry::setTextureSize(texture, thumbnail.total());
+        Profiler::countUpload(thumbnail.total());
+        this->textures.push_back(texture);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    this->thumbnails.clear();
+}
+
+void VariantGallery::release()
+{
+    for (GLuint &texture : this->textures)
+        ResourceRegistry::releaseTexture(texture);
+    this->textures.clear();
+}
@@ -0,0 +1,111 @@
+/**
+@file
+@brief VariantGallery header file.
+*/
+
+#ifndef VARIANTGALLERY_H
+#define VARIANTGALLERY_H
+
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "GlutFramework.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "Colors.h"
+
+// Variants generated at once in the variant mode, chosen with the number keys
+#define VARIANT_COUNT 4
+#define VARIANT_MAX_COUNT 9
+// Side of the thumbnails in texels
+#define VARIANT_THUMBNAIL_SIZE 150
+// Space around the thumbnails in pixels, and fraction of the window height they may take
+#define VARIANT_MARGIN 20.0f
+#define VARIANT_MAX_HEIGHT 0.3f
+// Scale of the stroke font of the numbers
+#define VARIANT_LABEL_SCALE 0.2f
+
+/**
+ * @brief VariantGallery class which shows the candidate heightmaps of a batched generation and hands over the chosen one.
+ *
+ * The generation thread hands the variants over with setVariants, which also shrinks them into 8 bit thumbnails. The thumbnails
+ * are uploaded by the main thread at the next frame and drawn in a numbered row over the loading screen, until a variant is
+ * chosen (number keys) or the gallery is cleared.
+ */
+class VariantGallery
+{
+public:
+    /**
+     * @brief Construct the VariantGallery singleton, empty.
+     */
+    VariantGallery();
+
+    /**
+     * @brief Destroy the VariantGallery singleton, releasing the thumbnails.
+     */
+    ~VariantGallery();
+
+    /**
+     * @brief Create the vertex array of the thumbnail quad, must be called once the OpenGL context exists.
+     */
+    void initialize();
+
+    /**
+     * @brief Upload the new thumbnails if any and draw them with their number, in screen coordinates.
+     */
+    void draw();
+
+    /**
+     * @brief Hand over the variants of a generation, may be called from any thread.
+     *
+     * @param heightmaps Float heightmap of each variant, at most VARIANT_MAX_COUNT
+     */
+    static void setVariants(const std::vector<cv::Mat> &heightmaps);
+
+    /**
+     * @brief Check if variants are waiting to be chosen.
+     *
+     * @return true If the gallery holds variants
+     * @return false Otherwise
+     */
+    static bool isReady();
+
+    /**
+     * @brief Take a variant out of the gallery, which is cleared, must be called by the main thread.
+     *
+     * @param index Index of the variant, from 0
+     * @return cv::Mat Heightmap of the variant, empty if there is no such variant (the gallery is then left unchanged)
+     */
+    static cv::Mat choose(int index);
+
+    /**
+     * @brief Drop the variants and their thumbnails, must be called by the main thread.
+     */
+    static void clear();
+
+private:
+    static VariantGallery *instance;        ///< Used to access the VariantGallery object from the static functions
+
+    std::mutex mutex;                       ///< Protects the variants and the thumbnails handed over by the generation thread
+    std::vector<cv::Mat> heightmaps;        ///< Heightmaps of the variants
+    std::vector<cv::Mat> thumbnails;        ///< 8 bit thumbnails of the variants, waiting for their upload
+    bool is_pending;                        ///< Whether the thumbnails changed since the last upload
+    std::vector<GLuint> textures;           ///< Uploaded thumbnails
+    GLuint vao;                             ///< Vertex array of the thumbnail quad
+    GLuint vbo;                             ///< Positions and texture coordinates of the thumbnail quad
+
+    /**
+     * @brief Replace the uploaded thumbnails with the pending ones, must be called by the main thread.
+     */
+    void upload();
+
+    /**
+     * @brief Release the uploaded thumbnails, must be called by the main thread.
+     */
+    void release();
+};
+
+#endif // VARIANTGALLERY_H
@@ -0,0 +1,431 @@
+/**
+@file
+@brief Vegetation source file.
+*/
+
+#include "Vegetation.h"
+
+
+// Default constructor
+Vegetation::Vegetation()
+{
+    this->terrain = nullptr;
+    this->shader = nullptr;
+    this->chunks_per_side = 0;
+    this->corner_bo = 0;
+    this->stopping = false;
+}
+
+// Destructor
+Vegetation::~Vegetation()
+{
+    reset();
+}
+
+void Vegetation::initialize(Terrain *terrain, Shader *shader)
+{
+    buildGrid(terrain);
+    this->shader = shader;
+
+    // Quad corners shared by every instance: x spans [-1, 1] around the root, y spans [0, 1] from the ground up
+    GLfloat corners[] = {-1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, -1.0f, 1.0f};
+    this->corner_bo = ResourceRegistry::createBuffer(RESOURCE_VEGETATION);
+    glBindBuffer(GL_ARRAY_BUFFER, this->corner_bo);
+    ResourceRegistry::bufferData(this->corner_bo, GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Start the workers, leaving one core to the main thread
+    this->stopping = false;
+    int worker_count = std::max(1, std::min(4, (int)std::thread::hardware_concurrency() - 1));
+    for (int i = 0; i < worker_count; i++)
+        this->workers.emplace_back(&Vegetation::work, this);
+}
+
+void Vegetation::buildGrid(Terrain *terrain)
+{
+    // Release the chunks of the previous world, if any
+    reset();
+
+    this->terrain = terrain;
+
+    int dim = terrain->getDim();
+    float world_scale = terrain->getWorldDim() / dim;
+
+    // Build the chunk grid over the heightmap cells
+    this->chunks_per_side = (dim + VEGETATION_CHUNK_SIZE - 1) / VEGETATION_CHUNK_SIZE;
+    this->chunks.resize(this->chunks_per_side * this->chunks_per_side);
+
+    for (int row = 0; row < this->chunks_per_side; row++)
+    {
+        for (int col = 0; col < this->chunks_per_side; col++)
+        {
+            std::unique_ptr<VegetationChunk> chunk(new VegetationChunk());
+            chunk->row = row;
+            chunk->col = col;
+            chunk->state = CHUNK_EMPTY;
+
+            // Chunk corners in world coordinates (columns map to x, rows map to z)
+            int last_col = std::min((col + 1) * VEGETATION_CHUNK_SIZE, dim - 1);
+            int last_row = std::min((row + 1) * VEGETATION_CHUNK_SIZE, dim - 1);
+            chunk->min_corner.u = (col * VEGETATION_CHUNK_SIZE - dim / 2) * world_scale;
+            chunk->min_corner.v = (row * VEGETATION_CHUNK_SIZE - dim / 2) * world_scale;
+            chunk->max_corner.u = (last_col - dim / 2) * world_scale;
+            chunk->max_corner.v = (last_row - dim / 2) * world_scale;
+
+            this->chunks[row * this->chunks_per_side + col] = std::move(chunk);
+        }
+    }
+}
+
+int Vegetation::getChunkCount()
+{
+    return this->chunks.size();
+}
+
+int Vegetation::scatter(int index)
+{
+    VegetationChunk *chunk = this->chunks[index].get();
+    generate(chunk);
+    return chunk->object.instances.size() / VEGETATION_INSTANCE_STRIDE;
+}
+
+void Vegetation::reset()
+{
+    // Stop the workers, letting them finish the chunk they are generating
+    {
+        std::lock_guard<std::mutex> lock(this->jobs_mutex);
+        this->stopping = true;
+        this->jobs.clear();
+    }
+    this->jobs_condition.notify_all();
+    for (std::thread &worker : this->workers)
+        worker.join();
+    this->workers.clear();
+
+    // Release the chunk buffers
+    for (std::unique_ptr<VegetationChunk> &chunk : this->chunks)
+    {
+        if (chunk->state == CHUNK_UPLOADED)
+            ResourceRegistry::releaseObject(chunk->object);
+    }
+    this->chunks.clear();
+
+    ResourceRegistry::releaseBuffer(this->corner_bo);
+}
+
+void Vegetation::work()
+{
+    while (true)
+    {
+        int index;
+
+        // Wait for a job or for the stop request
+        {
+            std::unique_lock<std::mutex> lock(this->jobs_mutex);
+            this->jobs_condition.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+            if (this->stopping)
+                return;
+            index = this->jobs.front();
+            this->jobs.pop_front();
+        }
+
+        generate(this->chunks[index].get());
+        this->chunks[index]->state = CHUNK_READY;
+    }
+}
+
+void Vegetation::generate(VegetationChunk *chunk)
+{
+    float width = chunk->max_corner.u - chunk->min_corner.u;
+    float depth = chunk->max_corner.v - chunk->min_corner.v;
+
+    // Seed the generator with the chunk coordinates so that a chunk always gets the same bushes
+    std::mt19937 generator(VEGETATION_SEED ^ (chunk->row * 73856093u) ^ (chunk->col * 19349663u));
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    // Bridson's Poisson-disk sampling, run once per density level: each pass starts from the samples of the previous
+    // levels and fills the gaps with half the radius, so the samples of the first levels are evenly spread on their own
+    std::vector<Vec2<float>> samples;
+    int sample_counts[VEGETATION_LEVELS];
+
+    for (int level = 0; level < VEGETATION_LEVELS; level++)
+    {
+        float radius = VEGETATION_RADIUS * (float)(1 << (VEGETATION_LEVELS - 1 - level));
+        float cell_size = radius / std::sqrt(2.0f);
+        int grid_width = (int)std::ceil(width / cell_size);
+        int grid_depth = (int)std::ceil(depth / cell_size);
+
+        // Background grid storing at most one sample per cell
+        std::vector<int> grid(grid_width * grid_depth, -1);
+        auto cellOf = [&](Vec2<float> sample) {
+            int i = std::min((int)(sample.v / cell_size), grid_depth - 1);
+            int j = std::min((int)(sample.u / cell_size), grid_width - 1);
+            return i * grid_width + j;
+        };
+
+        // The chunks are generated independently, in any order: keep the samples half a radius away from the edges shared
+        // with a neighbour chunk, so that two samples on both sides of a seam are still a radius apart without clumping
+        float margin = radius * 0.5f;
+        float min_u = chunk->col > 0 ? margin : 0.0f;
+        float min_v = chunk->row > 0 ? margin : 0.0f;
+        float max_u = chunk->col < this->chunks_per_side - 1 ? width - margin : width;
+        float max_v = chunk->row < this->chunks_per_side - 1 ? depth - margin : depth;
+
+        // Samples of the previous levels are all seeds for the new pass
+        std::vector<int> active;
+        for (int k = 0; k < (int)samples.size(); k++)
+        {
+            grid[cellOf(samples[k])] = k;
+            active.push_back(k);
+        }
+        if (samples.empty() && min_u < max_u && min_v < max_v)
+        {
+            samples.push_back(Vec2<float>(min_u + uniform(generator) * (max_u - min_u), min_v + uniform(generator) * (max_v - min_v)));
+            grid[cellOf(samples.back())] = 0;
+            active.push_back(0);
+        }
+
+        while (!active.empty())
+        {
+            int a = generator() % active.size();
+            Vec2<float> origin = samples[active[a]];
+            bool found = false;
+
+            // Try a few candidates in the annulus [radius, 2 * radius] around the active sample
+            for (int attempt = 0; attempt < 30 && !found; attempt++)
+            {
+                float angle = uniform(generator) * 2.0f * M_PI;
+                float distance = radius * (1.0f + uniform(generator));
+                Vec2<float> candidate(origin.u + std::cos(angle) * distance, origin.v + std::sin(angle) * distance);
+
+                if (candidate.u < min_u || candidate.u >= max_u || candidate.v < min_v || candidate.v >= max_v)
+                    continue;
+
+                // Reject the candidate if any sample in the neighbouring cells is too close
+                int candidate_i = (int)(candidate.v / cell_size);
+                int candidate_j = (int)(candidate.u / cell_size);
+                bool is_far = true;
+                for (int i = std::max(0, candidate_i - 2); i <= std::min(grid_depth - 1, candidate_i + 2) && is_far; i++)
+                {
+                    for (int j = std::max(0, candidate_j - 2); j <= std::min(grid_width - 1, candidate_j + 2) && is_far; j++)
+                    {
+                        int neighbour = grid[i * grid_width + j];
+                        if (neighbour >= 0)
+                        {
+                            Vec2<float> difference = subtract(samples[neighbour], candidate);
+                            if (dot(difference, difference) < radius * radius)
+                                is_far = false;
+                        }
+                    }
+                }
+
+                if (is_far)
+                {
+                    samples.push_back(candidate);
+                    grid[cellOf(candidate)] = samples.size() - 1;
+                    active.push_back(samples.size() - 1);
+                    found = true;
+                }
+            }
+
+            // Retire the sample once its surroundings are full
+            if (!found)
+            {
+                active[a] = active.back();
+                active.pop_back();
+            }
+        }
+
+        sample_counts[level] = samples.size();
+    }
+
+    // Turn the samples into instances, dropping the submerged ones
+    int water_level = this->terrain->getWaterLevel();
+    float highlands = this->terrain->getBounds()->max_y * 0.4;
+
+    chunk->object.instances.clear();
+    int level = 0;
+    for (int k = 0; k < (int)samples.size(); k++)
+    {
+        while (k == sample_counts[level])
+            chunk->level_counts[level++] = chunk->object.instances.size() / VEGETATION_INSTANCE_STRIDE;
+
+        float x = chunk->min_corner.u + samples[k].u;
+        float z = chunk->min_corner.v + samples[k].v;
+        float y = getHeight(x, z);
+
+        if (y > water_level + WAVE_MACRO_AMPLITUDE)
+        {
+            chunk->object.instances.push_back(x);
+            chunk->object.instances.push_back(y);
+            chunk->object.instances.push_back(z);
+            chunk->object.instances.push_back(BUSH_SIZE);
+
+            // Lowland bushes use the left half of the atlas, highland bushes the right half
+            chunk->object.instances.push_back(y < highlands ? 0.0f : 1.0f);
+        }
+    }
+    while (level < VEGETATION_LEVELS)
+        chunk->level_counts[level++] = chunk->object.instances.size() / VEGETATION_INSTANCE_STRIDE;
+}
+
+void Vegetation::upload(VegetationChunk *chunk)
+{
+    GLint corner = this->shader->getAttribute("corner");
+    GLint position = this->shader->getAttribute("instance");
+    GLint species = this->shader->getAttribute("species");
+
+    // Generate the vertex array object for the chunk
+    chunk->object.vao = ResourceRegistry::createVertexArray(RESOURCE_VEGETATION);
+    // Bind the vertex array object for the chunk
+    glBindVertexArray(chunk->object.vao);
+
+    // Bind the shared corner buffer object
+    glBindBuffer(GL_ARRAY_BUFFER, this->corner_bo);
+    glEnableVertexAttribArray(corner);
+    glVertexAttribPointer(corner, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    // Bind and fill the instance buffer object once
+    chunk->object.instance_bo = ResourceRegistry::createBuffer(RESOURCE_VEGETATION);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->object.instance_bo);
+    ResourceRegistry::bufferData(chunk->object.instance_bo, GL_ARRAY_BUFFER, chunk->object.instances.size() * sizeof(float), chunk->object.instances.data(), GL_STATIC_DRAW);
+    Profiler::countUpload(chunk->object.instances.size() * sizeof(float));
+    glEnableVertexAttribArray(position);
+    glVertexAttribPointer(position, 4, GL_FLOAT, GL_FALSE, VEGETATION_INSTANCE_STRIDE * sizeof(float), (void *)0);
+    glVertexAttribDivisor(position, 1);
+    glEnableVertexAttribArray(species);
+    glVertexAttribPointer(species, 1, GL_FLOAT, GL_FALSE, VEGETATION_INSTANCE_STRIDE * sizeof(float), (void *)(4 * sizeof(float)));
+    glVertexAttribDivisor(species, 1);
+
+    // Unbind everything
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The CPU copy is not needed anymore
+    chunk->object.instances.clear();
+    chunk->object.instances.shrink_to_fit();
+}
+
+void Vegetation::update(Vec2<float> position)
+{
+    // Queue the chunks entering the far range, closest first
+    std::vector<std::pair<float, int>> requests;
+    for (int index = 0; index < (int)this->chunks.size(); index++)
+    {
+        if (this->chunks[index]->state != CHUNK_EMPTY)
+            continue;
+
+        float distance = getDistance(this->chunks[index].get(), position);
+        if (distance < VEGETATION_FAR_DISTANCE)
+            requests.push_back(std::make_pair(distance, index));
+    }
+
+    if (!requests.empty())
+    {
+        std::sort(requests.begin(), requests.end());
+        {
+            std::lock_guard<std::mutex> lock(this->jobs_mutex);
+            for (std::pair<float, int> &request : requests)
+            {
+                this->chunks[request.second]->state = CHUNK_PENDING;
+                this->jobs.push_back(request.second);
+            }
+        }
+        this->jobs_condition.notify_all();
+    }
+
+    // Upload a few generated chunks per frame to avoid spikes
+    int uploads = 0;
+    for (std::unique_ptr<VegetationChunk> &chunk : this->chunks)
+    {
+        if (uploads == VEGETATION_UPLOADS_PER_FRAME)
+            break;
+
+        if (chunk->state == CHUNK_READY)
+        {
+            upload(chunk.get());
+            chunk->state = CHUNK_UPLOADED;
+            uploads++;
+        }
+    }
+}
+
+void Vegetation::draw(Vec2<float> position, Vec2<float> direction)
+{
+    direction = normalize(direction);
+
+    for (std::unique_ptr<VegetationChunk> &chunk : this->chunks)
+    {
+        if (chunk->state != CHUNK_UPLOADED)
+            continue;
+
+        // Pick the density level from the distance
+        float distance = getDistance(chunk.get(), position);
+        int count;
+        if (distance < VEGETATION_NEAR_DISTANCE)
+            count = chunk->level_counts[VEGETATION_LEVELS - 1];
+        else if (distance < VEGETATION_MID_DISTANCE)
+            count = chunk->level_counts[VEGETATION_LEVELS - 2];
+        else if (distance < VEGETATION_FAR_DISTANCE)
+            count = chunk->level_counts[0];
+        else
+            continue;
+
+        if (count == 0 || !isInFrustum(chunk.get(), position, direction))
+            continue;
+
+        // Draw one camera-facing quad per instance
+        glBindVertexArray(chunk->object.vao);
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, count);
+        Profiler::countDrawCall();
+    }
+
+    glBindVertexArray(0);
+}
+
+float Vegetation::getHeight(float x, float z)
+{
+    Vec3<float> *map = this->terrain->getHeightmap();
+    int dim = this->terrain->getDim();
+    float world_scale = this->terrain->getWorldDim() / dim;
+
+    // Continuous heightmap coordinates
+    float j = std::min(std::max(x / world_scale + dim / 2, 0.0f), dim - 1.001f);
+    float i = std::min(std::max(z / world_scale + dim / 2, 0.0f), dim - 1.001f);
+    int i0 = (int)i;
+    int j0 = (int)j;
+    float di = i - i0;
+    float dj = j - j0;
+
+    float top = map[i0 * dim + j0].y * (1 - dj) + map[i0 * dim + j0 + 1].y * dj;
+    float bottom = map[(i0 + 1) * dim + j0].y * (1 - dj) + map[(i0 + 1) * dim + j0 + 1].y * dj;
+    return top * (1 - di) + bottom * di;
+}
+
+float Vegetation::getDistance(VegetationChunk *chunk, Vec2<float> position)
+{
+    float du = std::max(std::max(chunk->min_corner.u - position.u, 0.0f), position.u - chunk->max_corner.u);
+    float dv = std::max(std::max(chunk->min_corner.v - position.v, 0.0f), position.v - chunk->max_corner.v);
+    return std::sqrt(du * du + dv * dv);
+}
+
+bool Vegetation::isInFrustum(VegetationChunk *chunk, Vec2<float> position, Vec2<float> direction)
+{
+    // The chunk below the camera is always visible
+    if (getDistance(chunk, position) == 0)
+        return true;
+
+    float fov_angle = cos(FOV_ANGLE * M_PI / 180.0f);
+    Vec2<float> corners[4] = {
+        chunk->min_corner,
+        Vec2<float>(chunk->max_corner.u, chunk->min_corner.v),
+        Vec2<float>(chunk->min_corner.u, chunk->max_corner.v),
+        chunk->max_corner};
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (dot(normalize(subtract(corners[k], position)), direction) > fov_angle)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,185 @@
+/**
+@file
+@brief Vegetation header file.
+*/
+
+#ifndef VEGETATION_H
+#define VEGETATION_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include "Vec.hpp"
+#include "Object.h"
+#include "Shader.h"
+#include "Terrain.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "Constants.h"
+
+// Vegetation chunk states
+#define CHUNK_EMPTY 0       ///< Not generated yet
+#define CHUNK_PENDING 1     ///< Queued or being generated by a worker
+#define CHUNK_READY 2       ///< Generated, waiting to be uploaded by the main thread
+#define CHUNK_UPLOADED 3    ///< Resident on the GPU and drawable
+
+/**
+ * @brief Square portion of the terrain holding its own bushes.
+ */
+typedef struct VegetationChunk
+{
+    Vec2<float> min_corner;                     ///< Minimum (x, z) corner of the chunk in world coordinates
+    Vec2<float> max_corner;                     ///< Maximum (x, z) corner of the chunk in world coordinates
+    int row;                                    ///< Row of the chunk in the chunk grid
+    int col;                                    ///< Column of the chunk in the chunk grid
+    std::atomic<int> state;                     ///< Generation state of the chunk
+    int level_counts[VEGETATION_LEVELS];        ///< Cumulative number of instances up to each density level
+    Object object;                              ///< Instance buffers of the chunk
+} VegetationChunk;
+
+/**
+ * @brief Vegetation class which scatters, streams and draws the bushes chunk by chunk.
+ *
+ * The terrain is split into a grid of chunks. A chunk is generated lazily by a pool of worker threads the first time
+ * the camera gets close to it, using a deterministic seeded Poisson-disk scatter, and is then uploaded once by the main thread.
+ * The scatter is built in nested density levels (each level fills the gaps left by the previous one with half the radius),
+ * so that drawing a prefix of the instances yields a sparser but still evenly spread set: far chunks only draw the first levels.
+ * Each level keeps its samples half its radius away from the edges shared with the neighbour chunks, so that the spacing holds
+ * across the seams whatever order the chunks are generated in.
+ */
+class Vegetation
+{
+public:
+    /**
+     * @brief Construct a new Vegetation object.
+     */
+    Vegetation();
+
+    /**
+     * @brief Destroy the Vegetation object, stopping the workers and releasing the chunks.
+     */
+    ~Vegetation();
+
+    /**
+     * @brief Initialize the chunk grid over a new terrain and start the workers.
+     *
+     * @param terrain Terrain object reference
+     * @param shader Vegetation shader, used to retrieve the attribute locations
+     */
+    void initialize(Terrain *terrain, Shader *shader);
+
+    /**
+     * @brief Split a terrain into the chunk grid, without starting the workers nor creating OpenGL objects.
+     *
+     * @param terrain Terrain object reference
+     */
+    void buildGrid(Terrain *terrain);
+
+    /**
+     * @brief Get the number of chunks of the grid.
+     *
+     * @return int
+     */
+    int getChunkCount();
+
+    /**
+     * @brief Scatter the bushes of a chunk on the calling thread (used by the micro-benchmarks).
+     *
+     * @param index Index of the chunk in the grid
+     * @return int Number of bushes above the water
+     */
+    int scatter(int index);
+
+    /**
+     * @brief Queue the generation of the chunks close to the camera and upload the generated ones.
+     *
+     * Must be called from the thread owning the OpenGL context.
+     *
+     * @param position Position of the camera in world coordinates
+     */
+    void update(Vec2<float> position);
+
+    /**
+     * @brief Draw the visible chunks with a density depending on their distance from the camera.
+     *
+     * @param position Position of the camera in world coordinates
+     * @param direction Direction of the camera in world coordinates
+     */
+    void draw(Vec2<float> position, Vec2<float> direction);
+
+    /**
+     * @brief Stop the workers and release every chunk.
+     */
+    void reset();
+
+private:
+    Terrain *terrain;                                       ///< Terrain object reference
+    Shader *shader;                                         ///< Vegetation shader reference
+    int chunks_per_side;                                    ///< Number of chunks on each side of the grid
+    std::vector<std::unique_ptr<VegetationChunk>> chunks;   ///< Chunk grid
+    GLuint corner_bo;                                       ///< Quad corners buffer shared by every chunk
+
+    std::vector<std::thread> workers;                       ///< Worker threads generating the chunks
+    std::deque<int> jobs;                                   ///< Indexes of the chunks waiting to be generated
+    std::mutex jobs_mutex;                                  ///< Protects the jobs queue and the stopping flag
+    std::condition_variable jobs_condition;                 ///< Wakes up the workers when new jobs are queued
+    bool stopping;                                          ///< Tells the workers to exit
+
+    /**
+     * @brief Worker loop consuming the jobs queue.
+     */
+    void work();
+
+    /**
+     * @brief Scatter the bushes of a chunk (runs on a worker thread).
+     *
+     * @param chunk Chunk to generate
+     */
+    void generate(VegetationChunk *chunk);
+
+    /**
+     * @brief Upload the instances of a generated chunk.
+     *
+     * @param chunk Chunk to upload
+     */
+    void upload(VegetationChunk *chunk);
+
+    /**
+     * @brief Get the terrain height at a world position by bilinear interpolation of the heightmap.
+     *
+     * @param x World x-coordinate
+     * @param z World z-coordinate
+     * @return float
+     */
+    float getHeight(float x, float z);
+
+    /**
+     * @brief Get the distance between a position and the closest point of a chunk.
+     *
+     * @param chunk Chunk to measure
+     * @param position Position in world coordinates
+     * @return float
+     */
+    float getDistance(VegetationChunk *chunk, Vec2<float> position);
+
+    /**
+     * @brief Check if a chunk is in the frustum, with the same angular test used by the quadtree.
+     *
+     * @param chunk Chunk to check
+     * @param position Position of the camera in world coordinates
+     * @param direction Normalized direction of the camera in world coordinates
+     * @return true If the chunk is in the frustum
+     * @return false If the chunk is not in the frustum
+     */
+    bool isInFrustum(VegetationChunk *chunk, Vec2<float> position, Vec2<float> direction);
+};
+
+#endif // VEGETATION_H
@@ -0,0 +1,236 @@
+/**
+@file
+@brief VideoStream source file.
+*/
+
+#include "VideoStream.h"
+
+
+// Default constructor
+VideoStream::VideoStream()
+{
+    this->width = 0;
+    this->height = 0;
+    this->frame_time = std::chrono::duration<double>(1.0 / VIDEO_DEFAULT_FPS);
+    this->texture = 0;
+    for (int i = 0; i < VIDEO_PBO_COUNT; i++)
+        this->pbos[i] = 0;
+    this->current_pbo = 0;
+    this->has_frame = false;
+    this->read_index = 0;
+    this->write_index = 0;
+    this->frame_count = 0;
+    this->is_playing = false;
+    this->is_rewinding = false;
+    this->stopping = false;
+}
+
+// Destructor
+VideoStream::~VideoStream()
+{
+    release();
+}
+
+bool VideoStream::open(const char *path)
+{
+    if (!this->capture.open(path))
+    {
+        std::cerr << COLOR_RED << "Failed to open the clip " << path << COLOR_RESET << std::endl;
+        return false;
+    }
+
+    this->width = static_cast<int>(this->capture.get(cv::CAP_PROP_FRAME_WIDTH));
+    this->height = static_cast<int>(this->capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    double fps = this->capture.get(cv::CAP_PROP_FPS);
+    this->frame_time = std::chrono::duration<double>(1.0 / (fps > 0 ? fps : VIDEO_DEFAULT_FPS));
+    this->frames.resize(VIDEO_RING_SIZE);
+
+    // Allocate the texture storage once: every frame is then uploaded with glTexSubImage2D
+    this->texture = ResourceRegistry::createTexture(RESOURCE_MENU);
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (GLEW_ARB_texture_storage)
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, this->width, this->height);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, this->width, this->height, 0, GL_BGR, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    ResourceRegistry::setTextureSize(this->texture, (size_t)this->width * this->height * 4);
+
+    // Allocate the pixel buffer objects
+    for (int i = 0; i < VIDEO_PBO_COUNT; i++)
+    {
+        this->pbos[i] = ResourceRegistry::createBuffer(RESOURCE_MENU);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbos[i]);
+        ResourceRegistry::bufferData(this->pbos[i], GL_PIXEL_UNPACK_BUFFER, this->width * this->height * 3, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // Start the decoder, paused until the clip is played or prefetched
+    this->stopping = false;
+    this->decoder = std::thread(&VideoStream::decode, this);
+
+    return true;
+}
+
+void VideoStream::setPlaying(bool is_playing)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->ring_mutex);
+        if (this->is_playing == is_playing)
+            return;
+        this->is_playing = is_playing;
+    }
+    this->ring_condition.notify_one();
+}
+
+void VideoStream::rewind()
+{
+    {
+        // Drop the decoded frames here, so that the main thread never reads a slot the decoder is rewriting
+        std::lock_guard<std::mutex> lock(this->ring_mutex);
+        this->read_index = 0;
+        this->write_index = 0;
+        this->frame_count = 0;
+        this->is_rewinding = true;
+    }
+    this->ring_condition.notify_one();
+    this->has_frame = false;
+}
+
+void VideoStream::decode()
+{
+    while (true)
+    {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(this->ring_mutex);
+            this->ring_condition.wait(lock, [this]{ return this->stopping || this->is_rewinding || (this->is_playing && this->frame_count < VIDEO_RING_SIZE); });
+
+            if (this->stopping)
+                return;
+
+            if (this->is_rewinding)
+            {
+                this->capture.set(cv::CAP_PROP_POS_FRAMES, 0);
+                this->is_rewinding = false;
+                continue;
+            }
+
+            slot = this->write_index;
+        }
+
+        // Decode outside of the lock: the slot is free until it is published
+        if (!this->capture.read(this->frames[slot]))
+        {
+            // Loop the clip
+            this->capture.set(cv::CAP_PROP_POS_FRAMES, 0);
+            if (!this->capture.read(this->frames[slot]))
+            {
+                std::lock_guard<std::mutex> lock(this->ring_mutex);
+                this->is_playing = false;
+                continue;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->ring_mutex);
+            // A rewind requested while decoding makes this frame stale
+            if (this->is_rewinding)
+                continue;
+            this->write_index = (this->write_index + 1) % VIDEO_RING_SIZE;
+            this->frame_count++;
+        }
+    }
+}
+
+void VideoStream::update()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (this->has_frame && now < this->next_frame_time)
+        return;
+
+    // Never wait for the decoder: if no frame is ready, keep showing the current one
+    int slot;
+    {
+        std::lock_guard<std::mutex> lock(this->ring_mutex);
+        if (this->frame_count == 0)
+            return;
+        slot = this->read_index;
+    }
+
+    const cv::Mat &frame = this->frames[slot];
+    if (frame.cols == this->width && frame.rows == this->height && frame.isContinuous())
+    {
+        GLsizeiptr size = this->width * this->height * 3;
+
+        // Copy the frame into a pixel buffer object, invalidating its previous content so that the driver doesn't stall
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbos[this->current_pbo]);
+        void *pointer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (pointer)
+        {
+            memcpy(pointer, frame.data, size);
+            Profiler::countUpload(size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            // The upload is sourced from the bound pixel buffer object and returns immediately
+            glBindTexture(GL_TEXTURE_2D, this->texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->width, this->height, GL_BGR, GL_UNSIGNED_BYTE, 0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            this->has_frame = true;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        this->current_pbo = (this->current_pbo + 1) % VIDEO_PBO_COUNT;
+    }
+
+    // Free the slot for the decoder
+    {
+        std::lock_guard<std::mutex> lock(this->ring_mutex);
+        this->read_index = (this->read_index + 1) % VIDEO_RING_SIZE;
+        this->frame_count--;
+    }
+    this->ring_condition.notify_one();
+
+    // Keep the clip cadence, without catching up after the clip has been paused
+    this->next_frame_time += std::chrono::duration_cast<std::chrono::steady_clock::duration>(this->frame_time);
+    if (this->next_frame_time < now)
+        this->next_frame_time = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(this->frame_time);
+}
+
+bool VideoStream::hasFrame()
+{
+    return this->has_frame;
+}
+
+GLuint VideoStream::getTexture()
+{
+    return this->texture;
+}
+
+void VideoStream::release()
+{
+    // Stop the decoder
+    if (this->decoder.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->ring_mutex);
+            this->stopping = true;
+        }
+        this->ring_condition.notify_one();
+        this->decoder.join();
+    }
+
+    this->capture.release();
+    this->frames.clear();
+    this->has_frame = false;
+
+    // Delete the OpenGL objects
+    ResourceRegistry::releaseTexture(this->texture);
+    for (int i = 0; i < VIDEO_PBO_COUNT; i++)
+        ResourceRegistry::releaseBuffer(this->pbos[i]);
+}
@@ -0,0 +1,126 @@
+/**
+@file
+@brief VideoStream header file.
+*/
+
+#ifndef VIDEOSTREAM_H
+#define VIDEOSTREAM_H
+
+#include <GL/glew.h>
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include "Colors.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+
+// Number of decoded frames buffered ahead of the displayed one
+#define VIDEO_RING_SIZE 4
+// Number of pixel buffer objects used to upload the frames
+#define VIDEO_PBO_COUNT 2
+// Frame rate used when the clip doesn't report its own
+#define VIDEO_DEFAULT_FPS 40
+
+/**
+ * @brief Video clip decoded in the background and streamed into a texture.
+ *
+ * Each clip owns a decoder thread filling a small ring of frames while the clip is playing (or being prefetched), so that the main
+ * loop never waits for the decoder. Frames are uploaded through a pair of pixel buffer objects into a texture with immutable storage
+ * allocated once: the copy into the buffer and the glTexSubImage2D call return immediately, the transfer is done by the driver.
+ */
+class VideoStream
+{
+public:
+    /**
+     * @brief Construct a new Video Stream object.
+     */
+    VideoStream();
+
+    /**
+     * @brief Destroy the Video Stream object, stopping the decoder.
+     */
+    ~VideoStream();
+
+    /**
+     * @brief Open a clip, allocate its texture and upload buffers and start the (paused) decoder thread.
+     *
+     * @param path Path of the clip
+     * @return true If the clip was opened
+     * @return false If the clip couldn't be opened
+     */
+    bool open(const char *path);
+
+    /**
+     * @brief Let the decoder fill the ring or pause it.
+     *
+     * @param is_playing Whether the decoder should keep the ring full
+     */
+    void setPlaying(bool is_playing);
+
+    /**
+     * @brief Restart the clip from the first frame, dropping the frames already decoded.
+     */
+    void rewind();
+
+    /**
+     * @brief Upload the next decoded frame if it is due, without ever waiting for the decoder.
+     *
+     * Must be called from the thread owning the OpenGL context.
+     */
+    void update();
+
+    /**
+     * @brief Check if a frame has been uploaded since the clip was opened or rewound.
+     *
+     * @return true If the texture holds a frame
+     * @return false If the texture is still empty
+     */
+    bool hasFrame();
+
+    /**
+     * @brief Get the texture holding the current frame.
+     *
+     * @return GLuint
+     */
+    GLuint getTexture();
+
+    /**
+     * @brief Stop the decoder and release the clip and its OpenGL objects.
+     */
+    void release();
+
+private:
+    cv::VideoCapture capture;                   ///< Clip being decoded
+    int width;                                  ///< Frame width
+    int height;                                 ///< Frame height
+    std::chrono::duration<double> frame_time;   ///< Time each frame stays on screen
+    std::chrono::steady_clock::time_point next_frame_time; ///< Time at which the next frame is due
+
+    GLuint texture;                             ///< Texture with immutable storage holding the current frame
+    GLuint pbos[VIDEO_PBO_COUNT];               ///< Pixel buffer objects used to upload the frames
+    int current_pbo;                            ///< Pixel buffer object used by the next upload
+    bool has_frame;                             ///< Whether the texture holds a frame
+
+    std::vector<cv::Mat> frames;                ///< Ring of decoded frames
+    int read_index;                             ///< Index of the oldest decoded frame
+    int write_index;                            ///< Index of the slot the decoder writes next
+    int frame_count;                            ///< Number of decoded frames in the ring
+    bool is_playing;                            ///< Whether the decoder should keep the ring full
+    bool is_rewinding;                          ///< Tells the decoder to restart the clip
+    bool stopping;                              ///< Tells the decoder to exit
+    std::mutex ring_mutex;                      ///< Protects the ring indexes and the flags
+    std::condition_variable ring_condition;     ///< Wakes up the decoder when a slot is freed or the flags change
+    std::thread decoder;                        ///< Decoder thread
+
+    /**
+     * @brief Decoder loop, looping the clip forever.
+     */
+    void decode();
+};
+
+#endif // VIDEOSTREAM_H
@@ -11,28 +11,91 @@
 #include "InputHandler.h"
 #include "GlutFramework.h"
 #include "SoundManager.h"
+#include "AssetManager.h"
+#include "FrameScheduler.h"
+#include "Profiler.h"
+#include "InputRecorder.h"
+#include "ResourceRegistry.h"
+#include <cstring>
 
 using namespace std;
 
-// Global objects variables
+// Global objects variables, the registry is destroyed last so that the others release their resources through it
+ResourceRegistry resource_registry;
+AssetManager asset_manager;
 Camera camera;
 InputHandler input_handler;
 GlutFramework glut_framework;
 SoundManager sound_manager;
 Renderer renderer;
 QuadTree quadtree;
+FrameScheduler frame_scheduler;
+Profiler profiler;
+InputRecorder input_recorder;
 
 int main(int argc, char **argv)
 {
+    // Start decoding the assets in background while the window is being created
+    AssetManager::prefetch();
+    
     // Initialize the framework
     glut_framework.initialize(argc, argv);
     
+    // Record the session with --record <path> or replay a recording with --replay <path>
+    // Bound the memory with --gpu-budget <MB> and --host-budget <MB> (0 disables a budget)
+    // Save the generated heightmaps in background with --save-heightmap 1
+    // Compare the C++ generator with the Python one with --validate-inference 1
+    // Generate worlds several model inputs wide, from overlapping tiles, with --world-tiles <tiles per side>
+    // Bound the cache of the generated heightmaps on disk with --generation-cache <MB> (0 disables it)
+    // Configure ONNX Runtime with --onnx-threads <intra-op>, --onnx-inter-threads <inter-op> and --onnx-optimization <0-3>
+    size_t gpu_budget = GPU_MEMORY_BUDGET;
+    size_t host_budget = HOST_MEMORY_BUDGET;
+    int onnx_settings[] = {ONNX_INTRA_OP_THREADS, ONNX_INTER_OP_THREADS, ONNX_OPTIMIZATION_LEVEL};
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--record") && !input_recorder.startRecording(argv[i + 1]))
+            return 1;
+        else if (!strcmp(argv[i], "--replay") && !input_recorder.startReplay(argv[i + 1]))
+            return 1;
+        else if (!strcmp(argv[i], "--gpu-budget"))
+            gpu_budget = strtoull(argv[i + 1], nullptr, 10) * 1024 * 1024;
+        else if (!strcmp(argv[i], "--host-budget"))
+            host_budget = strtoull(argv[i + 1], nullptr, 10) * 1024 * 1024;
+        else if (!strcmp(argv[i], "--save-heightmap"))
+            Inference::setSaving(atoi(argv[i + 1]) != 0);
+        else if (!strcmp(argv[i], "--validate-inference"))
+            Inference::setValidation(atoi(argv[i + 1]) != 0);
+        else if (!strcmp(argv[i], "--world-tiles"))
+            Inference::setWorldTiles(atoi(argv[i + 1]));
+        else if (!strcmp(argv[i], "--generation-cache"))
+            GenerationCache::setBudget(strtoull(argv[i + 1], nullptr, 10) * 1024 * 1024);
+        else if (!strcmp(argv[i], "--onnx-threads"))
+            onnx_settings[0] = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--onnx-inter-threads"))
+            onnx_settings[1] = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--onnx-optimization"))
+            onnx_settings[2] = atoi(argv[i + 1]);
+    }
+    ResourceRegistry::setBudget(gpu_budget, host_budget);
+#ifdef USE_ONNXRUNTIME
+    OnnxGenerator::configure(onnx_settings[0], onnx_settings[1], onnx_settings[2]);
+#endif
+    
+    // Create the profiler queries
+    profiler.initialize();
+    
+    // Initialize the sounds
+    sound_manager.initialize();
+    
     // Initialize the inputs
     input_handler.initialize(&camera, &renderer, &sound_manager, &quadtree);
     
     // Initialize the mesh
     renderer.initialize(&camera, &quadtree);
     
+    // Pace the frames and run the simulation steps
+    frame_scheduler.initialize(&camera, &input_handler, &renderer);
+    
     // Run the framework
     glut_framework.run();
 }
\ No newline at end of file
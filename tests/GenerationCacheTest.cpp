@@ -0,0 +1,100 @@
+/**
+@file
+@brief Tests of the generation cache. Runs in a temporary folder, without a display, and returns 1 if a check fails.
+*/
+
+#include <opencv2/opencv.hpp>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "GenerationCache.h"
+#include "Colors.h"
+
+using namespace std;
+
+static int failures = 0;
+
+/**
+ * @brief Report a check, counting it as a failure if its condition is false.
+ *
+ * @param condition Checked condition
+ * @param name Description of the check
+ */
+static void check(bool condition, const char *name)
+{
+    if (condition)
+        printf(COLOR_GREEN "passed" COLOR_RESET " %s\n", name);
+    else
+        printf(COLOR_RED "FAILED" COLOR_RESET " %s\n", name);
+    failures += condition ? 0 : 1;
+}
+
+/**
+ * @brief Build a small heightmap whose heights all equal a value.
+ *
+ * @param value Height of every pixel
+ * @return cv::Mat Float heightmap
+ */
+static cv::Mat makeHeightmap(float value)
+{
+    cv::Mat heightmap(16, 16, CV_32FC1);
+    heightmap.setTo(value);
+    return heightmap;
+}
+
+// A batch whose variants are only partly cached keeps the cached ones, and counts one hit or miss per variant
+static void testPartialBatch()
+{
+    vector<float> input(8 * 8 * 4, 0.5f);
+    vector<string> keys;
+    for (uint32_t seed = 0; seed < 4; seed++)
+        keys.push_back(GenerationCache::getKey(input, seed, "model|test"));
+    GenerationCache::save(keys[0], makeHeightmap(10.0f));
+    GenerationCache::save(keys[2], makeHeightmap(30.0f));
+
+    int hits = GenerationCache::getHits();
+    int misses = GenerationCache::getMisses();
+    vector<cv::Mat> heightmaps;
+    vector<size_t> missing = GenerationCache::loadBatch(keys, heightmaps);
+
+    check(missing == vector<size_t>({1, 3}), "partial batch: only the variants missing from the cache are generated");
+    check(heightmaps.size() == 4 && !heightmaps[0].empty() && !heightmaps[2].empty(), "partial batch: the cached variants are kept");
+    check(heightmaps[1].empty() && heightmaps[3].empty(), "partial batch: the missing variants are left empty");
+    check(!heightmaps[0].empty() && heightmaps[0].at<float>(5, 5) == 10.0f && heightmaps[2].at<float>(5, 5) == 30.0f,
+          "partial batch: each cached variant is read back at its index");
+    check(GenerationCache::getHits() - hits == 2 && GenerationCache::getMisses() - misses == 2, "partial batch: one hit or miss per variant");
+}
+
+// A disabled cache gives empty keys, which are neither hits nor misses
+static void testDisabledKeys()
+{
+    int hits = GenerationCache::getHits();
+    int misses = GenerationCache::getMisses();
+    vector<cv::Mat> heightmaps;
+    vector<size_t> missing = GenerationCache::loadBatch(vector<string>(3), heightmaps);
+
+    check(missing.size() == 3 && heightmaps.size() == 3, "disabled cache: every variant is generated");
+    check(GenerationCache::getHits() == hits && GenerationCache::getMisses() == misses, "disabled cache: nothing is counted");
+}
+
+int main()
+{
+    // The cache folder is relative to the working directory, keep it away from the real one
+    char directory[] = "/tmp/earthcraft-tests-XXXXXX";
+    if (mkdtemp(directory) == nullptr || chdir(directory) != 0 || mkdir("assets", 0755) != 0)
+    {
+        printf(COLOR_RED "Failed to create a temporary folder\n" COLOR_RESET);
+        return 1;
+    }
+
+    testPartialBatch();
+    testDisabledKeys();
+
+    string command = string("rm -rf ") + directory;
+    if (system(command.c_str()) != 0)
+        printf(COLOR_YELLOW "Failed to remove %s\n" COLOR_RESET, directory);
+    printf("%d check(s) failed\n", failures);
+    return failures > 0 ? 1 : 0;
+}